@@ -5,6 +5,7 @@ PackageImport["GeneralUtilities`"]
 PackageExport["AcyclicGraphTake"]
 
 PackageScope["acyclicGraphTake"]
+PackageScope["dagQ"]
 
 (* Utility function to check for directed, acyclic graphs *)
 dagQ[graph_] := AcyclicGraphQ[graph] && DirectedGraphQ[graph] && LoopFreeGraphQ[graph]
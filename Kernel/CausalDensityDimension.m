@@ -4,6 +4,14 @@ PackageImport["GeneralUtilities`"]
 
 PackageExport["CausalDensityDimension"]
 
+importLibSetReplaceFunction[
+  "causalGraphDiamondCounts" -> cpp$causalGraphDiamondCounts,
+  {Integer,                  (* vertex count *)
+   {Integer, 1, "Constant"}, (* {source, target, source, target, ...} *)
+   Integer,                  (* start vertex *)
+   Integer},                 (* end vertex *)
+  {Integer, 1}];             (* {vertex count, comparable pair count} *)
+
 (* Documentation *)
 SetUsage @ "
 CausalDensityDimension[graph$, vertices$] gives an estimate of the dimension of a subgraph of the graph graph$ \
@@ -32,12 +40,29 @@ expr : CausalDensityDimension[causalGraph_, vertices_] := ModuleScope[
 (* Normal form *)
 causalDensityDimension[causalGraph_, vertices_] := Module[{d},
   With[{
-    diamond = TransitiveClosureGraph[acyclicGraphTake[causalGraph, vertices]]},
-    If[EmptyGraphQ[diamond],
+    counts = causalDiamondCounts[causalGraph, vertices]},
+    If[counts[[2]] == 0,
       Infinity
     ,
       Replace[d, FindRoot[
-        {EdgeCount[diamond] / ((VertexCount[diamond])^2) == (Gamma[d + 1] * Gamma[d / 2])/(4 Gamma[3 d / 2])},
+        {counts[[2]] / (counts[[1]]^2) == (Gamma[d + 1] * Gamma[d / 2])/(4 Gamma[3 d / 2])},
         {d, 1, 0, Infinity}]]]
   ]
 ]
+
+(* {vertex count, edge count of the transitive closure} of the diamond. libSetReplace computes it with bitsets, which
+   avoids constructing the transitive closure graph. Invalid arguments are reported by acyclicGraphTake. *)
+causalDiamondCounts[graph_ ? dagQ, {startVertex_, endVertex_}] /;
+    $libSetReplaceAvailable && EdgeCount[graph] > 0 && VertexQ[graph, startVertex] && VertexQ[graph, endVertex] :=
+  With[{vertexIndices = First /@ PositionIndex[VertexList[graph]] - 1},
+    cpp$causalGraphDiamondCounts[
+      VertexCount[graph],
+      Flatten @ Map[vertexIndices, List @@@ EdgeList[graph][[All, {1, 2}]], {2}],
+      vertexIndices[startVertex],
+      vertexIndices[endVertex]]
+  ];
+
+causalDiamondCounts[graph_, vertices_] := With[{
+    diamond = TransitiveClosureGraph[acyclicGraphTake[graph, vertices]]},
+  {VertexCount[diamond], EdgeCount[diamond]}
+];
@@ -4,6 +4,12 @@ PackageImport["GeneralUtilities`"]
 
 PackageExport["HypergraphUnifications"]
 
+importLibSetReplaceFunction[
+  "hypergraphUnifications" -> cpp$hypergraphUnifications,
+  {{Integer, 1, "Constant"},  (* first hypergraph *)
+   {Integer, 1, "Constant"}}, (* second hypergraph *)
+  {Integer, 1}];              (* {count, edge indices...} *)
+
 (* Documentation *)
 
 SetUsage @ "
@@ -26,6 +32,16 @@ HypergraphUnifications[args___] := ModuleScope[
 
 hypergraphUnifications[args___] /; !Developer`CheckArgumentCount[HypergraphUnifications[args], 2, 2] := Throw[$Failed];
 
+(* libSetReplace tracks vertex identifications with a union-find structure instead of constructing a Graph for each
+   match, and only returns the pairs of identified edges. Invalid edges are reported by the Wolfram Language
+   implementation. *)
+
+hypergraphUnifications[e1_List, e2_List] /; $libSetReplaceAvailable && AllTrue[e1, ListQ] && AllTrue[e2, ListQ] :=
+  decodeUnifications[
+    Map[$$1, e1, {2}],
+    Map[$$2, e2, {2}],
+    cpp$hypergraphUnifications[encodeHypergraph[e1], encodeHypergraph[e2]]];
+
 hypergraphUnifications[e1_List, e2_List] := With[{
     uniqueE1 = Map[$$1, e1, {2}], uniqueE2 = Map[$$2, e2, {2}]},
   findUnion[uniqueE1, uniqueE2, ##] & @@@
@@ -34,6 +50,33 @@ hypergraphUnifications[e1_List, e2_List] := With[{
       {overlaps_} -> overlaps]
 ];
 
+encodeHypergraph[hypergraph_] := With[{vertexIndices = First /@ PositionIndex[Catenate[hypergraph]]},
+  Flatten @ {Length @ hypergraph, {Length @ #, #} & /@ Map[vertexIndices, hypergraph, {2}]}
+];
+
+(* Edge indices are 0-based positions in the unified hypergraph for each edge of the first and then of the second
+   hypergraph. The edges at the same position are the identified ones, and their pairs are ordered by the first edge,
+   same as in findRemainingOverlaps. The unified hypergraphs are then constructed by findUnion, so that their vertices
+   are numbered the same way as without libSetReplace. *)
+
+decodeUnifications[_, _, {0}] := {};
+
+decodeUnifications[e1_, e2_, {count_, edgeIndices___}] :=
+  With[{edgeMatch = identifiedEdges[Length[e1], #]},
+    findUnion[
+      e1,
+      e2,
+      edgeMatch,
+      Fold[combinedVertexMatch[#1, e1[[#2[[1]]]], e2[[#2[[2]]]]] &, emptyVertexMatch[], List @@@ Normal[edgeMatch]]]
+  ] & /@ Partition[{edgeIndices}, Length[e1] + Length[e2]];
+
+identifiedEdges[e1Length_, edgeIndices_] := With[{
+    e2EdgesByIndex = AssociationThread[edgeIndices[[e1Length + 1 ;;]] -> Range[Length[edgeIndices] - e1Length]]},
+  Association @ Select[
+    Thread[Range[e1Length] -> Lookup[e2EdgesByIndex, edgeIndices[[;; e1Length]], Missing[]]],
+    !MissingQ[Last[#]] &]
+];
+
 hypergraphUnifications[e : Except[_List], _] := hypergraphNotListFail[e];
 
 hypergraphUnifications[_, e : Except[_List]] := hypergraphNotListFail[e];
@@ -0,0 +1,30 @@
+Package["SetReplace`"]
+
+PackageImport["GeneralUtilities`"]
+
+PackageScope["hypergraphBallVolumes"]
+
+importLibSetReplaceFunction[
+  "atomsGraphBallVolumes" -> cpp$atomsGraphBallVolumes,
+  {{Integer, 1, "Constant"}, (* hypergraph *)
+   Integer,                  (* hyperedge connectivity *)
+   {Integer, 1, "Constant"}, (* centers *)
+   Integer},                 (* max radius *)
+  {Integer, 2}];             (* {center, radius} -> volume *)
+
+(* Each hyperedge is converted either to a path or to a clique of its vertices, the resulting graph is undirected. *)
+
+$hyperedgeConnectivityCodes = <|"Path" -> 0, "Clique" -> 1|>;
+
+(* Returns a packed matrix of the numbers of vertices within distances 0 through maxRadius from each of the centers.
+   The centers must be vertices of the hypergraph. This is much faster than computing GraphDistance on the output of
+   HypergraphToGraph because balls are grown in C++, 64 centers at a time. *)
+
+hypergraphBallVolumes[hypergraph_, centers_, maxRadius_, connectivity_ : "Path"] := ModuleScope[
+  vertexIndices = First /@ PositionIndex[Catenate[hypergraph]];
+  cpp$atomsGraphBallVolumes[
+    Flatten @ {Length @ hypergraph, {Length @ #, #} & /@ Map[vertexIndices, hypergraph, {2}]},
+    $hyperedgeConnectivityCodes[connectivity],
+    vertexIndices /@ centers,
+    maxRadius]
+];
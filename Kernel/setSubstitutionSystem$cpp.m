@@ -3,6 +3,8 @@ Package["SetReplace`"]
 PackageImport["GeneralUtilities`"]
 
 PackageScope["setSubstitutionSystem$cpp"]
+PackageScope["$lastLibSetReplaceStatistics"]
+PackageScope["$lastLibSetReplaceMemoryUsage"]
 
 importLibSetReplaceFunction[
   "hypergraphSubstitutionSystemInitialize" -> cpp$setInitialize,
@@ -14,13 +16,14 @@ importLibSetReplaceFunction[
    {Integer, 1, "Constant"}, (* ordering function index, forward / reverse, function, forward / reverse, ... *)
    Integer,                  (* event deduplication *)
    (* random seed, passed as two numbers because LibraryLink does not support unsigned ints *)
-   {Integer, 1, "Constant"}},
+   {Integer, 1, "Constant"},
+   Integer},                 (* state deduplication *)
   "Void"];
 
 importLibSetReplaceFunction[
   "hypergraphSubstitutionSystemReplace" -> cpp$setReplace,
   {Integer,                   (* set ID *)
-   {Integer, 1, "Constant"},  (* {events, generations, atoms, max expressions per atom, expressions} *)
+   {Integer, 1, "Constant"},  (* {events, generations, atoms, max expressions per atom, expressions, memory bytes} *)
    Real},                     (* time constraint *)
   "Void"];
 
@@ -34,6 +37,16 @@ importLibSetReplaceFunction[
   {Integer},     (* set ID *)
   {Integer, 1}]; (* expressions *)
 
+importLibSetReplaceFunction[
+  "hypergraphSubstitutionSystemStates" -> cpp$setStates,
+  {Integer},     (* set ID *)
+  {Integer, 1}]; (* token ID lists *)
+
+importLibSetReplaceFunction[
+  "hypergraphSubstitutionSystemStateTransitions" -> cpp$setStateTransitions,
+  {Integer},     (* set ID *)
+  {Integer, 1}]; (* {source state, target state, event, source state, target state, event, ...} *)
+
 importLibSetReplaceFunction[
   "hypergraphSubstitutionSystemMaxCompleteGeneration" -> cpp$maxCompleteGeneration,
   {Integer}, (* set ID *)
@@ -44,6 +57,16 @@ importLibSetReplaceFunction[
   {Integer}, (* set ID *)
   Integer];  (* reason *)
 
+importLibSetReplaceFunction[
+  "hypergraphSubstitutionSystemStatistics" -> cpp$statistics,
+  {Integer},     (* set ID *)
+  {Integer, 1}]; (* {counters, timers in nanoseconds} *)
+
+importLibSetReplaceFunction[
+  "hypergraphSubstitutionSystemMemoryUsage" -> cpp$memoryUsage,
+  {Integer},     (* set ID *)
+  {Integer, 1}]; (* {tokens, events, separation, atoms index, matches, state graph} in bytes *)
+
 (* The following code turns a nested list into a single list, prepending sizes of each sublist. I.e., {{a}, {b, c, d}}
    becomes {2, 1, a, 3, b, c, d}, where the first 2 is the length of the entire list, and 1 and 3 are the lengths of
    sublists. *)
@@ -117,6 +140,7 @@ $terminationReasonCodes = <|
   6 -> $fixedPoint,
   7 -> $Aborted,
   8 -> $timeConstraint
+  (* 9 is the memory limit, which WolframModel does not set *)
 |>;
 
 (* GlobalSpacelike is syntactic sugar for "EventSelectionFunction" -> "MultiwaySpacelike", "MaxDestroyerEvents" -> 1 *)
@@ -137,6 +161,8 @@ $orderingFunctionCodes = <|
   $expressionIDs -> 2,
   $ruleIndex -> 3,
   $any -> 4,
+  $maxInputGeneration -> 5,
+  $minInputGeneration -> 6,
   $forward -> 0,
   $backward -> 1
 |>;
@@ -146,6 +172,58 @@ $eventDeduplicationCodes = <|
   $sameInputSetIsomorphicOutputs -> 1
 |>;
 
+(* Same order as Statistics::Counter and Statistics::Timer in libSetReplace/Statistics.hpp. *)
+
+$statisticsCounterNames = {
+  "MatchAttempts",
+  "ArityPrunes",
+  "BindingFailures",
+  "SeparationFailures",
+  "CandidateSelections",
+  "MatchesInserted",
+  "DuplicateMatches",
+  "MatchesRemoved",
+  "DeduplicationComparisons",
+  "IndexLookups",
+  "IndexInsertions",
+  "IndexRemovals",
+  "CostEstimates",
+  "StaleMatchesSkipped"};
+
+$statisticsTimerNames = {"CandidateSelection", "Deduplication", "MatchInsertion", "MatchRemoval", "IndexUpdate"};
+
+(* libSetReplace returns an empty list if it is compiled without statistics *)
+
+decodeStatistics[{}] := Missing["NotAvailable"];
+
+decodeStatistics[list_List] := <|
+  "Counters" -> AssociationThread[$statisticsCounterNames -> Take[list, Length[$statisticsCounterNames]]],
+  "Timers" -> AssociationThread[
+    $statisticsTimerNames -> (Quantity[#, "Nanoseconds"] & /@ Drop[list, Length[$statisticsCounterNames]])]
+|>;
+
+decodeStatistics[_] := Missing["NotAvailable"];
+
+(* Statistics of the most recent evolution, used for profiling. *)
+
+$lastLibSetReplaceStatistics = Missing["NotAvailable"];
+
+(* Same order as HypergraphSubstitutionSystem::MemoryUsage in libSetReplace/HypergraphSubstitutionSystem.hpp. *)
+
+$memoryUsageNames = {"Tokens", "Events", "Separation", "AtomsIndex", "Matches", "StateGraph"};
+
+decodeMemoryUsage[list : {___Integer}] /; Length[list] == Length[$memoryUsageNames] :=
+  Quantity[#, "Bytes"] & /@ AssociationThread[$memoryUsageNames -> list];
+
+decodeMemoryUsage[_] := Missing["NotAvailable"];
+
+(* Memory taken by the system at the end of the most recent evolution. *)
+
+$lastLibSetReplaceMemoryUsage = Missing["NotAvailable"];
+
+(* States are not tracked by WolframModel at the moment, so the state graph is always disabled. *)
+$stateDeduplicationDisabled = 0;
+
 setSubstitutionSystem$cpp[
         rules_, set_, stepSpec_, returnOnAbortQ_, timeConstraint_, eventOrderingFunction_, eventSelectionFunction_,
         eventDeduplication_] /;
@@ -174,20 +252,25 @@ setSubstitutionSystem$cpp[
     maxDestroyerEvents[stepSpec[$maxDestroyerEvents], eventSelectionFunction],
     Catenate[Replace[eventOrderingFunction, $orderingFunctionCodes, {2}]],
     Replace[eventDeduplication, $eventDeduplicationCodes],
-    IntegerDigits[RandomInteger[{0, $maxUInt32}], 2^16, 2]
+    IntegerDigits[RandomInteger[{0, $maxUInt32}], 2^16, 2],
+    $stateDeduplicationDisabled
   ];
 
   CheckAbort[
     cpp$setReplace[
       setID,
-      stepSpec /@ {
-          $maxEvents, $maxGenerationsLocal, $maxFinalVertices, $maxFinalVertexDegree, $maxFinalExpressions} /.
-        {Infinity | (_ ? MissingQ) -> $unset},
+      Append[
+        stepSpec /@ {
+            $maxEvents, $maxGenerationsLocal, $maxFinalVertices, $maxFinalVertexDegree, $maxFinalExpressions} /.
+          {Infinity | (_ ? MissingQ) -> $unset},
+        $unset (* memory limit *)],
       timeConstraint /. Infinity -> $unset]
   ,
     If[!returnOnAbortQ, Abort[]]
   ];
 
+  $lastLibSetReplaceStatistics = decodeStatistics[cpp$statistics[setID]];
+  $lastLibSetReplaceMemoryUsage = decodeMemoryUsage[cpp$memoryUsage[setID]];
   terminationReason = $terminationReasonCodes[cpp$terminationReason[setID]];
   If[(terminationReason === $timeConstraint) && !returnOnAbortQ, Return @ $Aborted];
   terminationReason = Replace[terminationReason, $notTerminated -> $timeConstraint];
@@ -30,6 +30,8 @@ PackageScope["$reverseSortedExpressionIDs"]
 PackageScope["$expressionIDs"]
 PackageScope["$ruleIndex"]
 PackageScope["$any"]
+PackageScope["$maxInputGeneration"]
+PackageScope["$minInputGeneration"]
 PackageScope["$forward"]
 PackageScope["$backward"]
 
@@ -192,6 +194,10 @@ $eventOrderingFunctions = <|
   "ReverseRuleOrdering" -> {$expressionIDs, $backward},
   "RuleIndex" -> {$ruleIndex, $forward},
   "ReverseRuleIndex" -> {$ruleIndex, $backward},
+  "OldestGeneration" -> {$maxInputGeneration, $forward},
+  "NewestGeneration" -> {$maxInputGeneration, $backward},
+  "OldestInputGeneration" -> {$minInputGeneration, $forward},
+  "NewestInputGeneration" -> {$minInputGeneration, $backward},
   "Random" -> Nothing, (* Random is done automatically in C++ if no more sorting is available *)
   "Any" -> {$any, $forward} (* OrderingDirection here doesn't do anything *)
 |>;
@@ -259,16 +265,10 @@ atomPatternQ[pattern_Pattern ? (AtomQ[#[[1]]] && #[[2]] === Blank[] &)] := True;
 atomPatternQ[_] := False;
 
 inertConditionSimpleRuleQ[
-    (* empty expressions/subsets are not supported in the input, conditions are not supported *)
+    (* empty expressions/subsets are not supported in the input, conditions are not supported, disconnected inputs
+       are matched one connected component at a time *)
     inertCondition[left : {{__ ? atomPatternQ}..}, True]
-    :> right : Module[{___ ? AtomQ} (* newly created atoms *), {{___ ? AtomQ}...}]] := Module[{p},
-  ConnectedGraphQ @ Graph[
-    Flatten[Apply[
-        UndirectedEdge,
-        (Partition[#, 2, 1] & /@ (Append[#, #[[1]]] &) /@ left),
-        {2}]]
-      /. x_Pattern :> p[x[[1]]]]
-];
+    :> right : Module[{___ ? AtomQ} (* newly created atoms *), {{___ ? AtomQ}...}]] := True;
 
 inertConditionSimpleRuleQ[___] := False;
 
@@ -291,8 +291,8 @@ General::noLowLevel =
   "Low level implementation was not compiled for your system type.";
 
 General::lowLevelNotImplemented =
-  "Low level implementation is only available for local rules, " <>
-  "and only for sets of lists (hypergraphs).";
+  "Low level implementation is only available for rules with nonempty inputs consisting of atoms and atom patterns, " <>
+  "and without conditions, and only for sets of lists (hypergraphs).";
 
 General::symbNotImplemented =
   "Custom event ordering, selection and deduplication are only available for local rules, " <>
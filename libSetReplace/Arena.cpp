@@ -0,0 +1,105 @@
+#include "Arena.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+
+namespace SetReplace {
+namespace {
+// Chunks start small, so that small systems (e.g., the ones used for isomorphism checks) do not take much memory, and
+// double in size up to the size of a huge page.
+constexpr size_t firstChunkSize = size_t(1) << 14;
+constexpr size_t hugePageSize = size_t(1) << 21;
+}  // namespace
+
+Arena::Arena(const bool useHugePages) : useHugePages_(useHugePages), nextChunkSize_(firstChunkSize) {}
+
+Arena::~Arena() {
+  for (auto* list : {chunks_, largeAllocations_}) {
+    while (list) {
+      Allocation* const next = list->next;
+      releaseToSystem(list);
+      list = next;
+    }
+  }
+}
+
+void* Arena::allocate(const size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > maxPooledSize) {
+    return allocateFromSystem(sizeof(Allocation) + bytes, false) + 1;
+  }
+  FreeBlock*& freeBlock = freeBlocks_[sizeClass(bytes)];
+  if (freeBlock) {
+    FreeBlock* const result = freeBlock;
+    freeBlock = result->next;
+    return result;
+  }
+  return allocateFromChunk((sizeClass(bytes) + 1) * alignment);
+}
+
+void Arena::deallocate(void* const pointer, const size_t bytes) noexcept {
+  if (!pointer) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > maxPooledSize) {
+    Allocation* const allocation = static_cast<Allocation*>(pointer) - 1;
+    if (allocation->previous) {
+      allocation->previous->next = allocation->next;
+    } else {
+      largeAllocations_ = allocation->next;
+    }
+    if (allocation->next) allocation->next->previous = allocation->previous;
+    releaseToSystem(allocation);
+    return;
+  }
+  FreeBlock*& freeBlock = freeBlocks_[sizeClass(bytes)];
+  freeBlock = new (pointer) FreeBlock{freeBlock};
+}
+
+size_t Arena::reservedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reservedBytes_;
+}
+
+void* Arena::allocateFromChunk(const size_t blockSize) {
+  if (static_cast<size_t>(chunkEnd_ - chunkPosition_) < blockSize) {
+    // The rest of the current chunk is smaller than maxPooledSize, so it is not worth keeping.
+    Allocation* const chunk = allocateFromSystem(nextChunkSize_, true);
+    chunkPosition_ = reinterpret_cast<char*>(chunk + 1);
+    chunkEnd_ = reinterpret_cast<char*>(chunk) + chunk->size;
+    nextChunkSize_ = std::min(2 * nextChunkSize_, hugePageSize);
+  }
+  void* const result = chunkPosition_;
+  chunkPosition_ += blockSize;
+  return result;
+}
+
+Arena::Allocation* Arena::allocateFromSystem(const size_t size, const bool isChunk) {
+  const bool isHuge = useHugePages_ && size >= hugePageSize;
+  void* const memory = isHuge ? ::operator new(size, std::align_val_t(hugePageSize)) : ::operator new(size);
+#ifdef MADV_HUGEPAGE
+  // Only a hint, the memory is still usable if transparent huge pages are disabled.
+  if (isHuge) madvise(memory, size, MADV_HUGEPAGE);
+#endif
+  Allocation*& list = isChunk ? chunks_ : largeAllocations_;
+  Allocation* const allocation = new (memory) Allocation{nullptr, list, size};
+  if (list) list->previous = allocation;
+  list = allocation;
+  reservedBytes_ += size;
+  return allocation;
+}
+
+void Arena::releaseToSystem(Allocation* const allocation) noexcept {
+  const size_t size = allocation->size;
+  reservedBytes_ -= size;
+  if (useHugePages_ && size >= hugePageSize) {
+    ::operator delete(allocation, std::align_val_t(hugePageSize));
+  } else {
+    ::operator delete(allocation);
+  }
+}
+}  // namespace SetReplace
@@ -0,0 +1,142 @@
+#ifndef LIBSETREPLACE_ARENA_HPP_
+#define LIBSETREPLACE_ARENA_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace SetReplace {
+/** @brief Pooled memory resource, which takes memory from the system in large chunks, and only returns it all at once
+ * on destruction.
+ * @details Small allocations are carved from the chunks, and freed blocks are kept in per-size free lists for reuse.
+ * Larger ones (e.g., vector storage and hash table buckets) are taken from the system individually, but are released
+ * with the arena as well if they are not deallocated before that. This is thread-safe.
+ *
+ * Containers use it through ArenaAllocator. The node-based containers of HypergraphSubstitutionSystem allocate one
+ * block per element, so keeping them in an arena avoids the overhead of the general-purpose heap, and keeps the nodes
+ * of each structure close to each other.
+ */
+class Arena {
+ public:
+  /** @brief Alignment of all allocations, the same as of malloc.
+   */
+  static constexpr size_t alignment = alignof(std::max_align_t);
+
+  /** @brief Allocations larger than this are taken from the system individually.
+   */
+  static constexpr size_t maxPooledSize = 256;
+
+  /** @brief Creates an empty arena, no memory is taken until the first allocation.
+   * @param useHugePages if true, chunks are aligned to, and eventually sized as, 2 MiB huge pages, and the kernel is
+   * advised to back them with transparent huge pages where supported (Linux). This reduces TLB misses on large
+   * systems, at the cost of taking memory in larger increments.
+   */
+  explicit Arena(bool useHugePages = false);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /** @brief Releases all memory, including the blocks that were never deallocated.
+   */
+  ~Arena();
+
+  /** @brief Allocates at least bytes bytes aligned to Arena::alignment.
+   */
+  void* allocate(size_t bytes);
+
+  /** @brief Returns a block for reuse, bytes should be the same as passed to allocate().
+   */
+  void deallocate(void* pointer, size_t bytes) noexcept;
+
+  /** @brief Creates an object in the arena that is never destroyed.
+   * @details The object is only released as part of the arena, so it should only own memory allocated from the same
+   * arena. This skips destroying large structures element by element, which otherwise takes a noticeable time.
+   */
+  template <typename T, typename... Args>
+  T& make(Args&&... args) {
+    static_assert(alignof(T) <= alignment, "over-aligned types are not supported");
+    return *new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /** @brief Total size of the memory taken from the system, which includes unused space in chunks and free lists.
+   */
+  size_t reservedBytes() const;
+
+ private:
+  // Block sizes are multiples of alignment, so there is a free list for each multiple up to maxPooledSize.
+  static constexpr size_t sizeClassCount = maxPooledSize / alignment;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  // Chunks and large allocations start with this header, which links them into lists released on destruction.
+  struct alignas(alignment) Allocation {
+    Allocation* previous;
+    Allocation* next;
+    size_t size;
+  };
+
+  static size_t sizeClass(const size_t bytes) { return (std::max<size_t>(bytes, 1) - 1) / alignment; }
+
+  void* allocateFromChunk(size_t blockSize);
+  Allocation* allocateFromSystem(size_t size, bool isChunk);
+  void releaseToSystem(Allocation* allocation) noexcept;
+
+  const bool useHugePages_;
+  mutable std::mutex mutex_;
+  std::array<FreeBlock*, sizeClassCount> freeBlocks_ = {};
+  // Unused space at the end of the current chunk.
+  char* chunkPosition_ = nullptr;
+  char* chunkEnd_ = nullptr;
+  size_t nextChunkSize_;
+  Allocation* chunks_ = nullptr;
+  Allocation* largeAllocations_ = nullptr;
+  size_t reservedBytes_ = 0;
+};
+
+/** @brief Standard allocator interface to an Arena, which is shared by all copies of the allocator.
+ * @details The arena should outlive all containers and shared pointers using it. Nested containers should use
+ * std::scoped_allocator_adaptor, so that the inner ones are allocated from the same arena.
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+
+  template <typename U>
+  // NOLINTNEXTLINE(runtime/explicit): allocators of different types are converted implicitly by the containers
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+  T* allocate(const size_t count) {
+    static_assert(alignof(T) <= Arena::alignment, "over-aligned types are not supported");
+    if (count > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+    return static_cast<T*>(arena_->allocate(count * sizeof(T)));
+  }
+
+  void deallocate(T* const pointer, const size_t count) noexcept { arena_->deallocate(pointer, count * sizeof(T)); }
+
+  Arena* arena() const noexcept { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept {
+    return arena_ == other.arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+    return arena_ != other.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_ARENA_HPP_
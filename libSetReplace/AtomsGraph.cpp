@@ -0,0 +1,235 @@
+#include "AtomsGraph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+// Each bit of a mask corresponds to a center in the current batch.
+using CentersMask = uint64_t;
+constexpr int64_t batchSize = 64;
+
+// Index of the lowest set bit using a de Bruijn sequence, https://www.chessprogramming.org/BitScan
+int lowestBitIndex(const CentersMask mask) {
+  constexpr CentersMask deBruijnSequence = 0x03f79d71b4cb0a89;
+  constexpr int indices[64] = {0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+                               62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+                               63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+                               46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6};
+  return indices[((mask & (~mask + 1)) * deBruijnSequence) >> 58];
+}
+}  // namespace
+
+class AtomsGraph::Implementation {
+ private:
+  std::vector<Atom> atoms_;
+  std::unordered_map<Atom, int64_t> atomIndices_;
+  std::vector<int64_t> neighborOffsets_;
+  std::vector<int64_t> neighbors_;
+
+ public:
+  Implementation(const std::vector<AtomsVector>& hyperedges, const HyperedgeConnectivity connectivity) {
+    if (connectivity != HyperedgeConnectivity::Path && connectivity != HyperedgeConnectivity::Clique) {
+      throw Error::InvalidConnectivity;
+    }
+
+    for (const auto& hyperedge : hyperedges) {
+      for (const auto atom : hyperedge) {
+        if (atomIndices_.emplace(atom, static_cast<int64_t>(atoms_.size())).second) atoms_.push_back(atom);
+      }
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    const auto addEdge = [this, &edges](const Atom first, const Atom second) {
+      if (first == second) return;
+      const int64_t firstIndex = atomIndices_.at(first);
+      const int64_t secondIndex = atomIndices_.at(second);
+      edges.emplace_back(firstIndex, secondIndex);
+      edges.emplace_back(secondIndex, firstIndex);
+    };
+    for (const auto& hyperedge : hyperedges) {
+      if (connectivity == HyperedgeConnectivity::Path) {
+        for (size_t i = 1; i < hyperedge.size(); ++i) {
+          addEdge(hyperedge[i - 1], hyperedge[i]);
+        }
+      } else {
+        for (size_t i = 0; i < hyperedge.size(); ++i) {
+          for (size_t j = i + 1; j < hyperedge.size(); ++j) {
+            addEdge(hyperedge[i], hyperedge[j]);
+          }
+        }
+      }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    neighborOffsets_.assign(atoms_.size() + 1, 0);
+    neighbors_.reserve(edges.size());
+    for (const auto& edge : edges) {
+      ++neighborOffsets_[edge.first + 1];
+      neighbors_.push_back(edge.second);
+    }
+    for (size_t i = 1; i < neighborOffsets_.size(); ++i) {
+      neighborOffsets_[i] += neighborOffsets_[i - 1];
+    }
+  }
+
+  const std::vector<Atom>& atoms() const { return atoms_; }
+
+  const std::vector<int64_t>& neighborOffsets() const { return neighborOffsets_; }
+
+  const std::vector<int64_t>& neighbors() const { return neighbors_; }
+
+  std::vector<std::vector<int64_t>> ballVolumes(const std::vector<Atom>& centers,
+                                                const int64_t maxRadius,
+                                                const std::function<bool()>& abortRequested) const {
+    if (maxRadius < 0) throw Error::InvalidRadius;
+
+    std::vector<int64_t> centerIndices;
+    centerIndices.reserve(centers.size());
+    for (const auto center : centers) {
+      const auto indexIterator = atomIndices_.find(center);
+      if (indexIterator == atomIndices_.end()) throw Error::AtomNotFound;
+      centerIndices.push_back(indexIterator->second);
+    }
+
+    std::vector<std::vector<int64_t>> volumes(centers.size(), std::vector<int64_t>(maxRadius + 1));
+    const int64_t batchCount = (static_cast<int64_t>(centers.size()) + batchSize - 1) / batchSize;
+
+    // If one thread aborts, alert other threads with this flag
+    std::atomic<bool> aborted = false;
+    const std::function<bool()> shouldAbort = [&aborted, &abortRequested]() {
+      if (aborted || abortRequested()) aborted = true;
+      return aborted.load();
+    };
+
+    // Only create threads if there is more than one batch
+    const auto threadAcquisitionToken =
+        Parallelism::acquire(Parallelism::HardwareType::StdCpu, static_cast<int>(batchCount));
+    const int numThreadsToUse = threadAcquisitionToken->numThreads();
+    const int64_t batchStride = std::max(numThreadsToUse, 1);
+    const auto growBallsForBatchRange = [&](const int64_t start) {
+      BatchState state(atoms_.size());
+      for (int64_t batch = start; batch < batchCount && !aborted; batch += batchStride) {
+        growBalls(centerIndices, batch, maxRadius, shouldAbort, &state, &volumes);
+      }
+    };
+
+    if (numThreadsToUse > 0) {
+      std::vector<std::thread> threads(numThreadsToUse);
+      for (int i = 0; i < numThreadsToUse; ++i) {
+        threads[i] = std::thread(growBallsForBatchRange, i);
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    } else {
+      growBallsForBatchRange(0);
+    }
+
+    if (aborted) throw Error::Aborted;
+    return volumes;
+  }
+
+ private:
+  // Per-thread buffers, reused between batches. Masks are kept zero outside of growBalls.
+  struct BatchState {
+    std::vector<CentersMask> visited;
+    std::vector<CentersMask> frontier;
+    std::vector<CentersMask> reached;
+    std::vector<int64_t> frontierVertices;
+    std::vector<int64_t> reachedVertices;
+
+    explicit BatchState(const size_t vertexCount)
+        : visited(vertexCount, 0), frontier(vertexCount, 0), reached(vertexCount, 0) {}
+  };
+
+  void growBalls(const std::vector<int64_t>& centerIndices,
+                 const int64_t batch,
+                 const int64_t maxRadius,
+                 const std::function<bool()>& shouldAbort,
+                 BatchState* state,
+                 std::vector<std::vector<int64_t>>* volumes) const {
+    const int64_t firstCenter = batch * batchSize;
+    const int64_t batchCenterCount = std::min(batchSize, static_cast<int64_t>(centerIndices.size()) - firstCenter);
+
+    std::vector<int64_t> counts(batchCenterCount, 0);
+    for (int64_t i = 0; i < batchCenterCount; ++i) {
+      const int64_t vertex = centerIndices[firstCenter + i];
+      if (state->frontier[vertex] == 0) state->frontierVertices.push_back(vertex);
+      state->visited[vertex] |= CentersMask(1) << i;
+      state->frontier[vertex] |= CentersMask(1) << i;
+      ++counts[i];
+    }
+    std::vector<int64_t> visitedVertices = state->frontierVertices;
+
+    for (int64_t radius = 0; radius <= maxRadius; ++radius) {
+      if (radius > 0 && !state->frontierVertices.empty()) {
+        if (shouldAbort()) break;
+
+        // Push the frontier of every center to the neighbors simultaneously
+        for (const auto vertex : state->frontierVertices) {
+          const CentersMask mask = state->frontier[vertex];
+          for (int64_t i = neighborOffsets_[vertex]; i < neighborOffsets_[vertex + 1]; ++i) {
+            const int64_t neighbor = neighbors_[i];
+            if (state->reached[neighbor] == 0) state->reachedVertices.push_back(neighbor);
+            state->reached[neighbor] |= mask;
+          }
+          state->frontier[vertex] = 0;
+        }
+        state->frontierVertices.clear();
+
+        for (const auto vertex : state->reachedVertices) {
+          CentersMask newCenters = state->reached[vertex] & ~state->visited[vertex];
+          state->reached[vertex] = 0;
+          if (newCenters == 0) continue;
+          if (state->visited[vertex] == 0) visitedVertices.push_back(vertex);
+          state->visited[vertex] |= newCenters;
+          state->frontier[vertex] = newCenters;
+          state->frontierVertices.push_back(vertex);
+          for (; newCenters != 0; newCenters &= newCenters - 1) {
+            ++counts[lowestBitIndex(newCenters)];
+          }
+        }
+        state->reachedVertices.clear();
+      }
+
+      for (int64_t i = 0; i < batchCenterCount; ++i) {
+        (*volumes)[firstCenter + i][radius] = counts[i];
+      }
+    }
+
+    for (const auto vertex : state->frontierVertices) {
+      state->frontier[vertex] = 0;
+    }
+    state->frontierVertices.clear();
+    for (const auto vertex : visitedVertices) {
+      state->visited[vertex] = 0;
+    }
+  }
+};
+
+AtomsGraph::AtomsGraph(const std::vector<AtomsVector>& hyperedges, const HyperedgeConnectivity connectivity)
+    : implementation_(std::make_shared<Implementation>(hyperedges, connectivity)) {}
+
+const std::vector<Atom>& AtomsGraph::atoms() const { return implementation_->atoms(); }
+
+const std::vector<int64_t>& AtomsGraph::neighborOffsets() const { return implementation_->neighborOffsets(); }
+
+const std::vector<int64_t>& AtomsGraph::neighbors() const { return implementation_->neighbors(); }
+
+std::vector<std::vector<int64_t>> AtomsGraph::ballVolumes(const std::vector<Atom>& centers,
+                                                          const int64_t maxRadius,
+                                                          const std::function<bool()>& shouldAbort) const {
+  return implementation_->ballVolumes(centers, maxRadius, shouldAbort);
+}
+}  // namespace SetReplace
@@ -0,0 +1,62 @@
+#ifndef LIBSETREPLACE_ATOMSGRAPH_HPP_
+#define LIBSETREPLACE_ATOMSGRAPH_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "IDTypes.hpp"
+
+namespace SetReplace {
+/** @brief AtomsGraph is an undirected graph with atoms of a hypergraph as vertices, which is used to measure its
+ * spatial properties, such as the effective dimension.
+ * @details The adjacency is stored in the compressed sparse row format, so the graph is immutable once created.
+ */
+class AtomsGraph {
+ public:
+  /** @brief Type of the error occurred during evaluation.
+   */
+  enum Error { None, Aborted, InvalidConnectivity, InvalidRadius, AtomNotFound };
+
+  /** @brief Which pairs of atoms of each hyperedge are connected by graph edges.
+   */
+  enum class HyperedgeConnectivity {
+    Path = 0,    // consecutive atoms, e.g., {1, 2, 3} becomes 1 - 2 - 3
+    Clique = 1,  // all pairs of atoms, e.g., {1, 2, 3} becomes 1 - 2, 1 - 3, 2 - 3
+  };
+
+  /** @brief Creates the graph from a list of hyperedges.
+   * @details Self-loops and multiple edges are dropped, as they do not affect distances.
+   */
+  AtomsGraph(const std::vector<AtomsVector>& hyperedges, HyperedgeConnectivity connectivity);
+
+  /** @brief Distinct atoms of the hypergraph, in the order of their first appearance. The vertex indices of the CSR
+   * arrays refer to this list.
+   */
+  const std::vector<Atom>& atoms() const;
+
+  /** @brief Positions in neighbors() where the neighbors of each vertex begin. Has one extra element at the end.
+   */
+  const std::vector<int64_t>& neighborOffsets() const;
+
+  /** @brief Concatenated sorted lists of vertex indices adjacent to each vertex.
+   */
+  const std::vector<int64_t>& neighbors() const;
+
+  /** @brief Counts the atoms within each graph distance from 0 to maxRadius from each of the centers.
+   * @details Balls are grown with a breadth-first search, which is run simultaneously for batches of 64 centers by
+   * keeping the frontiers as bit masks. Batches are processed in parallel if threads are available. Calls shouldAbort()
+   * frequently, and throws Error::Aborted if that returns true.
+   * @return Addressed as [centerIndex][radius].
+   */
+  std::vector<std::vector<int64_t>> ballVolumes(const std::vector<Atom>& centers,
+                                                int64_t maxRadius,
+                                                const std::function<bool()>& shouldAbort) const;
+
+ private:
+  class Implementation;
+  std::shared_ptr<Implementation> implementation_;
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_ATOMSGRAPH_HPP_
@@ -1,63 +1,318 @@
 #include "AtomsIndex.hpp"
 
 #include <algorithm>
+#include <limits>
 #include <memory>
+#include <scoped_allocator>
+#include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "Arena.hpp"
+#include "Parallelism.hpp"
+
 namespace SetReplace {
+namespace {
+// Bit i is set if the atom appears at position i, positions after the last bit share it.
+using PositionMask = uint64_t;
+
+size_t positionIndex(const size_t position) { return std::min(position, AtomsIndex::maxIndexedPositions - 1); }
+
+PositionMask positionBit(const size_t position) { return PositionMask(1) << positionIndex(position); }
+
+PositionMask atomPositions(const AtomsVector& atoms, const Atom atom) {
+  PositionMask result = 0;
+  for (size_t position = 0; position < atoms.size(); ++position) {
+    if (atoms[position] == atom) result |= positionBit(position);
+  }
+  return result;
+}
+
+// Lists of at least this many tokens are added to the index in multiple threads.
+constexpr size_t minTokensForParallelInsertion = 1 << 14;
+constexpr size_t tokensPerInsertionThread = 1 << 12;
+
+// Number of buckets the index entries are distributed into by the lowest bits of the atom.
+constexpr int radixBits = 10;
+constexpr size_t radixBucketCount = size_t(1) << radixBits;
+
+size_t radixBucket(const Atom atom) { return static_cast<size_t>(atom) & (radixBucketCount - 1); }
+
+// Runs function(thread) for each thread in [0, threadCount) in parallel.
+template <typename Function>
+void runInThreads(const int threadCount, const Function& function) {
+  std::vector<std::thread> threads;
+  threads.reserve(threadCount);
+  for (int thread = 0; thread < threadCount; ++thread) threads.emplace_back(function, thread);
+  for (auto& thread : threads) thread.join();
+}
+}  // namespace
+
 class AtomsIndex::Implementation {
  private:
+  // Declared first, so that it outlives everything allocated from it.
+  Arena arena_;
   const GetAtomsVectorFunc getAtomsVector_;
-  std::unordered_map<Atom, std::unordered_set<TokenID>> index_;
+  // Tokens containing each atom, grouped by arity, with the positions of the atom stored alongside each token.
+  using TokensWithPositions = std::unordered_map<TokenID,
+                                                 PositionMask,
+                                                 std::hash<TokenID>,
+                                                 std::equal_to<TokenID>,
+                                                 ArenaAllocator<std::pair<const TokenID, PositionMask>>>;
+  using PositionCounts = std::vector<size_t, ArenaAllocator<size_t>>;
+  struct ArityTokens {
+    using allocator_type = ArenaAllocator<ArityTokens>;
+    explicit ArityTokens(const allocator_type& allocator) : tokens(allocator), positionCounts(allocator) {}
+
+    TokensWithPositions tokens;
+    // Number of the tokens above containing the atom at each position, used to estimate the cost of matching.
+    PositionCounts positionCounts;
+  };
+  template <typename Key, typename Value>
+  using ArenaMap = std::unordered_map<Key,
+                                      Value,
+                                      std::hash<Key>,
+                                      std::equal_to<Key>,
+                                      std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const Key, Value>>>>;
+  using Index = ArenaMap<Atom, ArenaMap<size_t, ArityTokens>>;
+  // Everything in the index is allocated from the arena, so it is released in bulk instead of being destroyed.
+  Index& index_;
 
  public:
-  explicit Implementation(GetAtomsVectorFunc getAtomsVector) : getAtomsVector_(std::move(getAtomsVector)) {}
+  Implementation(GetAtomsVectorFunc getAtomsVector, const bool useHugePages)
+      : arena_(useHugePages),
+        getAtomsVector_(std::move(getAtomsVector)),
+        index_(arena_.make<Index>(Index::allocator_type(ArenaAllocator<Index::value_type>(&arena_)))) {}
 
   void removeTokens(const std::vector<TokenID>& tokenIDs) {
-    const std::unordered_set<TokenID> tokensToDelete(tokenIDs.begin(), tokenIDs.end());
-
-    std::unordered_set<Atom> involvedAtoms;
     for (const auto& token : tokenIDs) {
       const auto& atomsVector = getAtomsVector_(token);
-      involvedAtoms.insert(atomsVector.begin(), atomsVector.end());
+      for (const auto& atom : atomsVector) {
+        const auto atomIterator = index_.find(atom);
+        if (atomIterator == index_.end()) continue;
+        const auto arityIterator = atomIterator->second.find(atomsVector.size());
+        if (arityIterator == atomIterator->second.end()) continue;
+        auto& arityTokens = arityIterator->second;
+        const auto tokenIterator = arityTokens.tokens.find(token);
+        // Atoms repeated in the token are visited more than once, but the token is only removed the first time
+        if (tokenIterator == arityTokens.tokens.end()) continue;
+        updatePositionCounts(&arityTokens.positionCounts, tokenIterator->second, -1);
+        arityTokens.tokens.erase(tokenIterator);
+        if (arityTokens.tokens.empty()) atomIterator->second.erase(arityIterator);
+        if (atomIterator->second.empty()) index_.erase(atomIterator);
+      }
     }
+  }
 
-    for (const auto& atom : involvedAtoms) {
-      auto& atomTokenSet = index_[atom];
-      auto atomTokenIterator = atomTokenSet.begin();
-      const auto atomTokenSetEnd = atomTokenSet.cend();
-      while (atomTokenIterator != atomTokenSetEnd) {
-        if (tokensToDelete.count(*atomTokenIterator)) {
-          atomTokenIterator = atomTokenSet.erase(atomTokenIterator);
-        } else {
-          ++atomTokenIterator;
+  void addTokens(const std::vector<TokenID>& tokenIDs) {
+    if (tokenIDs.size() >= minTokensForParallelInsertion) {
+      const auto threadAcquisitionToken = Parallelism::acquire(
+          Parallelism::HardwareType::StdCpu, static_cast<int>(tokenIDs.size() / tokensPerInsertionThread));
+      if (threadAcquisitionToken->numThreads() > 0) {
+        addTokensInParallel(tokenIDs, threadAcquisitionToken->numThreads());
+        return;
+      }
+    }
+    for (const auto& tokenID : tokenIDs) {
+      const auto& atomsVector = getAtomsVector_(tokenID);
+      for (size_t position = 0; position < atomsVector.size(); ++position) {
+        const Atom atom = atomsVector[position];
+        // Repeated atoms are indexed with all of their positions at their first occurrence
+        if (std::find(atomsVector.begin(), atomsVector.begin() + position, atom) != atomsVector.begin() + position) {
+          continue;
+        }
+        auto& arityTokens = index_[atom][atomsVector.size()];
+        const PositionMask positions = atomPositions(atomsVector, atom);
+        if (arityTokens.positionCounts.empty()) {
+          arityTokens.positionCounts.resize(std::min(atomsVector.size(), maxIndexedPositions));
+        }
+        if (arityTokens.tokens.emplace(tokenID, positions).second) {
+          updatePositionCounts(&arityTokens.positionCounts, positions, 1);
         }
       }
-      if (atomTokenSet.empty()) {
-        index_.erase(atom);
+    }
+  }
+
+  size_t estimatedTokensMatchingPattern(const AtomsVector& pattern) const {
+    size_t result = std::numeric_limits<size_t>::max();
+    for (size_t position = 0; position < pattern.size(); ++position) {
+      const Atom atom = pattern[position];
+      if (atom < 0) continue;
+      const auto atomIterator = index_.find(atom);
+      if (atomIterator == index_.end()) return 0;
+      const auto arityIterator = atomIterator->second.find(pattern.size());
+      if (arityIterator == atomIterator->second.end()) return 0;
+      result = std::min(result, arityIterator->second.positionCounts[positionIndex(position)]);
+    }
+    return result == std::numeric_limits<size_t>::max() ? 0 : result;
+  }
+
+  size_t memoryUsage() const { return arena_.reservedBytes(); }
+
+  std::unordered_set<TokenID> tokensContainingAtom(const Atom atom) const {
+    std::unordered_set<TokenID> result;
+    const auto atomIterator = index_.find(atom);
+    if (atomIterator == index_.end()) return result;
+    for (const auto& arityAndTokens : atomIterator->second) {
+      for (const auto& tokenAndPositions : arityAndTokens.second.tokens) {
+        result.insert(tokenAndPositions.first);
       }
     }
+    return result;
   }
 
-  void addTokens(const std::vector<TokenID>& tokenIDs) {
-    for (const auto& tokenID : tokenIDs) {
-      for (const auto& atom : getAtomsVector_(tokenID)) {
-        index_[atom].insert(tokenID);
+  std::vector<TokenID> tokensMatchingPattern(const AtomsVector& pattern) const {
+    // Tokens of the right arity containing each of the specific atoms, and the positions where they should be
+    std::vector<std::pair<const TokensWithPositions*, PositionMask>> requirements;
+    for (size_t position = 0; position < pattern.size(); ++position) {
+      const Atom atom = pattern[position];
+      if (atom < 0 || std::find(pattern.begin(), pattern.begin() + position, atom) != pattern.begin() + position) {
+        continue;
       }
+      const auto atomIterator = index_.find(atom);
+      if (atomIterator == index_.end()) return {};
+      const auto arityIterator = atomIterator->second.find(pattern.size());
+      if (arityIterator == atomIterator->second.end()) return {};
+      requirements.emplace_back(&arityIterator->second.tokens, atomPositions(pattern, atom));
+    }
+    if (requirements.empty()) return {};
+
+    // Only the smallest list is enumerated, the others are only used for lookups
+    std::swap(requirements.front(),
+              *std::min_element(requirements.begin(), requirements.end(), [](const auto& first, const auto& second) {
+                return first.first->size() < second.first->size();
+              }));
+    const auto meetsRequirement = [](const std::pair<const TokensWithPositions*, PositionMask>& requirement,
+                                     const TokenID token) {
+      const auto tokenIterator = requirement.first->find(token);
+      return tokenIterator != requirement.first->end() &&
+             (tokenIterator->second & requirement.second) == requirement.second;
+    };
+    std::vector<TokenID> result;
+    for (const auto& tokenAndPositions : *requirements.front().first) {
+      const TokenID token = tokenAndPositions.first;
+      if ((tokenAndPositions.second & requirements.front().second) != requirements.front().second) continue;
+      const auto meetsOtherRequirement = [&meetsRequirement, token](const auto& requirement) {
+        return meetsRequirement(requirement, token);
+      };
+      if (std::all_of(requirements.begin() + 1, requirements.end(), meetsOtherRequirement)) result.push_back(token);
     }
+    return result;
   }
 
-  std::unordered_set<TokenID> tokensContainingAtom(const Atom atom) const {
-    const auto resultIterator = index_.find(atom);
-    return resultIterator != index_.end() ? resultIterator->second : std::unordered_set<TokenID>();
+ private:
+  // An atom of the token at tokenIDs[order], only the first occurrence of each atom in a token is included.
+  struct Entry {
+    Atom atom;
+    uint32_t arity;
+    size_t order;
+  };
+
+  // Builds the same index as the sequential loop in addTokens(). The entries are sorted by atom with a radix pass
+  // distributing them into buckets, followed by sorting each bucket, so that the tokens of each atom and arity are
+  // contiguous, and in the same order as they would be inserted sequentially. Then, each thread fills in the token
+  // lists of its own atoms and arities, only creating the lists themselves is sequential.
+  void addTokensInParallel(const std::vector<TokenID>& tokenIDs, const int threadCount) {
+    // Each thread collects the entries of its range of tokens, and counts them by bucket.
+    std::vector<std::vector<Entry>> threadEntries(threadCount);
+    std::vector<std::vector<size_t>> threadBucketOffsets(threadCount, std::vector<size_t>(radixBucketCount));
+    runInThreads(threadCount, [&](const int thread) {
+      const size_t begin = tokenIDs.size() * thread / threadCount;
+      const size_t end = tokenIDs.size() * (thread + 1) / threadCount;
+      for (size_t order = begin; order < end; ++order) {
+        const auto& atomsVector = getAtomsVector_(tokenIDs[order]);
+        for (size_t position = 0; position < atomsVector.size(); ++position) {
+          const Atom atom = atomsVector[position];
+          if (std::find(atomsVector.begin(), atomsVector.begin() + position, atom) != atomsVector.begin() + position) {
+            continue;
+          }
+          threadEntries[thread].push_back({atom, static_cast<uint32_t>(atomsVector.size()), order});
+          ++threadBucketOffsets[thread][radixBucket(atom)];
+        }
+      }
+    });
+
+    // Buckets are stored one after another, and within each bucket, the entries of each thread are in thread order.
+    std::vector<size_t> bucketBegins(radixBucketCount + 1);
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < radixBucketCount; ++bucket) {
+      bucketBegins[bucket] = offset;
+      for (auto& bucketOffsets : threadBucketOffsets) {
+        const size_t count = bucketOffsets[bucket];
+        bucketOffsets[bucket] = offset;
+        offset += count;
+      }
+    }
+    bucketBegins[radixBucketCount] = offset;
+
+    std::vector<Entry> entries(offset);
+    runInThreads(threadCount, [&](const int thread) {
+      for (const auto& entry : threadEntries[thread]) {
+        entries[threadBucketOffsets[thread][radixBucket(entry.atom)]++] = entry;
+      }
+      threadEntries[thread] = std::vector<Entry>();
+    });
+
+    runInThreads(threadCount, [&](const int thread) {
+      for (size_t bucket = thread; bucket < radixBucketCount; bucket += threadCount) {
+        std::sort(entries.begin() + bucketBegins[bucket],
+                  entries.begin() + bucketBegins[bucket + 1],
+                  [](const Entry& first, const Entry& second) {
+                    return std::tie(first.atom, first.arity, first.order) <
+                           std::tie(second.atom, second.arity, second.order);
+                  });
+      }
+    });
+
+    // Creating the lists modifies the index maps, so it cannot be done concurrently.
+    std::vector<std::pair<ArityTokens*, size_t>> groupBegins;
+    for (size_t begin = 0; begin < entries.size(); ++begin) {
+      if (begin > 0 && entries[begin].atom == entries[begin - 1].atom &&
+          entries[begin].arity == entries[begin - 1].arity) {
+        continue;
+      }
+      auto& arityTokens = index_[entries[begin].atom][entries[begin].arity];
+      if (arityTokens.positionCounts.empty()) {
+        arityTokens.positionCounts.resize(std::min<size_t>(entries[begin].arity, maxIndexedPositions));
+      }
+      groupBegins.emplace_back(&arityTokens, begin);
+    }
+    groupBegins.emplace_back(nullptr, entries.size());
+
+    runInThreads(threadCount, [&](const int thread) {
+      for (size_t group = thread; group + 1 < groupBegins.size(); group += threadCount) {
+        auto& arityTokens = *groupBegins[group].first;
+        for (size_t i = groupBegins[group].second; i < groupBegins[group + 1].second; ++i) {
+          const TokenID tokenID = tokenIDs[entries[i].order];
+          const PositionMask positions = atomPositions(getAtomsVector_(tokenID), entries[i].atom);
+          if (arityTokens.tokens.emplace(tokenID, positions).second) {
+            updatePositionCounts(&arityTokens.positionCounts, positions, 1);
+          }
+        }
+      }
+    });
+  }
+
+  // Adds a token with the atom at given positions to the counts if direction is positive, removes it otherwise.
+  static void updatePositionCounts(PositionCounts* positionCounts,
+                                   const PositionMask positions,
+                                   const int direction) {
+    for (size_t position = 0; position < positionCounts->size(); ++position) {
+      if (!(positions & positionBit(position))) continue;
+      if (direction > 0) {
+        ++(*positionCounts)[position];
+      } else {
+        --(*positionCounts)[position];
+      }
+    }
   }
 };
 
-AtomsIndex::AtomsIndex(const GetAtomsVectorFunc& getAtomsVector)
-    : implementation_(std::make_shared<Implementation>(getAtomsVector)) {}
+AtomsIndex::AtomsIndex(const GetAtomsVectorFunc& getAtomsVector, const bool useHugePages)
+    : implementation_(std::make_shared<Implementation>(getAtomsVector, useHugePages)) {}
 
 void AtomsIndex::removeTokens(const std::vector<TokenID>& tokenIDs) { implementation_->removeTokens(tokenIDs); }
 
@@ -66,4 +321,14 @@ void AtomsIndex::addTokens(const std::vector<TokenID>& tokenIDs) { implementatio
 std::unordered_set<TokenID> AtomsIndex::tokensContainingAtom(const Atom atom) const {
   return implementation_->tokensContainingAtom(atom);
 }
+
+std::vector<TokenID> AtomsIndex::tokensMatchingPattern(const AtomsVector& pattern) const {
+  return implementation_->tokensMatchingPattern(pattern);
+}
+
+size_t AtomsIndex::estimatedTokensMatchingPattern(const AtomsVector& pattern) const {
+  return implementation_->estimatedTokensMatchingPattern(pattern);
+}
+
+size_t AtomsIndex::memoryUsage() const { return implementation_->memoryUsage(); }
 }  // namespace SetReplace
@@ -10,13 +10,19 @@
 
 namespace SetReplace {
 /** @brief AtomsIndex keeps references to tokens accessible by atoms, which is useful for matching.
+ * @details Tokens are indexed by atom and arity, and each reference stores the positions of the atom in the token, so
+ * that tokens of a wrong shape can be skipped without looking up their atoms. The number of tokens containing each atom
+ * at each position is maintained as well, so that the cost of matching an input can be estimated.
+ *
+ * The index is allocated from its own Arena, and is released with it at once rather than token by token.
  */
 class AtomsIndex {
  public:
   /** @brief Creates an empty index.
    * @param getAtomsVector datasource function that returns the list of atoms for a requested token.
+   * @param useHugePages whether to back the index with transparent huge pages, see Arena.
    */
-  explicit AtomsIndex(const GetAtomsVectorFunc& getAtomsVector);
+  explicit AtomsIndex(const GetAtomsVectorFunc& getAtomsVector, bool useHugePages = false);
 
   /** @brief Removes tokens with specified IDs from the index.
    */
@@ -30,6 +36,26 @@ class AtomsIndex {
    */
   std::unordered_set<TokenID> tokensContainingAtom(Atom atom) const;
 
+  /** @brief Returns the tokens that can match a pattern, i.e., have the same arity, and contain each of its non-pattern
+   * (non-negative) atoms at the same positions.
+   * @details The pattern atoms are not checked, so binding them can still fail. Tokens with more than
+   * maxIndexedPositions atoms are not distinguished by the positions after that. The pattern should contain at least
+   * one non-pattern atom, otherwise, an empty list is returned.
+   */
+  std::vector<TokenID> tokensMatchingPattern(const AtomsVector& pattern) const;
+
+  /** @brief Returns an upper bound of tokensMatchingPattern(pattern).size() without enumerating the tokens.
+   * @details It is the smallest number of tokens of the pattern arity containing one of its non-pattern atoms at one of
+   * its positions. It only takes a few lookups, as these numbers are maintained as tokens are added and removed.
+   */
+  size_t estimatedTokensMatchingPattern(const AtomsVector& pattern) const;
+
+  /** @brief Bytes of memory taken by the index, see Arena::reservedBytes().
+   */
+  size_t memoryUsage() const;
+
+  static constexpr size_t maxIndexedPositions = 64;
+
  private:
   class Implementation;
   std::shared_ptr<Implementation> implementation_;
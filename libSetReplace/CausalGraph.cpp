@@ -0,0 +1,415 @@
+#include "CausalGraph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+using BitsetWord = uint64_t;
+constexpr int64_t bitsPerWord = 64;
+
+// Reachability bitsets of a single block of target vertices are limited to this many words (64 MB) per thread.
+constexpr int64_t maxBlockWords = int64_t(1) << 23;
+
+// shouldAbort() might be slow, so it is only checked once per this many rows.
+constexpr int64_t abortCheckPeriod = 4096;
+
+int64_t popcount(const BitsetWord word) { return static_cast<int64_t>(std::bitset<bitsPerWord>(word).count()); }
+
+// Lists of neighbors in the compressed sparse row format.
+struct Adjacency {
+  std::vector<int64_t> offsets;
+  std::vector<int64_t> neighbors;
+
+  Adjacency(const int64_t vertexCount, const std::vector<std::pair<int64_t, int64_t>>& edges, const bool reversed)
+      : offsets(vertexCount + 1, 0), neighbors(edges.size()) {
+    for (const auto& edge : edges) {
+      ++offsets[(reversed ? edge.second : edge.first) + 1];
+    }
+    for (int64_t i = 1; i <= vertexCount; ++i) {
+      offsets[i] += offsets[i - 1];
+    }
+    std::vector<int64_t> writePositions(offsets.begin(), offsets.end() - 1);
+    for (const auto& edge : edges) {
+      const auto source = reversed ? edge.second : edge.first;
+      const auto target = reversed ? edge.first : edge.second;
+      neighbors[writePositions[source]++] = target;
+    }
+  }
+
+  int64_t begin(const int64_t vertex) const { return offsets[vertex]; }
+  int64_t end(const int64_t vertex) const { return offsets[vertex + 1]; }
+};
+
+std::vector<std::pair<int64_t, int64_t>> eventEdges(const EventsView& events) {
+  std::vector<EventID> tokenCreators;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  for (EventID event = 0; event < static_cast<EventID>(events.size()); ++event) {
+    for (const auto token : events[event].inputTokens) {
+      edges.emplace_back(tokenCreators[token], event);
+    }
+    for (const auto token : events[event].outputTokens) {
+      if (token >= static_cast<TokenID>(tokenCreators.size())) tokenCreators.resize(token + 1);
+      tokenCreators[token] = event;
+    }
+  }
+  return edges;
+}
+}  // namespace
+
+class CausalGraph::Implementation {
+ private:
+  const int64_t vertexCount_;
+  const Adjacency outEdges_;
+  const Adjacency inEdges_;
+  std::vector<int64_t> topologicalOrder_;
+  std::vector<int64_t> topologicalIndices_;
+  std::vector<Generation> layers_;
+
+ public:
+  // Events are already sorted topologically as inputs of each event must be created before it.
+  explicit Implementation(const EventsView& events)
+      : Implementation(static_cast<int64_t>(events.size()), eventEdges(events), identityOrder(events.size())) {}
+
+  // If topologicalOrder is empty, it is computed from the edges.
+  Implementation(const int64_t vertexCount,
+                 const std::vector<std::pair<int64_t, int64_t>>& edges,
+                 std::vector<int64_t> topologicalOrder = {})
+      : vertexCount_(validVertexCount(vertexCount, edges)),
+        outEdges_(vertexCount, edges, false),
+        inEdges_(vertexCount, edges, true),
+        topologicalOrder_(std::move(topologicalOrder)) {
+    if (topologicalOrder_.empty()) sortTopologically();
+    topologicalIndices_.resize(vertexCount_);
+    for (int64_t i = 0; i < vertexCount_; ++i) {
+      topologicalIndices_[topologicalOrder_[i]] = i;
+    }
+    computeLayers();
+  }
+
+  int64_t vertexCount() const { return vertexCount_; }
+
+  const std::vector<int64_t>& edgeOffsets() const { return outEdges_.offsets; }
+
+  const std::vector<int64_t>& edgeTargets() const { return outEdges_.neighbors; }
+
+  const std::vector<Generation>& layers() const { return layers_; }
+
+  std::shared_ptr<Implementation> transitiveReduction(const std::function<bool()>& abortRequested) const {
+    // If one thread aborts, alert other threads with this flag
+    std::atomic<bool> aborted = false;
+    const std::function<bool()> shouldAbort = [&aborted, &abortRequested]() {
+      if (aborted || abortRequested()) aborted = true;
+      return aborted.load();
+    };
+
+    // Each vertex is processed independently, so vertices are split into contiguous ranges for threads. Small graphs
+    // are not worth the threads, as each of them needs a buffer the size of the graph.
+    const int64_t minVerticesPerThread = abortCheckPeriod;
+    const auto threadAcquisitionToken = Parallelism::acquire(
+        Parallelism::HardwareType::StdCpu,
+        static_cast<int>(std::min<int64_t>(vertexCount_ / minVerticesPerThread, std::numeric_limits<int>::max())));
+    const int64_t rangeCount = std::max(threadAcquisitionToken->numThreads(), 1);
+    std::vector<std::vector<std::pair<int64_t, int64_t>>> rangeEdges(rangeCount);
+    const auto reduceRange = [&](const int64_t range) {
+      reduceEdges(range * vertexCount_ / rangeCount,
+                  (range + 1) * vertexCount_ / rangeCount,
+                  shouldAbort,
+                  &rangeEdges[range]);
+    };
+
+    if (threadAcquisitionToken->numThreads() > 0) {
+      std::vector<std::thread> threads(rangeCount);
+      for (int64_t i = 0; i < rangeCount; ++i) {
+        threads[i] = std::thread(reduceRange, i);
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    } else {
+      reduceRange(0);
+    }
+    if (aborted) throw Error::Aborted;
+
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    for (const auto& range : rangeEdges) {
+      edges.insert(edges.end(), range.begin(), range.end());
+    }
+    // Reachability is unchanged, so the topological order remains valid.
+    return std::make_shared<Implementation>(vertexCount_, edges, topologicalOrder_);
+  }
+
+  std::vector<int64_t> diamond(const int64_t start, const int64_t end) const {
+    if (start < 0 || start >= vertexCount_ || end < 0 || end >= vertexCount_) throw Error::InvalidVertex;
+
+    // Vertices after end in topological order cannot be in the diamond, so they are not explored.
+    const int64_t endIndex = topologicalIndices_[end];
+    std::vector<bool> isFuture(vertexCount_, false);
+    std::deque<int64_t> queue;
+    if (topologicalIndices_[start] <= endIndex) {
+      isFuture[start] = true;
+      queue.push_back(start);
+    }
+    while (!queue.empty()) {
+      const int64_t vertex = queue.front();
+      queue.pop_front();
+      for (int64_t i = outEdges_.begin(vertex); i < outEdges_.end(vertex); ++i) {
+        const int64_t child = outEdges_.neighbors[i];
+        if (!isFuture[child] && topologicalIndices_[child] <= endIndex) {
+          isFuture[child] = true;
+          queue.push_back(child);
+        }
+      }
+    }
+
+    std::vector<int64_t> result;
+    if (!isFuture[end]) return result;
+    std::vector<bool> isInDiamond(vertexCount_, false);
+    isInDiamond[end] = true;
+    queue.push_back(end);
+    while (!queue.empty()) {
+      const int64_t vertex = queue.front();
+      queue.pop_front();
+      result.push_back(vertex);
+      for (int64_t i = inEdges_.begin(vertex); i < inEdges_.end(vertex); ++i) {
+        const int64_t parent = inEdges_.neighbors[i];
+        if (isFuture[parent] && !isInDiamond[parent]) {
+          isInDiamond[parent] = true;
+          queue.push_back(parent);
+        }
+      }
+    }
+
+    std::sort(result.begin(), result.end(), [this](const int64_t first, const int64_t second) {
+      return topologicalIndices_[first] < topologicalIndices_[second];
+    });
+    return result;
+  }
+
+  DiamondCounts diamondCounts(const int64_t start,
+                              const int64_t end,
+                              const std::function<bool()>& abortRequested) const {
+    const auto diamondVertices = diamond(start, end);
+    const int64_t diamondSize = static_cast<int64_t>(diamondVertices.size());
+    if (diamondSize == 0) return {0, 0};
+
+    // Children of each diamond vertex in local indices, which are positions in diamondVertices, so that children always
+    // have larger indices than their parents.
+    std::vector<int64_t> localIndices(vertexCount_, -1);
+    for (int64_t i = 0; i < diamondSize; ++i) {
+      localIndices[diamondVertices[i]] = i;
+    }
+    std::vector<std::pair<int64_t, int64_t>> localEdges;
+    for (int64_t i = 0; i < diamondSize; ++i) {
+      const int64_t vertex = diamondVertices[i];
+      for (int64_t j = outEdges_.begin(vertex); j < outEdges_.end(vertex); ++j) {
+        const int64_t child = localIndices[outEdges_.neighbors[j]];
+        if (child >= 0) localEdges.emplace_back(i, child);
+      }
+    }
+    const Adjacency children(diamondSize, localEdges, false);
+
+    const int64_t totalWords = (diamondSize + bitsPerWord - 1) / bitsPerWord;
+    const int64_t blockWords = std::clamp(maxBlockWords / diamondSize, int64_t(1), totalWords);
+    const int64_t blockCount = (totalWords + blockWords - 1) / blockWords;
+
+    // If one thread aborts, alert other threads with this flag
+    std::atomic<bool> aborted = false;
+    const std::function<bool()> shouldAbort = [&aborted, &abortRequested]() {
+      if (aborted || abortRequested()) aborted = true;
+      return aborted.load();
+    };
+
+    std::atomic<int64_t> comparablePairCount = 0;
+    const auto countPairsForBlock = [&](const int64_t block) {
+      comparablePairCount += countPairsInBlock(children, diamondSize, block * blockWords, blockWords, shouldAbort);
+    };
+
+    // Only create threads if there is more than one block
+    const auto threadAcquisitionToken =
+        Parallelism::acquire(Parallelism::HardwareType::StdCpu, static_cast<int>(blockCount));
+    const int numThreadsToUse = threadAcquisitionToken->numThreads();
+    if (numThreadsToUse > 0) {
+      std::vector<std::thread> threads(numThreadsToUse);
+      for (int i = 0; i < numThreadsToUse; ++i) {
+        threads[i] = std::thread([&, i]() {
+          for (int64_t block = i; block < blockCount && !aborted; block += numThreadsToUse) {
+            countPairsForBlock(block);
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    } else {
+      for (int64_t block = 0; block < blockCount && !aborted; ++block) {
+        countPairsForBlock(block);
+      }
+    }
+
+    if (aborted) throw Error::Aborted;
+    return {diamondSize, comparablePairCount};
+  }
+
+ private:
+  static int64_t validVertexCount(const int64_t vertexCount, const std::vector<std::pair<int64_t, int64_t>>& edges) {
+    if (vertexCount < 0) throw Error::InvalidVertex;
+    for (const auto& edge : edges) {
+      if (edge.first < 0 || edge.first >= vertexCount || edge.second < 0 || edge.second >= vertexCount) {
+        throw Error::InvalidVertex;
+      }
+    }
+    return vertexCount;
+  }
+
+  // Kahn's algorithm
+  void sortTopologically() {
+    std::vector<int64_t> remainingInDegrees(vertexCount_);
+    topologicalOrder_.reserve(vertexCount_);
+    for (int64_t vertex = 0; vertex < vertexCount_; ++vertex) {
+      remainingInDegrees[vertex] = inEdges_.end(vertex) - inEdges_.begin(vertex);
+      if (remainingInDegrees[vertex] == 0) topologicalOrder_.push_back(vertex);
+    }
+    for (size_t i = 0; i < topologicalOrder_.size(); ++i) {
+      const int64_t vertex = topologicalOrder_[i];
+      for (int64_t j = outEdges_.begin(vertex); j < outEdges_.end(vertex); ++j) {
+        const int64_t child = outEdges_.neighbors[j];
+        if (--remainingInDegrees[child] == 0) topologicalOrder_.push_back(child);
+      }
+    }
+    if (static_cast<int64_t>(topologicalOrder_.size()) != vertexCount_) throw Error::CyclicGraph;
+  }
+
+  static std::vector<int64_t> identityOrder(const size_t vertexCount) {
+    std::vector<int64_t> result(vertexCount);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+      result[vertex] = static_cast<int64_t>(vertex);
+    }
+    return result;
+  }
+
+  // Longest path from a source, which is the same as the generation for the events graph.
+  void computeLayers() {
+    layers_.assign(vertexCount_, initialGeneration);
+    for (const auto vertex : topologicalOrder_) {
+      for (int64_t i = outEdges_.begin(vertex); i < outEdges_.end(vertex); ++i) {
+        auto& childLayer = layers_[outEdges_.neighbors[i]];
+        childLayer = std::max(childLayer, layers_[vertex] + 1);
+      }
+    }
+  }
+
+  // Keeps the edges from the given vertices to the children that are not reachable through other children. Children
+  // are visited in topological order, so any longer path to a child must go through a child visited before it.
+  void reduceEdges(const int64_t beginVertex,
+                   const int64_t endVertex,
+                   const std::function<bool()>& shouldAbort,
+                   std::vector<std::pair<int64_t, int64_t>>* keptEdges) const {
+    // Marked with the current vertex to avoid clearing between vertices.
+    std::vector<int64_t> reachedFrom(vertexCount_, -1);
+    std::vector<int64_t> children;
+    std::vector<int64_t> stack;
+    for (int64_t vertex = beginVertex; vertex < endVertex; ++vertex) {
+      if (vertex % abortCheckPeriod == 0 && shouldAbort()) return;
+      children.assign(outEdges_.neighbors.begin() + outEdges_.begin(vertex),
+                      outEdges_.neighbors.begin() + outEdges_.end(vertex));
+      std::sort(children.begin(), children.end(), [this](const int64_t first, const int64_t second) {
+        return topologicalIndices_[first] < topologicalIndices_[second];
+      });
+      if (children.empty()) continue;
+      const int64_t lastChildIndex = topologicalIndices_[children.back()];
+
+      for (const auto child : children) {
+        if (reachedFrom[child] == vertex) continue;
+        keptEdges->emplace_back(vertex, child);
+        reachedFrom[child] = vertex;
+        stack.push_back(child);
+        while (!stack.empty()) {
+          const int64_t descendant = stack.back();
+          stack.pop_back();
+          for (int64_t i = outEdges_.begin(descendant); i < outEdges_.end(descendant); ++i) {
+            const int64_t next = outEdges_.neighbors[i];
+            if (reachedFrom[next] != vertex && topologicalIndices_[next] <= lastChildIndex) {
+              reachedFrom[next] = vertex;
+              stack.push_back(next);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Counts pairs (ancestor, descendant) such that the descendant's index is in the given block of words. Vertices are
+  // processed in reverse topological order, so the descendants of each vertex are the union of its children and their
+  // descendants. Vertices after the block cannot have descendants in it, so they are skipped.
+  static int64_t countPairsInBlock(const Adjacency& children,
+                                   const int64_t vertexCount,
+                                   const int64_t firstWord,
+                                   const int64_t blockWords,
+                                   const std::function<bool()>& shouldAbort) {
+    const int64_t firstVertex = firstWord * bitsPerWord;
+    const int64_t endVertex = std::min(vertexCount, (firstWord + blockWords) * bitsPerWord);
+    std::vector<BitsetWord> descendants(endVertex * blockWords, 0);
+
+    int64_t result = 0;
+    for (int64_t vertex = endVertex - 1; vertex >= 0; --vertex) {
+      if (vertex % abortCheckPeriod == 0 && shouldAbort()) return 0;
+      BitsetWord* row = &descendants[vertex * blockWords];
+      for (int64_t i = children.begin(vertex); i < children.end(vertex); ++i) {
+        const int64_t child = children.neighbors[i];
+        if (child >= endVertex) continue;
+        const BitsetWord* childRow = &descendants[child * blockWords];
+        for (int64_t word = 0; word < blockWords; ++word) {
+          row[word] |= childRow[word];
+        }
+        if (child >= firstVertex) {
+          row[(child - firstVertex) / bitsPerWord] |= BitsetWord(1) << ((child - firstVertex) % bitsPerWord);
+        }
+      }
+      for (int64_t word = 0; word < blockWords; ++word) {
+        result += popcount(row[word]);
+      }
+    }
+    return result;
+  }
+};
+
+CausalGraph::CausalGraph(const EventsView& events) : implementation_(std::make_shared<Implementation>(events)) {}
+
+CausalGraph::CausalGraph(const int64_t vertexCount, const std::vector<std::pair<int64_t, int64_t>>& edges)
+    : implementation_(std::make_shared<Implementation>(vertexCount, edges)) {}
+
+CausalGraph::CausalGraph(std::shared_ptr<Implementation> implementation) : implementation_(std::move(implementation)) {}
+
+int64_t CausalGraph::vertexCount() const { return implementation_->vertexCount(); }
+
+const std::vector<int64_t>& CausalGraph::edgeOffsets() const { return implementation_->edgeOffsets(); }
+
+const std::vector<int64_t>& CausalGraph::edgeTargets() const { return implementation_->edgeTargets(); }
+
+const std::vector<Generation>& CausalGraph::layers() const { return implementation_->layers(); }
+
+CausalGraph CausalGraph::transitiveReduction(const std::function<bool()>& shouldAbort) const {
+  return CausalGraph(implementation_->transitiveReduction(shouldAbort));
+}
+
+std::vector<int64_t> CausalGraph::diamond(const int64_t start, const int64_t end) const {
+  return implementation_->diamond(start, end);
+}
+
+CausalGraph::DiamondCounts CausalGraph::diamondCounts(const int64_t start,
+                                                      const int64_t end,
+                                                      const std::function<bool()>& shouldAbort) const {
+  return implementation_->diamondCounts(start, end, shouldAbort);
+}
+}  // namespace SetReplace
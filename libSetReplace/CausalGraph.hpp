@@ -0,0 +1,87 @@
+#ifndef LIBSETREPLACE_CAUSALGRAPH_HPP_
+#define LIBSETREPLACE_CAUSALGRAPH_HPP_
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "IDTypes.hpp"
+#include "TokenEventGraph.hpp"
+
+namespace SetReplace {
+/** @brief CausalGraph is an immutable directed acyclic graph, such as a graph of causal relationships between events.
+ * @details The edges are stored in the compressed sparse row format, and vertices are kept in a topological order.
+ */
+class CausalGraph {
+ public:
+  /** @brief Type of the error occurred during evaluation.
+   */
+  enum Error { None, Aborted, InvalidVertex, CyclicGraph };
+
+  /** @brief Number of vertices in a causal diamond, and the number of pairs of them that are causally related.
+   */
+  struct DiamondCounts {
+    int64_t vertexCount;
+    int64_t comparablePairCount;
+  };
+
+  /** @brief Creates a graph with events as vertices and an edge from the creator event to the destroyer event for
+   * each token.
+   * @details Vertices are identified by EventIDs, including the initial event.
+   */
+  explicit CausalGraph(const EventsView& events);
+
+  /** @brief Creates a graph from an arbitrary list of edges between vertices 0 to vertexCount - 1.
+   * @details Throws Error::CyclicGraph if the edges are not acyclic (including self-loops), and Error::InvalidVertex if
+   * edges refer to nonexistent vertices.
+   */
+  CausalGraph(int64_t vertexCount, const std::vector<std::pair<int64_t, int64_t>>& edges);
+
+  /** @brief Total number of vertices.
+   */
+  int64_t vertexCount() const;
+
+  /** @brief Positions in edgeTargets() where the outgoing edges of each vertex begin. Has one extra element at the end.
+   */
+  const std::vector<int64_t>& edgeOffsets() const;
+
+  /** @brief Concatenated lists of targets of the outgoing edges of each vertex.
+   * @details For the events graph, the targets are sorted, and there is a separate edge for each token.
+   */
+  const std::vector<int64_t>& edgeTargets() const;
+
+  /** @brief Length of the longest path from a source to each vertex.
+   * @details For the events graph, this is the same as the generation of each event.
+   */
+  const std::vector<Generation>& layers() const;
+
+  /** @brief Creates a graph with the same reachability and the smallest number of edges.
+   * @details Multiple edges are merged as well. Vertices are processed in parallel if threads are available. Calls
+   * shouldAbort() frequently, and throws Error::Aborted if that returns true.
+   */
+  CausalGraph transitiveReduction(const std::function<bool()>& shouldAbort) const;
+
+  /** @brief Vertices of the diamond, i.e., vertices reachable from start from which end is reachable (including start
+   * and end themselves), in topological order.
+   * @details The result is empty if end is not reachable from start.
+   */
+  std::vector<int64_t> diamond(int64_t start, int64_t end) const;
+
+  /** @brief Counts vertices and the pairs related by the transitive closure in the diamond between start and end.
+   * @details This is the input for the Myrheim-Meyer dimension estimator. Reachability is computed in reverse
+   * topological order with bitsets, which are split into blocks of target vertices to bound memory. Blocks are
+   * processed in parallel if threads are available. Calls shouldAbort() frequently, and throws Error::Aborted if that
+   * returns true.
+   */
+  DiamondCounts diamondCounts(int64_t start, int64_t end, const std::function<bool()>& shouldAbort) const;
+
+ private:
+  class Implementation;
+  std::shared_ptr<Implementation> implementation_;
+
+  explicit CausalGraph(std::shared_ptr<Implementation> implementation);
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_CAUSALGRAPH_HPP_
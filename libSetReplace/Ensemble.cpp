@@ -0,0 +1,99 @@
+#include "Ensemble.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+Ensemble::Summary summarize(const HypergraphSubstitutionSystem& system, const bool includeFinalTokens) {
+  Ensemble::Summary summary;
+  const auto events = system.events();
+  std::vector<bool> isDestroyed(system.tokenCount(), false);
+  for (const auto& event : events) {
+    for (const auto token : event.inputTokens) {
+      isDestroyed[token] = true;
+    }
+    summary.generationCount = std::max(summary.generationCount, event.generation);
+  }
+  summary.eventCount = static_cast<int64_t>(events.size()) - 1;  // without the initial event
+
+  std::unordered_set<Atom> finalAtoms;
+  for (TokenID token = 0; token < static_cast<TokenID>(isDestroyed.size()); ++token) {
+    if (isDestroyed[token]) continue;
+    const auto& atoms = system.tokenAtoms(token);
+    ++summary.finalTokenCount;
+    finalAtoms.insert(atoms.begin(), atoms.end());
+    if (includeFinalTokens) summary.finalTokens.push_back(atoms);
+  }
+  summary.finalAtomCount = static_cast<int64_t>(finalAtoms.size());
+  summary.terminationReason = system.terminationReason();
+  return summary;
+}
+}  // namespace
+
+std::vector<Ensemble::Summary> Ensemble::evolve(const std::vector<Rule>& rules,
+                                                std::vector<Job> jobs,
+                                                const uint64_t maxDestroyerEvents,
+                                                const HypergraphMatcher::OrderingSpec& orderingSpec,
+                                                const HypergraphMatcher::EventDeduplication eventDeduplication,
+                                                const bool includeFinalTokens,
+                                                const std::function<bool()>& abortRequested) {
+  std::vector<Summary> summaries(jobs.size());
+  // The remaining jobs are aborted after the first error, so only that error is kept.
+  std::exception_ptr error;
+  std::atomic<bool> failed = false;
+  const std::function<bool()> shouldAbort = [&failed, &abortRequested]() {
+    return failed.load() || abortRequested();
+  };
+
+  const auto evolveJob = [&](const size_t jobIndex) {
+    try {
+      auto& job = jobs[jobIndex];
+      HypergraphSubstitutionSystem system(rules,
+                                          std::move(job.initialTokens),
+                                          maxDestroyerEvents,
+                                          orderingSpec,
+                                          eventDeduplication,
+                                          job.randomSeed);
+      system.replace(job.stepSpec, shouldAbort);
+      summaries[jobIndex] = summarize(system, includeFinalTokens);
+    } catch (...) {
+      if (!failed.exchange(true)) error = std::current_exception();
+    }
+  };
+
+  // Only create threads if there is more than one job
+  const auto threadAcquisitionToken =
+      Parallelism::acquire(Parallelism::HardwareType::StdCpu, static_cast<int>(jobs.size()));
+  const int numThreadsToUse = threadAcquisitionToken->numThreads();
+  if (numThreadsToUse == 0) {
+    for (size_t job = 0; job < jobs.size() && !failed; ++job) {
+      evolveJob(job);
+    }
+  } else {
+    std::atomic<size_t> nextJob = 0;
+    const auto evolveJobs = [&]() {
+      for (size_t job = nextJob++; job < jobs.size() && !failed; job = nextJob++) {
+        evolveJob(job);
+      }
+    };
+    std::vector<std::thread> threads(numThreadsToUse);
+    for (int i = 0; i < numThreadsToUse; ++i) {
+      threads[i] = std::thread(evolveJobs);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  if (error) std::rethrow_exception(error);
+  return summaries;
+}
+}  // namespace SetReplace
@@ -0,0 +1,67 @@
+#ifndef LIBSETREPLACE_ENSEMBLE_HPP_
+#define LIBSETREPLACE_ENSEMBLE_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "HypergraphMatcher.hpp"
+#include "HypergraphSubstitutionSystem.hpp"
+#include "IDTypes.hpp"
+#include "Rule.hpp"
+
+namespace SetReplace {
+/** @brief Evolves many independent systems with the same rules, such as the same initial state with different random
+ * seeds, which is useful to collect statistics over random orderings.
+ */
+class Ensemble {
+ public:
+  /** @brief Initial state, random seed and step limits of a single system of the ensemble.
+   */
+  struct Job {
+    std::vector<AtomsVector> initialTokens;
+    unsigned int randomSeed = 0;
+    HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  };
+
+  /** @brief Result of evolving a single system of the ensemble.
+   */
+  struct Summary {
+    /** @brief Number of events, not including the initial one.
+     */
+    int64_t eventCount = 0;
+
+    /** @brief Largest generation of the events, 0 if there are none.
+     */
+    Generation generationCount = 0;
+
+    /** @brief Number of tokens that were not destroyed, and the number of distinct atoms in them.
+     */
+    int64_t finalTokenCount = 0;
+    int64_t finalAtomCount = 0;
+
+    HypergraphSubstitutionSystem::TerminationReason terminationReason =
+        HypergraphSubstitutionSystem::TerminationReason::NotTerminated;
+
+    /** @brief Tokens that were not destroyed in the order of creation, only filled in if requested.
+     */
+    std::vector<AtomsVector> finalTokens;
+  };
+
+  /** @brief Evolves a system for each job, and returns their summaries in the order of the jobs.
+   * @details The parameters other than jobs are the same as in the HypergraphSubstitutionSystem constructor. If
+   * threads are available, jobs are evolved in parallel, in which case matching within each job is usually
+   * single-threaded, as the threads are already taken. The results do not depend on the number of threads. Calls
+   * shouldAbort() frequently. If any job throws, the remaining ones are aborted, and the first error is rethrown.
+   * @param includeFinalTokens whether to fill in Summary::finalTokens, which otherwise only have their sizes computed.
+   */
+  static std::vector<Summary> evolve(const std::vector<Rule>& rules,
+                                     std::vector<Job> jobs,
+                                     uint64_t maxDestroyerEvents,
+                                     const HypergraphMatcher::OrderingSpec& orderingSpec,
+                                     HypergraphMatcher::EventDeduplication eventDeduplication,
+                                     bool includeFinalTokens,
+                                     const std::function<bool()>& shouldAbort);
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_ENSEMBLE_HPP_
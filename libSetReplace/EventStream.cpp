@@ -0,0 +1,346 @@
+#include "EventStream.hpp"
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SetReplace {
+namespace {
+// "SREVT" followed by the format version.
+constexpr char streamMagic[8] = {'S', 'R', 'E', 'V', 'T', '\0', '\0', '\1'};
+
+// Maps signed deltas to unsigned numbers so that small negative deltas are small as well: 0, -1, 1, -2, ... become
+// 0, 1, 2, 3, ...
+uint64_t zigzagEncode(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzagDecode(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Memory-maps the entire file read-only, or reads it into memory where mmap is not available.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw EventStreamReader::Error::CannotOpenFile;
+    contents_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = reinterpret_cast<const uint8_t*>(contents_.data());
+    size_ = contents_.size();
+#else
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) throw EventStreamReader::Error::CannotOpenFile;
+    struct stat fileStatus;
+    if (fstat(descriptor, &fileStatus) != 0) {
+      close(descriptor);
+      throw EventStreamReader::Error::CannotOpenFile;
+    }
+    // Files that do not fit in the address space cannot be mapped, and st_size would not fit in size_ either.
+    if (fileStatus.st_size < 0 ||
+        static_cast<uintmax_t>(fileStatus.st_size) > static_cast<uintmax_t>(std::numeric_limits<size_t>::max())) {
+      close(descriptor);
+      throw EventStreamReader::Error::CannotOpenFile;
+    }
+    size_ = static_cast<size_t>(fileStatus.st_size);
+    if (size_ > 0) {
+      void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (mapping == MAP_FAILED) {
+        close(descriptor);
+        throw EventStreamReader::Error::CannotOpenFile;
+      }
+      data_ = static_cast<const uint8_t*>(mapping);
+    }
+    close(descriptor);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+  }
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  std::vector<char> contents_;
+#endif
+};
+}  // namespace
+
+class EventStreamWriter::Implementation {
+ private:
+  std::ofstream file_;
+  const size_t bufferSize_;
+  std::vector<char> buffer_;
+
+  // The first output of the next event, which input token IDs are stored relative to.
+  int64_t nextTokenID_ = 0;
+  // Atoms are stored relative to the previous atom in the file. New atoms are named consecutively, so the deltas are
+  // small.
+  int64_t previousAtom_ = 0;
+  int64_t eventCount_ = 0;
+
+ public:
+  Implementation(const std::string& path, const size_t bufferSize)
+      : file_(path, std::ios::binary | std::ios::trunc), bufferSize_(std::max<size_t>(bufferSize, 1)) {
+    if (!file_) throw Error::CannotOpenFile;
+    file_.write(streamMagic, sizeof(streamMagic));
+    buffer_.reserve(bufferSize_);
+  }
+
+  Implementation(const Implementation&) = delete;
+  Implementation& operator=(const Implementation&) = delete;
+
+  ~Implementation() {
+    try {
+      flush();
+    } catch (...) {
+      // Destructors cannot throw, write errors are only reported by explicit flush() calls.
+    }
+  }
+
+  void write(const Event& event, const std::vector<AtomsVector>& outputAtoms) {
+    if (outputAtoms.size() != event.outputTokens.size() ||
+        (!event.outputTokens.empty() && event.outputTokens[0] != nextTokenID_)) {
+      throw Error::NonConsecutiveTokenIDs;
+    }
+
+    appendVarint(zigzagEncode(event.rule));
+    appendVarint(static_cast<uint64_t>(event.generation));
+
+    // The first input relative to the first output, the rest relative to the previous input, as rules usually match
+    // recently created tokens that are close to each other.
+    appendVarint(event.inputTokens.size());
+    int64_t previousToken = nextTokenID_;
+    for (const auto token : event.inputTokens) {
+      appendVarint(zigzagEncode(previousToken - token));
+      previousToken = token;
+    }
+
+    appendVarint(outputAtoms.size());
+    for (const auto& atoms : outputAtoms) {
+      appendVarint(atoms.size());
+      for (const auto atom : atoms) {
+        appendVarint(zigzagEncode(atom - previousAtom_));
+        previousAtom_ = atom;
+      }
+    }
+
+    nextTokenID_ += static_cast<int64_t>(outputAtoms.size());
+    ++eventCount_;
+    if (buffer_.size() >= bufferSize_) writeBuffer();
+  }
+
+  void flush() {
+    writeBuffer();
+    file_.flush();
+    if (!file_) throw Error::WriteFailed;
+  }
+
+  int64_t eventCount() const { return eventCount_; }
+
+ private:
+  void appendVarint(uint64_t value) {
+    while (value >= 0x80) {
+      buffer_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+    buffer_.push_back(static_cast<char>(value));
+  }
+
+  void writeBuffer() {
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    if (!file_) throw Error::WriteFailed;
+  }
+};
+
+EventStreamWriter::EventStreamWriter(const std::string& path, const size_t bufferSize)
+    : implementation_(std::make_shared<Implementation>(path, bufferSize)) {}
+
+void EventStreamWriter::write(const Event& event, const std::vector<AtomsVector>& outputAtoms) {
+  implementation_->write(event, outputAtoms);
+}
+
+void EventStreamWriter::flush() { implementation_->flush(); }
+
+int64_t EventStreamWriter::eventCount() const { return implementation_->eventCount(); }
+
+class EventStreamReader::Implementation {
+ private:
+  // Position of an event in the file, and the values its input token IDs and atoms are stored relative to.
+  struct Checkpoint {
+    size_t offset;
+    int64_t nextTokenID;
+    int64_t previousAtom;
+  };
+
+  // Decodes consecutive events starting from a checkpoint.
+  class Decoder {
+   private:
+    const uint8_t* const begin_;
+    const uint8_t* position_;
+    const uint8_t* const end_;
+    int64_t nextTokenID_;
+    int64_t previousAtom_;
+
+   public:
+    Decoder(const MappedFile& file, const Checkpoint& checkpoint)
+        : begin_(file.data()),
+          position_(file.data() + checkpoint.offset),
+          end_(file.data() + file.size()),
+          nextTokenID_(checkpoint.nextTokenID),
+          previousAtom_(checkpoint.previousAtom) {}
+
+    bool atEnd() const { return position_ == end_; }
+
+    Checkpoint checkpoint() const { return {static_cast<size_t>(position_ - begin_), nextTokenID_, previousAtom_}; }
+
+    // ID of the first output of the next event.
+    int64_t nextTokenID() const { return nextTokenID_; }
+
+    // Reads the next event, which is only stored in event and outputAtoms if they are not null.
+    void readEvent(StreamEvent* event, std::vector<AtomsVector>* outputAtoms) {
+      const int64_t rule = zigzagDecode(readVarint());
+      const auto generation = static_cast<int64_t>(readVarint());
+      if (!fitsInID<RuleID>(rule) || !fitsInID<Generation>(generation)) throw Error::InvalidFormat;
+      if (event) {
+        event->rule = static_cast<RuleID>(rule);
+        event->generation = static_cast<Generation>(generation);
+        event->inputTokens.clear();
+        event->outputTokens.clear();
+      }
+
+      const uint64_t inputCount = readCount();
+      int64_t previousToken = nextTokenID_;
+      for (uint64_t i = 0; i < inputCount; ++i) {
+        const int64_t token = previousToken - zigzagDecode(readVarint());
+        if (token < 0 || token >= nextTokenID_) throw Error::InvalidFormat;
+        if (event) event->inputTokens.push_back(static_cast<TokenID>(token));
+        previousToken = token;
+      }
+
+      const uint64_t outputCount = readCount();
+      if (!fitsInID<TokenID>(nextTokenID_ + static_cast<int64_t>(outputCount) - 1)) throw Error::InvalidFormat;
+      if (outputAtoms) outputAtoms->resize(outputCount);
+      for (uint64_t i = 0; i < outputCount; ++i) {
+        const uint64_t atomCount = readCount();
+        if (outputAtoms) (*outputAtoms)[i].resize(atomCount);
+        for (uint64_t j = 0; j < atomCount; ++j) {
+          const int64_t atom = previousAtom_ + zigzagDecode(readVarint());
+          if (!fitsInID<Atom>(atom)) throw Error::InvalidFormat;
+          if (outputAtoms) (*outputAtoms)[i][j] = static_cast<Atom>(atom);
+          previousAtom_ = atom;
+        }
+        if (event) event->outputTokens.push_back(static_cast<TokenID>(nextTokenID_));
+        ++nextTokenID_;
+      }
+    }
+
+   private:
+    uint64_t readVarint() {
+      uint64_t result = 0;
+      for (int shift = 0; shift < 64; shift += 7) {
+        if (position_ == end_) throw Error::InvalidFormat;  // truncated, e.g., if the writer was killed
+        const uint8_t byte = *(position_++);
+        result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return result;
+      }
+      throw Error::InvalidFormat;
+    }
+
+    // Counts cannot exceed the number of remaining bytes, which prevents huge allocations from corrupted files.
+    uint64_t readCount() {
+      const uint64_t count = readVarint();
+      if (count > static_cast<uint64_t>(end_ - position_)) throw Error::InvalidFormat;
+      return count;
+    }
+  };
+
+  const MappedFile file_;
+  // Checkpoints before the events 0, eventsPerCheckpoint, 2 * eventsPerCheckpoint, ...
+  std::vector<Checkpoint> checkpoints_;
+  int64_t eventCount_ = 0;
+  int64_t tokenCount_ = 0;
+
+ public:
+  explicit Implementation(const std::string& path) : file_(path) {
+    if (file_.size() < sizeof(streamMagic) ||
+        !std::equal(std::begin(streamMagic), std::end(streamMagic), file_.data())) {
+      throw Error::InvalidFormat;
+    }
+    // The entire file is decoded once, so that invalid files are rejected here rather than on access
+    Decoder decoder(file_, {sizeof(streamMagic), 0, 0});
+    for (; !decoder.atEnd(); ++eventCount_) {
+      if (eventCount_ % eventsPerCheckpoint == 0) checkpoints_.push_back(decoder.checkpoint());
+      decoder.readEvent(nullptr, nullptr);
+    }
+    tokenCount_ = decoder.nextTokenID();
+  }
+
+  int64_t eventCount() const { return eventCount_; }
+
+  int64_t tokenCount() const { return tokenCount_; }
+
+  StreamEvent event(const EventID eventID) const {
+    if (eventID < 0 || eventID >= eventCount_) throw Error::InvalidID;
+    Decoder decoder(file_, checkpoints_[static_cast<size_t>(eventID / eventsPerCheckpoint)]);
+    for (int64_t i = 0; i < eventID % eventsPerCheckpoint; ++i) {
+      decoder.readEvent(nullptr, nullptr);
+    }
+    StreamEvent result{};
+    decoder.readEvent(&result, nullptr);
+    return result;
+  }
+
+  AtomsVector tokenAtoms(const TokenID tokenID) const {
+    if (tokenID < 0 || tokenID >= tokenCount_) throw Error::InvalidID;
+    // The last checkpoint before the event that created the token
+    const auto checkpointIt = std::upper_bound(
+        checkpoints_.begin(), checkpoints_.end(), tokenID, [](const TokenID token, const Checkpoint& checkpoint) {
+          return token < checkpoint.nextTokenID;
+        });
+    Decoder decoder(file_, *std::prev(checkpointIt));
+    std::vector<AtomsVector> outputAtoms;
+    int64_t firstOutput;
+    do {
+      firstOutput = decoder.nextTokenID();
+      decoder.readEvent(nullptr, &outputAtoms);
+    } while (decoder.nextTokenID() <= tokenID);
+    return std::move(outputAtoms[static_cast<size_t>(tokenID - firstOutput)]);
+  }
+};
+
+EventStreamReader::EventStreamReader(const std::string& path)
+    : implementation_(std::make_shared<Implementation>(path)) {}
+
+int64_t EventStreamReader::eventCount() const { return implementation_->eventCount(); }
+
+int64_t EventStreamReader::tokenCount() const { return implementation_->tokenCount(); }
+
+StreamEvent EventStreamReader::event(const EventID eventID) const { return implementation_->event(eventID); }
+
+AtomsVector EventStreamReader::tokenAtoms(const TokenID tokenID) const { return implementation_->tokenAtoms(tokenID); }
+}  // namespace SetReplace
@@ -0,0 +1,114 @@
+#ifndef LIBSETREPLACE_EVENTSTREAM_HPP_
+#define LIBSETREPLACE_EVENTSTREAM_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IDTypes.hpp"
+#include "TokenEventGraph.hpp"
+
+namespace SetReplace {
+/** @brief Receives the events of a HypergraphSubstitutionSystem in the order they are created, starting with the
+ * initial event.
+ */
+class EventSink {
+ public:
+  virtual ~EventSink() = default;
+
+  /** @brief Called once per event.
+   * @param outputAtoms atoms of the event outputs, in the same order as event.outputTokens.
+   * @details Output token IDs are consecutive, and follow the outputs of the previous event.
+   */
+  virtual void write(const Event& event, const std::vector<AtomsVector>& outputAtoms) = 0;
+
+  /** @brief Called after each HypergraphSubstitutionSystem::replace(), so that buffered events become visible.
+   */
+  virtual void flush() {}
+};
+
+/** @brief Appends events and the atoms of their outputs to a binary file, which can be read with EventStreamReader.
+ * @details Events are encoded into a buffer, which is written to the file once it is full, on flush(), and on
+ * destruction. Numbers are stored as variable-length integers. Output token IDs are implied by the order of events, and
+ * input token IDs and atoms are stored as deltas from the nearby ones, so most of them take a single byte.
+ */
+class EventStreamWriter : public EventSink {
+ public:
+  /** @brief Type of the error occurred during writing.
+   */
+  enum class Error { CannotOpenFile, WriteFailed, NonConsecutiveTokenIDs };
+
+  static constexpr size_t defaultBufferSize = 1 << 20;
+
+  /** @brief Creates the file, or truncates it if it exists.
+   */
+  explicit EventStreamWriter(const std::string& path, size_t bufferSize = defaultBufferSize);
+
+  void write(const Event& event, const std::vector<AtomsVector>& outputAtoms) override;
+
+  void flush() override;
+
+  /** @brief Number of events written so far, including the initial one.
+   */
+  int64_t eventCount() const;
+
+ private:
+  class Implementation;
+  std::shared_ptr<Implementation> implementation_;
+};
+
+/** @brief An event read by EventStreamReader, which owns its token IDs, unlike Event.
+ */
+struct StreamEvent {
+  RuleID rule;
+  std::vector<TokenID> inputTokens;
+  std::vector<TokenID> outputTokens;
+  Generation generation;
+};
+
+/** @brief Reads the events and tokens written by EventStreamWriter.
+ * @details The file is memory-mapped (read into memory on Windows), and is validated once on construction, which also
+ * records the decoder state before every eventsPerCheckpoint-th event. Events and tokens are then decoded from the
+ * mapping on access, starting from the nearest checkpoint, so the memory taken by the reader is a small fraction of the
+ * file size.
+ */
+class EventStreamReader {
+ public:
+  /** @brief Type of the error occurred during reading.
+   */
+  enum class Error { CannotOpenFile, InvalidFormat, InvalidID };
+
+  static constexpr int64_t eventsPerCheckpoint = 16;
+
+  /** @brief Opens and validates the file.
+   * @details Throws Error::CannotOpenFile if the file cannot be opened or mapped, including files larger than the
+   * address space, and Error::InvalidFormat if it was not written by EventStreamWriter.
+   */
+  explicit EventStreamReader(const std::string& path);
+
+  /** @brief Number of events in the file, including the initial one.
+   */
+  int64_t eventCount() const;
+
+  /** @brief Number of tokens created by the events in the file.
+   */
+  int64_t tokenCount() const;
+
+  /** @brief Event with the given ID, same as HypergraphSubstitutionSystem::events()[eventID] of the system that wrote
+   * it. Throws Error::InvalidID if there is no such event.
+   */
+  StreamEvent event(EventID eventID) const;
+
+  /** @brief Atoms of the token with the given ID, same as HypergraphSubstitutionSystem::tokens()[tokenID] of the system
+   * that wrote it. Throws Error::InvalidID if there is no such token.
+   */
+  AtomsVector tokenAtoms(TokenID tokenID) const;
+
+ private:
+  class Implementation;
+  std::shared_ptr<Implementation> implementation_;
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_EVENTSTREAM_HPP_
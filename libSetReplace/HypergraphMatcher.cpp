@@ -2,12 +2,15 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <deque>
 #include <functional>
 #include <limits>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <random>
+#include <scoped_allocator>
 #include <set>
 #include <shared_mutex>  // NOLINT cpplint thinks this is a C system header for some reason
 #include <thread>
@@ -16,13 +19,18 @@
 #include <utility>
 #include <vector>
 
+#include "Arena.hpp"
 #include "Parallelism.hpp"
+#include "SumTree.hpp"
+#include "Tracing.hpp"
 
 namespace SetReplace {
 namespace {
 class MatchComparator {
  private:
   const HypergraphMatcher::OrderingSpec orderingSpec_;
+  // Only used for OrderingFunction::RuleWeight
+  const std::vector<Rule>* rules_;
 
   template <typename T>
   static int compare(T a, T b) {
@@ -30,7 +38,8 @@ class MatchComparator {
   }
 
  public:
-  explicit MatchComparator(HypergraphMatcher::OrderingSpec orderingSpec) : orderingSpec_(std::move(orderingSpec)) {}
+  MatchComparator(HypergraphMatcher::OrderingSpec orderingSpec, const std::vector<Rule>* rules)
+      : orderingSpec_(std::move(orderingSpec)), rules_(rules) {}
 
   bool operator()(const MatchPtr& a, const MatchPtr& b) const {
     for (const auto& ordering : orderingSpec_) {
@@ -51,7 +60,7 @@ class MatchComparator {
     return false;
   }
 
-  static int compare(const MatchPtr& a, const MatchPtr& b, const HypergraphMatcher::OrderingFunction& ordering) {
+  int compare(const MatchPtr& a, const MatchPtr& b, const HypergraphMatcher::OrderingFunction& ordering) const {
     switch (ordering) {
       case HypergraphMatcher::OrderingFunction::SortedInputTokenIndices:
         return compareSortedIDs(a, b, false);
@@ -65,6 +74,15 @@ class MatchComparator {
       case HypergraphMatcher::OrderingFunction::RuleIndex:
         return compare(a->rule, b->rule);
 
+      case HypergraphMatcher::OrderingFunction::MaxInputGeneration:
+        return compare(a->maxInputGeneration, b->maxInputGeneration);
+
+      case HypergraphMatcher::OrderingFunction::MinInputGeneration:
+        return compare(a->minInputGeneration, b->minInputGeneration);
+
+      case HypergraphMatcher::OrderingFunction::RuleWeight:
+        return compare((*rules_)[a->rule].weight, (*rules_)[b->rule].weight);
+
       default:
         return 0;  // throw is called in constructor of Matcher::Implementation
     }
@@ -131,34 +149,221 @@ class MatchEquality {
     return mismatchedIterators.first == a->inputTokens.end() && mismatchedIterators.second == b->inputTokens.end();
   }
 };
+
+// Matches are arranged in buckets. Each bucket contains matches that are equivalent in terms of the ordering
+// function, however, buckets themselves are ordered according to that function.
+// To select next match, we select a random element from the first bucket.
+// That in particular means the random ordering function will automatically be used if ordering
+// specification is incomplete. For OrderingFunction::WeightedRandom, the weights of the matches of each bucket are also
+// kept in a sum tree, so that the weighted choice takes O(log n).
+//
+// If the first ordering function is a generation, the ordered buckets are further split into levels indexed by that
+// generation, and only the remaining ordering functions are used to order the buckets within each level. The levels
+// form a bucket queue with a cursor at the first nonempty level. Generations of new matches rarely go below the
+// cursor, so generation-ordered evolution only moves the cursor forward, and the insertion and deletion of matches does
+// not depend on the number of generations.
+class MatchQueue {
+ public:
+  using MatchVector = std::vector<MatchPtr, ArenaAllocator<MatchPtr>>;
+
+  // We use MatchPtr instead of Match to save memory, however, they are hashed and sorted according to their
+  // dereferenced values in the corresponding classes above.
+  // We cannot directly select a random element from an unordered_map, which is why we use a vector here.
+  struct Bucket {
+    using allocator_type = ArenaAllocator<Bucket>;
+    explicit Bucket(const allocator_type& allocator)
+        : indices(0, MatchHasher(), MatchEquality(), allocator), matches(allocator) {}
+
+    std::unordered_map<MatchPtr,
+                       size_t,
+                       MatchHasher,
+                       MatchEquality,
+                       ArenaAllocator<std::pair<const MatchPtr, size_t>>>
+        indices;
+    MatchVector matches;
+  };
+
+  using Weights = SumTree<ArenaAllocator<double>>;
+
+  // The levels and buckets are allocated from arena.
+  MatchQueue(const HypergraphMatcher::OrderingSpec& orderingSpec, const std::vector<Rule>* rules, Arena* arena)
+      : levelFunction_(levelFunction(orderingSpec)),
+        reverseLevels_(levelFunction_ != HypergraphMatcher::OrderingFunction::Last &&
+                       orderingSpec.front().second == HypergraphMatcher::OrderingDirection::Reverse),
+        bucketsComparator_(levelFunction_ != HypergraphMatcher::OrderingFunction::Last
+                               ? HypergraphMatcher::OrderingSpec(orderingSpec.begin() + 1, orderingSpec.end())
+                               : orderingSpec,
+                           rules),
+        levelAllocator_(ArenaAllocator<Level::value_type>(arena)),
+        isWeighted_(HypergraphMatcher::isWeightedRandom(orderingSpec)),
+        bucketWeights_(BucketWeights::allocator_type(ArenaAllocator<BucketWeights::value_type>(arena))) {
+    levels_.emplace_back(bucketsComparator_, levelAllocator_);
+  }
+
+  // Returns false if the match is already in the queue. The weight is ignored unless the queue is weighted.
+  bool insert(const MatchPtr& matchPtr, const double weight) {
+    const size_t levelIndex = this->levelIndex(matchPtr);
+    while (levels_.size() <= levelIndex) {
+      levels_.emplace_back(bucketsComparator_, levelAllocator_);
+    }
+    auto& bucket = levels_[levelIndex].try_emplace(matchPtr).first->second;  // works because comparison is smart
+    if (bucket.indices.count(matchPtr)) return false;  // works because hashing is smart
+    bucket.matches.push_back(matchPtr);
+    bucket.indices[matchPtr] = bucket.matches.size() - 1;
+    if (isWeighted_) bucketWeights_[&bucket].push_back(weight);
+
+    if (size_ == 0 || (reverseLevels_ ? levelIndex > firstLevel_ : levelIndex < firstLevel_)) {
+      firstLevel_ = levelIndex;
+    }
+    ++size_;
+    return true;
+  }
+
+  void erase(const MatchPtr& matchPtr) {
+    auto& level = levels_[levelIndex(matchPtr)];
+    const auto bucketIt = level.find(matchPtr);
+    auto& bucket = bucketIt->second;
+    const auto bucketIndex = bucket.indices.at(matchPtr);
+    // O(1) order-non-preserving deletion from a vector
+    std::swap(bucket.matches[bucketIndex], bucket.matches[bucket.matches.size() - 1]);
+    bucket.indices[bucket.matches[bucketIndex]] = bucketIndex;
+    bucket.indices.erase(bucket.matches[bucket.matches.size() - 1]);
+    bucket.matches.pop_back();
+    if (isWeighted_) {
+      const auto weightsIt = bucketWeights_.find(&bucket);
+      auto& weights = weightsIt->second;
+      weights.set(bucketIndex, weights.weight(weights.size() - 1));
+      weights.pop_back();
+      if (bucket.indices.empty()) bucketWeights_.erase(weightsIt);
+    }
+    if (bucket.indices.empty()) level.erase(bucketIt);
+
+    --size_;
+    while (size_ > 0 && levels_[firstLevel_].empty()) {
+      if (reverseLevels_) {
+        --firstLevel_;
+      } else {
+        ++firstLevel_;
+      }
+    }
+  }
+
+  bool empty() const { return size_ == 0; }
+
+  size_t size() const { return size_; }
+
+  // Matches that are equivalent according to the ordering spec, and come before all others.
+  const Bucket& firstBucket() const { return levels_[firstLevel_].begin()->second; }
+
+  // Weights of the matches of the first bucket, only available if the queue is weighted.
+  const Weights& firstBucketWeights() const { return bucketWeights_.find(&firstBucket())->second; }
+
+  // All matches in the queue order.
+  std::vector<MatchPtr> allMatches() const {
+    std::vector<MatchPtr> result;
+    result.reserve(size_);
+    for (size_t i = 0; i < levels_.size(); ++i) {
+      for (const auto& exampleAndBucket : levels_[reverseLevels_ ? levels_.size() - 1 - i : i]) {
+        result.insert(result.end(), exampleAndBucket.second.matches.begin(), exampleAndBucket.second.matches.end());
+      }
+    }
+    return result;
+  }
+
+ private:
+  using LevelAllocator = std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const MatchPtr, Bucket>>>;
+  using Level = std::map<MatchPtr, Bucket, MatchComparator, LevelAllocator>;
+  // Keyed by the address of the bucket, which does not change, as the buckets are nodes of the levels. These are kept
+  // separately from the buckets, so that they take no memory for the other orderings, which often have a bucket for
+  // every match.
+  using BucketWeights =
+      std::unordered_map<const Bucket*,
+                         Weights,
+                         std::hash<const Bucket*>,
+                         std::equal_to<const Bucket*>,
+                         std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const Bucket* const, Weights>>>>;
+
+  // Yields OrderingFunction::Last if the queue has a single level.
+  static HypergraphMatcher::OrderingFunction levelFunction(const HypergraphMatcher::OrderingSpec& orderingSpec) {
+    if (!orderingSpec.empty() &&
+        (orderingSpec.front().first == HypergraphMatcher::OrderingFunction::MaxInputGeneration ||
+         orderingSpec.front().first == HypergraphMatcher::OrderingFunction::MinInputGeneration)) {
+      return orderingSpec.front().first;
+    }
+    return HypergraphMatcher::OrderingFunction::Last;
+  }
+
+  size_t levelIndex(const MatchPtr& matchPtr) const {
+    switch (levelFunction_) {
+      case HypergraphMatcher::OrderingFunction::MaxInputGeneration:
+        return static_cast<size_t>(matchPtr->maxInputGeneration);
+      case HypergraphMatcher::OrderingFunction::MinInputGeneration:
+        return static_cast<size_t>(matchPtr->minInputGeneration);
+      default:
+        return 0;
+    }
+  }
+
+  const HypergraphMatcher::OrderingFunction levelFunction_;
+  const bool reverseLevels_;
+  const MatchComparator bucketsComparator_;
+  const LevelAllocator levelAllocator_;
+  // A deque, so that adding levels does not move the existing ones.
+  std::deque<Level> levels_;
+  size_t firstLevel_ = 0;
+  size_t size_ = 0;
+  const bool isWeighted_;
+  BucketWeights bucketWeights_;
+};
+
+// If the cheapest input is estimated to have more candidate tokens than this, the candidates of all inputs are
+// enumerated to find the actual cheapest one.
+constexpr size_t maxTrustedCandidateEstimate = 256;
+
+// If the ordering is total, tokens are split into chunks of at least this size that are matched in separate threads.
+constexpr size_t minTokensPerMatchingTask = 1024;
+
+// Random products of component matches that are not stored are sampled at most this many times before the available
+// ones are enumerated instead, which only happens if almost all pairs of component matches share tokens.
+constexpr int maxProductSamples = 64;
 }  // namespace
 
 class HypergraphMatcher::Implementation {
  private:
+  using MatchSet = std::unordered_set<MatchPtr, MatchHasher, MatchEquality, ArenaAllocator<MatchPtr>>;
+  using MatchVector = MatchQueue::MatchVector;
+  using MatchVectorList = std::vector<MatchVector, std::scoped_allocator_adaptor<ArenaAllocator<MatchVector>>>;
+  using TokenMatches =
+      std::unordered_map<TokenID,
+                         MatchVector,
+                         std::hash<TokenID>,
+                         std::equal_to<TokenID>,
+                         std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const TokenID, MatchVector>>>>;
+
+  // Matches and the structures indexing them are allocated from here. Declared first, so that it outlives them.
+  Arena arena_;
+
   const std::vector<Rule>& rules_;
   AtomsIndex& atomsIndex_;
   const GetAtomsVectorFunc getAtomsVector_;
   const GetTokenSeparationFunc getTokenSeparation_;
+  const GetTokenGenerationFunc getTokenGeneration_;
+  const GetMatchWeightFunc getMatchWeight_;
   const OrderingSpec orderingSpec_;
+  const bool isWeightedRandom_;
 
-  // Matches are arranged in buckets. Each bucket contains matches that are equivalent in terms of the ordering
-  // function, however, buckets themselves are ordered according to that function.
-  // To select next match, we select a random element from the first bucket.
-  // That in particular means the random ordering function will automatically be used if ordering
-  // specification is incomplete.
-
-  // We use MatchPtr instead of Match to save memory, however, they are hashed and sorted according to their
-  // dereferenced values in the corresponding classes above.
-
-  // We cannot directly select a random element from an unordered_map, which is why we use a vector here.
-  using Bucket = std::pair<std::unordered_map<MatchPtr, size_t, MatchHasher, MatchEquality>, std::vector<MatchPtr>>;
-  std::map<MatchPtr, Bucket, MatchComparator> matchQueue_;
-  std::unordered_map<TokenID, std::unordered_set<MatchPtr, MatchHasher, MatchEquality>> tokensToMatches_;
+  MatchQueue matchQueue_;
+  std::unordered_map<TokenID,
+                     MatchSet,
+                     std::hash<TokenID>,
+                     std::equal_to<TokenID>,
+                     std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const TokenID, MatchSet>>>>
+      tokensToMatches_;
 
   // A frequent operation here is detection of duplicate matches. Hashing is much faster than searching for
   // duplicates in a std::map, so we separately keep a flat hash table of all matches to speed that up.
   // That's purely an optimization.
-  std::unordered_set<MatchPtr, MatchHasher, MatchEquality> allMatches_;
+  MatchSet allMatches_;
 
   std::mt19937 randomGenerator_;
   MatchPtr nextMatch_;
@@ -168,7 +373,17 @@ class HypergraphMatcher::Implementation {
   // This is needed either for event deduplication or to keep the order in which matches are added deterministic.
   // We sort them for event deduplication purposes by sets they match to, and then by the chosen ordering function,
   // so that each batch with identical inputs can be processed together, and it's obvious which copy should be retained.
-  std::set<MatchPtr, MatchComparator> newMatches_;
+  std::set<MatchPtr, MatchComparator, ArenaAllocator<MatchPtr>> newMatches_;
+  // The order in which matches of a rule are found only affects the random choice between equivalent matches, so if
+  // there is no such choice, matching of a rule can be split between threads.
+  const bool splitRulesBetweenThreads_;
+
+  const MatchRemoval matchRemoval_;
+  // Tokens passed to removeMatchesInvolvingTokens in the lazy mode, indexed by ID. Matches involving them are stale.
+  std::vector<bool, ArenaAllocator<bool>> destroyedTokens_;
+  // Destroyed tokens whose matches have not been removed yet, and an upper bound of the number of their matches.
+  std::vector<TokenID, ArenaAllocator<TokenID>> tokensWithStaleMatches_;
+  size_t staleMatchCount_ = 0;
 
   /**
    * This variable is typically monitored in shouldAbort such that other threads can check if they should abort.
@@ -183,6 +398,51 @@ class HypergraphMatcher::Implementation {
    */
   mutable std::mutex matchMutex;
 
+  // Only modified from the calling thread, the worker threads accumulate into their own instances.
+  Statistics statistics_;
+
+  // Connected components of the rule inputs, as lists of input indices, and the corresponding inputs.
+  // Rules with a single component are matched as a whole. Otherwise, each component is matched separately, and complete
+  // matches are products of the component matches, which avoids enumerating unrelated tokens during matching.
+  std::vector<std::vector<std::vector<size_t>>> ruleInputComponents_;
+  std::vector<std::vector<std::vector<AtomsVector>>> ruleComponentInputs_;
+  // Matches of each component of disconnected rules, indexed by rule and component, with input tokens in the order of
+  // the component inputs. Only accessed by the thread matching the corresponding rule.
+  std::vector<MatchVectorList> componentMatches_;
+  // Component matches found by the current call to completeMatchesStartingWithInput, indexed by rule.
+  std::vector<std::vector<Match>> newComponentMatches_;
+  bool hasDisconnectedRules_ = false;
+
+  // Products of the two components of a disconnected rule that are not stored, because the ordering spec does not
+  // distinguish them, see HypergraphMatcher. They are chosen from componentMatches_ instead.
+  struct LazyProducts {
+    explicit LazyProducts(Arena* arena)
+        : tokenMatches{TokenMatches(ArenaAllocator<TokenMatches::value_type>(arena)),
+                       TokenMatches(ArenaAllocator<TokenMatches::value_type>(arena))},
+          deletedProducts(0, MatchHasher(), MatchEquality(), ArenaAllocator<MatchPtr>(arena)) {}
+
+    bool enabled = false;
+    // Pairs of component matches that share a token, and therefore do not form a product.
+    size_t conflictingPairs = 0;
+    // Matches of each component containing each token.
+    TokenMatches tokenMatches[2];
+    // Products passed to deleteMatch(), which are not chosen again.
+    MatchSet deletedProducts;
+    // Indices of the component matches of the last product chosen with OrderingFunction::Any. The next one is looked
+    // for starting from there, so that the deleted products before it are not enumerated again.
+    std::pair<size_t, size_t> cursor = {0, 0};
+  };
+  std::vector<LazyProducts> lazyProducts_;
+  bool hasLazyProducts_ = false;
+  // Compares the rules of lazy products with each other and with the stored matches. The ordering spec only compares
+  // rules if there are any lazy products, so a match without input tokens stands for all matches of its rule.
+  const MatchComparator ruleComparator_;
+  std::vector<MatchPtr> ruleMatches_;
+
+  // Bytes taken by the input tokens of the matches in allMatches_ and componentMatches_, which are allocated outside of
+  // the arena. Component matches are stored by the matching threads.
+  std::atomic<size_t> matchInputTokensBytes_{0};
+
  public:
   Implementation(const std::vector<Rule>& rules,
                  AtomsIndex* atomsIndex,
@@ -190,27 +450,76 @@ class HypergraphMatcher::Implementation {
                  GetTokenSeparationFunc getTokenSeparation,
                  const OrderingSpec& orderingSpec,
                  const EventDeduplication& eventDeduplication,
-                 const unsigned int randomSeed)
-      : rules_(rules),
+                 const unsigned int randomSeed,
+                 GetTokenGenerationFunc getTokenGeneration,
+                 const MatchRemoval matchRemoval,
+                 const bool useHugePages,
+                 GetMatchWeightFunc getMatchWeight)
+      : arena_(useHugePages),
+        rules_(rules),
         atomsIndex_(*atomsIndex),
         getAtomsVector_(std::move(getAtomsVector)),
         getTokenSeparation_(std::move(getTokenSeparation)),
+        getTokenGeneration_(std::move(getTokenGeneration)),
+        getMatchWeight_(std::move(getMatchWeight)),
         orderingSpec_(orderingSpec),
-        matchQueue_(MatchComparator(orderingSpec)),
+        isWeightedRandom_(isWeightedRandom(orderingSpec)),
+        matchQueue_(orderingSpec, &rules, &arena_),
+        tokensToMatches_(ArenaAllocator<MatchSet>(&arena_)),
+        allMatches_(0, MatchHasher(), MatchEquality(), ArenaAllocator<MatchPtr>(&arena_)),
         randomGenerator_(randomSeed),
         eventDeduplication_(eventDeduplication),
-        newMatches_(MatchComparator(newMatchesOrderingSpec(orderingSpec))),
-        currentError(None) {
+        newMatches_(MatchComparator(newMatchesOrderingSpec(orderingSpec), &rules), ArenaAllocator<MatchPtr>(&arena_)),
+        splitRulesBetweenThreads_(isTotalOrder(orderingSpec)),
+        matchRemoval_(matchRemoval),
+        destroyedTokens_(ArenaAllocator<bool>(&arena_)),
+        tokensWithStaleMatches_(ArenaAllocator<TokenID>(&arena_)),
+        currentError(None),
+        ruleComparator_(orderingSpec, &rules) {
     for (const auto& ordering : orderingSpec) {
       if (ordering.first < OrderingFunction::First || ordering.first >= OrderingFunction::Last) {
         throw HypergraphMatcher::Error::InvalidOrderingFunction;
       } else if (ordering.second < OrderingDirection::First || ordering.second >= OrderingDirection::Last) {
         throw HypergraphMatcher::Error::InvalidOrderingDirection;
+      } else if ((ordering.first == OrderingFunction::MaxInputGeneration ||
+                  ordering.first == OrderingFunction::MinInputGeneration) &&
+                 !getTokenGeneration_) {
+        throw HypergraphMatcher::Error::InvalidOrderingFunction;
+      }
+    }
+    if (isWeightedRandom_) {
+      for (const auto& rule : rules) {
+        if (!isValidWeight(rule.weight)) throw HypergraphMatcher::Error::InvalidWeight;
       }
     }
+
+    ruleInputComponents_.reserve(rules.size());
+    ruleComponentInputs_.reserve(rules.size());
+    for (const auto& rule : rules) {
+      ruleInputComponents_.push_back(inputComponents(rule.inputs));
+      auto& componentInputs = ruleComponentInputs_.emplace_back();
+      for (const auto& component : ruleInputComponents_.back()) {
+        auto& inputs = componentInputs.emplace_back();
+        for (const auto inputIndex : component) inputs.push_back(rule.inputs[inputIndex]);
+      }
+      componentMatches_.emplace_back(ruleInputComponents_.back().size(),
+                                     MatchVector(ArenaAllocator<MatchPtr>(&arena_)),
+                                     ArenaAllocator<MatchVector>(&arena_));
+      hasDisconnectedRules_ = hasDisconnectedRules_ || ruleInputComponents_.back().size() > 1;
+
+      auto& lazyProducts = lazyProducts_.emplace_back(&arena_);
+      lazyProducts.enabled = ruleInputComponents_.back().size() == 2 &&
+                             rule.eventSelectionFunction == EventSelectionFunction::All &&
+                             eventDeduplication == EventDeduplication::None && ordersByRuleOnly(orderingSpec) &&
+                             !(isWeightedRandom_ && getMatchWeight_);
+      hasLazyProducts_ = hasLazyProducts_ || lazyProducts.enabled;
+      ruleMatches_.push_back(std::make_shared<Match>(Match{static_cast<RuleID>(ruleMatches_.size()), {}}));
+    }
+    newComponentMatches_.resize(rules.size());
   }
 
   void addMatchesInvolvingTokens(const std::vector<TokenID>& tokenIDs, const std::function<bool()>& abortRequested) {
+    Tracing::Scope traceScope("addMatchesInvolvingTokens");
     // If one thread errors, alert other threads with this function
     const std::function<bool()> shouldAbort = [this, &abortRequested]() {
       return getCurrentError() != None || abortRequested();
@@ -218,32 +527,45 @@ class HypergraphMatcher::Implementation {
 
     MatchStorage matchStorage;
     {
-      // Only create threads if there is more than one rule
-      const auto threadAcquisitionToken =
-          Parallelism::acquire(Parallelism::HardwareType::StdCpu, static_cast<int>(rules_.size()));
+      // Only create threads if there is more than one rule or chunk of tokens
+      const size_t maxChunksPerRule =
+          splitRulesBetweenThreads_ ? (tokenIDs.size() + minTokensPerMatchingTask - 1) / minTokensPerMatchingTask : 1;
+      const auto threadAcquisitionToken = Parallelism::acquire(
+          Parallelism::HardwareType::StdCpu, static_cast<int>(rules_.size() * std::max<size_t>(maxChunksPerRule, 1)));
       const int& numThreadsToUse = threadAcquisitionToken->numThreads();
       matchStorage = numThreadsToUse == 0 && eventDeduplication_ == EventDeduplication::None ? MatchStorage::Main
                                                                                              : MatchStorage::NewMatches;
-
-      auto addMatchesForRuleRange = [=](RuleID start) {
-        for (RuleID i = start; i < static_cast<RuleID>(rules_.size()); i += numThreadsToUse) {
-          addMatchesForRule(tokenIDs, i, shouldAbort, matchStorage);
+      const auto tasks = matchingTasks(tokenIDs, std::min(maxChunksPerRule, static_cast<size_t>(numThreadsToUse)));
+
+      auto addMatchesForRuleRange = [=, &tasks](size_t start, Statistics* threadStatistics) {
+        Tracing::Scope threadTraceScope("addMatchesForRules");
+        for (size_t i = start; i < tasks.size(); i += numThreadsToUse) {
+          addMatchesForRule(tasks[i].second.empty() ? tokenIDs : tasks[i].second,
+                            tasks[i].first,
+                            shouldAbort,
+                            matchStorage,
+                            threadStatistics);
         }
       };
 
       if (numThreadsToUse > 0) {
         // Multi-threaded path
         std::vector<std::thread> threads(numThreadsToUse);
+        std::vector<Statistics> threadStatistics(numThreadsToUse);
         for (int i = 0; i < numThreadsToUse; ++i) {
-          threads[i] = std::thread(addMatchesForRuleRange, i);
+          threads[i] = std::thread(addMatchesForRuleRange, i, &threadStatistics[i]);
         }
         for (auto& thread : threads) {
           thread.join();
         }
+        for (const auto& statistics : threadStatistics) {
+          statistics_ += statistics;
+        }
       } else {
         // Single-threaded path
+        Tracing::Scope rulesTraceScope("addMatchesForRules");
         for (RuleID i = 0; i < static_cast<RuleID>(rules_.size()); ++i) {
-          addMatchesForRule(tokenIDs, i, shouldAbort, matchStorage);
+          addMatchesForRule(tokenIDs, i, shouldAbort, matchStorage, &statistics_);
         }
       }
     }
@@ -255,10 +577,14 @@ class HypergraphMatcher::Implementation {
     }
 
     if (eventDeduplication_ == EventDeduplication::SameInputSetIsomorphicOutputs) {
+      Statistics::ScopedTimer timer(&statistics_, Statistics::Timer::Deduplication);
+      Tracing::Scope deduplicationTraceScope("removeIdenticalMatches");
       removeIdenticalMatches(abortRequested);
     }
 
     if (matchStorage == MatchStorage::NewMatches) {
+      Statistics::ScopedTimer timer(&statistics_, Statistics::Timer::MatchInsertion);
+      Tracing::Scope insertionTraceScope("insertNewMatches");
       insertNewMatches();
     }
     chooseNextMatch();
@@ -267,11 +593,19 @@ class HypergraphMatcher::Implementation {
   // Note, deletion changes the ordering of allMatchIterators_, therefore
   // deletion should be done in deterministic order, otherwise, the random replacements will not be deterministic
   void removeMatchesInvolvingTokens(const std::vector<TokenID>& tokenIDs) {
+    Statistics::ScopedTimer timer(&statistics_, Statistics::Timer::MatchRemoval);
+    Tracing::Scope traceScope("removeMatchesInvolvingTokens");
+    if (matchRemoval_ == MatchRemoval::Lazy) {
+      markTokensDestroyed(tokenIDs);
+      if (hasDisconnectedRules_) removeComponentMatchesInvolvingTokens(tokenIDs);
+      chooseNextMatch();
+      return;
+    }
     // do not use unordered_set, as it make order undeterministic
     // any ordering spec works here, as long as it's complete.
     OrderingSpec fullOrderingSpec = {{OrderingFunction::InputTokenIndices, OrderingDirection::Normal},
                                      {OrderingFunction::RuleIndex, OrderingDirection::Normal}};
-    std::set<MatchPtr, MatchComparator> matchesToDelete((MatchComparator(fullOrderingSpec)));
+    std::set<MatchPtr, MatchComparator> matchesToDelete(MatchComparator(fullOrderingSpec, &rules_));
 
     for (const auto& token : tokenIDs) {
       const auto& matches = tokensToMatches_[token];
@@ -282,11 +616,21 @@ class HypergraphMatcher::Implementation {
       deleteMatch(match);
     }
 
+    if (hasDisconnectedRules_) removeComponentMatchesInvolvingTokens(tokenIDs);
+
     chooseNextMatch();
   }
 
   void deleteMatch(const MatchPtr& matchPtr) {
-    allMatches_.erase(matchPtr);
+    Tracing::Scope traceScope("deleteMatch");
+    statistics_.increment(Statistics::Counter::MatchesRemoved);
+    if (lazyProducts_[matchPtr->rule].enabled) {
+      if (lazyProducts_[matchPtr->rule].deletedProducts.insert(matchPtr).second) {
+        matchInputTokensBytes_ += inputTokensBytes(*matchPtr);
+      }
+      return;
+    }
+    if (allMatches_.erase(matchPtr)) matchInputTokensBytes_ -= inputTokensBytes(*matchPtr);
 
     const auto& tokens = matchPtr->inputTokens;
     for (const auto token : tokens) {
@@ -294,25 +638,49 @@ class HypergraphMatcher::Implementation {
       if (tokensToMatches_[token].empty()) tokensToMatches_.erase(token);
     }
 
-    const auto bucketIt = matchQueue_.find(matchPtr);
-    auto& bucket = bucketIt->second;
-    const auto bucketIndex = bucket.first.at(matchPtr);
-    // O(1) order-non-preserving deletion from a vector
-    std::swap(bucket.second[bucketIndex], bucket.second[bucket.second.size() - 1]);
-    bucket.first[bucket.second[bucketIndex]] = bucketIndex;
-    bucket.first.erase(bucket.second[bucket.second.size() - 1]);
-    bucket.second.pop_back();
-    if (bucket.first.empty()) matchQueue_.erase(bucketIt);
+    matchQueue_.erase(matchPtr);
   }
 
-  bool empty() const { return matchQueue_.empty(); }
+  // The stale matches are removed by chooseNextMatch() until the next match is not stale, so the queue is only nonempty
+  // if there is a valid match in it.
+  bool empty() const {
+    if (!matchQueue_.empty()) return false;
+    for (RuleID rule = 0; hasLazyProducts_ && rule < static_cast<RuleID>(rules_.size()); ++rule) {
+      if (productCount(rule) > 0) return false;
+    }
+    return true;
+  }
+
+  const Statistics& statistics() const { return statistics_; }
+
+  size_t memoryUsage() const { return arena_.reservedBytes() + matchInputTokensBytes_; }
+
+  double totalWeight() const {
+    if (empty()) return 0;
+    bool queueIncluded;
+    double result = 0;
+    for (const auto rule : firstProductRules(&queueIncluded)) {
+      result += productsWeight(rule);
+    }
+    return queueIncluded ? result + queueWeight() : result;
+  }
 
   MatchPtr nextMatch() const { return nextMatch_; }
 
-  std::vector<MatchPtr> allMatches() const {
-    std::vector<MatchPtr> result;
-    for (const auto& exampleAndBucket : matchQueue_) {
-      result.insert(result.end(), exampleAndBucket.second.second.begin(), exampleAndBucket.second.second.end());
+  std::vector<MatchPtr> allMatches() {
+    auto result = matchQueue_.allMatches();
+    if (staleMatchCount_ > 0) {
+      const auto isStaleMatch = [this](const MatchPtr& match) { return isStale(match); };
+      result.erase(std::remove_if(result.begin(), result.end(), isStaleMatch), result.end());
+    }
+    for (RuleID rule = 0; hasLazyProducts_ && rule < static_cast<RuleID>(rules_.size()); ++rule) {
+      if (!lazyProducts_[rule].enabled) continue;
+      Match product;
+      for (size_t first = 0; first < componentMatches_[rule][0].size(); ++first) {
+        for (size_t second = 0; second < componentMatches_[rule][1].size(); ++second) {
+          if (isAvailableProduct(rule, first, second, &product)) result.push_back(newProductPtr(std::move(product)));
+        }
+      }
     }
     return result;
   }
@@ -330,19 +698,410 @@ class HypergraphMatcher::Implementation {
     return outputAtomsVectors(rules_.at(match->rule), matchInputAtomsVectors(match));
   }
 
+  // Uses HypergraphMatcher itself to determine if two hypergraphs are isomorphic.
+  // Isomorphism in this case refers to a renaming of *pattern* (negative) atoms in one of the hypergraphs to
+  // make it identical to the other one. Positive atoms are not attempted to be renamed.
+  // Thus, for example, {{-1, -2}, {-2, -3}} is isomorphic to {{-3, -4}, {-5, -3}},
+  // but {{1, -2}, {-2, 3}} is not isomorphic to {{3, -2}, {-2, 1}}.
+  static bool isomorphic(const std::vector<AtomsVector>& firstHypergraph,
+                         const std::vector<AtomsVector>& secondHypergraph,
+                         const std::function<bool()>& abortRequested) {
+    if (firstHypergraph.size() != secondHypergraph.size()) return false;
+    if (firstHypergraph.size() == 0) return true;
+
+    // Append the same atom to each token to ensure connectivity, so that all matches can be found starting from a
+    // single token. The atom here is just an arbitrary large number, which is unlikely to be reached.
+    constexpr Atom connectingAtom = compactIDs ? 1943106676 : 943106676560858694;
+
+    // We will use the same hypergraph as an input to a rule
+    const std::vector<Rule> rules = {
+        {appendAtomToEveryToken(firstHypergraph, connectingAtom), {}, EventSelectionFunction::All}};
+
+    // And the second hypergraph as an initial state (with patterns instantiated)
+    // If the two hypergraphs are isomorphic, the rule will match. Note, it cannot match to a subhypergraph because the
+    // number of tokens (hyperedges) is the same, and multiple parts of the rule input cannot match to the same token.
+    auto connectedSecondHypergraph = appendAtomToEveryToken(secondHypergraph, connectingAtom);
+    instantiatePatternAtoms(&connectedSecondHypergraph);
+    const GetAtomsVectorFunc getAtomsVector =
+        [&connectedSecondHypergraph](const TokenID& tokenID) -> const AtomsVector& {
+      return connectedSecondHypergraph.at(tokenID);
+    };
+
+    // We don't need this function, but we need to pass something.
+    const GetTokenSeparationFunc getTokenSeparation = [](const TokenID&, const TokenID&) -> SeparationType {
+      return SeparationType::Unknown;
+    };
+
+    AtomsIndex atomsIndex(getAtomsVector);
+    std::vector<TokenID> allTokenIDs(firstHypergraph.size());
+    for (TokenID i = 0; i < static_cast<TokenID>(firstHypergraph.size()); ++i) {
+      allTokenIDs.emplace_back(i);
+    }
+    atomsIndex.addTokens(allTokenIDs);
+
+    HypergraphMatcher matcher(rules, &atomsIndex, getAtomsVector, getTokenSeparation, {}, EventDeduplication::None);
+    // We only need to pass one token because any token will need to be included in the match.
+    matcher.addMatchesInvolvingTokens({0}, abortRequested);
+    return !matcher.empty();
+  }
+
  private:
-  enum class MatchStorage { Main, NewMatches };
+  enum class MatchStorage { Main, NewMatches, Components };
+
+  // Inputs sharing an atom are in the same component. Components and inputs within them are in the order of the inputs.
+  static std::vector<std::vector<size_t>> inputComponents(const std::vector<AtomsVector>& inputs) {
+    std::vector<size_t> parents(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) parents[i] = i;
+    const auto root = [&parents](size_t input) {
+      while (parents[input] != input) input = parents[input] = parents[parents[input]];
+      return input;
+    };
+
+    std::unordered_map<Atom, size_t> atomInputs;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      for (const auto atom : inputs[i]) {
+        const auto atomInputIt = atomInputs.emplace(atom, i).first;
+        parents[root(i)] = root(atomInputIt->second);
+      }
+    }
+
+    std::vector<std::vector<size_t>> components;
+    std::unordered_map<size_t, size_t> rootComponents;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      const auto rootComponentIt = rootComponents.emplace(root(i), components.size()).first;
+      if (rootComponentIt->second == components.size()) components.emplace_back();
+      components[rootComponentIt->second].push_back(i);
+    }
+    return components;
+  }
+
+  // Rules paired with the tokens to match them to. Connected rules are split into chunkCount chunks of tokens if
+  // splitRulesBetweenThreads_, otherwise, the token list is empty, which means all tokenIDs.
+  std::vector<std::pair<RuleID, std::vector<TokenID>>> matchingTasks(const std::vector<TokenID>& tokenIDs,
+                                                                     const size_t chunkCount) const {
+    std::vector<std::pair<RuleID, std::vector<TokenID>>> tasks;
+    for (RuleID rule = 0; rule < static_cast<RuleID>(rules_.size()); ++rule) {
+      if (chunkCount <= 1 || ruleInputComponents_[rule].size() > 1) {
+        tasks.emplace_back(rule, std::vector<TokenID>());
+        continue;
+      }
+      for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        const auto chunkBegin = tokenIDs.begin() + tokenIDs.size() * chunk / chunkCount;
+        const auto chunkEnd = tokenIDs.begin() + tokenIDs.size() * (chunk + 1) / chunkCount;
+        tasks.emplace_back(rule, std::vector<TokenID>(chunkBegin, chunkEnd));
+      }
+    }
+    return tasks;
+  }
 
   void addMatchesForRule(const std::vector<TokenID>& tokenIDs,
                          const RuleID& ruleID,
                          const std::function<bool()>& shouldAbort,
-                         const MatchStorage matchStorage) {
+                         const MatchStorage matchStorage,
+                         Statistics* statistics) {
+    if (ruleInputComponents_[ruleID].size() > 1) {
+      addMatchesForDisconnectedRule(tokenIDs, ruleID, shouldAbort, matchStorage, statistics);
+      return;
+    }
     const auto& ruleInputTokens = rules_[ruleID].inputs;
     for (size_t i = 0; i < ruleInputTokens.size(); ++i) {
       const Match emptyMatch{ruleID, std::vector<TokenID>(ruleInputTokens.size(), -1)};
-      completeMatchesStartingWithInput(
-          emptyMatch, ruleInputTokens, rules_[ruleID].eventSelectionFunction, i, tokenIDs, shouldAbort, matchStorage);
+      completeMatchesStartingWithInput(emptyMatch,
+                                       ruleInputTokens,
+                                       rules_[ruleID].eventSelectionFunction,
+                                       i,
+                                       tokenIDs,
+                                       shouldAbort,
+                                       matchStorage,
+                                       statistics);
+    }
+  }
+
+  void addMatchesForDisconnectedRule(const std::vector<TokenID>& tokenIDs,
+                                     const RuleID& ruleID,
+                                     const std::function<bool()>& shouldAbort,
+                                     const MatchStorage matchStorage,
+                                     Statistics* statistics) {
+    const auto& componentInputs = ruleComponentInputs_[ruleID];
+    std::vector<MatchVector> newComponentMatches(componentInputs.size(),
+                                                 MatchVector(ArenaAllocator<MatchPtr>(&arena_)));
+    for (size_t component = 0; component < componentInputs.size(); ++component) {
+      const auto& inputs = componentInputs[component];
+      for (size_t i = 0; i < inputs.size(); ++i) {
+        const Match emptyMatch{ruleID, std::vector<TokenID>(inputs.size(), -1)};
+        completeMatchesStartingWithInput(emptyMatch,
+                                         inputs,
+                                         rules_[ruleID].eventSelectionFunction,
+                                         i,
+                                         tokenIDs,
+                                         shouldAbort,
+                                         MatchStorage::Components,
+                                         statistics);
+      }
+      // Component matches involving multiple new tokens are found once for each of them
+      std::unordered_set<MatchPtr, MatchHasher, MatchEquality> uniqueMatches;
+      for (auto& match : newComponentMatches_[ruleID]) {
+        auto matchPtr = newMatchPtr(std::move(match));
+        if (uniqueMatches.insert(matchPtr).second) newComponentMatches[component].push_back(std::move(matchPtr));
+      }
+      newComponentMatches_[ruleID].clear();
+    }
+
+    auto& componentMatches = componentMatches_[ruleID];
+    if (lazyProducts_[ruleID].enabled) {
+      for (size_t component = 0; component < componentMatches.size(); ++component) {
+        for (const auto& match : newComponentMatches[component]) {
+          addLazyProductFactor(ruleID, component, match);
+          matchInputTokensBytes_ += inputTokensBytes(*match);
+        }
+        componentMatches[component].insert(componentMatches[component].end(),
+                                           newComponentMatches[component].begin(),
+                                           newComponentMatches[component].end());
+      }
+      return;
+    }
+
+    // Each new product is formed exactly once, at the last component that has a new match in it. The components before
+    // it use both old and new matches, and the components after it only use the old ones.
+    for (size_t lastNewComponent = 0; lastNewComponent < componentMatches.size(); ++lastNewComponent) {
+      std::vector<const MatchVector*> factors;
+      for (size_t component = 0; component < componentMatches.size(); ++component) {
+        factors.push_back(component == lastNewComponent ? &newComponentMatches[component]
+                                                        : &componentMatches[component]);
+      }
+      Match product{ruleID, std::vector<TokenID>(rules_[ruleID].inputs.size(), -1)};
+      addProductMatches(factors, 0, &product, shouldAbort, matchStorage, statistics);
+      for (const auto& match : newComponentMatches[lastNewComponent]) {
+        matchInputTokensBytes_ += inputTokensBytes(*match);
+      }
+      componentMatches[lastNewComponent].insert(componentMatches[lastNewComponent].end(),
+                                                newComponentMatches[lastNewComponent].begin(),
+                                                newComponentMatches[lastNewComponent].end());
+    }
+  }
+
+  // Enumerates products of the component matches in factors starting from firstComponent, given that the earlier
+  // components are already in the product.
+  void addProductMatches(const std::vector<const MatchVector*>& factors,
+                         const size_t firstComponent,
+                         Match* product,
+                         const std::function<bool()>& shouldAbort,
+                         const MatchStorage matchStorage,
+                         Statistics* statistics) {
+    if (firstComponent == factors.size()) {
+      storeCompleteMatch(*product, matchStorage, statistics);
+      return;
+    }
+
+    const auto& inputIndices = ruleInputComponents_[product->rule][firstComponent];
+    const bool spacelike = rules_[product->rule].eventSelectionFunction == EventSelectionFunction::Spacelike;
+    for (const auto& componentMatch : *factors[firstComponent]) {
+      if (getCurrentError() != None) return;
+      if (shouldAbort()) {
+        setCurrentErrorIfNone(Error::Aborted);
+        return;
+      }
+
+      const auto isCompatible = [this, product, spacelike](const TokenID token) {
+        return isTokenUnused(*product, token) && (!spacelike || isSpacelikeSeparated(token, product->inputTokens));
+      };
+      if (!std::all_of(componentMatch->inputTokens.begin(), componentMatch->inputTokens.end(), isCompatible)) continue;
+
+      for (size_t i = 0; i < inputIndices.size(); ++i) {
+        product->inputTokens[inputIndices[i]] = componentMatch->inputTokens[i];
+      }
+      addProductMatches(factors, firstComponent + 1, product, shouldAbort, matchStorage, statistics);
+      for (const auto inputIndex : inputIndices) {
+        product->inputTokens[inputIndex] = -1;
+      }
+    }
+  }
+
+  void removeComponentMatchesInvolvingTokens(const std::vector<TokenID>& tokenIDs) {
+    const std::unordered_set<TokenID> removedTokens(tokenIDs.begin(), tokenIDs.end());
+    const auto involvesRemovedTokens = [&removedTokens](const MatchPtr& match) {
+      return std::any_of(match->inputTokens.begin(), match->inputTokens.end(), [&removedTokens](const TokenID token) {
+        return removedTokens.count(token) > 0;
+      });
+    };
+    // Order-preserving, so that the order of products stays deterministic
+    for (RuleID rule = 0; rule < static_cast<RuleID>(rules_.size()); ++rule) {
+      auto& lazyProducts = lazyProducts_[rule];
+      for (size_t component = 0; component < componentMatches_[rule].size(); ++component) {
+        auto& matches = componentMatches_[rule][component];
+        const auto removedMatchesBegin = std::stable_partition(
+            matches.begin(), matches.end(), [&](const MatchPtr& match) { return !involvesRemovedTokens(match); });
+        for (auto removedMatchIt = removedMatchesBegin; removedMatchIt != matches.end(); ++removedMatchIt) {
+          if (lazyProducts.enabled) removeLazyProductFactor(rule, component, *removedMatchIt);
+          matchInputTokensBytes_ -= inputTokensBytes(**removedMatchIt);
+        }
+        matches.erase(removedMatchesBegin, matches.end());
+      }
+      for (auto productIt = lazyProducts.deletedProducts.begin(); productIt != lazyProducts.deletedProducts.end();) {
+        if (involvesRemovedTokens(*productIt)) {
+          matchInputTokensBytes_ -= inputTokensBytes(**productIt);
+          productIt = lazyProducts.deletedProducts.erase(productIt);
+        } else {
+          ++productIt;
+        }
+      }
+    }
+  }
+
+  // Adds a new match of a component of a rule with lazy products, which forms products with the matches of the other
+  // component that do not share tokens with it.
+  void addLazyProductFactor(const RuleID rule, const size_t component, const MatchPtr& match) {
+    auto& lazyProducts = lazyProducts_[rule];
+    lazyProducts.conflictingPairs += matchesSharingTokens(lazyProducts.tokenMatches[1 - component], *match).size();
+    for (const auto token : match->inputTokens) {
+      lazyProducts.tokenMatches[component][token].push_back(match);
+    }
+  }
+
+  void removeLazyProductFactor(const RuleID rule, const size_t component, const MatchPtr& match) {
+    auto& lazyProducts = lazyProducts_[rule];
+    for (const auto token : match->inputTokens) {
+      auto& tokenMatches = lazyProducts.tokenMatches[component][token];
+      tokenMatches.erase(std::find(tokenMatches.begin(), tokenMatches.end(), match));
+      if (tokenMatches.empty()) lazyProducts.tokenMatches[component].erase(token);
+    }
+    lazyProducts.conflictingPairs -= matchesSharingTokens(lazyProducts.tokenMatches[1 - component], *match).size();
+  }
+
+  static std::unordered_set<const Match*> matchesSharingTokens(const TokenMatches& tokenMatches, const Match& match) {
+    std::unordered_set<const Match*> result;
+    for (const auto token : match.inputTokens) {
+      const auto tokenMatchesIt = tokenMatches.find(token);
+      if (tokenMatchesIt == tokenMatches.end()) continue;
+      for (const auto& tokenMatch : tokenMatchesIt->second) {
+        result.insert(tokenMatch.get());
+      }
+    }
+    return result;
+  }
+
+  // Number of products of a rule with lazy products that can be chosen, zero for other rules.
+  size_t productCount(const RuleID rule) const {
+    const auto& lazyProducts = lazyProducts_[rule];
+    if (!lazyProducts.enabled) return 0;
+    const auto& componentMatches = componentMatches_[rule];
+    return componentMatches[0].size() * componentMatches[1].size() - lazyProducts.conflictingPairs -
+           lazyProducts.deletedProducts.size();
+  }
+
+  double productsWeight(const RuleID rule) const {
+    return static_cast<double>(productCount(rule)) * (isWeightedRandom_ ? rules_[rule].weight : 1);
+  }
+
+  double queueWeight() const {
+    if (isWeightedRandom_) return matchQueue_.firstBucketWeights().total();
+    return static_cast<double>(matchQueue_.firstBucket().matches.size());
+  }
+
+  // Checks if the given matches of the two components of a rule with lazy products form a product that can be chosen,
+  // and if so, writes it to product.
+  bool isAvailableProduct(const RuleID rule, const size_t first, const size_t second, Match* product) const {
+    const Match* factors[] = {componentMatches_[rule][0][first].get(), componentMatches_[rule][1][second].get()};
+    const auto& secondTokens = factors[1]->inputTokens;
+    const auto isSharedToken = [&secondTokens](const TokenID token) {
+      return std::find(secondTokens.begin(), secondTokens.end(), token) != secondTokens.end();
+    };
+    if (std::any_of(factors[0]->inputTokens.begin(), factors[0]->inputTokens.end(), isSharedToken)) return false;
+
+    *product = Match{rule, std::vector<TokenID>(rules_[rule].inputs.size(), -1)};
+    for (size_t component = 0; component < 2; ++component) {
+      const auto& inputIndices = ruleInputComponents_[rule][component];
+      for (size_t i = 0; i < inputIndices.size(); ++i) {
+        product->inputTokens[inputIndices[i]] = factors[component]->inputTokens[i];
+      }
+    }
+    const auto& deletedProducts = lazyProducts_[rule].deletedProducts;
+    // The aliasing constructor makes a non-owning pointer for the lookup
+    return deletedProducts.empty() || !deletedProducts.count(MatchPtr(MatchPtr(), product));
+  }
+
+  // Rules with lazy products that are chosen from together with the first bucket of matchQueue_, if queueIncluded.
+  // These are the rules with products that go first according to the ordering spec, which are equivalent to each other.
+  std::vector<RuleID> firstProductRules(bool* queueIncluded) const {
+    std::vector<RuleID> result;
+    for (RuleID rule = 0; hasLazyProducts_ && rule < static_cast<RuleID>(rules_.size()); ++rule) {
+      if (productCount(rule) == 0) continue;
+      if (!result.empty()) {
+        if (ruleComparator_(ruleMatches_[result.front()], ruleMatches_[rule])) continue;
+        if (ruleComparator_(ruleMatches_[rule], ruleMatches_[result.front()])) result.clear();
+      }
+      result.push_back(rule);
+    }
+
+    *queueIncluded = !matchQueue_.empty();
+    if (*queueIncluded && !result.empty()) {
+      const auto& queueMatch = matchQueue_.firstBucket().matches.front();
+      if (ruleComparator_(queueMatch, ruleMatches_[result.front()])) {
+        result.clear();
+      } else {
+        *queueIncluded = !ruleComparator_(ruleMatches_[result.front()], queueMatch);
+      }
+    }
+    return result;
+  }
+
+  // Chooses a product of one of the rules, all of which have available products, according to their weights.
+  MatchPtr chooseProduct(const std::vector<RuleID>& productRules) {
+    RuleID rule = productRules.front();
+    if (matchAny()) return newProductPtr(productAfterCursor(rule));
+    if (productRules.size() > 1) {
+      double totalWeight = 0;
+      for (const auto productRule : productRules) totalWeight += productsWeight(productRule);
+      double position = std::uniform_real_distribution<double>(0, totalWeight)(randomGenerator_);
+      for (const auto productRule : productRules) {
+        rule = productRule;
+        position -= productsWeight(productRule);
+        if (position < 0) break;
+      }
     }
+    return newProductPtr(randomProduct(rule));
+  }
+
+  // The first available product of the rule starting from the cursor, wrapping around the end.
+  Match productAfterCursor(const RuleID rule) {
+    auto& cursor = lazyProducts_[rule].cursor;
+    const size_t secondCount = componentMatches_[rule][1].size();
+    const size_t pairCount = componentMatches_[rule][0].size() * secondCount;
+    // Component matches may have been added or removed since, in which case the cursor moves to a different pair
+    size_t pair = cursor.first * secondCount + cursor.second;
+    if (pair >= pairCount) pair = 0;
+    Match product;
+    for (size_t i = 0; i < pairCount; ++i, pair = pair + 1 < pairCount ? pair + 1 : 0) {
+      if (isAvailableProduct(rule, pair / secondCount, pair % secondCount, &product)) {
+        cursor = {pair / secondCount, pair % secondCount};
+        break;
+      }
+    }
+    return product;
+  }
+
+  Match randomProduct(const RuleID rule) {
+    const auto& componentMatches = componentMatches_[rule];
+    std::uniform_int_distribution<size_t> firstDistribution(0, componentMatches[0].size() - 1);
+    std::uniform_int_distribution<size_t> secondDistribution(0, componentMatches[1].size() - 1);
+    Match product;
+    for (int sample = 0; sample < maxProductSamples; ++sample) {
+      const size_t first = firstDistribution(randomGenerator_);
+      if (isAvailableProduct(rule, first, secondDistribution(randomGenerator_), &product)) return product;
+    }
+
+    size_t productIndex = std::uniform_int_distribution<size_t>(0, productCount(rule) - 1)(randomGenerator_);
+    for (size_t first = 0; first < componentMatches[0].size(); ++first) {
+      for (size_t second = 0; second < componentMatches[1].size(); ++second) {
+        if (isAvailableProduct(rule, first, second, &product) && productIndex-- == 0) return product;
+      }
+    }
+    return product;
+  }
+
+  MatchPtr newProductPtr(Match product) {
+    setInputGenerations(&product);
+    return newMatchPtr(std::move(product));
   }
 
   void completeMatchesStartingWithInput(const Match& incompleteMatch,
@@ -351,7 +1110,8 @@ class HypergraphMatcher::Implementation {
                                         const size_t nextInputIdx,
                                         const std::vector<TokenID>& potentialTokenIDs,
                                         const std::function<bool()>& shouldAbort,
-                                        const MatchStorage matchStorage) {
+                                        const MatchStorage matchStorage,
+                                        Statistics* statistics) {
     for (const auto tokenID : potentialTokenIDs) {
       if (getCurrentError() != None) {
         return;
@@ -363,7 +1123,8 @@ class HypergraphMatcher::Implementation {
                                  nextInputIdx,
                                  tokenID,
                                  shouldAbort,
-                                 matchStorage);
+                                 matchStorage,
+                                 statistics);
       }
     }
   }
@@ -390,7 +1151,9 @@ class HypergraphMatcher::Implementation {
                                 const size_t nextInputIdx,
                                 const TokenID potentialTokenID,
                                 const std::function<bool()>& shouldAbort,
-                                const MatchStorage matchStorage) {
+                                const MatchStorage matchStorage,
+                                Statistics* statistics) {
+    statistics->increment(Statistics::Counter::MatchAttempts);
     // If WL wants to abort, abort
     if (shouldAbort()) {
       setCurrentErrorIfNone(Error::Aborted);
@@ -402,6 +1165,7 @@ class HypergraphMatcher::Implementation {
 
     // tokens (hyperedges) of different sizes, cannot match
     if (input.size() != tokenAtoms.size()) {
+      statistics->increment(Statistics::Counter::ArityPrunes);
       return;
     }
 
@@ -410,31 +1174,61 @@ class HypergraphMatcher::Implementation {
 
     auto newInputs = partiallyMatchedInputs;
     if (!substituteMissingAtomsIfPossible(input, tokenAtoms, &newInputs)) {
+      statistics->increment(Statistics::Counter::BindingFailures);
       return;
     }
     if (eventSelectionFunction == EventSelectionFunction::Spacelike &&
         !isSpacelikeSeparated(potentialTokenID, newMatch.inputTokens)) {
+      statistics->increment(Statistics::Counter::SeparationFailures);
       return;
     }
 
     if (isMatchComplete(newMatch)) {
-      std::lock_guard<std::mutex> lock(matchMutex);
-      if (matchStorage == MatchStorage::NewMatches) {
-        newMatches_.insert(std::make_shared<Match>(newMatch));
+      if (matchStorage == MatchStorage::Components) {
+        // Only the thread matching the rule accesses its component matches, so no locking is needed
+        newComponentMatches_[newMatch.rule].push_back(std::move(newMatch));
       } else {
-        insertMatch(std::make_shared<Match>(newMatch));
+        storeCompleteMatch(std::move(newMatch), matchStorage, statistics);
       }
       return;
     }
 
-    const auto nextInputIdxAndCandidateTokens = nextBestInputAndTokensToTry(newMatch, newInputs);
+    const auto nextInputIdxAndCandidateTokens = nextBestInputAndTokensToTry(newMatch, newInputs, statistics);
     completeMatchesStartingWithInput(newMatch,
                                      newInputs,
                                      eventSelectionFunction,
                                      nextInputIdxAndCandidateTokens.first,
                                      nextInputIdxAndCandidateTokens.second,
                                      shouldAbort,
-                                     matchStorage);
+                                     matchStorage,
+                                     statistics);
+  }
+
+  void storeCompleteMatch(Match match, const MatchStorage matchStorage, Statistics* statistics) {
+    setInputGenerations(&match);
+    std::lock_guard<std::mutex> lock(matchMutex);
+    if (matchStorage == MatchStorage::NewMatches) {
+      newMatches_.insert(newMatchPtr(std::move(match)));
+    } else {
+      insertMatch(newMatchPtr(std::move(match)), statistics);
+    }
+  }
+
+  // The match and its reference count are allocated together in the arena.
+  MatchPtr newMatchPtr(Match match) {
+    return std::allocate_shared<Match>(ArenaAllocator<Match>(&arena_), std::move(match));
+  }
+
+  // Generations are computed once here, so that they don't need to be looked up every time matches are compared.
+  void setInputGenerations(Match* match) const {
+    if (!getTokenGeneration_ || match->inputTokens.empty()) return;
+    match->minInputGeneration = std::numeric_limits<Generation>::max();
+    match->maxInputGeneration = std::numeric_limits<Generation>::min();
+    for (const auto token : match->inputTokens) {
+      const Generation generation = getTokenGeneration_(token);
+      match->minInputGeneration = std::min(match->minInputGeneration, generation);
+      match->maxInputGeneration = std::max(match->maxInputGeneration, generation);
+    }
   }
 
   bool isSpacelikeSeparated(const TokenID newToken, const std::vector<TokenID>& previousTokens) {
@@ -458,21 +1252,21 @@ class HypergraphMatcher::Implementation {
       return first->rule < second->rule;
     });
     for (const auto& match : sortedMatches) {
-      insertMatch(match);
+      insertMatch(match, &statistics_);
     }
   }
 
-  void insertMatch(const MatchPtr matchPtr) {
+  void insertMatch(const MatchPtr matchPtr, Statistics* statistics) {
+    // Computed before anything is inserted, in case the weight is invalid.
+    const double weight = isWeightedRandom_ ? matchWeight(*matchPtr) : 1;
     if (!allMatches_.insert(matchPtr).second) {
+      statistics->increment(Statistics::Counter::DuplicateMatches);
       return;
     }
+    matchInputTokensBytes_ += inputTokensBytes(*matchPtr);
+    statistics->increment(Statistics::Counter::MatchesInserted);
 
-    const auto bucketIt = matchQueue_.emplace(matchPtr, Bucket()).first;  // works because comparison is smart
-    auto& bucket = bucketIt->second;
-    if (!bucket.first.count(matchPtr)) {  // works because hashing is smart
-      bucket.second.push_back(matchPtr);
-      bucket.first[matchPtr] = bucket.second.size() - 1;
-
+    if (matchQueue_.insert(matchPtr, weight)) {
       const auto& tokens = matchPtr->inputTokens;
       for (const auto token : tokens) {
         tokensToMatches_[token].insert(matchPtr);
@@ -480,6 +1274,16 @@ class HypergraphMatcher::Implementation {
     }
   }
 
+  double matchWeight(const Match& match) const {
+    const double weight = rules_[match.rule].weight * (getMatchWeight_ ? getMatchWeight_(match) : 1);
+    if (!isValidWeight(weight)) throw HypergraphMatcher::Error::InvalidWeight;
+    return weight;
+  }
+
+  static bool isValidWeight(const double weight) { return weight > 0 && std::isfinite(weight); }
+
+  static size_t inputTokensBytes(const Match& match) { return match.inputTokens.capacity() * sizeof(TokenID); }
+
   static bool isMatchComplete(const Match& match) {
     return std::find_if(match.inputTokens.begin(), match.inputTokens.end(), [](const auto& token) -> bool {
              return token < 0;
@@ -487,78 +1291,177 @@ class HypergraphMatcher::Implementation {
   }
 
   std::pair<size_t, std::vector<TokenID>> nextBestInputAndTokensToTry(
-      const Match& incompleteMatch, const std::vector<AtomsVector>& partiallyMatchedInputs) const {
-    int64_t nextInputIdx = -1;
-    std::vector<TokenID> nextTokensToTry;
-
-    // For each input, we will see how many tokens in the hypergraph contain atoms appearing in this input.
-    // The fewer there are, the less branching we will have to do.
+      const Match& incompleteMatch,
+      const std::vector<AtomsVector>& partiallyMatchedInputs,
+      Statistics* statistics) const {
+    Statistics::ScopedTimer timer(statistics, Statistics::Timer::CandidateSelection);
+    statistics->increment(Statistics::Counter::CandidateSelections);
+    // For each input, we will estimate how many tokens in the hypergraph have its shape and contain atoms appearing in
+    // it. The fewer there are, the less branching we will have to do. The estimates only take a few index lookups, so
+    // the candidate tokens are only enumerated for the chosen input.
+    std::vector<std::pair<size_t, size_t>> estimatesAndInputs;
     for (size_t i = 0; i < partiallyMatchedInputs.size(); ++i) {
       if (incompleteMatch.inputTokens[i] != -1) continue;
 
-      std::unordered_set<Atom> appearingAtoms;
-      bool allAtomsArePatterns = true;
-      for (const auto atom : partiallyMatchedInputs[i]) {
-        if (atom >= 0) {
-          appearingAtoms.insert(atom);
-          allAtomsArePatterns = false;
-        }
-      }
+      const auto& input = partiallyMatchedInputs[i];
+      const bool allAtomsArePatterns =
+          std::all_of(input.begin(), input.end(), [](const Atom atom) { return atom < 0; });
 
       // this input does not have any specific atom references,
       // there is nothing we can do unless we want to enumerate the entire set
       if (allAtomsArePatterns) continue;
 
-      // For each token, we will count how many of the input atoms appear in it.
-      // We will then only use tokens that have all the required atoms.
-      std::unordered_map<TokenID, uint64_t> inputAtomsCountByToken;
-      for (const auto atom : appearingAtoms) {
-        for (const auto token : atomsIndex_.tokensContainingAtom(atom)) {
-          inputAtomsCountByToken[token]++;
-        }
-      }
-
-      // Here we will collect all tokens that contain all the required atoms.
-      std::vector<TokenID> potentialTokens;
-      for (const auto& tokenAndCount : inputAtomsCountByToken) {
-        if (tokenAndCount.second == appearingAtoms.size()) {
-          potentialTokens.push_back(tokenAndCount.first);
-        }
-      }
-
-      // If there are fewer tokens, that is what we'll want to try first.
-      // Note, if there are zero matching tokens, it means the match is not possible, because none of the tokens contain
-      // all the atoms needed.
-      if (nextInputIdx == -1 || potentialTokens.size() < nextTokensToTry.size()) {
-        nextTokensToTry = potentialTokens;
-        nextInputIdx = static_cast<int64_t>(i);
-      }
+      // Estimates are only computed below if there is more than one input to choose from
+      estimatesAndInputs.emplace_back(0, i);
     }
 
-    if (nextInputIdx == -1) {
+    if (estimatesAndInputs.empty()) {
       // We could not find any potential inputs, which means, all inputs not already matched are fully patterns,
       // and don't have any specific atom references.
-      // That implies rule inputs do not form a connected hypergraph, which is not supported at the moment,
-      // and would require custom logic to implement efficiently.
+      // That implies rule inputs do not form a connected hypergraph, which should not happen, as disconnected rules are
+      // matched one component at a time.
       setCurrentErrorIfNone(DisconnectedInputs);
       return {{}, {}};
-    } else {
-      return {nextInputIdx, nextTokensToTry};
     }
+
+    if (estimatesAndInputs.size() > 1) {
+      for (auto& estimateAndInput : estimatesAndInputs) {
+        statistics->increment(Statistics::Counter::CostEstimates);
+        const auto& input = partiallyMatchedInputs[estimateAndInput.second];
+        estimateAndInput.first = atomsIndex_.estimatedTokensMatchingPattern(input);
+      }
+    }
+
+    // Note, if the estimate is zero, it means the match is not possible, because none of the tokens contain all the
+    // atoms needed.
+    const auto cheapestInput = *std::min_element(estimatesAndInputs.begin(), estimatesAndInputs.end());
+    if (cheapestInput.first <= maxTrustedCandidateEstimate) {
+      statistics->increment(Statistics::Counter::IndexLookups);
+      return {cheapestInput.second, atomsIndex_.tokensMatchingPattern(partiallyMatchedInputs[cheapestInput.second])};
+    }
+
+    // All inputs contain high-degree (hub) atoms. An estimate only accounts for a single atom of the input, so it can
+    // be far from the actual number of candidates if the input has other specific atoms. Choosing the wrong input would
+    // multiply the branching, so the candidates of such inputs are enumerated to find their actual numbers.
+    size_t nextInputIdx = cheapestInput.second;
+    size_t nextTokensCount = cheapestInput.first;
+    std::vector<TokenID> nextTokensToTry;
+    bool nextTokensEnumerated = false;
+    for (const auto& estimateAndInput : estimatesAndInputs) {
+      const auto& input = partiallyMatchedInputs[estimateAndInput.second];
+      if (isCandidateEstimateExact(input)) continue;
+      statistics->increment(Statistics::Counter::IndexLookups);
+      std::vector<TokenID> potentialTokens = atomsIndex_.tokensMatchingPattern(input);
+      if (estimateAndInput.second == nextInputIdx || potentialTokens.size() < nextTokensCount) {
+        nextInputIdx = estimateAndInput.second;
+        nextTokensCount = potentialTokens.size();
+        nextTokensToTry = std::move(potentialTokens);
+        nextTokensEnumerated = true;
+      }
+    }
+    if (!nextTokensEnumerated) {
+      statistics->increment(Statistics::Counter::IndexLookups);
+      nextTokensToTry = atomsIndex_.tokensMatchingPattern(partiallyMatchedInputs[nextInputIdx]);
+    }
+    return {nextInputIdx, nextTokensToTry};
+  }
+
+  // The estimate only accounts for one specific atom at one position, so it is exact if there are no others.
+  static bool isCandidateEstimateExact(const AtomsVector& input) {
+    size_t specificAtomPosition = input.size();
+    for (size_t position = 0; position < input.size(); ++position) {
+      if (input[position] < 0) continue;
+      if (specificAtomPosition != input.size()) return false;
+      specificAtomPosition = position;
+    }
+    return specificAtomPosition + 1 < AtomsIndex::maxIndexedPositions;
   }
 
   bool matchAny() { return !orderingSpec_.empty() && orderingSpec_.back().first == OrderingFunction::Any; }
 
   // This should be called every time matches are updated.
   void chooseNextMatch() {
-    if (empty()) return;
-    const auto& allPossibleMatches = matchQueue_.begin()->second.second;
-    if (matchAny()) {
-      nextMatch_ = allPossibleMatches.front();
-    } else {
-      auto distribution = std::uniform_int_distribution<size_t>(0, allPossibleMatches.size() - 1);
-      nextMatch_ = allPossibleMatches[distribution(randomGenerator_)];
+    while (true) {
+      bool queueIncluded;
+      const auto productRules = firstProductRules(&queueIncluded);
+      if (!productRules.empty() && (!queueIncluded || isProductChosenOverQueue(productRules))) {
+        nextMatch_ = chooseProduct(productRules);
+        return;
+      }
+      if (!queueIncluded) break;
+
+      const auto& allPossibleMatches = matchQueue_.firstBucket().matches;
+      if (matchAny()) {
+        nextMatch_ = allPossibleMatches.front();
+      } else if (isWeightedRandom_) {
+        const auto& weights = matchQueue_.firstBucketWeights();
+        auto distribution = std::uniform_real_distribution<double>(0, weights.total());
+        nextMatch_ = allPossibleMatches[weights.find(distribution(randomGenerator_))];
+      } else {
+        auto distribution = std::uniform_int_distribution<size_t>(0, allPossibleMatches.size() - 1);
+        nextMatch_ = allPossibleMatches[distribution(randomGenerator_)];
+      }
+      if (staleMatchCount_ == 0 || !isStale(nextMatch_)) return;
+      statistics_.increment(Statistics::Counter::StaleMatchesSkipped);
+      deleteMatch(nextMatch_);
+      --staleMatchCount_;
     }
+    nextMatch_ = nullptr;
+  }
+
+  // Chooses between the first bucket of matchQueue_ and the lazy products equivalent to it according to their weights.
+  // OrderingFunction::Any prefers the stored matches.
+  bool isProductChosenOverQueue(const std::vector<RuleID>& productRules) {
+    if (matchAny()) return false;
+    double totalWeight = queueWeight();
+    for (const auto rule : productRules) totalWeight += productsWeight(rule);
+    return std::uniform_real_distribution<double>(0, totalWeight)(randomGenerator_) >= queueWeight();
+  }
+
+  void markTokensDestroyed(const std::vector<TokenID>& tokenIDs) {
+    for (const auto token : tokenIDs) {
+      if (static_cast<size_t>(token) >= destroyedTokens_.size()) destroyedTokens_.resize(token + 1);
+      destroyedTokens_[token] = true;
+      const auto matchesIterator = tokensToMatches_.find(token);
+      if (matchesIterator == tokensToMatches_.end()) continue;
+      tokensWithStaleMatches_.push_back(token);
+      staleMatchCount_ += matchesIterator->second.size();
+    }
+    // Stale matches are only removed all at once if they make up about half of the queue, so the cost is proportional
+    // to the number of matches made stale since the last time.
+    if (staleMatchCount_ > matchQueue_.size() / 2) removeStaleMatches();
+  }
+
+  void removeStaleMatches() {
+    Tracing::Scope traceScope("removeStaleMatches");
+    // The order of removal does not matter here, as it can only affect the random choice between equivalent matches,
+    // which should not be made in the lazy mode.
+    std::vector<MatchPtr> matchesToDelete;
+    for (const auto token : tokensWithStaleMatches_) {
+      const auto matchesIterator = tokensToMatches_.find(token);
+      if (matchesIterator == tokensToMatches_.end()) continue;
+      matchesToDelete.assign(matchesIterator->second.begin(), matchesIterator->second.end());
+      for (const auto& match : matchesToDelete) {
+        deleteMatch(match);
+      }
+    }
+    tokensWithStaleMatches_.clear();
+    staleMatchCount_ = 0;
+  }
+
+  bool isStale(const MatchPtr& match) const {
+    return std::any_of(match->inputTokens.begin(), match->inputTokens.end(), [this](const TokenID token) {
+      return static_cast<size_t>(token) < destroyedTokens_.size() && destroyedTokens_[token];
+    });
+  }
+
+  // Yields true if matches of the same rule are equivalent according to orderingSpec, and are chosen between either
+  // uniformly at random, by their rule weights, or arbitrarily.
+  static bool ordersByRuleOnly(const OrderingSpec& orderingSpec) {
+    return std::all_of(orderingSpec.begin(), orderingSpec.end(), [](const auto& ordering) {
+      return ordering.first == OrderingFunction::RuleIndex || ordering.first == OrderingFunction::RuleWeight ||
+             ordering.first == OrderingFunction::Any || ordering.first == OrderingFunction::WeightedRandom;
+    });
   }
 
   // Ordering spec that is used in newMatches_ set.
@@ -589,6 +1492,7 @@ class HypergraphMatcher::Implementation {
 
       bool matchAppearedBefore = false;
       for (const auto& addedMatch : addedSameInputMatches) {
+        statistics_.increment(Statistics::Counter::DeduplicationComparisons);
         if (sameOutcomeAssumingSameInputs(*newMatchIt, addedMatch, abortRequested)) {
           matchAppearedBefore = true;
           break;
@@ -626,53 +1530,6 @@ class HypergraphMatcher::Implementation {
     return isomorphic(firstOutputs, secondOutput, abortRequested);
   }
 
-  // Uses HypergraphMatcher itself to determine if two hypergraphs are isomorphic.
-  // Isomorphism in this case refers to a renaming of *pattern* (negative) atoms in one of the hypergraphs to
-  // make it identical to the other one. Positive atoms are not attempted to be renamed.
-  // Thus, for example, {{-1, -2}, {-2, -3}} is isomorphic to {{-3, -4}, {-5, -3}},
-  // but {{1, -2}, {-2, 3}} is not isomorphic to {{3, -2}, {-2, 1}}.
-  static bool isomorphic(const std::vector<AtomsVector>& firstHypergraph,
-                         const std::vector<AtomsVector>& secondHypergraph,
-                         const std::function<bool()>& abortRequested) {
-    if (firstHypergraph.size() != secondHypergraph.size()) return false;
-    if (firstHypergraph.size() == 0) return true;
-
-    // HypergraphMatcher does not support disconnected rules, so append the same atom to each token to ensure
-    // connectivity. The atom here is just an arbitrary large number, which is unlikely to be reached.
-    constexpr Atom connectingAtom = 943106676560858694;
-
-    // We will use the same hypergraph as an input to a rule
-    const std::vector<Rule> rules = {
-        {appendAtomToEveryToken(firstHypergraph, connectingAtom), {}, EventSelectionFunction::All}};
-
-    // And the second hypergraph as an initial state (with patterns instantiated)
-    // If the two hypergraphs are isomorphic, the rule will match. Note, it cannot match to a subhypergraph because the
-    // number of tokens (hyperedges) is the same, and multiple parts of the rule input cannot match to the same token.
-    auto connectedSecondHypergraph = appendAtomToEveryToken(secondHypergraph, connectingAtom);
-    instantiatePatternAtoms(&connectedSecondHypergraph);
-    const GetAtomsVectorFunc getAtomsVector =
-        [&connectedSecondHypergraph](const TokenID& tokenID) -> const AtomsVector& {
-      return connectedSecondHypergraph.at(tokenID);
-    };
-
-    // We don't need this function, but we need to pass something.
-    const GetTokenSeparationFunc getTokenSeparation = [](const TokenID&, const TokenID&) -> SeparationType {
-      return SeparationType::Unknown;
-    };
-
-    AtomsIndex atomsIndex(getAtomsVector);
-    std::vector<TokenID> allTokenIDs(firstHypergraph.size());
-    for (TokenID i = 0; i < static_cast<TokenID>(firstHypergraph.size()); ++i) {
-      allTokenIDs.emplace_back(i);
-    }
-    atomsIndex.addTokens(allTokenIDs);
-
-    HypergraphMatcher matcher(rules, &atomsIndex, getAtomsVector, getTokenSeparation, {}, EventDeduplication::None);
-    // We only need to pass one token because any token will need to be included in the match.
-    matcher.addMatchesInvolvingTokens({0}, abortRequested);
-    return !matcher.empty();
-  }
-
   // Finds the largest atom in a set of tokens
   static Atom largestAtom(const std::vector<AtomsVector>& set) {
     Atom result = std::numeric_limits<Atom>::min();
@@ -777,9 +1634,42 @@ HypergraphMatcher::HypergraphMatcher(const std::vector<Rule>& rules,
                                      const GetTokenSeparationFunc& getTokenSeparation,
                                      const OrderingSpec& orderingSpec,
                                      const EventDeduplication& eventDeduplication,
-                                     const unsigned int randomSeed)
-    : implementation_(std::make_shared<Implementation>(
-          rules, atomsIndex, getAtomsVector, getTokenSeparation, orderingSpec, eventDeduplication, randomSeed)) {}
+                                     const unsigned int randomSeed,
+                                     const GetTokenGenerationFunc& getTokenGeneration,
+                                     const MatchRemoval matchRemoval,
+                                     const bool useHugePages,
+                                     const GetMatchWeightFunc& getMatchWeight)
+    : implementation_(std::make_shared<Implementation>(rules,
+                                                       atomsIndex,
+                                                       getAtomsVector,
+                                                       getTokenSeparation,
+                                                       orderingSpec,
+                                                       eventDeduplication,
+                                                       randomSeed,
+                                                       getTokenGeneration,
+                                                       matchRemoval,
+                                                       useHugePages,
+                                                       getMatchWeight)) {}
+
+bool HypergraphMatcher::isTotalOrder(const OrderingSpec& orderingSpec) {
+  // Distinct matches differ either by the rule or by the input tokens
+  const auto containsFunction = [&orderingSpec](const OrderingFunction function) {
+    return std::any_of(orderingSpec.begin(), orderingSpec.end(), [function](const auto& ordering) {
+      return ordering.first == function;
+    });
+  };
+  return containsFunction(OrderingFunction::InputTokenIndices) && containsFunction(OrderingFunction::RuleIndex);
+}
+
+bool HypergraphMatcher::ordersNewerTokensLast(const OrderingSpec& orderingSpec) {
+  return !orderingSpec.empty() &&
+         orderingSpec.front() ==
+             std::make_pair(OrderingFunction::ReverseSortedInputTokenIndices, OrderingDirection::Normal);
+}
+
+bool HypergraphMatcher::isWeightedRandom(const OrderingSpec& orderingSpec) {
+  return !orderingSpec.empty() && orderingSpec.back().first == OrderingFunction::WeightedRandom;
+}
 
 void HypergraphMatcher::addMatchesInvolvingTokens(const std::vector<TokenID>& tokenIDs,
                                                   const std::function<bool()>& shouldAbort) {
@@ -794,6 +1684,12 @@ void HypergraphMatcher::deleteMatch(const MatchPtr matchPtr) { implementation_->
 
 bool HypergraphMatcher::empty() const { return implementation_->empty(); }
 
+Statistics HypergraphMatcher::statistics() const { return implementation_->statistics(); }
+
+size_t HypergraphMatcher::memoryUsage() const { return implementation_->memoryUsage(); }
+
+double HypergraphMatcher::totalWeight() const { return implementation_->totalWeight(); }
+
 MatchPtr HypergraphMatcher::nextMatch() const { return implementation_->nextMatch(); }
 
 std::vector<MatchPtr> HypergraphMatcher::allMatches() const { return implementation_->allMatches(); }
@@ -806,4 +1702,10 @@ std::vector<AtomsVector> HypergraphMatcher::matchOutputAtomsVectors(const MatchP
   return implementation_->matchOutputAtomsVectors(match);
 }
 
+bool HypergraphMatcher::isomorphic(const std::vector<AtomsVector>& firstHypergraph,
+                                   const std::vector<AtomsVector>& secondHypergraph,
+                                   const std::function<bool()>& shouldAbort) {
+  return Implementation::isomorphic(firstHypergraph, secondHypergraph, shouldAbort);
+}
+
 }  // namespace SetReplace
@@ -1,6 +1,7 @@
 #ifndef LIBSETREPLACE_HYPERGRAPHMATCHER_HPP_
 #define LIBSETREPLACE_HYPERGRAPHMATCHER_HPP_
 
+#include <functional>
 #include <memory>
 #include <set>
 #include <utility>
@@ -9,20 +10,52 @@
 #include "AtomsIndex.hpp"
 #include "IDTypes.hpp"
 #include "Rule.hpp"
+#include "Statistics.hpp"
 #include "TokenEventGraph.hpp"
 
 namespace SetReplace {
+/** @brief Function that returns the weight of a match, see HypergraphMatcher::OrderingFunction::WeightedRandom.
+ */
+using GetMatchWeightFunc = std::function<double(const Match&)>;
+
 /** @brief HypergraphMatcher takes rules, atoms index, and a list of tokens, and returns all possible matches.
  * @details This contains the lowest-level code, and the main functionality of the library. Uses atomsIndex to discover
  * tokens, thus if an token is absent from the atomsIndex, it would not appear in any matches.
+ *
+ * If the rule inputs form a disconnected hypergraph, each connected component is matched separately, and the matches of
+ * the rule are products of the component matches that do not share tokens.
+ *
+ * The products of a rule with two components and EventSelectionFunction::All are not stored if the matches are only
+ * ordered by their rules, i.e., the ordering spec only consists of RuleIndex, RuleWeight, Any and WeightedRandom
+ * (without getMatchWeight), and there is no event deduplication. They are then only formed once chosen as the next
+ * match, or requested by allMatches(), so the memory does not grow as the product of the component match counts.
  */
 class HypergraphMatcher {
  public:
   /** @brief Type of the error occurred during evaluation.
    */
-  enum Error { None, Aborted, DisconnectedInputs, NoMatches, InvalidOrderingFunction, InvalidOrderingDirection };
+  enum Error {
+    None,
+    Aborted,
+    DisconnectedInputs,
+    NoMatches,
+    InvalidOrderingFunction,
+    InvalidOrderingDirection,
+    InvalidWeight
+  };
 
   /** @brief All possible functions available to sort matches. Random is the default that is always applied last.
+   * @details MaxInputGeneration orders by the causal depth of the event, which is one more than the largest generation
+   * of its inputs. MinInputGeneration orders by the oldest input instead. RuleWeight orders by Rule::weight.
+   *
+   * Any and WeightedRandom do not order matches, and only have an effect if they are the last function in the spec.
+   * Any then chooses the first of the equivalent matches instead of a random one, and WeightedRandom chooses one at
+   * random with probability proportional to its weight, which is the Rule::weight of its rule times the value of
+   * getMatchWeight if one is given. This is the choice of the next reaction in the Gillespie algorithm, if the weights
+   * are the reaction rates, see HypergraphMatcher::totalWeight().
+   *
+   * If the first function in the spec is one of the generations, matches are kept in a bucket queue indexed by that
+   * generation, so that generation-ordered evolution does not get slower as the number of generations grows.
    *
    * If adding additional values, preserve First and Last, as these are used for valid enum checking.
    */
@@ -33,7 +66,11 @@ class HypergraphMatcher {
     InputTokenIndices = 2,
     RuleIndex = 3,
     Any = 4,
-    Last = 5
+    MaxInputGeneration = 5,
+    MinInputGeneration = 6,
+    RuleWeight = 7,
+    WeightedRandom = 8,
+    Last = 9
   };
 
   /** @brief Whether to sort in normal or reverse order.
@@ -48,8 +85,43 @@ class HypergraphMatcher {
 
   enum class EventDeduplication { None = 0, SameInputSetIsomorphicOutputs = 1 };
 
+  /** @brief How removeMatchesInvolvingTokens() removes the matches.
+   * @details Eager removes all of them immediately. Lazy only marks the tokens as destroyed, and the stale matches are
+   * removed once they are about to be chosen by nextMatch(), or all at once after enough of them accumulate, so the
+   * cost of removing the matches of a token is only paid if they are ever reached or their number becomes significant.
+   *
+   * Both modes choose the same matches if the ordering spec contains InputTokenIndices and RuleIndex, in which case
+   * all matches are ordered. Otherwise, the matches chosen at random from equivalent ones differ, as the order of
+   * removals is different.
+   */
+  enum class MatchRemoval { Eager, Lazy };
+
+  /** @brief Yields true if orderingSpec orders all distinct matches, so that no random choice is made.
+   */
+  static bool isTotalOrder(const OrderingSpec& orderingSpec);
+
+  /** @brief Yields true if matches involving a token newer than all inputs of another match are always ordered after
+   * that match.
+   * @details This is the case if the first function is ReverseSortedInputTokenIndices in the normal direction, as the
+   * newest input token is compared first.
+   */
+  static bool ordersNewerTokensLast(const OrderingSpec& orderingSpec);
+
+  /** @brief Yields true if the next match is chosen with probabilities proportional to the match weights.
+   */
+  static bool isWeightedRandom(const OrderingSpec& orderingSpec);
+
   /** @brief Creates a new matcher object.
-   * @details This is an O(1) operation, does not do any matching yet.
+   * @details This is an O(1) operation, does not do any matching yet. getTokenGeneration is only required for the
+   * generation ordering functions, and Error::InvalidOrderingFunction is thrown if they are used without it.
+   *
+   * Matches are allocated from an Arena owned by the matcher, so the MatchPtrs it returns should not outlive it.
+   *
+   * If the ordering is OrderingFunction::WeightedRandom, match weights should be positive and finite, otherwise
+   * Error::InvalidWeight is thrown, by the constructor for rule weights, and once a match is found for the weights
+   * returned by getMatchWeight.
+   * @param useHugePages whether to back the arena with transparent huge pages.
+   * @param getMatchWeight optional weight multiplier of each match, only used for OrderingFunction::WeightedRandom.
    */
   HypergraphMatcher(const std::vector<Rule>& rules,
                     AtomsIndex* atomsIndex,
@@ -57,7 +129,11 @@ class HypergraphMatcher {
                     const GetTokenSeparationFunc& getTokenSeparation,
                     const OrderingSpec& orderingSpec,
                     const EventDeduplication& eventDeduplication,
-                    unsigned int randomSeed = 0);
+                    unsigned int randomSeed = 0,
+                    const GetTokenGenerationFunc& getTokenGeneration = {},
+                    MatchRemoval matchRemoval = MatchRemoval::Eager,
+                    bool useHugePages = false,
+                    const GetMatchWeightFunc& getMatchWeight = {});
 
   /** @brief Finds and adds to the index all matches involving specified tokens.
    * @details Calls shouldAbort() frequently, and throws Error::Aborted if that returns true. Otherwise might take
@@ -77,6 +153,23 @@ class HypergraphMatcher {
    */
   bool empty() const;
 
+  /** @brief Counters and timers of the matching done so far, all zero unless compiled with LIBSETREPLACE_STATISTICS.
+   */
+  Statistics statistics() const;
+
+  /** @brief Bytes of memory taken by the matches, and the structures ordering and indexing them.
+   * @details The structures and the matches themselves are counted by their arena, see Arena::reservedBytes(), and
+   * the input token lists of the matches as they are stored and removed.
+   */
+  size_t memoryUsage() const;
+
+  /** @brief Sum of the weights of the matches the next match is chosen from.
+   * @details These are the matches equivalent to the next one according to the ordering spec. If the ordering is not
+   * OrderingFunction::WeightedRandom, all weights are one, so this is their number. For the Gillespie algorithm, this
+   * is the total rate of all reactions, and the time until the next one is exponentially distributed with this rate.
+   */
+  double totalWeight() const;
+
   /** @brief Returns the match that should be substituted next.
    * @details Throws Error::NoMatches if there are no matches.
    */
@@ -94,6 +187,16 @@ class HypergraphMatcher {
    */
   std::vector<AtomsVector> matchOutputAtomsVectors(const MatchPtr& match) const;
 
+  /** @brief Yields true if secondHypergraph can be obtained from firstHypergraph by renaming its pattern (negative)
+   * atoms.
+   * @details Positive atoms are not renamed. Different patterns can be renamed to the same atom, so to check for an
+   * isomorphism, all atoms of firstHypergraph should be patterns, and both hypergraphs should have the same number of
+   * distinct atoms.
+   */
+  static bool isomorphic(const std::vector<AtomsVector>& firstHypergraph,
+                         const std::vector<AtomsVector>& secondHypergraph,
+                         const std::function<bool()>& shouldAbort);
+
  private:
   class Implementation;
   std::shared_ptr<Implementation> implementation_;
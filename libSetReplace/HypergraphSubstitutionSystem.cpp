@@ -1,16 +1,33 @@
 #include "HypergraphSubstitutionSystem.hpp"
 
 #include <algorithm>
+#include <deque>
 #include <limits>
 #include <memory>
+#include <random>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "Arena.hpp"
+#include "Tracing.hpp"
+
 namespace SetReplace {
 class HypergraphSubstitutionSystem::Implementation {
  private:
+  using AtomDegrees = std::unordered_map<Atom,
+                                         int64_t,
+                                         std::hash<Atom>,
+                                         std::equal_to<Atom>,
+                                         ArenaAllocator<std::pair<const Atom, int64_t>>>;
+
+  // The tokens, the atom degrees and the tokens waiting to be indexed are allocated from here, so that their memory is
+  // counted, see memoryUsage(). Declared first, so that it outlives them.
+  Arena arena_;
+  // Same for the event times, which are counted with the events.
+  Arena eventTimesArena_;
+
   // Rules cannot be changed during evaluation as the previously found and kept matches will become invalid.
   // If rules do need to be changed, create another instance of HypergraphSubstitutionSystem and copy the tokens over.
   const std::vector<Rule> rules_;
@@ -20,7 +37,11 @@ class HypergraphSubstitutionSystem::Implementation {
   const uint64_t maxDestroyerEvents_;
   TerminationReason terminationReason_ = TerminationReason::NotTerminated;
 
-  std::unordered_map<TokenID, AtomsVector> tokens_;
+  // Indexed by token ID, as these are assigned consecutively, and tokens are never removed. A deque keeps the
+  // references returned by the atoms vector getters valid as new tokens are added.
+  std::deque<AtomsVector, ArenaAllocator<AtomsVector>> tokens_;
+  // The atoms themselves are allocated by the atom vectors, so their capacities are counted separately.
+  int64_t atomsBytes_ = 0;
   TokenEventGraph causalGraph_;
 
   Atom nextAtom_ = 1;
@@ -29,34 +50,63 @@ class HypergraphSubstitutionSystem::Implementation {
 
   // In another words, token counts by atom.
   // Note, we cannot use atomsIndex_, because it does not keep last generation tokens.
-  std::unordered_map<Atom, int64_t> atomDegrees_;
+  AtomDegrees atomDegrees_;
 
   AtomsIndex atomsIndex_;
 
   HypergraphMatcher matcher_;
 
-  std::vector<TokenID> unindexedTokens_;
+  MultiwayStateGraph stateGraph_;
+  const bool hasStateGraph_;
+
+  std::vector<TokenID, ArenaAllocator<TokenID>> unindexedTokens_;
+
+  // If the matches of new tokens are always ordered after the existing ones, and no random choice is made, the next
+  // event is the same whether or not the outputs of the previous events are matched first. Matching is then deferred
+  // until the existing matches run out, or maxDeferredEvents events are applied. Each matching pass then covers
+  // multiple events, so there are fewer of them to parallelize, and the matches of the tokens destroyed in the meantime
+  // are never created.
+  static constexpr int64_t maxDeferredEvents = 256;
+  const bool canDeferMatching_;
+  int64_t deferredEventCount_ = 0;
+
+  // Only the operations done outside of the matcher, see statistics().
+  Statistics statistics_;
+
+  std::shared_ptr<EventSink> eventSink_;
+
+  // Only recorded for HypergraphMatcher::OrderingFunction::WeightedRandom, see eventTimes().
+  const bool recordsEventTimes_;
+  std::vector<double, ArenaAllocator<double>> eventTimes_;
+  std::mt19937 timeRandomGenerator_;
 
  public:
   Implementation(const std::vector<Rule>& rules,
-                 const std::vector<AtomsVector>& initialTokens,
+                 std::vector<AtomsVector> initialTokens,
                  const uint64_t maxDestroyerEvents,
                  const HypergraphMatcher::OrderingSpec& orderingSpec,
                  const HypergraphMatcher::EventDeduplication& eventDeduplication,
-                 const unsigned int randomSeed)
+                 const unsigned int randomSeed,
+                 const MultiwayStateGraph::StateDeduplication stateDeduplication,
+                 const bool useHugePages,
+                 const GetMatchWeightFunc& getMatchWeight)
       : Implementation(
             rules,
-            initialTokens,
+            std::move(initialTokens),
             maxDestroyerEvents,
             orderingSpec,
             eventDeduplication,
             randomSeed,
+            stateDeduplication,
+            useHugePages,
+            getMatchWeight,
             [this](const TokenID& tokenID) -> const AtomsVector& { return tokens_.at(tokenID); },
             [this](const TokenID& first, const TokenID& second) -> SeparationType {
               return causalGraph_.tokenSeparation(first, second);
             }) {}
 
   int64_t replaceOnce(const std::function<bool()> shouldAbortOrTimeOut, bool resetStepSpec = false) {
+    Tracing::Scope traceScope("replaceOnce");
     if (resetStepSpec) {
       updateStepSpec(StepSpecification{});
     }
@@ -67,7 +117,14 @@ class HypergraphSubstitutionSystem::Implementation {
       return 0;
     }
 
-    indexNewTokens(shouldAbortOrTimeOut);
+    if (stepSpec_.maxMemoryBytes != stepLimitDisabled && memoryUsage().total() > stepSpec_.maxMemoryBytes) {
+      terminationReason_ = TerminationReason::MaxMemory;
+      return 0;
+    }
+
+    if (!canDeferMatching_ || matcher_.empty() || deferredEventCount_ >= maxDeferredEvents) {
+      indexNewTokens(shouldAbortOrTimeOut);
+    }
     if (matcher_.empty()) {
       if (causalGraph_.largestGeneration() == stepSpec_.maxGenerationsLocal) {
         terminationReason_ = TerminationReason::MaxGenerationsLocal;
@@ -83,6 +140,7 @@ class HypergraphSubstitutionSystem::Implementation {
 
     // only makes sense to have final state step limits for a single history.
     if (!hasMultipleHistories()) {
+      Tracing::Scope limitsTraceScope("checkLimits");
       for (const auto function : {&Implementation::willExceedAtomLimits, &Implementation::willExceedTokenLimit}) {
         const auto willExceedAtomLimitsStatus = (this->*function)(explicitRuleInputs, explicitRuleOutputs);
         if (willExceedAtomLimitsStatus != TerminationReason::NotTerminated) {
@@ -92,22 +150,38 @@ class HypergraphSubstitutionSystem::Implementation {
       }
     }
 
+    throwIfIDsWillOverflow(explicitRuleOutputs.size());
+
     // At this point, we are committed to modifying the system.
 
     // Name newly created atoms as well, now all atoms in the output are explicitly named.
-    const auto namedRuleOutputs = nameAnonymousAtoms(explicitRuleOutputs);
+    auto namedRuleOutputs = nameAnonymousAtoms(explicitRuleOutputs);
 
     const auto outputTokenIDs =
         causalGraph_.addEvent(match->rule, match->inputTokens, static_cast<int>(namedRuleOutputs.size()));
+    if (recordsEventTimes_) {
+      std::exponential_distribution<double> timeToEvent(matcher_.totalWeight());
+      eventTimes_.push_back(eventTimes_.back() + timeToEvent(timeRandomGenerator_));
+    }
+    const auto eventID = static_cast<EventID>(causalGraph_.eventsCount());
+    if (eventSink_) {
+      eventSink_->write(Event{match->rule, match->inputTokens, outputTokenIDs, causalGraph_.eventGeneration(eventID)},
+                        namedRuleOutputs);
+    }
 
-    addTokens(outputTokenIDs, namedRuleOutputs);
+    addTokens(std::move(namedRuleOutputs));
+    // If all states this event leads to are already known, its outputs are not indexed, and the events following these
+    // states are not duplicated. Without the history, there is no state graph, so all outputs are indexed.
+    indexTokensLater(causalGraph_.keepsHistory() ? stateGraph_.addEvent(eventID) : outputTokenIDs);
+    ++deferredEventCount_;
 
     if (maxDestroyerEvents_ == 1) {
       matcher_.removeMatchesInvolvingTokens(match->inputTokens);
-      atomsIndex_.removeTokens(match->inputTokens);
+      removeFromAtomsIndex(match->inputTokens);
       // The following only make sense for single-history systems.
       destroyedTokenCount_ += match->inputTokens.size();
       updateAtomDegrees(&atomDegrees_, match->inputTokens, -1);
+      if (!causalGraph_.keepsHistory()) discardAtoms(match->inputTokens);
     } else if (maxDestroyerEvents_ == static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
       matcher_.deleteMatch(match);
     } else {
@@ -120,7 +194,7 @@ class HypergraphSubstitutionSystem::Implementation {
         }
       }
       matcher_.removeMatchesInvolvingTokens(inputTokensToRemove);
-      atomsIndex_.removeTokens(inputTokensToRemove);
+      removeFromAtomsIndex(inputTokensToRemove);
     }
 
     return 1;
@@ -162,15 +236,13 @@ class HypergraphSubstitutionSystem::Implementation {
     }
   }
 
+  size_t tokenCount() const { return tokens_.size(); }
+
+  const AtomsVector& tokenAtoms(const TokenID tokenID) const { return tokens_.at(tokenID); }
+
   std::vector<AtomsVector> tokens() const {
-    std::vector<std::pair<TokenID, AtomsVector>> idsAndTokens(tokens_.begin(), tokens_.end());
-    std::sort(idsAndTokens.begin(), idsAndTokens.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
-    std::vector<AtomsVector> result;
-    result.reserve(idsAndTokens.size());
-    for (const auto& idAndToken : idsAndTokens) {
-      result.emplace_back(idAndToken.second);
-    }
-    return result;
+    if (!causalGraph_.keepsHistory()) throw Error::HistoryNotKept;
+    return std::vector<AtomsVector>(tokens_.begin(), tokens_.end());
   }
 
   Generation maxCompleteGeneration(const std::function<bool()>& shouldAbort) {
@@ -180,23 +252,112 @@ class HypergraphSubstitutionSystem::Implementation {
 
   TerminationReason terminationReason() const { return terminationReason_; }
 
-  const std::vector<Event>& events() const { return causalGraph_.events(); }
+  EventsView events() const {
+    if (!causalGraph_.keepsHistory()) throw Error::HistoryNotKept;
+    return causalGraph_.events();
+  }
+
+  void setEventSink(std::shared_ptr<EventSink> sink, const bool keepHistory) {
+    if (!causalGraph_.keepsHistory()) throw Error::HistoryNotKept;
+    // Past events are needed to find new events in multihistories, and to deduplicate states.
+    if (!keepHistory && (hasMultipleHistories() || hasStateGraph_)) throw Error::HistoryRequired;
+
+    if (sink) {
+      std::vector<AtomsVector> outputAtoms;
+      for (const auto& event : causalGraph_.events()) {
+        outputAtoms.clear();
+        for (const auto token : event.outputTokens) {
+          outputAtoms.push_back(tokens_[token]);
+        }
+        sink->write(event, outputAtoms);
+      }
+    }
+    eventSink_ = std::move(sink);
+
+    if (!keepHistory) {
+      causalGraph_.discardHistory();
+      std::vector<TokenID> destroyedTokens;
+      for (TokenID token = 0; token < static_cast<TokenID>(tokens_.size()); ++token) {
+        if (causalGraph_.destroyerEventsCount(token) > 0) destroyedTokens.push_back(token);
+      }
+      discardAtoms(destroyedTokens);
+    }
+  }
+
+  void flushEventSink() {
+    if (eventSink_) eventSink_->flush();
+  }
+
+  std::vector<std::vector<TokenID>> states() const { return stateGraph_.states(); }
+
+  std::vector<StateTransition> stateTransitions() const { return stateGraph_.transitions(); }
+
+  Statistics statistics() const {
+    auto result = matcher_.statistics();
+    result += statistics_;
+    return result;
+  }
+
+  std::vector<double> eventTimes() const { return std::vector<double>(eventTimes_.begin(), eventTimes_.end()); }
+
+  MemoryUsage memoryUsage() const {
+    MemoryUsage result;
+    result.tokens = static_cast<int64_t>(arena_.reservedBytes()) + atomsBytes_;
+    result.events = static_cast<int64_t>(causalGraph_.historyMemoryUsage() + eventTimesArena_.reservedBytes());
+    result.separation = static_cast<int64_t>(causalGraph_.separationMemoryUsage());
+    result.atomsIndex = static_cast<int64_t>(atomsIndex_.memoryUsage());
+    result.matches = static_cast<int64_t>(matcher_.memoryUsage());
+    result.stateGraph = static_cast<int64_t>(stateGraph_.memoryUsage());
+    return result;
+  }
 
  private:
   Implementation(const std::vector<Rule>& rules,
-                 const std::vector<AtomsVector>& initialTokens,
+                 std::vector<AtomsVector> initialTokens,
                  const uint64_t maxDestroyerEvents,
                  const HypergraphMatcher::OrderingSpec& orderingSpec,
                  const HypergraphMatcher::EventDeduplication& eventDeduplication,
                  const unsigned int randomSeed,
+                 const MultiwayStateGraph::StateDeduplication stateDeduplication,
+                 const bool useHugePages,
+                 const GetMatchWeightFunc& getMatchWeight,
                  const GetAtomsVectorFunc& getAtomsVector,
                  const GetTokenSeparationFunc& getTokenSeparation)
-      : rules_(optimizeRules(rules, maxDestroyerEvents)),
+      : arena_(useHugePages),
+        rules_(optimizeRules(rules, maxDestroyerEvents)),
         maxDestroyerEvents_(maxDestroyerEvents),
-        causalGraph_(static_cast<int>(initialTokens.size()), separationTrackingMethod(maxDestroyerEvents, rules)),
-        atomsIndex_(getAtomsVector),
-        matcher_(
-            rules_, &atomsIndex_, getAtomsVector, getTokenSeparation, orderingSpec, eventDeduplication, randomSeed) {
+        tokens_(ArenaAllocator<AtomsVector>(&arena_)),
+        causalGraph_(static_cast<int>(initialTokens.size()),
+                     separationTrackingMethod(maxDestroyerEvents, rules),
+                     useHugePages),
+        atomDegrees_(ArenaAllocator<AtomDegrees::value_type>(&arena_)),
+        atomsIndex_(getAtomsVector, useHugePages),
+        matcher_(rules_,
+                 &atomsIndex_,
+                 getAtomsVector,
+                 getTokenSeparation,
+                 orderingSpec,
+                 eventDeduplication,
+                 randomSeed,
+                 [this](const TokenID& id) { return causalGraph_.tokenGeneration(id); },
+                 // Lazy removal would change which of the equivalent matches are chosen at random
+                 HypergraphMatcher::isTotalOrder(orderingSpec) ? HypergraphMatcher::MatchRemoval::Lazy
+                                                               : HypergraphMatcher::MatchRemoval::Eager,
+                 useHugePages,
+                 getMatchWeight),
+        stateGraph_(stateDeduplication, &causalGraph_, getAtomsVector),
+        hasStateGraph_(stateDeduplication != MultiwayStateGraph::StateDeduplication::Disabled),
+        unindexedTokens_(ArenaAllocator<TokenID>(&arena_)),
+        canDeferMatching_(maxDestroyerEvents == 1 && HypergraphMatcher::isTotalOrder(orderingSpec) &&
+                          HypergraphMatcher::ordersNewerTokensLast(orderingSpec)),
+        recordsEventTimes_(HypergraphMatcher::isWeightedRandom(orderingSpec)),
+        eventTimes_(ArenaAllocator<double>(&eventTimesArena_)) {
+    if (recordsEventTimes_) {
+      eventTimes_.push_back(0);
+      // Seeded differently from the matcher, so that the times do not depend on the choices of matches.
+      std::seed_seq timeSeed{randomSeed};
+      timeRandomGenerator_.seed(timeSeed);
+    }
     for (const auto& token : initialTokens) {
       for (const auto& atom : token) {
         if (atom <= 0) throw Error::NonPositiveAtoms;
@@ -204,7 +365,9 @@ class HypergraphSubstitutionSystem::Implementation {
         incrementNextAtom();
       }
     }
-    addTokens(causalGraph_.allTokenIDs(), initialTokens);
+    const auto initialTokenIDs = causalGraph_.allTokenIDs();
+    addTokens(std::move(initialTokens));
+    indexTokensLater(initialTokenIDs);
   }
 
   std::vector<Rule> optimizeRules(const std::vector<Rule>& rules, uint64_t maxDestroyerEvents) {
@@ -217,7 +380,7 @@ class HypergraphSubstitutionSystem::Implementation {
       std::vector<Rule> newRules;
       newRules.reserve(rules.size());
       for (const auto& rule : rules) {
-        newRules.push_back(Rule{rule.inputs, rule.outputs, EventSelectionFunction::All});
+        newRules.push_back(Rule{rule.inputs, rule.outputs, EventSelectionFunction::All, rule.weight});
       }
       return newRules;
     } else {
@@ -225,6 +388,14 @@ class HypergraphSubstitutionSystem::Implementation {
     }
   }
 
+  // TokenID and EventID are only 32-bit if compactIDs is true, otherwise the limits below cannot be reached.
+  void throwIfIDsWillOverflow(const size_t newTokenCount) const {
+    if (!fitsInID<TokenID>(static_cast<int64_t>(causalGraph_.tokenCount() + newTokenCount) - 1)) {
+      throw Error::TokenCountOverflow;
+    }
+    if (!fitsInID<EventID>(static_cast<int64_t>(causalGraph_.eventsCount()) + 1)) throw Error::EventCountOverflow;
+  }
+
   Atom incrementNextAtom() {
     if (nextAtom_ == std::numeric_limits<Atom>::max()) {
       throw Error::AtomCountOverflow;
@@ -237,9 +408,10 @@ class HypergraphSubstitutionSystem::Implementation {
     const auto previousMaxGeneration = stepSpec_.maxGenerationsLocal;
     stepSpec_ = newStepSpec;
     if (newStepSpec.maxGenerationsLocal > previousMaxGeneration) {
-      for (const auto& idAndToken : tokens_) {
-        if (causalGraph_.tokenGeneration(idAndToken.first) == previousMaxGeneration) {
-          unindexedTokens_.push_back(idAndToken.first);
+      // Newest tokens first, so that the choices between equivalent matches are the same as in the previous versions.
+      for (TokenID id = static_cast<TokenID>(tokens_.size()) - 1; id >= 0; --id) {
+        if (causalGraph_.tokenGeneration(id) == previousMaxGeneration && stateGraph_.isTokenReachable(id)) {
+          unindexedTokens_.push_back(id);
         }
       }
     }
@@ -257,10 +429,24 @@ class HypergraphSubstitutionSystem::Implementation {
   }
 
   void indexNewTokens(const std::function<bool()>& shouldAbort) {
+    Tracing::Scope traceScope("indexNewTokens");
+    const std::vector<TokenID> tokens(unindexedTokens_.begin(), unindexedTokens_.end());
     // Atoms index must be updated first, because the matcher uses it to discover tokens.
-    atomsIndex_.addTokens(unindexedTokens_);
-    matcher_.addMatchesInvolvingTokens(unindexedTokens_, shouldAbort);
+    {
+      Statistics::ScopedTimer timer(&statistics_, Statistics::Timer::IndexUpdate);
+      statistics_.increment(Statistics::Counter::IndexInsertions, tokens.size());
+      atomsIndex_.addTokens(tokens);
+    }
+    matcher_.addMatchesInvolvingTokens(tokens, shouldAbort);
     unindexedTokens_.clear();
+    deferredEventCount_ = 0;
+  }
+
+  void removeFromAtomsIndex(const std::vector<TokenID>& tokenIDs) {
+    Statistics::ScopedTimer timer(&statistics_, Statistics::Timer::IndexUpdate);
+    Tracing::Scope traceScope("removeFromAtomsIndex");
+    statistics_.increment(Statistics::Counter::IndexRemovals, tokenIDs.size());
+    atomsIndex_.removeTokens(tokenIDs);
   }
 
   bool hasMultipleHistories() const { return maxDestroyerEvents_ > 1; }
@@ -301,7 +487,8 @@ class HypergraphSubstitutionSystem::Implementation {
     }
   }
 
-  static void updateAtomDegrees(std::unordered_map<Atom, int64_t>* atomDegrees,
+  template <typename AtomDegreesMap>
+  static void updateAtomDegrees(AtomDegreesMap* atomDegrees,
                                 const std::vector<AtomsVector>& deltaTokens,
                                 const int64_t deltaCount,
                                 bool deleteIfZero = true) {
@@ -333,6 +520,7 @@ class HypergraphSubstitutionSystem::Implementation {
   }
 
   std::vector<AtomsVector> nameAnonymousAtoms(const std::vector<AtomsVector>& atomVectors) {
+    Tracing::Scope traceScope("nameAnonymousAtoms");
     std::unordered_map<Atom, Atom> names;
     std::vector<AtomsVector> result = atomVectors;
     for (auto& token : result) {
@@ -349,24 +537,44 @@ class HypergraphSubstitutionSystem::Implementation {
     return result;
   }
 
-  void addTokens(const std::vector<TokenID>& ids, const std::vector<AtomsVector>& tokens) {
-    if (ids.empty()) return;
+  // The tokens get the IDs following the existing ones, as these are assigned consecutively by the causal graph.
+  void addTokens(std::vector<AtomsVector> tokens) {
+    if (tokens.empty()) return;
 
-    for (size_t index = 0; index < ids.size(); ++index) {
-      tokens_.insert(std::make_pair(ids[index], tokens[index]));
+    // atom degrees are only used for final state step limiters
+    if (!hasMultipleHistories()) updateAtomDegrees(&atomDegrees_, tokens, +1);
+
+    for (auto& token : tokens) {
+      atomsBytes_ += atomsBytes(token);
+      tokens_.push_back(std::move(token));
+    }
+  }
+
+  // Only for tokens that are no longer used for matching. The tokens keep their IDs, but the memory of their atoms is
+  // released.
+  void discardAtoms(const std::vector<TokenID>& ids) {
+    for (const auto id : ids) {
+      atomsBytes_ -= atomsBytes(tokens_[id]);
+      AtomsVector().swap(tokens_[id]);
+    }
+  }
+
+  // Vectors allocate exactly their capacity.
+  static int64_t atomsBytes(const AtomsVector& atoms) {
+    return static_cast<int64_t>(atoms.capacity() * sizeof(Atom));
+  }
 
+  void indexTokensLater(const std::vector<TokenID>& ids) {
+    for (const auto id : ids) {
       // If generation is at least maxGeneration_, we will never use these tokens as inputs, so no need adding them
       // to the index.
-      if (causalGraph_.tokenGeneration(ids[index]) < stepSpec_.maxGenerationsLocal) {
-        unindexedTokens_.push_back(ids[index]);
+      if (causalGraph_.tokenGeneration(id) < stepSpec_.maxGenerationsLocal) {
+        unindexedTokens_.push_back(id);
       }
     }
-
-    // atom degrees are only used for final state step limiters
-    if (!hasMultipleHistories()) updateAtomDegrees(&atomDegrees_, tokens, +1);
   }
 
-  void updateAtomDegrees(std::unordered_map<Atom, int64_t>* atomDegrees,
+  void updateAtomDegrees(AtomDegrees* atomDegrees,
                          const std::vector<TokenID>& deltaTokenIDs,
                          const int64_t deltaCount) const {
     std::vector<AtomsVector> tokens;
@@ -380,11 +588,7 @@ class HypergraphSubstitutionSystem::Implementation {
   Generation smallestGeneration(const std::vector<MatchPtr>& matches) const {
     Generation smallestSoFar = std::numeric_limits<Generation>::max();
     for (const auto& match : matches) {
-      Generation largestForTheMatch = 0;
-      for (const TokenID id : match->inputTokens) {
-        largestForTheMatch = std::max(largestForTheMatch, causalGraph_.tokenGeneration(id));
-      }
-      smallestSoFar = std::min(smallestSoFar, largestForTheMatch);
+      smallestSoFar = std::min(smallestSoFar, match->maxInputGeneration);
     }
     return smallestSoFar;
   }
@@ -397,7 +601,7 @@ class HypergraphSubstitutionSystem::Implementation {
     }
     for (const auto& rule : rules) {
       if (rule.eventSelectionFunction != EventSelectionFunction::All) {
-        return TokenEventGraph::SeparationTrackingMethod::DestroyerChoices;
+        return TokenEventGraph::SeparationTrackingMethod::DestroyerChoiceSets;
       }
     }
     return TokenEventGraph::SeparationTrackingMethod::None;
@@ -406,13 +610,23 @@ class HypergraphSubstitutionSystem::Implementation {
 
 HypergraphSubstitutionSystem::HypergraphSubstitutionSystem(
     const std::vector<Rule>& rules,
-    const std::vector<AtomsVector>& initialTokens,
+    std::vector<AtomsVector> initialTokens,
     uint64_t maxDestroyerEvents,
     const HypergraphMatcher::OrderingSpec& orderingSpec,
     const HypergraphMatcher::EventDeduplication& eventDeduplication,
-    unsigned int randomSeed)
-    : implementation_(std::make_shared<Implementation>(
-          rules, initialTokens, maxDestroyerEvents, orderingSpec, eventDeduplication, randomSeed)) {}
+    unsigned int randomSeed,
+    MultiwayStateGraph::StateDeduplication stateDeduplication,
+    const bool useHugePages,
+    const GetMatchWeightFunc& getMatchWeight)
+    : implementation_(std::make_shared<Implementation>(rules,
+                                                       std::move(initialTokens),
+                                                       maxDestroyerEvents,
+                                                       orderingSpec,
+                                                       eventDeduplication,
+                                                       randomSeed,
+                                                       stateDeduplication,
+                                                       useHugePages,
+                                                       getMatchWeight)) {}
 
 int64_t HypergraphSubstitutionSystem::replaceOnce(const std::function<bool()>& shouldAbort) {
   return implementation_->replaceOnce(shouldAbort, true);
@@ -421,11 +635,32 @@ int64_t HypergraphSubstitutionSystem::replaceOnce(const std::function<bool()>& s
 int64_t HypergraphSubstitutionSystem::replace(const StepSpecification& stepSpec,
                                               const std::function<bool()>& shouldAbort,
                                               std::chrono::steady_clock::duration const timeConstraint) {
-  return implementation_->replace(stepSpec, shouldAbort, timeConstraint);
+  int64_t count;
+  try {
+    count = implementation_->replace(stepSpec, shouldAbort, timeConstraint);
+  } catch (...) {
+    // The trace of an aborted evolution is the most useful one, and so are the events produced before the abort.
+    Tracing::flush();
+    try {
+      implementation_->flushEventSink();
+    } catch (...) {
+      // The original error is more relevant.
+    }
+    throw;
+  }
+  Tracing::flush();
+  implementation_->flushEventSink();
+  return count;
 }
 
 std::vector<AtomsVector> HypergraphSubstitutionSystem::tokens() const { return implementation_->tokens(); }
 
+size_t HypergraphSubstitutionSystem::tokenCount() const { return implementation_->tokenCount(); }
+
+const AtomsVector& HypergraphSubstitutionSystem::tokenAtoms(const TokenID tokenID) const {
+  return implementation_->tokenAtoms(tokenID);
+}
+
 Generation HypergraphSubstitutionSystem::maxCompleteGeneration(const std::function<bool()>& shouldAbort) {
   return implementation_->maxCompleteGeneration(shouldAbort);
 }
@@ -434,5 +669,23 @@ HypergraphSubstitutionSystem::TerminationReason HypergraphSubstitutionSystem::te
   return implementation_->terminationReason();
 }
 
-const std::vector<Event>& HypergraphSubstitutionSystem::events() const { return implementation_->events(); }
+EventsView HypergraphSubstitutionSystem::events() const { return implementation_->events(); }
+
+void HypergraphSubstitutionSystem::setEventSink(std::shared_ptr<EventSink> sink, const bool keepHistory) {
+  implementation_->setEventSink(std::move(sink), keepHistory);
+}
+
+std::vector<std::vector<TokenID>> HypergraphSubstitutionSystem::states() const { return implementation_->states(); }
+
+std::vector<StateTransition> HypergraphSubstitutionSystem::stateTransitions() const {
+  return implementation_->stateTransitions();
+}
+
+Statistics HypergraphSubstitutionSystem::statistics() const { return implementation_->statistics(); }
+
+std::vector<double> HypergraphSubstitutionSystem::eventTimes() const { return implementation_->eventTimes(); }
+
+HypergraphSubstitutionSystem::MemoryUsage HypergraphSubstitutionSystem::memoryUsage() const {
+  return implementation_->memoryUsage();
+}
 }  // namespace SetReplace
@@ -8,8 +8,11 @@
 #include <vector>
 
 #include "AtomsIndex.hpp"
+#include "EventStream.hpp"
 #include "HypergraphMatcher.hpp"
+#include "MultiwayStateGraph.hpp"
 #include "Rule.hpp"
+#include "Statistics.hpp"
 #include "TokenEventGraph.hpp"
 
 namespace SetReplace {
@@ -25,7 +28,11 @@ class HypergraphSubstitutionSystem {
     DisconnectedInputs,
     NonPositiveAtoms,
     AtomCountOverflow,
-    FinalStateStepSpecificationForMultihistory
+    TokenCountOverflow,
+    EventCountOverflow,
+    FinalStateStepSpecificationForMultihistory,
+    HistoryNotKept,
+    HistoryRequired
   };
 
   static constexpr int64_t stepLimitDisabled = std::numeric_limits<int64_t>::max();
@@ -44,6 +51,8 @@ class HypergraphSubstitutionSystem {
    * number of atoms in the final state to go over the limit.
    * @var maxFinalAtomDegree Same as above, but for the maximum number of tokens a single atom is involved in.
    * @var maxFinalTokens Same as for the atoms above, but for tokens.
+   * @var maxMemoryBytes The evaluation is stopped before the next event once memoryUsage().total() exceeds this. It is
+   * a soft limit, as the matching of the tokens created by the previous events can take more memory before the check.
    */
   struct StepSpecification {
     int64_t maxEvents = stepLimitDisabled;
@@ -51,6 +60,7 @@ class HypergraphSubstitutionSystem {
     int64_t maxFinalAtoms = stepLimitDisabled;
     int64_t maxFinalAtomDegree = stepLimitDisabled;
     int64_t maxFinalTokens = stepLimitDisabled;
+    int64_t maxMemoryBytes = stepLimitDisabled;
   };
 
   /** @brief Status of evaluation / termination reason if evaluation is finished.
@@ -65,22 +75,54 @@ class HypergraphSubstitutionSystem {
     Complete = 6,
     Aborted = 7,
     TimeConstrained = 8,
+    MaxMemory = 9,
+  };
+
+  /** @brief Bytes of memory taken by each part of the system, see memoryUsage().
+   * @var tokens Atoms of the tokens, and the number of tokens containing each atom.
+   * @var events Events, and the creator events and destroyer event counts of tokens.
+   * @var separation Data used to determine the separation between tokens in multihistories.
+   * @var atomsIndex Index of the tokens by atoms used for matching.
+   * @var matches Matches, and the structures ordering and indexing them.
+   * @var stateGraph Global states, and the transitions between them, see MultiwayStateGraph.
+   */
+  struct MemoryUsage {
+    int64_t tokens = 0;
+    int64_t events = 0;
+    int64_t separation = 0;
+    int64_t atomsIndex = 0;
+    int64_t matches = 0;
+    int64_t stateGraph = 0;
+
+    int64_t total() const { return tokens + events + separation + atomsIndex + matches + stateGraph; }
   };
 
   /** @brief Creates a new hypergraph system with given evaluation rules, and initial condition.
    * @param rules substitution rules used for evaluation. Note, these rules cannot be changed.
-   * @param initialTokens initial state. It will be lazily indexed before the first replacement.
+   * @param initialTokens initial state. It will be lazily indexed before the first replacement. It is moved into the
+   * system, so a decoded state passed as an rvalue is not copied.
    * @param maxDestroyerEvents maximum number of allowed destroyer events per token.
    * @param orderingSpec in which order to apply events.
    * @param eventIdentification defines which events should be treated as identical.
    * @param randomSeed the seed to use for selecting matches in random evaluation case.
+   * @param stateDeduplication if not disabled, global states are enumerated, and the states that are the same are
+   * merged. Only the tokens of newly discovered states are matched further, so the events following a state are shared
+   * by all states merged with it.
+   * @param useHugePages whether to back the arenas of the matcher, the atoms index and the separation tracking data
+   * with transparent huge pages, see Arena. This does not change the results.
+   * @param getMatchWeight optional weight multiplier of each match, only used for the
+   * HypergraphMatcher::OrderingFunction::WeightedRandom ordering.
    */
-  HypergraphSubstitutionSystem(const std::vector<Rule>& rules,
-                               const std::vector<AtomsVector>& initialTokens,
-                               uint64_t maxDestroyerEvents,
-                               const HypergraphMatcher::OrderingSpec& orderingSpec,
-                               const HypergraphMatcher::EventDeduplication& eventIdentification,
-                               unsigned int randomSeed = 0);
+  HypergraphSubstitutionSystem(
+      const std::vector<Rule>& rules,
+      std::vector<AtomsVector> initialTokens,
+      uint64_t maxDestroyerEvents,
+      const HypergraphMatcher::OrderingSpec& orderingSpec,
+      const HypergraphMatcher::EventDeduplication& eventIdentification,
+      unsigned int randomSeed = 0,
+      MultiwayStateGraph::StateDeduplication stateDeduplication = MultiwayStateGraph::StateDeduplication::Disabled,
+      bool useHugePages = false,
+      const GetMatchWeightFunc& getMatchWeight = {});
 
   /** @brief Perform a single substitution, create the corresponding event, and output tokens.
    * @param shouldAbortOrTimeOut function that should return true if abort is requested or the evolution timed out.
@@ -99,9 +141,19 @@ class HypergraphSubstitutionSystem {
                   std::chrono::steady_clock::duration const timeConstraint = timeConstraintDisabled);
 
   /** @brief List of all tokens in the system, past and present.
+   * @details Throws Error::HistoryNotKept if the history is only written to an event sink.
    */
   std::vector<AtomsVector> tokens() const;
 
+  /** @brief Number of tokens in the system, past and present.
+   */
+  size_t tokenCount() const;
+
+  /** @brief Atoms of a single token, which can be used to export tokens without copying all of them at once.
+   * @details Empty for destroyed tokens if the history is only written to an event sink.
+   */
+  const AtomsVector& tokenAtoms(TokenID tokenID) const;
+
   /** @brief Returns the largest generation that has both been reached, and has no matches that would produce
    * tokens with that or lower generation.
    * @details Takes O(matches count) + as long as it would take to do the next step (because new tokens need to be
@@ -115,8 +167,47 @@ class HypergraphSubstitutionSystem {
   TerminationReason terminationReason() const;
 
   /** @brief Yields rule IDs corresponding to each event.
+   * @details Throws Error::HistoryNotKept if the history is only written to an event sink.
+   */
+  EventsView events() const;
+
+  /** @brief Writes all events so far to the sink, and then each new event as soon as it is created.
+   * @param keepHistory if false, events and destroyed tokens are no longer kept in memory, and can only be recovered
+   * from the sink, e.g., with EventStreamReader. Throws Error::HistoryRequired for multihistories and if the state
+   * graph is enabled, as these need past events to continue the evolution.
+   * @details Replaces the previous sink if any. Throws Error::HistoryNotKept if the history was already discarded, as
+   * the new sink would not get the past events.
+   */
+  void setEventSink(std::shared_ptr<EventSink> sink, bool keepHistory = true);
+
+  /** @brief Token IDs of all global states discovered so far, empty if the state graph is disabled.
+   */
+  std::vector<std::vector<TokenID>> states() const;
+
+  /** @brief Transitions between the global states, empty if the state graph is disabled.
+   */
+  std::vector<StateTransition> stateTransitions() const;
+
+  /** @brief Counters and timers of matching and indexing, all zero unless compiled with LIBSETREPLACE_STATISTICS.
+   * @details Accumulated over all calls to replace() and maxCompleteGeneration().
+   */
+  Statistics statistics() const;
+
+  /** @brief Times of all events including the initial one, which is at time 0, if the ordering is
+   * HypergraphMatcher::OrderingFunction::WeightedRandom, empty otherwise.
+   * @details The time between events is exponentially distributed with the rate HypergraphMatcher::totalWeight() of the
+   * matches the event was chosen from. If WeightedRandom is the only ordering function, these are all matches, so this
+   * is the Gillespie algorithm, in which the matches are the possible reactions, and their weights are the rates. The
+   * times are kept even if the history is discarded, see setEventSink().
+   */
+  std::vector<double> eventTimes() const;
+
+  /** @brief Memory currently taken by the system, not including the state graph.
+   * @details Most structures are allocated from arenas, which count the memory they take from the system, including
+   * the blocks kept for reuse. Flat vectors are counted by their capacity. This takes a few lock acquisitions, and is
+   * only computed in replaceOnce() if StepSpecification::maxMemoryBytes is set.
    */
-  const std::vector<Event>& events() const;
+  MemoryUsage memoryUsage() const;
 
  private:
   class Implementation;
@@ -0,0 +1,248 @@
+#include "HypergraphUnifications.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+// shouldAbort() might be slow, so it is only checked once per this many search nodes.
+constexpr int64_t abortCheckPeriod = 1024;
+
+// Union-find over vertices without path compression, so that the unions can be undone in the reverse order.
+class RollbackUnionFind {
+ public:
+  explicit RollbackUnionFind(const int64_t size) : parents_(size), sizes_(size, 1) {
+    for (int64_t i = 0; i < size; ++i) {
+      parents_[i] = i;
+    }
+  }
+
+  int64_t find(int64_t vertex) const {
+    while (parents_[vertex] != vertex) vertex = parents_[vertex];
+    return vertex;
+  }
+
+  void unite(const int64_t first, const int64_t second) {
+    int64_t firstRoot = find(first);
+    int64_t secondRoot = find(second);
+    if (firstRoot == secondRoot) {
+      history_.push_back(-1);
+      return;
+    }
+    if (sizes_[firstRoot] < sizes_[secondRoot]) std::swap(firstRoot, secondRoot);
+    parents_[secondRoot] = firstRoot;
+    sizes_[firstRoot] += sizes_[secondRoot];
+    history_.push_back(secondRoot);
+  }
+
+  // Undoes the last unite() call.
+  void rollback() {
+    const int64_t attachedRoot = history_.back();
+    history_.pop_back();
+    if (attachedRoot == -1) return;
+    sizes_[parents_[attachedRoot]] -= sizes_[attachedRoot];
+    parents_[attachedRoot] = attachedRoot;
+  }
+
+ private:
+  std::vector<int64_t> parents_;
+  std::vector<int64_t> sizes_;
+  std::vector<int64_t> history_;
+};
+
+// Hypergraph with atoms replaced by dense vertex indices, which are shared between both hypergraphs, but do not
+// overlap.
+std::vector<std::vector<int64_t>> toVertexIndices(const std::vector<AtomsVector>& hypergraph, int64_t* vertexCount) {
+  std::unordered_map<Atom, int64_t> vertexIndices;
+  std::vector<std::vector<int64_t>> result;
+  result.reserve(hypergraph.size());
+  for (const auto& edge : hypergraph) {
+    auto& resultEdge = result.emplace_back();
+    resultEdge.reserve(edge.size());
+    for (const auto atom : edge) {
+      const auto insertion = vertexIndices.emplace(atom, *vertexCount);
+      if (insertion.second) ++*vertexCount;
+      resultEdge.push_back(insertion.first->second);
+    }
+  }
+  return result;
+}
+
+class UnificationSearch {
+ public:
+  UnificationSearch(const std::vector<std::vector<int64_t>>& first,
+                    const std::vector<std::vector<int64_t>>& second,
+                    const int64_t vertexCount,
+                    const std::function<void(const HypergraphUnification&)>& callback,
+                    const std::function<bool()>& shouldAbort)
+      : first_(first),
+        second_(second),
+        vertexCount_(vertexCount),
+        callback_(callback),
+        shouldAbort_(shouldAbort),
+        vertices_(vertexCount),
+        isSecondEdgeUsed_(second.size(), false) {}
+
+  // Enumerates all unifications starting with the given pair.
+  void searchFrom(const size_t firstEdge, const size_t secondEdge) {
+    pushPair(firstEdge, secondEdge);
+    popPair();
+  }
+
+ private:
+  const std::vector<std::vector<int64_t>>& first_;
+  const std::vector<std::vector<int64_t>>& second_;
+  const int64_t vertexCount_;
+  const std::function<void(const HypergraphUnification&)>& callback_;
+  const std::function<bool()>& shouldAbort_;
+
+  RollbackUnionFind vertices_;
+  std::vector<std::pair<size_t, size_t>> pairs_;
+  std::vector<bool> isSecondEdgeUsed_;
+  int64_t nodesUntilAbortCheck_ = 0;
+
+  void pushPair(const size_t firstEdge, const size_t secondEdge) {
+    if (--nodesUntilAbortCheck_ < 0) {
+      if (shouldAbort_()) throw HypergraphUnifications::Error::Aborted;
+      nodesUntilAbortCheck_ = abortCheckPeriod;
+    }
+
+    for (size_t i = 0; i < first_[firstEdge].size(); ++i) {
+      vertices_.unite(first_[firstEdge][i], second_[secondEdge][i]);
+    }
+    pairs_.emplace_back(firstEdge, secondEdge);
+    isSecondEdgeUsed_[secondEdge] = true;
+
+    callback_(unification());
+
+    // Only larger first edges can follow, so that each set of pairs is only visited once.
+    for (size_t nextFirstEdge = firstEdge + 1; nextFirstEdge < first_.size(); ++nextFirstEdge) {
+      for (size_t nextSecondEdge = 0; nextSecondEdge < second_.size(); ++nextSecondEdge) {
+        if (canPair(nextFirstEdge, nextSecondEdge)) {
+          pushPair(nextFirstEdge, nextSecondEdge);
+          popPair();
+        }
+      }
+    }
+  }
+
+  bool canPair(const size_t firstEdge, const size_t secondEdge) const {
+    return !isSecondEdgeUsed_[secondEdge] && first_[firstEdge].size() == second_[secondEdge].size();
+  }
+
+  void popPair() {
+    const auto [firstEdge, secondEdge] = pairs_.back();
+    pairs_.pop_back();
+    isSecondEdgeUsed_[secondEdge] = false;
+    for (size_t i = 0; i < first_[firstEdge].size(); ++i) {
+      vertices_.rollback();
+    }
+  }
+
+  HypergraphUnification unification() const {
+    HypergraphUnification result;
+    result.firstEdgeIndices.assign(first_.size(), -1);
+    result.secondEdgeIndices.assign(second_.size(), -1);
+    std::vector<Atom> rootAtoms(vertexCount_, 0);
+    Atom nextAtom = 1;
+    const auto addEdge = [this, &result, &rootAtoms, &nextAtom](const std::vector<int64_t>& edge) {
+      auto& atoms = result.hypergraph.emplace_back();
+      atoms.reserve(edge.size());
+      for (const auto vertex : edge) {
+        auto& atom = rootAtoms[vertices_.find(vertex)];
+        if (atom == 0) atom = nextAtom++;
+        atoms.push_back(atom);
+      }
+      return static_cast<int64_t>(result.hypergraph.size()) - 1;
+    };
+
+    for (const auto& pair : pairs_) {
+      result.firstEdgeIndices[pair.first] = -2;
+      result.secondEdgeIndices[pair.second] = -2;
+    }
+    result.hypergraph.reserve(first_.size() + second_.size() - pairs_.size());
+    for (size_t i = 0; i < first_.size(); ++i) {
+      if (result.firstEdgeIndices[i] == -1) result.firstEdgeIndices[i] = addEdge(first_[i]);
+    }
+    for (size_t i = 0; i < second_.size(); ++i) {
+      if (result.secondEdgeIndices[i] == -1) result.secondEdgeIndices[i] = addEdge(second_[i]);
+    }
+    for (const auto& pair : pairs_) {
+      result.firstEdgeIndices[pair.first] = result.secondEdgeIndices[pair.second] = addEdge(first_[pair.first]);
+    }
+    return result;
+  }
+};
+}  // namespace
+
+void HypergraphUnifications::enumerate(const std::vector<AtomsVector>& firstHypergraph,
+                                       const std::vector<AtomsVector>& secondHypergraph,
+                                       const std::function<void(const HypergraphUnification&)>& callback,
+                                       const std::function<bool()>& abortRequested) {
+  int64_t vertexCount = 0;
+  const auto first = toVertexIndices(firstHypergraph, &vertexCount);
+  const auto second = toVertexIndices(secondHypergraph, &vertexCount);
+
+  std::vector<std::pair<size_t, size_t>> firstPairs;
+  for (size_t firstEdge = 0; firstEdge < first.size(); ++firstEdge) {
+    for (size_t secondEdge = 0; secondEdge < second.size(); ++secondEdge) {
+      if (first[firstEdge].size() == second[secondEdge].size()) firstPairs.emplace_back(firstEdge, secondEdge);
+    }
+  }
+
+  // Only create threads if there is more than one first pair
+  const auto threadAcquisitionToken =
+      Parallelism::acquire(Parallelism::HardwareType::StdCpu, static_cast<int>(firstPairs.size()));
+  const int numThreadsToUse = threadAcquisitionToken->numThreads();
+  if (numThreadsToUse == 0) {
+    UnificationSearch search(first, second, vertexCount, callback, abortRequested);
+    for (const auto& pair : firstPairs) {
+      search.searchFrom(pair.first, pair.second);
+    }
+    return;
+  }
+
+  // Results of each subtree are buffered, so that they can be passed to the callback in the sequential order.
+  std::vector<std::vector<HypergraphUnification>> subtreeResults(firstPairs.size());
+  std::atomic<size_t> nextSubtree = 0;
+  std::atomic<bool> aborted = false;
+  const std::function<bool()> shouldAbort = [&aborted, &abortRequested]() {
+    if (aborted || abortRequested()) aborted = true;
+    return aborted.load();
+  };
+  const auto searchSubtrees = [&]() {
+    try {
+      for (size_t subtree = nextSubtree++; subtree < firstPairs.size(); subtree = nextSubtree++) {
+        auto& results = subtreeResults[subtree];
+        const std::function<void(const HypergraphUnification&)> collect =
+            [&results](const HypergraphUnification& unification) { results.push_back(unification); };
+        UnificationSearch search(first, second, vertexCount, collect, shouldAbort);
+        search.searchFrom(firstPairs[subtree].first, firstPairs[subtree].second);
+      }
+    } catch (Error) {
+      aborted = true;
+    }
+  };
+
+  std::vector<std::thread> threads(numThreadsToUse);
+  for (int i = 0; i < numThreadsToUse; ++i) {
+    threads[i] = std::thread(searchSubtrees);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (aborted) throw Error::Aborted;
+
+  for (const auto& results : subtreeResults) {
+    for (const auto& unification : results) {
+      callback(unification);
+    }
+  }
+}
+}  // namespace SetReplace
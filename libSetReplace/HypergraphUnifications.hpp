@@ -0,0 +1,52 @@
+#ifndef LIBSETREPLACE_HYPERGRAPHUNIFICATIONS_HPP_
+#define LIBSETREPLACE_HYPERGRAPHUNIFICATIONS_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "IDTypes.hpp"
+
+namespace SetReplace {
+/** @brief Hypergraph containing both of the given hypergraphs as subhypergraphs, with some of their hyperedges
+ * identified.
+ */
+struct HypergraphUnification {
+  /** @brief Unmatched edges of the first hypergraph, then unmatched edges of the second one, then the matched edges.
+   * @details Atoms are numbered starting from 1 in the order of their first appearance.
+   */
+  std::vector<AtomsVector> hypergraph;
+
+  /** @brief Index in the hypergraph for each edge of the first hypergraph.
+   */
+  std::vector<int64_t> firstEdgeIndices;
+
+  /** @brief Index in the hypergraph for each edge of the second hypergraph.
+   */
+  std::vector<int64_t> secondEdgeIndices;
+};
+
+/** @brief Enumerates the ways to overlap two hypergraphs, which is used to find critical pairs of rules.
+ * @details Each unification corresponds to a nonempty sequence of pairs of edges of equal arity (one from each
+ * hypergraph), in which the edges of the first hypergraph are increasing and the edges of the second one are distinct.
+ * Atoms at the same positions of the paired edges are identified, which is tracked with a union-find structure that
+ * is rolled back on backtracking. The atoms of the two hypergraphs are always distinct, even if they have the same IDs.
+ */
+class HypergraphUnifications {
+ public:
+  /** @brief Type of the error occurred during evaluation.
+   */
+  enum Error { None, Aborted };
+
+  /** @brief Calls the callback for each unification in the order of a depth-first search over the edge pairs.
+   * @details If threads are available, the subtrees starting with different first edge pairs are searched in parallel,
+   * but the callback is still called on this thread in the same order. Calls shouldAbort() frequently, and throws
+   * Error::Aborted if that returns true.
+   */
+  static void enumerate(const std::vector<AtomsVector>& firstHypergraph,
+                        const std::vector<AtomsVector>& secondHypergraph,
+                        const std::function<void(const HypergraphUnification&)>& callback,
+                        const std::function<bool()>& shouldAbort);
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_HYPERGRAPHUNIFICATIONS_HPP_
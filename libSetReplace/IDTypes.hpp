@@ -2,20 +2,44 @@
 #define LIBSETREPLACE_IDTYPES_HPP_
 
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <vector>
 
 namespace SetReplace {
+/** @brief Integer type of token, atom and event IDs, as well as generations.
+ * @details It is 32-bit if LIBSETREPLACE_COMPACT_IDS is defined (the SET_REPLACE_ENABLE_COMPACT_IDS CMake option),
+ * which halves the memory used by the index, matches and the causal graph, and 64-bit otherwise. Values coming from
+ * outside of the library (e.g., the atoms of the initial state) should be checked with fitsInID() before converting.
+ */
+#ifdef LIBSETREPLACE_COMPACT_IDS
+using IDInteger = int32_t;
+#else
+using IDInteger = int64_t;
+#endif
+
+constexpr bool compactIDs = sizeof(IDInteger) < sizeof(int64_t);
+
+/** @brief Yields true if value can be converted to ID without overflow, which is always the case unless compactIDs is
+ * true.
+ */
+template <typename ID>
+constexpr bool fitsInID(const int64_t value) {
+  return value >= static_cast<int64_t>(std::numeric_limits<ID>::min()) &&
+         value <= static_cast<int64_t>(std::numeric_limits<ID>::max());
+}
+
 /** @brief Identifiers for tokens, which are the elements of the multiset in the multiset system, and contain ordered
  * sequences of atoms, e.g., hyperedges in the hypergraph system.
  */
-using TokenID = int64_t;
+using TokenID = IDInteger;
 
 /** @brief Identifiers for atoms, which are the elements of tokens, e.g., vertices in the hypergraph in the hypergraph
  * system.
  * @details Positive IDs refer to specific atoms, negative IDs refer to patterns (as, for instance, can be used in the
  * rules).
  */
-using Atom = int64_t;
+using Atom = IDInteger;
 
 /** @brief List of atoms without references to events, as can be used in, e.g., rule specification. Corresponds to
  * contents of tokens in the hypergraph system.
@@ -33,15 +57,20 @@ constexpr RuleID initialConditionRule = -1;
 
 /** @brief Identifiers for substitution events, later events have larger IDs.
  */
-using EventID = int64_t;
+using EventID = IDInteger;
 constexpr EventID initialConditionEvent = 0;
 
 /** @brief Layer this token belongs to in the causal graph.
  * @details Specifically, if the largest generation of tokens in the event inputs is n, the generation of its
  * outputs will be n + 1.
  */
-using Generation = int64_t;
+using Generation = IDInteger;
 constexpr Generation initialGeneration = 0;
+
+/** @brief Identifiers for global states of the multiway system, in the order they were discovered.
+ */
+using StateID = int64_t;
+constexpr StateID initialState = 0;
 }  // namespace SetReplace
 
 #endif  // LIBSETREPLACE_IDTYPES_HPP_
@@ -0,0 +1,402 @@
+#include "MultiwayStateGraph.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <random>
+#include <scoped_allocator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Arena.hpp"
+#include "HypergraphMatcher.hpp"
+
+namespace SetReplace {
+namespace {
+// Finalizer of splitmix64, https://xorshift.di.unimi.it/splitmix64.c
+uint64_t mix(uint64_t value) {
+  value += 0x9e3779b97f4a7c15;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+  return value ^ (value >> 31);
+}
+
+uint64_t combine(const uint64_t seed, const uint64_t value) { return mix(seed ^ mix(value)); }
+}  // namespace
+
+class MultiwayStateGraph::Implementation {
+ private:
+  // Declared first, so that it outlives everything allocated from it.
+  Arena arena_;
+  const StateDeduplication stateDeduplication_;
+  const TokenEventGraph& tokenEventGraph_;
+  const GetAtomsVectorFunc getAtomsVector_;
+
+  // Everything here grows with the number of states, so it is allocated from the arena to be counted by memoryUsage().
+  template <typename T>
+  using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+  template <typename T>
+  using ArenaVectorList = std::vector<ArenaVector<T>, std::scoped_allocator_adaptor<ArenaAllocator<ArenaVector<T>>>>;
+  using StateIDs = ArenaVector<StateID>;
+  using StatesByHash =
+      std::unordered_map<uint64_t,
+                         StateIDs,
+                         std::hash<uint64_t>,
+                         std::equal_to<uint64_t>,
+                         std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const uint64_t, StateIDs>>>>;
+
+  // Tokens of each state, sorted by ID.
+  ArenaVectorList<TokenID> states_;
+  ArenaVector<uint64_t> stateHashes_;
+  StatesByHash statesByHash_;
+
+  ArenaVector<StateTransition> transitions_;
+  // Indices of transitions_ starting at each state. These are needed to apply past events to newly discovered states.
+  ArenaVectorList<size_t> outgoingTransitions_;
+
+  // Addressed as tokenStates_[tokenID] -> states containing the token, in the order of discovery.
+  ArenaVectorList<StateID> tokenStates_;
+
+  // Zobrist keys of tokens. The hash of a state is the sum of the keys of its tokens. Note, XOR is usually used to
+  // combine Zobrist keys, however, it would not work here because a state can contain the same atoms vector more than
+  // once, and these would cancel each other out.
+  ArenaVector<uint64_t> tokenKeys_;
+  std::mt19937_64 keyGenerator_;
+
+  // The initial state is hashed lazily because the atoms of the initial tokens might not be available yet at
+  // construction.
+  bool isInitialStateHashed_ = false;
+
+ public:
+  Implementation(const StateDeduplication stateDeduplication,
+                 const TokenEventGraph* tokenEventGraph,
+                 GetAtomsVectorFunc getAtomsVector)
+      : stateDeduplication_(stateDeduplication),
+        tokenEventGraph_(*tokenEventGraph),
+        getAtomsVector_(std::move(getAtomsVector)),
+        states_(ArenaAllocator<ArenaVector<TokenID>>(&arena_)),
+        stateHashes_(ArenaAllocator<uint64_t>(&arena_)),
+        statesByHash_(ArenaAllocator<StatesByHash::value_type>(&arena_)),
+        transitions_(ArenaAllocator<StateTransition>(&arena_)),
+        outgoingTransitions_(ArenaAllocator<ArenaVector<size_t>>(&arena_)),
+        tokenStates_(ArenaAllocator<ArenaVector<StateID>>(&arena_)),
+        tokenKeys_(ArenaAllocator<uint64_t>(&arena_)) {
+    if (stateDeduplication_ == StateDeduplication::Disabled) return;
+    const auto initialTokens = tokenEventGraph_.allTokenIDs();
+    tokenKeys_.resize(initialTokens.size());
+    tokenStates_.resize(initialTokens.size());
+    std::vector<TokenID> activatedTokens;
+    createState(initialTokens, 0, &activatedTokens);
+  }
+
+  std::vector<TokenID> addEvent(const EventID event) {
+    const auto outputTokens = tokenEventGraph_.events()[event].outputTokens;
+    if (stateDeduplication_ == StateDeduplication::Disabled) {
+      return std::vector<TokenID>(outputTokens.begin(), outputTokens.end());
+    }
+    if (!isInitialStateHashed_) hashInitialState();
+    registerTokens(outputTokens);
+
+    // States discovered while applying the event need all past events applied to them as well, so we keep a queue.
+    std::deque<std::pair<StateID, EventID>> statesAndEventsToApply;
+    for (const auto state : statesContainingTokens(tokenEventGraph_.events()[event].inputTokens)) {
+      statesAndEventsToApply.emplace_back(state, event);
+    }
+
+    std::vector<TokenID> activatedTokens;
+    while (!statesAndEventsToApply.empty()) {
+      const auto [state, eventToApply] = statesAndEventsToApply.front();
+      statesAndEventsToApply.pop_front();
+      applyEvent(state, eventToApply, &statesAndEventsToApply, &activatedTokens);
+    }
+    std::sort(activatedTokens.begin(), activatedTokens.end());
+    return activatedTokens;
+  }
+
+  bool isTokenReachable(const TokenID token) const {
+    return stateDeduplication_ == StateDeduplication::Disabled ||
+           (token < static_cast<TokenID>(tokenStates_.size()) && !tokenStates_[token].empty());
+  }
+
+  std::vector<std::vector<TokenID>> states() const {
+    std::vector<std::vector<TokenID>> result;
+    result.reserve(states_.size());
+    for (const auto& tokens : states_) result.emplace_back(tokens.begin(), tokens.end());
+    return result;
+  }
+
+  std::vector<StateTransition> transitions() const {
+    return std::vector<StateTransition>(transitions_.begin(), transitions_.end());
+  }
+
+  size_t memoryUsage() const { return arena_.reservedBytes(); }
+
+ private:
+  TokenIDsView stateTokens(const StateID state) const {
+    const auto& tokens = states_[state];
+    return TokenIDsView(tokens.data(), tokens.data() + tokens.size());
+  }
+
+  void hashInitialState() {
+    const auto initialTokens = stateTokens(initialState);
+    registerTokens(initialTokens);
+    statesByHash_.clear();
+    stateHashes_[initialState] = stateHash(initialTokens);
+    statesByHash_[stateHashes_[initialState]].push_back(initialState);
+    isInitialStateHashed_ = true;
+  }
+
+  void registerTokens(const TokenIDsView& tokens) {
+    for (const auto token : tokens) {
+      if (token >= static_cast<TokenID>(tokenKeys_.size())) {
+        tokenKeys_.resize(token + 1);
+        tokenStates_.resize(token + 1);
+      }
+      tokenKeys_[token] = tokenKey(token);
+    }
+  }
+
+  uint64_t tokenKey(const TokenID token) {
+    switch (stateDeduplication_) {
+      case StateDeduplication::SameTokens:
+        return keyGenerator_();
+
+      case StateDeduplication::SameAtomsVectors:
+        return atomsVectorKey(getAtomsVector_(token));
+
+      case StateDeduplication::IsomorphicAtomsVectors:
+        return atomsVectorShapeKey(getAtomsVector_(token));
+
+      default:
+        return 0;
+    }
+  }
+
+  static uint64_t atomsVectorKey(const AtomsVector& atoms) {
+    uint64_t result = mix(atoms.size());
+    for (const auto atom : atoms) {
+      result = combine(result, static_cast<uint64_t>(atom));
+    }
+    return result;
+  }
+
+  // Only depends on which positions of the token contain the same atoms, so it is invariant under renaming of atoms.
+  static uint64_t atomsVectorShapeKey(const AtomsVector& atoms) {
+    uint64_t result = mix(atoms.size());
+    for (const auto atom : atoms) {
+      const auto firstOccurrence = std::find(atoms.begin(), atoms.end(), atom) - atoms.begin();
+      result = combine(result, static_cast<uint64_t>(firstOccurrence));
+    }
+    return result;
+  }
+
+  // Atom degrees are also invariant under renaming, and they make hash collisions between non-isomorphic states much
+  // less frequent. The key for degree zero must be zero so that atoms that are not in the state do not contribute.
+  static uint64_t atomDegreeKey(const int64_t degree) {
+    constexpr uint64_t degreeSalt = 0x5bd1e9955bd1e995;
+    return degree == 0 ? 0 : mix(static_cast<uint64_t>(degree) ^ degreeSalt);
+  }
+
+  uint64_t stateHash(const TokenIDsView& tokens) const {
+    uint64_t result = 0;
+    for (const auto token : tokens) {
+      result += tokenKeys_[token];
+    }
+    if (stateDeduplication_ == StateDeduplication::IsomorphicAtomsVectors) {
+      for (const auto& atomAndDegree : atomDegrees(tokens)) {
+        result += atomDegreeKey(atomAndDegree.second);
+      }
+    }
+    return result;
+  }
+
+  std::unordered_map<Atom, int64_t> atomDegrees(const TokenIDsView& tokens) const {
+    std::unordered_map<Atom, int64_t> degrees;
+    for (const auto token : tokens) {
+      for (const auto atom : getAtomsVector_(token)) {
+        ++degrees[atom];
+      }
+    }
+    return degrees;
+  }
+
+  // Computes the hash of the state obtained from sourceState by replacing inputTokens with outputTokens in O(1) unless
+  // atom degrees are needed, in which case the source state is scanned once.
+  uint64_t successorStateHash(const StateID sourceState,
+                              const std::vector<TokenID>& inputTokens,
+                              const std::vector<TokenID>& outputTokens) const {
+    uint64_t result = stateHashes_[sourceState];
+    for (const auto token : inputTokens) result -= tokenKeys_[token];
+    for (const auto token : outputTokens) result += tokenKeys_[token];
+
+    if (stateDeduplication_ == StateDeduplication::IsomorphicAtomsVectors) {
+      std::unordered_map<Atom, int64_t> degreeDeltas;
+      for (const auto token : inputTokens) {
+        for (const auto atom : getAtomsVector_(token)) --degreeDeltas[atom];
+      }
+      for (const auto token : outputTokens) {
+        for (const auto atom : getAtomsVector_(token)) ++degreeDeltas[atom];
+      }
+
+      std::unordered_map<Atom, int64_t> sourceDegrees;
+      for (const auto& atomAndDelta : degreeDeltas) sourceDegrees[atomAndDelta.first] = 0;
+      for (const auto token : states_[sourceState]) {
+        for (const auto atom : getAtomsVector_(token)) {
+          const auto degreeIterator = sourceDegrees.find(atom);
+          if (degreeIterator != sourceDegrees.end()) ++degreeIterator->second;
+        }
+      }
+
+      for (const auto& atomAndDelta : degreeDeltas) {
+        const auto sourceDegree = sourceDegrees.at(atomAndDelta.first);
+        result += atomDegreeKey(sourceDegree + atomAndDelta.second) - atomDegreeKey(sourceDegree);
+      }
+    }
+    return result;
+  }
+
+  std::vector<StateID> statesContainingTokens(const TokenIDsView& tokens) const {
+    if (tokens.empty()) {
+      std::vector<StateID> allStates(states_.size());
+      for (StateID state = 0; state < static_cast<StateID>(states_.size()); ++state) allStates[state] = state;
+      return allStates;
+    }
+
+    // Only check states of the token that is in the fewest states.
+    const auto rarestToken = *std::min_element(tokens.begin(), tokens.end(), [this](const auto& a, const auto& b) {
+      return tokenStates_[a].size() < tokenStates_[b].size();
+    });
+    std::vector<StateID> result;
+    for (const auto state : tokenStates_[rarestToken]) {
+      const auto candidateTokens = stateTokens(state);
+      if (std::all_of(tokens.begin(), tokens.end(), [&candidateTokens](const TokenID token) {
+            return std::binary_search(candidateTokens.begin(), candidateTokens.end(), token);
+          })) {
+        result.push_back(state);
+      }
+    }
+    return result;
+  }
+
+  void applyEvent(const StateID sourceState,
+                  const EventID event,
+                  std::deque<std::pair<StateID, EventID>>* statesAndEventsToApply,
+                  std::vector<TokenID>* activatedTokens) {
+    const auto& inputTokens = tokenEventGraph_.events()[event].inputTokens;
+    const auto outputTokens = tokenEventGraph_.events()[event].outputTokens;
+    std::vector<TokenID> sortedInputTokens(inputTokens.begin(), inputTokens.end());
+    std::sort(sortedInputTokens.begin(), sortedInputTokens.end());
+    std::vector<TokenID> sortedOutputTokens(outputTokens.begin(), outputTokens.end());
+    std::sort(sortedOutputTokens.begin(), sortedOutputTokens.end());
+
+    std::vector<TokenID> remainingTokens;
+    const auto sourceTokens = stateTokens(sourceState);
+    std::set_difference(sourceTokens.begin(),
+                        sourceTokens.end(),
+                        sortedInputTokens.begin(),
+                        sortedInputTokens.end(),
+                        std::back_inserter(remainingTokens));
+    std::vector<TokenID> targetTokens;
+    targetTokens.reserve(remainingTokens.size() + sortedOutputTokens.size());
+    std::merge(remainingTokens.begin(),
+               remainingTokens.end(),
+               sortedOutputTokens.begin(),
+               sortedOutputTokens.end(),
+               std::back_inserter(targetTokens));
+
+    const auto targetHash = successorStateHash(sourceState, sortedInputTokens, sortedOutputTokens);
+    StateID targetState = findState(targetTokens, targetHash);
+    if (targetState == -1) {
+      targetState = createState(targetTokens, targetHash, activatedTokens);
+
+      // Events that happened before, and that do not conflict with the current one, can be applied to the new state as
+      // well. Other past events either need the tokens destroyed by the current one, or were not possible in
+      // sourceState in the first place.
+      for (const auto transitionIndex : outgoingTransitions_[sourceState]) {
+        const auto pastEvent = transitions_[transitionIndex].event;
+        const auto pastEventInputs = tokenEventGraph_.events()[pastEvent].inputTokens;
+        if (std::none_of(pastEventInputs.begin(), pastEventInputs.end(), [&sortedInputTokens](const TokenID token) {
+              return std::binary_search(sortedInputTokens.begin(), sortedInputTokens.end(), token);
+            })) {
+          statesAndEventsToApply->emplace_back(targetState, pastEvent);
+        }
+      }
+    }
+
+    outgoingTransitions_[sourceState].push_back(transitions_.size());
+    transitions_.push_back({sourceState, targetState, event});
+  }
+
+  // Returns -1 if there is no such state yet.
+  StateID findState(const std::vector<TokenID>& tokens, const uint64_t hash) const {
+    const auto candidatesIterator = statesByHash_.find(hash);
+    if (candidatesIterator == statesByHash_.end()) return -1;
+    for (const auto candidate : candidatesIterator->second) {
+      if (sameState(stateTokens(candidate), tokens)) return candidate;
+    }
+    return -1;
+  }
+
+  StateID createState(const std::vector<TokenID>& tokens,
+                      const uint64_t hash,
+                      std::vector<TokenID>* activatedTokens) {
+    const StateID state = static_cast<StateID>(states_.size());
+    for (const auto token : tokens) {
+      if (tokenStates_[token].empty()) activatedTokens->push_back(token);
+      tokenStates_[token].push_back(state);
+    }
+    states_.emplace_back(tokens.begin(), tokens.end());
+    stateHashes_.push_back(hash);
+    statesByHash_[hash].push_back(state);
+    outgoingTransitions_.emplace_back();
+    return state;
+  }
+
+  bool sameState(const TokenIDsView& first, const TokenIDsView& second) const {
+    if (first == second) return true;
+    if (first.size() != second.size() || stateDeduplication_ == StateDeduplication::SameTokens) return false;
+
+    const auto firstAtomsVectors = sortedAtomsVectors(first);
+    const auto secondAtomsVectors = sortedAtomsVectors(second);
+    if (firstAtomsVectors == secondAtomsVectors) return true;
+    if (stateDeduplication_ == StateDeduplication::SameAtomsVectors) return false;
+
+    if (atomDegrees(first).size() != atomDegrees(second).size()) return false;
+    // Turning all atoms of the first state into patterns makes the matcher check for the isomorphism.
+    auto firstPatterns = firstAtomsVectors;
+    for (auto& atoms : firstPatterns) {
+      for (auto& atom : atoms) atom = -atom;
+    }
+    // Note, we are already committed to the event at this point, so the check cannot be aborted.
+    return HypergraphMatcher::isomorphic(firstPatterns, secondAtomsVectors, []() { return false; });
+  }
+
+  std::vector<AtomsVector> sortedAtomsVectors(const TokenIDsView& tokens) const {
+    std::vector<AtomsVector> result;
+    result.reserve(tokens.size());
+    for (const auto token : tokens) {
+      result.push_back(getAtomsVector_(token));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+};
+
+MultiwayStateGraph::MultiwayStateGraph(const StateDeduplication stateDeduplication,
+                                       const TokenEventGraph* tokenEventGraph,
+                                       const GetAtomsVectorFunc& getAtomsVector)
+    : implementation_(std::make_shared<Implementation>(stateDeduplication, tokenEventGraph, getAtomsVector)) {}
+
+std::vector<TokenID> MultiwayStateGraph::addEvent(const EventID event) { return implementation_->addEvent(event); }
+
+bool MultiwayStateGraph::isTokenReachable(const TokenID token) const {
+  return implementation_->isTokenReachable(token);
+}
+
+std::vector<std::vector<TokenID>> MultiwayStateGraph::states() const { return implementation_->states(); }
+
+std::vector<StateTransition> MultiwayStateGraph::transitions() const { return implementation_->transitions(); }
+
+size_t MultiwayStateGraph::memoryUsage() const { return implementation_->memoryUsage(); }
+}  // namespace SetReplace
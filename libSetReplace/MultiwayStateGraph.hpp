@@ -0,0 +1,76 @@
+#ifndef LIBSETREPLACE_MULTIWAYSTATEGRAPH_HPP_
+#define LIBSETREPLACE_MULTIWAYSTATEGRAPH_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "IDTypes.hpp"
+#include "TokenEventGraph.hpp"
+
+namespace SetReplace {
+/** @brief Transition between two global states caused by a single event.
+ */
+struct StateTransition {
+  StateID source;
+  StateID target;
+  EventID event;
+};
+
+/** @brief MultiwayStateGraph enumerates the global states of a multihistory, and merges the states that are the same.
+ * @details A global state is a set of tokens obtained from the initial state by applying a sequence of events, each of
+ * which only uses the tokens of the previous state as inputs. The states are hashed incrementally (with Zobrist-style
+ * keys summed over the token multiset), so identifying a new state with a previously seen one is O(1) unless hashes
+ * collide.
+ */
+class MultiwayStateGraph {
+ public:
+  /** @brief Which states should be treated as the same vertex of the state graph.
+   */
+  enum class StateDeduplication {
+    Disabled = 0,                // states are not tracked at all
+    SameTokens = 1,              // states consisting of the same token IDs are merged (e.g., after commuting events)
+    SameAtomsVectors = 2,        // states with the same multisets of atoms vectors are merged
+    IsomorphicAtomsVectors = 3,  // states that are the same up to renaming of atoms are merged
+  };
+
+  /** @brief Creates a state graph containing only the initial state, which consists of all tokens currently present in
+   * tokenEventGraph.
+   * @param getAtomsVector datasource function that returns the list of atoms for a requested token.
+   */
+  MultiwayStateGraph(StateDeduplication stateDeduplication,
+                     const TokenEventGraph* tokenEventGraph,
+                     const GetAtomsVectorFunc& getAtomsVector);
+
+  /** @brief Applies a new event to all states containing its inputs, as well as to all states discovered as a result.
+   * @details The event must already be in tokenEventGraph, and its output tokens must be available through
+   * getAtomsVector.
+   * @return Tokens that appeared in a discovered state for the first time, i.e., the only tokens that need to be
+   * matched further. If the states are not tracked, returns the outputs of the event.
+   */
+  std::vector<TokenID> addEvent(EventID event);
+
+  /** @brief Whether the token belongs to at least one discovered state. Always true if the states are not tracked.
+   */
+  bool isTokenReachable(TokenID token) const;
+
+  /** @brief Token IDs of all discovered states (sorted within each state), in the order of discovery.
+   */
+  std::vector<std::vector<TokenID>> states() const;
+
+  /** @brief All transitions between the states, in the order they were discovered.
+   */
+  std::vector<StateTransition> transitions() const;
+
+  /** @brief Bytes of memory taken by the states, their hashes and transitions, and the per-token index of them.
+   * @details Everything is allocated from an arena, and counted by it, see Arena::reservedBytes().
+   */
+  size_t memoryUsage() const;
+
+ private:
+  class Implementation;
+  std::shared_ptr<Implementation> implementation_;
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_MULTIWAYSTATEGRAPH_HPP_
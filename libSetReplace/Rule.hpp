@@ -19,6 +19,9 @@ struct Rule {
   const std::vector<AtomsVector> inputs;
   const std::vector<AtomsVector> outputs;
   const EventSelectionFunction eventSelectionFunction;
+  /** @brief Relative weight of the rule, only used by HypergraphMatcher::OrderingFunction::RuleWeight.
+   */
+  const double weight = 1;
 };
 }  // namespace SetReplace
 
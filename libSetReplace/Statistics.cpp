@@ -0,0 +1,65 @@
+#include "Statistics.hpp"
+
+namespace SetReplace {
+Statistics& Statistics::operator+=(const Statistics& other) {
+  for (size_t i = 0; i < counters_.size(); ++i) {
+    counters_[i] += other.counters_[i];
+  }
+  for (size_t i = 0; i < timers_.size(); ++i) {
+    timers_[i] += other.timers_[i];
+  }
+  return *this;
+}
+
+const char* Statistics::name(const Counter counter) {
+  switch (counter) {
+    case Counter::MatchAttempts:
+      return "MatchAttempts";
+    case Counter::ArityPrunes:
+      return "ArityPrunes";
+    case Counter::BindingFailures:
+      return "BindingFailures";
+    case Counter::SeparationFailures:
+      return "SeparationFailures";
+    case Counter::CandidateSelections:
+      return "CandidateSelections";
+    case Counter::MatchesInserted:
+      return "MatchesInserted";
+    case Counter::DuplicateMatches:
+      return "DuplicateMatches";
+    case Counter::MatchesRemoved:
+      return "MatchesRemoved";
+    case Counter::DeduplicationComparisons:
+      return "DeduplicationComparisons";
+    case Counter::IndexLookups:
+      return "IndexLookups";
+    case Counter::IndexInsertions:
+      return "IndexInsertions";
+    case Counter::IndexRemovals:
+      return "IndexRemovals";
+    case Counter::CostEstimates:
+      return "CostEstimates";
+    case Counter::StaleMatchesSkipped:
+      return "StaleMatchesSkipped";
+    default:
+      return "Unknown";
+  }
+}
+
+const char* Statistics::name(const Timer timer) {
+  switch (timer) {
+    case Timer::CandidateSelection:
+      return "CandidateSelection";
+    case Timer::Deduplication:
+      return "Deduplication";
+    case Timer::MatchInsertion:
+      return "MatchInsertion";
+    case Timer::MatchRemoval:
+      return "MatchRemoval";
+    case Timer::IndexUpdate:
+      return "IndexUpdate";
+    default:
+      return "Unknown";
+  }
+}
+}  // namespace SetReplace
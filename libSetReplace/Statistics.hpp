@@ -0,0 +1,120 @@
+#ifndef LIBSETREPLACE_STATISTICS_HPP_
+#define LIBSETREPLACE_STATISTICS_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace SetReplace {
+/** @brief Counters and timers of the hot-path operations of HypergraphMatcher and HypergraphSubstitutionSystem, which
+ * are used to find where the time of a slow evolution goes.
+ * @details Statistics are only collected if the library is compiled with LIBSETREPLACE_STATISTICS defined (the
+ * SET_REPLACE_ENABLE_STATISTICS CMake option). Otherwise, all operations compile to nothing, and the values stay zero.
+ * Each thread accumulates into its own instance, and the instances are added together after the threads are joined,
+ * so no synchronization is needed.
+ */
+class Statistics {
+ public:
+  /** @brief Operations being counted.
+   *
+   * If adding additional values, add them before Count, and add their names to Statistics.cpp and
+   * setSubstitutionSystem$cpp.m.
+   */
+  enum class Counter {
+    MatchAttempts = 0,             // attempts to match a token to a rule input
+    ArityPrunes = 1,               // attempts rejected because the token and the input have different sizes
+    BindingFailures = 2,           // attempts rejected because the atoms are inconsistent with the partial match
+    SeparationFailures = 3,        // attempts rejected because the tokens are not spacelike separated
+    CandidateSelections = 4,       // searches for the next input to match and its candidate tokens
+    MatchesInserted = 5,           // complete matches added to the queue
+    DuplicateMatches = 6,          // complete matches already in the queue
+    MatchesRemoved = 7,            // matches deleted from the queue
+    DeduplicationComparisons = 8,  // isomorphism checks for event deduplication
+    IndexLookups = 9,              // lookups of tokens matching an input in AtomsIndex
+    IndexInsertions = 10,          // tokens added to AtomsIndex
+    IndexRemovals = 11,            // tokens removed from AtomsIndex
+    CostEstimates = 12,            // estimates of the number of tokens matching an input from AtomsIndex counts
+    StaleMatchesSkipped = 13,      // lazily removed matches reached while choosing the next match
+    Count = 14
+  };
+
+  /** @brief Operations being timed.
+   *
+   * If adding additional values, add them before Count, and add their names to Statistics.cpp and
+   * setSubstitutionSystem$cpp.m.
+   */
+  enum class Timer {
+    CandidateSelection = 0,  // summed over threads, so it can exceed the wall time
+    Deduplication = 1,
+    MatchInsertion = 2,
+    MatchRemoval = 3,
+    IndexUpdate = 4,
+    Count = 5
+  };
+
+#ifdef LIBSETREPLACE_STATISTICS
+  static constexpr bool enabled = true;
+#else
+  static constexpr bool enabled = false;
+#endif
+
+  /** @brief Measures the time from construction to destruction, and adds it to the specified timer.
+   */
+  class ScopedTimer {
+   public:
+    ScopedTimer(Statistics* statistics, const Timer timer) : statistics_(statistics), timer_(timer) {
+      if constexpr (enabled) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedTimer() {
+      if constexpr (enabled) statistics_->add(timer_, std::chrono::steady_clock::now() - start_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+   private:
+    Statistics* const statistics_;
+    const Timer timer_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  void increment(const Counter counter, const uint64_t amount = 1) {
+    if constexpr (enabled) counters_[static_cast<size_t>(counter)] += amount;
+  }
+
+  void add(const Timer timer, const std::chrono::steady_clock::duration duration) {
+    if constexpr (enabled) {
+      timers_[static_cast<size_t>(timer)] += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+  }
+
+  /** @brief Number of times the operation was done.
+   */
+  uint64_t count(const Counter counter) const { return counters_[static_cast<size_t>(counter)]; }
+
+  /** @brief Total time spent in the operation.
+   */
+  std::chrono::nanoseconds time(const Timer timer) const {
+    return std::chrono::nanoseconds(timers_[static_cast<size_t>(timer)]);
+  }
+
+  /** @brief Adds the values of another instance, typically the one accumulated by another thread.
+   */
+  Statistics& operator+=(const Statistics& other);
+
+  /** @brief Name of the counter, same as in the enum.
+   */
+  static const char* name(Counter counter);
+
+  /** @brief Name of the timer, same as in the enum.
+   */
+  static const char* name(Timer timer);
+
+ private:
+  std::array<uint64_t, static_cast<size_t>(Counter::Count)> counters_ = {};
+  std::array<int64_t, static_cast<size_t>(Timer::Count)> timers_ = {};
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_STATISTICS_HPP_
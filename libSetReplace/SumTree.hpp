@@ -0,0 +1,98 @@
+#ifndef LIBSETREPLACE_SUMTREE_HPP_
+#define LIBSETREPLACE_SUMTREE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace SetReplace {
+/** @brief Nonnegative weights of a sequence of items, from which an item can be chosen with probability proportional to
+ * its weight.
+ * @details The weights are the leaves of an implicit binary tree, in which each node is the sum of its children, so
+ * changing a weight and finding the item at a point of the cumulative distribution both take O(log n). Sums are
+ * recomputed from the children instead of being adjusted by differences, so rounding errors do not accumulate however
+ * many times the weights change.
+ */
+template <typename Allocator = std::allocator<double>>
+class SumTree {
+ public:
+  using allocator_type = Allocator;
+
+  explicit SumTree(const Allocator& allocator = Allocator()) : nodes_(allocator) {}
+
+  /** @brief Number of items.
+   */
+  size_t size() const { return size_; }
+
+  /** @brief Sum of all weights.
+   */
+  double total() const { return nodes_.empty() ? 0 : nodes_[1]; }
+
+  /** @brief Weight of the item at index.
+   */
+  double weight(const size_t index) const { return nodes_[leafCount() + index]; }
+
+  /** @brief Adds an item at the end, amortized O(log n).
+   */
+  void push_back(const double weight) {
+    if (size_ == leafCount()) grow();
+    ++size_;
+    set(size_ - 1, weight);
+  }
+
+  /** @brief Removes the last item.
+   */
+  void pop_back() {
+    set(size_ - 1, 0);
+    --size_;
+  }
+
+  /** @brief Changes the weight of the item at index.
+   */
+  void set(const size_t index, const double weight) {
+    size_t node = leafCount() + index;
+    nodes_[node] = weight;
+    for (node /= 2; node > 0; node /= 2) {
+      nodes_[node] = nodes_[2 * node] + nodes_[2 * node + 1];
+    }
+  }
+
+  /** @brief Yields the index of the item, in which the cumulative weight reaches point.
+   * @details That is, the sum of the weights of the preceding items is at most point, and the sum including the item
+   * is greater. point should be in [0, total()), and total() should be positive. Items with zero weight are never
+   * returned, even if point is not smaller than total() due to rounding.
+   */
+  size_t find(double point) const {
+    size_t node = 1;
+    while (node < leafCount()) {
+      node *= 2;
+      if (point >= nodes_[node] && nodes_[node + 1] > 0) {
+        point -= nodes_[node];
+        ++node;
+      }
+    }
+    return node - leafCount();
+  }
+
+ private:
+  // Leaves are stored at [leafCount(), 2 * leafCount()), and the children of node i at 2 * i and 2 * i + 1.
+  size_t leafCount() const { return nodes_.size() / 2; }
+
+  void grow() {
+    const size_t oldLeafCount = leafCount();
+    const size_t newLeafCount = std::max<size_t>(2 * oldLeafCount, 1);
+    std::vector<double, Allocator> nodes(2 * newLeafCount, 0., nodes_.get_allocator());
+    std::copy(nodes_.begin() + oldLeafCount, nodes_.begin() + oldLeafCount + size_, nodes.begin() + newLeafCount);
+    for (size_t node = newLeafCount - 1; node > 0; --node) {
+      nodes[node] = nodes[2 * node] + nodes[2 * node + 1];
+    }
+    nodes_.swap(nodes);
+  }
+
+  std::vector<double, Allocator> nodes_;
+  size_t size_ = 0;
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_SUMTREE_HPP_
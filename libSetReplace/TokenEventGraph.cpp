@@ -1,16 +1,26 @@
 #include "TokenEventGraph.hpp"
 
 #include <algorithm>
+#include <iterator>
 #include <memory>
+#include <scoped_allocator>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "Arena.hpp"
+
 namespace SetReplace {
 class TokenEventGraph::Implementation {
+  // Declared first, so that they outlive everything allocated from them. The history and the separation tracking data
+  // are kept apart so that their memory usage can be reported separately.
+  Arena arena_;
+  Arena historyArena_;
+
   // the first event is the "fake" initialization event
-  std::vector<Event> events_;
-  std::vector<EventID> tokenIDsToCreatorEvents_;
-  std::vector<uint64_t> tokenIDsToDestroyerEventsCount_;
+  EventsStorage events_;
+  EventsStorage::Array<EventID> tokenIDsToCreatorEvents_;
+  EventsStorage::Array<uint64_t> tokenIDsToDestroyerEventsCount_;
 
   // needed to return the largest generation in O(1)
   Generation largestGeneration_ = 0;
@@ -21,14 +31,44 @@ class TokenEventGraph::Implementation {
   // Addressed as destroyerChoices[eventID][tokenID] -> eventID.
   // For each event E, tells one which events need to be chosen as destroyers for each of the tokens in order to make E
   // possible. If there is no value for a given token, it means any destroyer can be chosen.
-  std::vector<std::unordered_map<TokenID, EventID>> destroyerChoices_;
+  // With SeparationTrackingMethod::DestroyerChoiceSets, an event merging branches can allow several destroyers of a
+  // token. Such a choice is stored as a negative ID, -(n + 1) refers to destroyerSets_[n], while positive IDs are
+  // single events (the initial event never destroys anything).
+  // These take a hash table per event, so they are allocated from the arena, and released in bulk instead of being
+  // destroyed.
+  using DestroyerChoices = std::unordered_map<TokenID,
+                                              EventID,
+                                              std::hash<TokenID>,
+                                              std::equal_to<TokenID>,
+                                              ArenaAllocator<std::pair<const TokenID, EventID>>>;
+  using DestroyerChoicesList =
+      std::vector<DestroyerChoices, std::scoped_allocator_adaptor<ArenaAllocator<DestroyerChoices>>>;
+  DestroyerChoicesList& destroyerChoices_;
+
+  // Sorted sets of destroyer events referred to by negative choices in destroyerChoices_.
+  using DestroyerSet = std::vector<EventID, ArenaAllocator<EventID>>;
+  using DestroyerSetList = std::vector<DestroyerSet, std::scoped_allocator_adaptor<ArenaAllocator<DestroyerSet>>>;
+  DestroyerSetList& destroyerSets_;
 
   // If false, destroyerChoices is meaningless, and not computed.
   bool isSpacelikeEvolution_ = true;
 
+  // If false, only the generations of events are kept, see discardHistory().
+  bool keepsHistory_ = true;
+
  public:
-  explicit Implementation(const int initialTokenCount, const SeparationTrackingMethod separationTrackingMethod)
-      : separationTrackingMethod_(separationTrackingMethod) {
+  Implementation(const int initialTokenCount,
+                 const SeparationTrackingMethod separationTrackingMethod,
+                 const bool useHugePages)
+      : arena_(useHugePages),
+        events_(&historyArena_),
+        tokenIDsToCreatorEvents_(ArenaAllocator<EventID>(&historyArena_)),
+        tokenIDsToDestroyerEventsCount_(ArenaAllocator<uint64_t>(&historyArena_)),
+        separationTrackingMethod_(separationTrackingMethod),
+        destroyerChoices_(arena_.make<DestroyerChoicesList>(
+            DestroyerChoicesList::allocator_type(ArenaAllocator<DestroyerChoices>(&arena_)))),
+        destroyerSets_(
+            arena_.make<DestroyerSetList>(DestroyerSetList::allocator_type(ArenaAllocator<DestroyerSet>(&arena_)))) {
     addEvent(initialConditionRule, {}, initialTokenCount);
   }
 
@@ -36,31 +76,51 @@ class TokenEventGraph::Implementation {
                                 const std::vector<TokenID>& initialTokens,
                                 const int outputTokenCount) {
     incrementDestroyerEventsCount(initialTokens);
-    const auto newTokens = createTokens(events_.size(), outputTokenCount);
+    const auto newTokens = createTokens(events_.generations.size(), outputTokenCount);
     const Generation generation = newEventGeneration(initialTokens);
-    events_.push_back({ruleID, initialTokens, newTokens, generation});
+    events_.generations.push_back(generation);
+    if (keepsHistory_) {
+      events_.rules.push_back(ruleID);
+      events_.inputTokens.insert(events_.inputTokens.end(), initialTokens.begin(), initialTokens.end());
+      events_.inputOffsets.push_back(events_.inputTokens.size());
+      events_.outputTokens.insert(events_.outputTokens.end(), newTokens.begin(), newTokens.end());
+      events_.outputOffsets.push_back(events_.outputTokens.size());
+    }
     largestGeneration_ = std::max(largestGeneration_, generation);
-    if (separationTrackingMethod_ == SeparationTrackingMethod::DestroyerChoices) addLastEventDestroyerChoices();
+    if (separationTrackingMethod_ != SeparationTrackingMethod::None) addLastEventDestroyerChoices();
     return newTokens;
   }
 
-  const std::vector<Event>& events() const { return events_; }
+  EventsView events() const { return EventsView(&events_); }
+
+  size_t eventsCount() const { return events_.generations.size() - 1; }
+
+  Generation eventGeneration(const EventID id) const { return events_.generations[id]; }
+
+  void discardHistory() {
+    keepsHistory_ = false;
+    release(&events_.rules);
+    release(&events_.inputOffsets);
+    release(&events_.inputTokens);
+    release(&events_.outputOffsets);
+    release(&events_.outputTokens);
+  }
 
-  size_t eventsCount() const { return events_.size() - 1; }
+  bool keepsHistory() const { return keepsHistory_; }
 
   std::vector<TokenID> allTokenIDs() const { return idsRange(0, tokenIDsToCreatorEvents_.size()); }
 
   size_t tokenCount() const { return tokenIDsToCreatorEvents_.size(); }
 
-  Generation tokenGeneration(const TokenID id) const { return events_[tokenIDsToCreatorEvents_[id]].generation; }
+  Generation tokenGeneration(const TokenID id) const { return events_.generations[tokenIDsToCreatorEvents_[id]]; }
 
   Generation largestGeneration() const { return largestGeneration_; }
 
   SeparationType tokenSeparation(const TokenID first, const TokenID second) const {
     if (!isSpacelikeEvolution_ || separationTrackingMethod_ == SeparationTrackingMethod::None) {
-      // This approach does not work with branchlike or timelike rules.
+      // DestroyerChoices does not work with branchlike or timelike rules.
       // For example, if a branchlike rule merges two branches and generates multiple tokens, this approach will not be
-      // able to determine that the output tokens are spacelike separated.
+      // able to determine that the output tokens are spacelike separated. DestroyerChoiceSets is used in that case.
       return SeparationType::Unknown;
     } else if (first == second) {
       return SeparationType::Identical;
@@ -74,12 +134,12 @@ class TokenEventGraph::Implementation {
       return SeparationType::Timelike;
     }
 
-    for (const auto& firstTokenAndChosenEvent : firstDestroyerChoices) {
-      const auto& token = firstTokenAndChosenEvent.first;
-      const auto& chosenEvent = firstTokenAndChosenEvent.second;
-      if (secondDestroyerChoices.count(token) && secondDestroyerChoices.at(token) != chosenEvent) {
-        // Both `first` and `second` tokens require a particular destroyer event to be chosen for `token` to exist.
-        // However, these destroyer events have to be different (`chosenEvent` and `secondDestroyerChoices.at(token)`).
+    for (const auto& firstTokenAndChoice : firstDestroyerChoices) {
+      const auto secondChoice = secondDestroyerChoices.find(firstTokenAndChoice.first);
+      if (secondChoice != secondDestroyerChoices.end() &&
+          !haveCommonDestroyer(firstTokenAndChoice.second, secondChoice->second)) {
+        // Both `first` and `second` tokens require a particular destroyer event to be chosen for the same token to
+        // exist. However, none of the destroyer events allowed for `first` is allowed for `second`.
         // So, the tokens are on different multihistory branches.
         return SeparationType::Branchlike;
       }
@@ -90,7 +150,17 @@ class TokenEventGraph::Implementation {
 
   uint64_t destroyerEventsCount(const TokenID id) { return tokenIDsToDestroyerEventsCount_[id]; }
 
+  size_t historyMemoryUsage() const { return historyArena_.reservedBytes(); }
+
+  size_t separationMemoryUsage() const { return arena_.reservedBytes(); }
+
  private:
+  // Swapping with an empty array returns the memory to the arena, unlike clear().
+  template <typename T>
+  static void release(EventsStorage::Array<T>* array) {
+    EventsStorage::Array<T>(array->get_allocator()).swap(*array);
+  }
+
   std::vector<TokenID> createTokens(const EventID creatorEvent, const int count) {
     const size_t beginIndex = tokenIDsToCreatorEvents_.size();
     tokenIDsToCreatorEvents_.insert(tokenIDsToCreatorEvents_.end(), count, creatorEvent);
@@ -116,41 +186,104 @@ class TokenEventGraph::Implementation {
   Generation newEventGeneration(const std::vector<TokenID>& inputTokens) const {
     Generation newEventGeneration = 0;
     for (const auto& inputToken : inputTokens) {
-      newEventGeneration = std::max(newEventGeneration, events_[tokenIDsToCreatorEvents_[inputToken]].generation + 1);
+      newEventGeneration = std::max(newEventGeneration, events_.generations[tokenIDsToCreatorEvents_[inputToken]] + 1);
     }
     return newEventGeneration;
   }
 
   // append prerequisites of the most recently added event to destroyerChoices_
   void addLastEventDestroyerChoices() {
-    if (!isSpacelikeEvolution_) return;  // only spacelike evolutions are supported at the moment
-    const auto& lastEvent = events_.back();
-    std::unordered_map<TokenID, EventID> newDestroyerChoices;
+    if (!isSpacelikeEvolution_) return;  // only spacelike evolutions are supported by DestroyerChoices
+    const EventID lastEvent = static_cast<EventID>(eventsCount());
+    const auto lastEventInputs = events()[lastEvent].inputTokens;
+    DestroyerChoices newDestroyerChoices{ArenaAllocator<DestroyerChoices::value_type>(&arena_)};
+    // All differing choices for the tokens on which the prerequisites disagree, these are rare.
+    std::unordered_map<TokenID, std::vector<EventID>> inconsistentChoices;
+
+    const auto addChoice = [&newDestroyerChoices, &inconsistentChoices](const TokenID token, const EventID choice) {
+      const auto tokenAndChoice = newDestroyerChoices.emplace(token, choice);
+      if (tokenAndChoice.second || tokenAndChoice.first->second == choice) return;
+      auto& choices = inconsistentChoices[token];
+      if (choices.empty()) choices.push_back(tokenAndChoice.first->second);
+      choices.push_back(choice);
+    };
 
     // For lastEvent to exist, its direct prerequisites have to exist as well. So, merge the destroyer choices from
     // creator events of all inputs to the lastEvent.
-    for (const auto& inputToken : lastEvent.inputTokens) {
+    for (const auto& inputToken : lastEventInputs) {
       // the input token itself needs to be destroyed by `lastEvent`.
-      newDestroyerChoices[inputToken] = events_.size() - 1;
+      addChoice(inputToken, lastEvent);
       const auto& inputEvent = tokenIDsToCreatorEvents_.at(inputToken);
-      for (const auto& inputEventTokenAndChosenEvent : destroyerChoices_.at(inputEvent)) {
-        const auto& token = inputEventTokenAndChosenEvent.first;
-        const auto& chosenEvent = inputEventTokenAndChosenEvent.second;
-        if (newDestroyerChoices.count(token) && newDestroyerChoices.at(token) != chosenEvent) {
-          // the prerequisite events for the `lastEvent` have inconsistent requirements. The lastEvent is not spacelike.
-          isSpacelikeEvolution_ = false;
-          destroyerChoices_.clear();
-          return;
-        }
-        newDestroyerChoices[token] = chosenEvent;
+      for (const auto& inputEventTokenAndChoice : destroyerChoices_.at(inputEvent)) {
+        addChoice(inputEventTokenAndChoice.first, inputEventTokenAndChoice.second);
+      }
+    }
+
+    if (!inconsistentChoices.empty()) {
+      if (separationTrackingMethod_ == SeparationTrackingMethod::DestroyerChoices) {
+        // the prerequisite events for the `lastEvent` have inconsistent requirements. The lastEvent is not spacelike.
+        isSpacelikeEvolution_ = false;
+        destroyerChoices_.clear();
+        return;
+      }
+      for (const auto& tokenAndChoices : inconsistentChoices) {
+        newDestroyerChoices[tokenAndChoices.first] = mergedChoice(tokenAndChoices.second);
+      }
+    }
+    destroyerChoices_.emplace_back(std::move(newDestroyerChoices));
+  }
+
+  // Sorted destroyer events allowed by a choice, a single event is its own range.
+  std::pair<const EventID*, const EventID*> destroyerRange(const EventID& choice) const {
+    if (choice > 0) return {&choice, &choice + 1};
+    const auto& destroyerSet = destroyerSets_[static_cast<size_t>(-choice - 1)];
+    return {destroyerSet.data(), destroyerSet.data() + destroyerSet.size()};
+  }
+
+  bool haveCommonDestroyer(const EventID& first, const EventID& second) const {
+    if (first == second) return true;
+    auto firstRange = destroyerRange(first);
+    auto secondRange = destroyerRange(second);
+    while (firstRange.first != firstRange.second && secondRange.first != secondRange.second) {
+      if (*firstRange.first == *secondRange.first) return true;
+      if (*firstRange.first < *secondRange.first) {
+        ++firstRange.first;
+      } else {
+        ++secondRange.first;
       }
     }
-    destroyerChoices_.emplace_back(newDestroyerChoices);
+    return false;
+  }
+
+  // Combines the choices for a token required by different prerequisites of an event. If some destroyers are allowed by
+  // all of them, these are the only ones possible. Otherwise, the event merges branches, each of which has its own
+  // destroyer, so any of them is allowed.
+  EventID mergedChoice(const std::vector<EventID>& choices) {
+    const auto firstRange = destroyerRange(choices.front());
+    std::vector<EventID> commonDestroyers(firstRange.first, firstRange.second);
+    std::vector<EventID> allDestroyers = commonDestroyers;
+    std::vector<EventID> result;  // reused for both set operations
+    for (size_t i = 1; i < choices.size(); ++i) {
+      const auto range = destroyerRange(choices[i]);
+      result.clear();
+      std::set_intersection(
+          commonDestroyers.begin(), commonDestroyers.end(), range.first, range.second, std::back_inserter(result));
+      commonDestroyers.swap(result);
+      result.clear();
+      std::set_union(allDestroyers.begin(), allDestroyers.end(), range.first, range.second, std::back_inserter(result));
+      allDestroyers.swap(result);
+    }
+    const auto& destroyers = commonDestroyers.empty() ? allDestroyers : commonDestroyers;
+    if (destroyers.size() == 1) return destroyers.front();
+    destroyerSets_.emplace_back(destroyers.begin(), destroyers.end());
+    return -static_cast<EventID>(destroyerSets_.size());
   }
 };
 
-TokenEventGraph::TokenEventGraph(const int initialTokenCount, const SeparationTrackingMethod separationTrackingMethod)
-    : implementation_(std::make_shared<Implementation>(initialTokenCount, separationTrackingMethod)) {}
+TokenEventGraph::TokenEventGraph(const int initialTokenCount,
+                                 const SeparationTrackingMethod separationTrackingMethod,
+                                 const bool useHugePages)
+    : implementation_(std::make_shared<Implementation>(initialTokenCount, separationTrackingMethod, useHugePages)) {}
 
 std::vector<TokenID> TokenEventGraph::addEvent(const RuleID ruleID,
                                                const std::vector<TokenID>& inputTokens,
@@ -158,10 +291,16 @@ std::vector<TokenID> TokenEventGraph::addEvent(const RuleID ruleID,
   return implementation_->addEvent(ruleID, inputTokens, outputTokenCount);
 }
 
-const std::vector<Event>& TokenEventGraph::events() const { return implementation_->events(); }
+EventsView TokenEventGraph::events() const { return implementation_->events(); }
 
 size_t TokenEventGraph::eventsCount() const { return implementation_->eventsCount(); }
 
+Generation TokenEventGraph::eventGeneration(const EventID id) const { return implementation_->eventGeneration(id); }
+
+void TokenEventGraph::discardHistory() { implementation_->discardHistory(); }
+
+bool TokenEventGraph::keepsHistory() const { return implementation_->keepsHistory(); }
+
 std::vector<TokenID> TokenEventGraph::allTokenIDs() const { return implementation_->allTokenIDs(); }
 
 size_t TokenEventGraph::tokenCount() const { return implementation_->tokenCount(); }
@@ -177,4 +316,8 @@ SeparationType TokenEventGraph::tokenSeparation(const TokenID first, const Token
 uint64_t TokenEventGraph::destroyerEventsCount(const TokenID id) const {
   return implementation_->destroyerEventsCount(id);
 }
+
+size_t TokenEventGraph::historyMemoryUsage() const { return implementation_->historyMemoryUsage(); }
+
+size_t TokenEventGraph::separationMemoryUsage() const { return implementation_->separationMemoryUsage(); }
 }  // namespace SetReplace
@@ -1,9 +1,11 @@
 #ifndef LIBSETREPLACE_TOKENEVENTGRAPH_HPP_
 #define LIBSETREPLACE_TOKENEVENTGRAPH_HPP_
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
+#include "Arena.hpp"
 #include "AtomsIndex.hpp"
 #include "IDTypes.hpp"
 
@@ -18,11 +20,49 @@ struct Match {
   /** @brief Tokens matching the rule inputs.
    */
   std::vector<TokenID> inputTokens;
+
+  /** @brief Largest and smallest generations of the input tokens, used for ordering. Not part of the match identity.
+   * @details The generation of the event outputs (i.e., its causal depth) is maxInputGeneration + 1.
+   */
+  Generation maxInputGeneration = initialGeneration;
+  Generation minInputGeneration = initialGeneration;
 };
 
 using MatchPtr = std::shared_ptr<const Match>;
 
+/** @brief Read-only view of a contiguous list of token IDs, such as the inputs or outputs of an event.
+ * @details Does not own the IDs. The views returned by TokenEventGraph are invalidated once new events are added.
+ */
+class TokenIDsView {
+ public:
+  using value_type = TokenID;
+  using iterator = const TokenID*;
+  using const_iterator = const TokenID*;
+
+  TokenIDsView(const TokenID* begin, const TokenID* end) : begin_(begin), end_(end) {}
+
+  // NOLINTNEXTLINE(runtime/explicit): vectors are implicitly viewable, same as with std::span
+  TokenIDsView(const std::vector<TokenID>& tokens) : begin_(tokens.data()), end_(tokens.data() + tokens.size()) {}
+
+  const_iterator begin() const { return begin_; }
+  const_iterator end() const { return end_; }
+  size_t size() const { return static_cast<size_t>(end_ - begin_); }
+  bool empty() const { return begin_ == end_; }
+  const TokenID& operator[](const size_t index) const { return begin_[index]; }
+
+ private:
+  const TokenID* begin_;
+  const TokenID* end_;
+};
+
+inline bool operator==(const TokenIDsView& first, const TokenIDsView& second) {
+  return std::equal(first.begin(), first.end(), second.begin(), second.end());
+}
+
+inline bool operator!=(const TokenIDsView& first, const TokenIDsView& second) { return !(first == second); }
+
 /** @brief Event is an instantiated replacement that has taken place in the system.
+ * @details Events are not stored as such. Instead, these are lightweight views into the EventsStorage arrays.
  */
 struct Event {
   /** @brief ID for the rule this event corresponds to.
@@ -31,17 +71,90 @@ struct Event {
 
   /** @brief Tokens matching the rule inputs.
    */
-  const std::vector<TokenID> inputTokens;
+  const TokenIDsView inputTokens;
 
   /** @brief Tokens created from the rule outputs.
    */
-  const std::vector<TokenID> outputTokens;
+  const TokenIDsView outputTokens;
 
   /** @brief Layer of the causal graph this event belongs to.
    */
   const Generation generation;
 };
 
+/** @brief Events stored as a struct of arrays, without per-event allocations.
+ * @details Inputs (outputs) of the event n are inputTokens[inputOffsets[n]] to inputTokens[inputOffsets[n + 1] - 1],
+ * so the offsets have one more element than the number of events. The arrays are allocated from an arena, so that
+ * their memory is counted by it.
+ */
+struct EventsStorage {
+  template <typename T>
+  using Array = std::vector<T, ArenaAllocator<T>>;
+
+  explicit EventsStorage(Arena* arena)
+      : rules(ArenaAllocator<RuleID>(arena)),
+        generations(ArenaAllocator<Generation>(arena)),
+        inputOffsets(1, 0, ArenaAllocator<size_t>(arena)),
+        inputTokens(ArenaAllocator<TokenID>(arena)),
+        outputOffsets(1, 0, ArenaAllocator<size_t>(arena)),
+        outputTokens(ArenaAllocator<TokenID>(arena)) {}
+
+  Array<RuleID> rules;
+  Array<Generation> generations;
+  Array<size_t> inputOffsets;
+  Array<TokenID> inputTokens;
+  Array<size_t> outputOffsets;
+  Array<TokenID> outputTokens;
+};
+
+/** @brief Read-only random-access view of all events, which is cheap to copy.
+ * @details Remains valid as long as the TokenEventGraph it was obtained from, however, the Events and TokenIDsViews
+ * returned by it are invalidated once new events are added.
+ */
+class EventsView {
+ public:
+  /** @brief Iterator over the events, which refers to the storage rather than the view, so it can outlive the view.
+   */
+  class Iterator {
+   public:
+    Iterator(const EventsStorage* storage, const EventID event) : storage_(storage), event_(event) {}
+    Event operator*() const { return EventsView(storage_)[event_]; }
+    Iterator& operator++() {
+      ++event_;
+      return *this;
+    }
+    bool operator==(const Iterator& other) const { return storage_ == other.storage_ && event_ == other.event_; }
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+   private:
+    const EventsStorage* storage_;
+    EventID event_;
+  };
+
+  explicit EventsView(const EventsStorage* storage) : storage_(storage) {}
+
+  size_t size() const { return storage_->rules.size(); }
+
+  Event operator[](const EventID event) const {
+    return {storage_->rules[event],
+            {storage_->inputTokens.data() + storage_->inputOffsets[event],
+             storage_->inputTokens.data() + storage_->inputOffsets[event + 1]},
+            {storage_->outputTokens.data() + storage_->outputOffsets[event],
+             storage_->outputTokens.data() + storage_->outputOffsets[event + 1]},
+            storage_->generations[event]};
+  }
+
+  Iterator begin() const { return Iterator(storage_, 0); }
+  Iterator end() const { return Iterator(storage_, static_cast<EventID>(size())); }
+
+  /** @brief Underlying arrays, which can be copied in bulk.
+   */
+  const EventsStorage& storage() const { return *storage_; }
+
+ private:
+  const EventsStorage* storage_;
+};
+
 /** @brief Type of separation between tokens.
  */
 enum class SeparationType {
@@ -54,6 +167,8 @@ enum class SeparationType {
 
 using GetTokenSeparationFunc = std::function<SeparationType(const TokenID&, const TokenID&)>;
 
+using GetTokenGenerationFunc = std::function<Generation(const TokenID&)>;
+
 /** @brief TokenEventGraph keeps track of causal relationships between events and tokens.
  @details It does not care and does not know about atoms at all because they are only used for matching. Tokens are
  only identified by IDs.
@@ -63,30 +178,50 @@ class TokenEventGraph {
   /** @brief Whether and what kind of separation (timelike, spacelike, branchlike) between tokens should be
    tracked.
    @details This tracking is in general expensive, so it should be disabled if not needed. It is however much faster to
-   precompute it during evolution than compute it on demand. Only supported for spacelike systems.
+   precompute it during evolution than compute it on demand.
+
+   DestroyerChoices only supports spacelike systems, and the separation becomes Unknown once an event merges branches
+   (i.e., has branchlike separated inputs). DestroyerChoiceSets keeps tracking it past such events, in which case the
+   merged event allows any of the destroyers chosen by either branch. The results are the same for spacelike systems.
    */
   enum class SeparationTrackingMethod {
-    None,             // lookup impossible
-    DestroyerChoices  // O(events * tokens) in memory and time, O(tokens) lookup
+    None,                // lookup impossible
+    DestroyerChoices,    // O(events * tokens) in memory and time, O(tokens) lookup
+    DestroyerChoiceSets  // same, plus O(destroyers) per token merged by an event
   };
 
   /** @brief Creates a new TokenEventGraph with a given number of initial tokens.
+   @param useHugePages whether to back the separation tracking data with transparent huge pages, see Arena.
    */
-  explicit TokenEventGraph(int initialTokenCount, SeparationTrackingMethod separationTrackingMethod);
+  TokenEventGraph(int initialTokenCount, SeparationTrackingMethod separationTrackingMethod, bool useHugePages = false);
 
   /** @brief Adds a new event, names its output tokens, and returns their IDs.
    */
   std::vector<TokenID> addEvent(RuleID ruleID, const std::vector<TokenID>& inputTokens, int outputTokenCount);
 
-  /** @brief Yields a vector of all events throughout history.
+  /** @brief Yields a view of all events throughout history.
    @details This includes the initial event, so the size of the result is one larger than eventsCount().
    */
-  const std::vector<Event>& events() const;
+  EventsView events() const;
 
   /** @brief Total number of events.
    */
   size_t eventsCount() const;
 
+  /** @brief Generation of a given event, which is available even if the history is discarded.
+   */
+  Generation eventGeneration(EventID id) const;
+
+  /** @brief Releases the rules, inputs and outputs of all events, and stops recording them for new events.
+   * @details Afterwards, events() is empty, but the generations and destroyer event counts of tokens are still
+   * available. Only supported if SeparationTrackingMethod is None, as the separation is computed from event inputs.
+   */
+  void discardHistory();
+
+  /** @brief False once discardHistory() is called.
+   */
+  bool keepsHistory() const;
+
   /** @brief Yields a vector of IDs for all tokens in the causal graph.
    */
   std::vector<TokenID> allTokenIDs() const;
@@ -113,6 +248,15 @@ class TokenEventGraph {
    */
   uint64_t destroyerEventsCount(TokenID id) const;
 
+  /** @brief Bytes of memory taken by the events, and by the creator events and destroyer event counts of tokens.
+   @details These are allocated from a separate arena from the separation tracking data, see Arena::reservedBytes().
+   */
+  size_t historyMemoryUsage() const;
+
+  /** @brief Bytes of memory taken by the separation tracking data, see Arena::reservedBytes().
+   */
+  size_t separationMemoryUsage() const;
+
  private:
   class Implementation;
   std::shared_ptr<Implementation> implementation_;
@@ -0,0 +1,161 @@
+#include "Tracing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SetReplace {
+namespace {
+struct TraceEvent {
+  const char* name;
+  int64_t startNanoseconds;
+  int64_t durationNanoseconds;
+};
+
+// Written by a single thread at a time, and only read after the writing threads are done.
+struct Buffer {
+  int64_t threadID;
+  std::vector<TraceEvent> events;
+  // Total number of events written since start(), the event n is stored at n % events.size().
+  std::atomic<uint64_t> writtenCount = 0;
+};
+
+struct Registry {
+  // Only locked when threads acquire or release buffers, and in the functions that should not be called during the
+  // evolution, never while recording events.
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Buffer>> buffers;  // indexed by thread ID
+  std::vector<std::shared_ptr<Buffer>> freeBuffers;
+  int64_t capacityPerThread = Tracing::defaultCapacityPerThread;
+  std::chrono::steady_clock::time_point epoch;
+  std::string outputPath;
+  std::atomic<bool> recording = false;
+};
+
+// Never destroyed, because thread-local buffers can be released after static objects are destroyed.
+Registry& registry() {
+  static auto* instance = new Registry();
+  return *instance;
+}
+
+// Owns the buffer of the current thread, and returns it to the registry once the thread finishes.
+class ThreadBuffer {
+ public:
+  ThreadBuffer() = default;
+  ThreadBuffer(const ThreadBuffer&) = delete;
+  ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+  ~ThreadBuffer() {
+    if (buffer_) {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      registry().freeBuffers.push_back(std::move(buffer_));
+    }
+  }
+
+  Buffer* get() {
+    if (!buffer_) {
+      auto& registryInstance = registry();
+      std::lock_guard<std::mutex> lock(registryInstance.mutex);
+      if (!registryInstance.freeBuffers.empty()) {
+        buffer_ = std::move(registryInstance.freeBuffers.back());
+        registryInstance.freeBuffers.pop_back();
+      } else {
+        buffer_ = std::make_shared<Buffer>();
+        buffer_->threadID = static_cast<int64_t>(registryInstance.buffers.size());
+        buffer_->events.resize(registryInstance.capacityPerThread);
+        registryInstance.buffers.push_back(buffer_);
+      }
+    }
+    return buffer_.get();
+  }
+
+ private:
+  std::shared_ptr<Buffer> buffer_;
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+int64_t nanoseconds(const std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+// Chrome trace timestamps are in microseconds, and can be fractional.
+void writeMicroseconds(std::ostream* output, const int64_t nanoseconds) {
+  char formatted[32];
+  std::snprintf(formatted, sizeof(formatted), "%.3f", static_cast<double>(nanoseconds) / 1000);
+  *output << formatted;
+}
+}  // namespace
+
+void Tracing::start(const std::string& outputPath, const int64_t capacityPerThread) {
+  if constexpr (!enabled) return;
+  if (!outputPath.empty() && !std::ofstream(outputPath)) throw Error::CannotOpenOutput;
+
+  auto& registryInstance = registry();
+  std::lock_guard<std::mutex> lock(registryInstance.mutex);
+  registryInstance.capacityPerThread = std::max<int64_t>(capacityPerThread, 1);
+  for (auto& buffer : registryInstance.buffers) {
+    buffer->events.assign(registryInstance.capacityPerThread, TraceEvent());
+    buffer->writtenCount = 0;
+  }
+  registryInstance.outputPath = outputPath;
+  registryInstance.epoch = std::chrono::steady_clock::now();
+  registryInstance.recording = true;
+}
+
+void Tracing::stop() { registry().recording = false; }
+
+bool Tracing::isRecording() { return enabled && registry().recording.load(std::memory_order_relaxed); }
+
+void Tracing::record(const char* name,
+                     const std::chrono::steady_clock::time_point start,
+                     const std::chrono::steady_clock::time_point end) {
+  Buffer* buffer = threadBuffer.get();
+  const uint64_t index = buffer->writtenCount.load(std::memory_order_relaxed);
+  buffer->events[index % buffer->events.size()] = {
+      name, nanoseconds(start - registry().epoch), nanoseconds(end - start)};
+  buffer->writtenCount.store(index + 1, std::memory_order_release);
+}
+
+void Tracing::write(std::ostream* output) {
+  auto& registryInstance = registry();
+  std::lock_guard<std::mutex> lock(registryInstance.mutex);
+  *output << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& buffer : registryInstance.buffers) {
+    const uint64_t writtenCount = buffer->writtenCount.load(std::memory_order_acquire);
+    if (writtenCount == 0) continue;
+    *output << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID
+            << ",\"args\":{\"name\":\"Thread " << buffer->threadID << "\"}}";
+    first = false;
+
+    const uint64_t capacity = buffer->events.size();
+    for (uint64_t i = writtenCount > capacity ? writtenCount - capacity : 0; i < writtenCount; ++i) {
+      const auto& event = buffer->events[i % capacity];
+      *output << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID
+              << ",\"ts\":";
+      writeMicroseconds(output, event.startNanoseconds);
+      *output << ",\"dur\":";
+      writeMicroseconds(output, event.durationNanoseconds);
+      *output << "}";
+    }
+  }
+  *output << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void Tracing::flushToOutputPath() {
+  std::string outputPath;
+  {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    outputPath = registry().outputPath;
+  }
+  if (outputPath.empty()) return;
+  std::ofstream output(outputPath);
+  write(&output);
+}
+}  // namespace SetReplace
@@ -0,0 +1,97 @@
+#ifndef LIBSETREPLACE_TRACING_HPP_
+#define LIBSETREPLACE_TRACING_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace SetReplace {
+/** @brief Records the phases of the evolution on a timeline, which can be opened in chrome://tracing or Perfetto.
+ * @details Tracing is only compiled in if LIBSETREPLACE_TRACING is defined (the SET_REPLACE_ENABLE_TRACING CMake
+ * option). Otherwise, scopes compile to nothing, and the other functions do nothing. If compiled in, recording still
+ * needs to be started with start().
+ *
+ * Each thread writes into its own fixed-capacity ring buffer, so recording is lock-free, and if a thread produces more
+ * events than the capacity, its oldest events are overwritten. Buffers of finished threads are reused by new threads,
+ * so thread IDs in the trace refer to buffers rather than OS threads.
+ *
+ * start(), stop(), write() and flush() should not be called while the evolution is running.
+ */
+class Tracing {
+ public:
+  /** @brief Type of the error occurred during tracing.
+   */
+  enum class Error { CannotOpenOutput };
+
+#ifdef LIBSETREPLACE_TRACING
+  static constexpr bool enabled = true;
+#else
+  static constexpr bool enabled = false;
+#endif
+
+  static constexpr int64_t defaultCapacityPerThread = 1 << 16;
+
+  /** @brief Records the time from construction to destruction as a single event in the calling thread's buffer.
+   * @param name should be a string literal, as only the pointer is stored.
+   */
+  class Scope {
+   public:
+    explicit Scope(const char* name) {
+      if constexpr (enabled) {
+        if (isRecording()) {
+          name_ = name;
+          start_ = std::chrono::steady_clock::now();
+        }
+      }
+    }
+
+    ~Scope() {
+      if constexpr (enabled) {
+        if (name_) record(name_, start_, std::chrono::steady_clock::now());
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    const char* name_ = nullptr;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /** @brief Discards previously recorded events, and starts recording.
+   * @param outputPath if not empty, flush() writes the trace to this file, which happens at the end of each
+   * HypergraphSubstitutionSystem::replace(). Throws Error::CannotOpenOutput if the file cannot be written.
+   * @param capacityPerThread the number of most recent events kept for each thread.
+   */
+  static void start(const std::string& outputPath = "", int64_t capacityPerThread = defaultCapacityPerThread);
+
+  /** @brief Stops recording. Recorded events are kept until the next start().
+   */
+  static void stop();
+
+  /** @brief Yields true if start() was called, and stop() was not called after it.
+   */
+  static bool isRecording();
+
+  /** @brief Writes all recorded events in the Chrome trace event JSON format.
+   */
+  static void write(std::ostream* output);
+
+  /** @brief Writes the trace to the output path given to start(), if any.
+   */
+  static void flush() {
+    if constexpr (enabled) flushToOutputPath();
+  }
+
+ private:
+  static void record(const char* name,
+                     std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end);
+
+  static void flushToOutputPath();
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_TRACING_HPP_
@@ -2,15 +2,20 @@
 
 // NOLINTNEXTLINE(build/c++11)
 #include <chrono>  // <chrono> is banned in Chromium, so cpplint flags it https://stackoverflow.com/a/33653404/905496
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <random>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "AtomsGraph.hpp"
+#include "CausalGraph.hpp"
 #include "HypergraphSubstitutionSystem.hpp"
+#include "HypergraphUnifications.hpp"
 
 namespace SetReplace {
 namespace {
@@ -51,7 +56,9 @@ std::vector<AtomsVector> getNextHypergraph(const mint& tensorLength, const mint*
     auto& currentToken = atomVectors[tokenIndex];
     currentToken.reserve(tokenLength);
     for (mint atomIndex = 0; atomIndex < tokenLength; ++atomIndex) {
-      currentToken.emplace_back(static_cast<Atom>(getDataFunc()));
+      const mint atom = getDataFunc();
+      if (!fitsInID<Atom>(atom)) throw LIBRARY_FUNCTION_ERROR;
+      currentToken.emplace_back(static_cast<Atom>(atom));
     }
   }
   return atomVectors;
@@ -107,49 +114,68 @@ HypergraphMatcher::OrderingSpec getOrderingSpec(WolframLibraryData libData, MTen
 
 // Seed is passed as two uint16_t because LibraryLink does not support unsigned ints, which becomes a problem on 32-bit
 // architectures
-uint32_t getSeed(WolframLibraryData libData, MTensor seedTensor) {
-  mint tensorLength = libData->MTensor_getFlattenedLength(seedTensor);
-  if (tensorLength != 2) throw LIBRARY_FUNCTION_ERROR;
-  mint* tensorData = libData->MTensor_getIntegerData(seedTensor);
+constexpr mint seedLength = 2;
+
+uint32_t getNextSeed(const mint& tensorLength, const mint* tensorData, mint* startReadIndex) {
   uint32_t result = 0;
-  for (mint i = 0; i < tensorLength; ++i) {
-    result = (1 << 16) * result + static_cast<uint32_t>(getData(tensorData, tensorLength, i));
+  for (mint i = 0; i < seedLength; ++i) {
+    result = (1 << 16) * result + static_cast<uint32_t>(getData(tensorData, tensorLength, (*startReadIndex)++));
   }
   return result;
 }
 
+uint32_t getSeed(WolframLibraryData libData, MTensor seedTensor) {
+  mint tensorLength = libData->MTensor_getFlattenedLength(seedTensor);
+  if (tensorLength != seedLength) throw LIBRARY_FUNCTION_ERROR;
+  mint readIndex = 0;
+  return getNextSeed(tensorLength, libData->MTensor_getIntegerData(seedTensor), &readIndex);
+}
+
 constexpr int64_t wlStepLimitDisabled = -1;
 
+constexpr mint stepSpecLength = 6;
+
+HypergraphSubstitutionSystem::StepSpecification getNextStepSpec(const mint& tensorLength,
+                                                                const mint* tensorData,
+                                                                mint* startReadIndex) {
+  std::vector<int64_t> stepSpecElements(stepSpecLength);
+  for (mint k = 0; k < stepSpecLength; ++k) {
+    stepSpecElements[k] = static_cast<int64_t>(getData(tensorData, tensorLength, (*startReadIndex)++));
+    if (stepSpecElements[k] == wlStepLimitDisabled) {
+      stepSpecElements[k] = HypergraphSubstitutionSystem::stepLimitDisabled;
+    }
+    if (stepSpecElements[k] < 0) throw LIBRARY_FUNCTION_ERROR;
+  }
+
+  return HypergraphSubstitutionSystem::StepSpecification{stepSpecElements[0],
+                                                         stepSpecElements[1],
+                                                         stepSpecElements[2],
+                                                         stepSpecElements[3],
+                                                         stepSpecElements[4],
+                                                         stepSpecElements[5]};
+}
+
 HypergraphSubstitutionSystem::StepSpecification getStepSpec(WolframLibraryData libData, MTensor stepsTensor) {
   mint tensorLength = libData->MTensor_getFlattenedLength(stepsTensor);
-  constexpr mint specLength = 5;
-  if (tensorLength != specLength) {
+  if (tensorLength != stepSpecLength) {
     throw LIBRARY_FUNCTION_ERROR;
   } else {
-    mint* tensorData = libData->MTensor_getIntegerData(stepsTensor);
-    std::vector<int64_t> stepSpecElements(specLength);
-    for (mint k = 0; k < specLength; ++k) {
-      stepSpecElements[k] = static_cast<int64_t>(getData(tensorData, specLength, k));
-      if (stepSpecElements[k] == wlStepLimitDisabled) {
-        stepSpecElements[k] = HypergraphSubstitutionSystem::stepLimitDisabled;
-      }
-      if (stepSpecElements[k] < 0) throw LIBRARY_FUNCTION_ERROR;
-    }
-
-    return HypergraphSubstitutionSystem::StepSpecification{
-        stepSpecElements[0], stepSpecElements[1], stepSpecElements[2], stepSpecElements[3], stepSpecElements[4]};
+    mint readIndex = 0;
+    return getNextStepSpec(tensorLength, libData->MTensor_getIntegerData(stepsTensor), &readIndex);
   }
 }
 
-MTensor putHypergraph(const std::vector<AtomsVector>& tokens, WolframLibraryData libData) {
-  // count + atoms list pointer for each token + an extra pointer at the end to the element one past the end
-  size_t tensorLength = 1 + (tokens.size() + 1);
-
-  // Atoms are next, positions to which are referenced in each token spec.
-  // This is where the first atom will be located.
-  size_t atomsPointer = tensorLength + 1;
-  for (const auto& token : tokens) {
-    tensorLength += token.size();
+// Used for tokens (lists of atoms), as well as for states (lists of token IDs).
+template <typename T>
+MTensor putNestedLists(const std::vector<std::vector<T>>& lists, WolframLibraryData libData) {
+  // count + elements list pointer for each list + an extra pointer at the end to the element one past the end
+  size_t tensorLength = 1 + (lists.size() + 1);
+
+  // Elements are next, positions to which are referenced in each list spec.
+  // This is where the first element will be located.
+  size_t elementsPointer = tensorLength + 1;
+  for (const auto& list : lists) {
+    tensorLength += list.size();
   }
 
   const mint dimensions[1] = {static_cast<mint>(tensorLength)};
@@ -165,74 +191,99 @@ MTensor putHypergraph(const std::vector<AtomsVector>& tokens, WolframLibraryData
     }
   };
 
-  appendToTensor({static_cast<mint>(tokens.size())});
-  for (const auto& token : tokens) {
-    appendToTensor({static_cast<mint>(atomsPointer)});
-    atomsPointer += token.size();
+  appendToTensor({static_cast<mint>(lists.size())});
+  for (const auto& list : lists) {
+    appendToTensor({static_cast<mint>(elementsPointer)});
+    elementsPointer += list.size();
   }
-  appendToTensor({static_cast<mint>(atomsPointer)});
+  appendToTensor({static_cast<mint>(elementsPointer)});
 
-  for (const auto& token : tokens) {
+  for (const auto& list : lists) {
     // Cannot do static_cast due to 32-bit Windows support
-    appendToTensor(std::vector<mint>(token.begin(), token.end()));
+    appendToTensor(std::vector<mint>(list.begin(), list.end()));
   }
 
   return output;
 }
 
-MTensor putEvents(const std::vector<Event>& events, WolframLibraryData libData) {
-  // ruleID + input tokens pointer + output tokens pointer + generation
-  // add fake rule ID and generation at the end to specify the length of the last token
-  size_t tensorLength = 1 + 4 * (events.size() + 1);
-
-  size_t inputsPointer = tensorLength + 1;
-  size_t outputsPointer = tensorLength + 1;
-  for (const auto& event : events) {
-    tensorLength += event.inputTokens.size() + event.outputTokens.size();
-    outputsPointer += event.inputTokens.size();
+MTensor putStateTransitions(const std::vector<StateTransition>& transitions, WolframLibraryData libData) {
+  // source state + target state + event for each transition
+  constexpr mint transitionLength = 3;
+  const mint dimensions[1] = {static_cast<mint>(transitionLength * transitions.size())};
+  MTensor output;
+  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  mint* outputData = libData->MTensor_getIntegerData(output);
+  for (const auto& transition : transitions) {
+    *(outputData++) = static_cast<mint>(transition.source);
+    *(outputData++) = static_cast<mint>(transition.target);
+    *(outputData++) = static_cast<mint>(transition.event);
   }
+  return output;
+}
 
-  const mint dimensions[1] = {static_cast<mint>(tensorLength)};
+MTensor putMatrix(const std::vector<std::vector<int64_t>>& rows, const mint columnCount, WolframLibraryData libData) {
+  const mint dimensions[2] = {static_cast<mint>(rows.size()), columnCount};
   MTensor output;
-  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  libData->MTensor_new(MType_Integer, 2, dimensions, &output);
+  mint* outputData = libData->MTensor_getIntegerData(output);
+  for (const auto& row : rows) {
+    // Cannot use std::copy due to 32-bit Windows support
+    for (const auto element : row) {
+      *(outputData++) = static_cast<mint>(element);
+    }
+  }
+  return output;
+}
 
-  mint writeIndex = 0;
-  mint position[1];
-  const auto appendToTensor = [libData, &writeIndex, &position, &output](const std::vector<mint>& numbers) {
-    for (const auto number : numbers) {
-      position[0] = ++writeIndex;
-      libData->MTensor_setInteger(output, position, number);
+// Copies a list of integers to tensor data, and returns the pointer past the last written element.
+template <typename T, typename Allocator>
+mint* copyToTensorData(const std::vector<T, Allocator>& list, mint* tensorData) {
+  if constexpr (std::is_integral_v<T> && sizeof(T) == sizeof(mint)) {
+    std::memcpy(tensorData, list.data(), list.size() * sizeof(mint));
+    return tensorData + list.size();
+  } else {
+    // 32-bit Windows support
+    for (const auto element : list) {
+      *(tensorData++) = static_cast<mint>(element);
     }
-  };
+    return tensorData;
+  }
+}
+
+MTensor putEvents(const EventsView& events, WolframLibraryData libData) {
+  const auto& storage = events.storage();
+  const size_t eventCount = events.size();
+
+  // ruleID + input tokens pointer + output tokens pointer + generation
+  // add fake rule ID and generation at the end to specify the length of the last token
+  const size_t headerLength = 1 + 4 * (eventCount + 1);
+  const size_t inputsPointer = headerLength + 1;
+  const size_t outputsPointer = inputsPointer + storage.inputTokens.size();
+  const size_t tensorLength = headerLength + storage.inputTokens.size() + storage.outputTokens.size();
 
-  appendToTensor({static_cast<mint>(events.size())});
-  for (const auto& event : events) {
-    appendToTensor({static_cast<mint>(event.rule),
-                    static_cast<mint>(inputsPointer),
-                    static_cast<mint>(outputsPointer),
-                    static_cast<mint>(event.generation)});
-    inputsPointer += event.inputTokens.size();
-    outputsPointer += event.outputTokens.size();
+  const mint dimensions[1] = {static_cast<mint>(tensorLength)};
+  MTensor output;
+  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  mint* outputData = libData->MTensor_getIntegerData(output);
+
+  *(outputData++) = static_cast<mint>(eventCount);
+  for (size_t event = 0; event < eventCount; ++event) {
+    *(outputData++) = static_cast<mint>(storage.rules[event]);
+    *(outputData++) = static_cast<mint>(inputsPointer + storage.inputOffsets[event]);
+    *(outputData++) = static_cast<mint>(outputsPointer + storage.outputOffsets[event]);
+    *(outputData++) = static_cast<mint>(storage.generations[event]);
   }
 
   // Put fake event at the end so that the length of final token can be determined on WL side.
   constexpr TokenID fakeRule = -2;
   constexpr Generation fakeGeneration = -1;
-  appendToTensor({static_cast<mint>(fakeRule),
-                  static_cast<mint>(inputsPointer),
-                  static_cast<mint>(outputsPointer),
-                  static_cast<mint>(fakeGeneration)});
-
-  for (const auto& event : events) {
-    // Cannot do static_cast due to 32-bit Windows support
-    appendToTensor(std::vector<mint>(event.inputTokens.begin(), event.inputTokens.end()));
-    outputsPointer += event.inputTokens.size();
-  }
+  *(outputData++) = static_cast<mint>(fakeRule);
+  *(outputData++) = static_cast<mint>(inputsPointer + storage.inputOffsets[eventCount]);
+  *(outputData++) = static_cast<mint>(outputsPointer + storage.outputOffsets[eventCount]);
+  *(outputData++) = static_cast<mint>(fakeGeneration);
 
-  for (const auto& event : events) {
-    // Cannot do static_cast due to 32-bit Windows support
-    appendToTensor(std::vector<mint>(event.outputTokens.begin(), event.outputTokens.end()));
-  }
+  outputData = copyToTensorData(storage.inputTokens, outputData);
+  copyToTensorData(storage.outputTokens, outputData);
 
   return output;
 }
@@ -241,7 +292,7 @@ int hypergraphSubstitutionSystemInitialize(WolframLibraryData libData,
                                            mint argc,
                                            const MArgument* argv,
                                            [[maybe_unused]] MArgument result) {
-  if (argc != 8) {
+  if (argc != 9) {
     return LIBRARY_FUNCTION_ERROR;
   }
 
@@ -255,6 +306,7 @@ int hypergraphSubstitutionSystemInitialize(WolframLibraryData libData,
   HypergraphMatcher::OrderingSpec orderingSpec;
   HypergraphMatcher::EventDeduplication eventDeduplication;
   unsigned int randomSeed;
+  MultiwayStateGraph::StateDeduplication stateDeduplication;
   try {
     thisSystemID = MArgument_getInteger(argv[0]);
     rules = getRules(libData, MArgument_getMTensor(argv[1]), MArgument_getMTensor(argv[2]));
@@ -265,13 +317,20 @@ int hypergraphSubstitutionSystemInitialize(WolframLibraryData libData,
     orderingSpec = getOrderingSpec(libData, MArgument_getMTensor(argv[5]));
     eventDeduplication = static_cast<HypergraphMatcher::EventDeduplication>(MArgument_getInteger(argv[6]));
     randomSeed = getSeed(libData, MArgument_getMTensor(argv[7]));
+    stateDeduplication = static_cast<MultiwayStateGraph::StateDeduplication>(MArgument_getInteger(argv[8]));
   } catch (...) {
     return LIBRARY_FUNCTION_ERROR;
   }
 
   try {
     hypergraphSubstitutionSystems_[thisSystemID] = std::make_unique<HypergraphSubstitutionSystem>(
-        rules, initialTokens, maxDestroyerEvents, orderingSpec, eventDeduplication, randomSeed);
+        rules,
+        std::move(initialTokens),
+        maxDestroyerEvents,
+        orderingSpec,
+        eventDeduplication,
+        randomSeed,
+        stateDeduplication);
   } catch (...) {
     return LIBRARY_FUNCTION_ERROR;
   }
@@ -338,7 +397,44 @@ int hypergraphSubstitutionSystemTokens(WolframLibraryData libData, mint argc, MA
     return LIBRARY_FUNCTION_ERROR;
   }
 
-  MArgument_setMTensor(result, putHypergraph(tokens, libData));
+  MArgument_setMTensor(result, putNestedLists(tokens, libData));
+
+  return LIBRARY_NO_ERROR;
+}
+
+int hypergraphSubstitutionSystemStates(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  if (argc != 1) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  const SystemID systemID = MArgument_getInteger(argv[0]);
+
+  try {
+    const auto& states = hypergraphSubstitutionSystemFromID(systemID).states();
+    MArgument_setMTensor(result, putNestedLists(states, libData));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  return LIBRARY_NO_ERROR;
+}
+
+int hypergraphSubstitutionSystemStateTransitions(WolframLibraryData libData,
+                                                 mint argc,
+                                                 MArgument* argv,
+                                                 MArgument result) {
+  if (argc != 1) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  const SystemID systemID = MArgument_getInteger(argv[0]);
+
+  try {
+    const auto& transitions = hypergraphSubstitutionSystemFromID(systemID).stateTransitions();
+    MArgument_setMTensor(result, putStateTransitions(transitions, libData));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
 
   return LIBRARY_NO_ERROR;
 }
@@ -351,7 +447,7 @@ int hypergraphSubstitutionSystemEvents(WolframLibraryData libData, mint argc, MA
   const SystemID systemID = MArgument_getInteger(argv[0]);
 
   try {
-    const auto& events = hypergraphSubstitutionSystemFromID(systemID).events();
+    const auto events = hypergraphSubstitutionSystemFromID(systemID).events();
     MArgument_setMTensor(result, putEvents(events, libData));
   } catch (...) {
     return LIBRARY_FUNCTION_ERROR;
@@ -403,6 +499,194 @@ int hypergraphSubstitutionSystemTerminationReason([[maybe_unused]] WolframLibrar
 
   return LIBRARY_NO_ERROR;
 }
+
+int hypergraphSubstitutionSystemStatistics(WolframLibraryData libData,
+                                           mint argc,
+                                           MArgument* argv,
+                                           MArgument result) {
+  if (argc != 1) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  const SystemID systemID = MArgument_getInteger(argv[0]);
+
+  Statistics statistics;
+  try {
+    statistics = hypergraphSubstitutionSystemFromID(systemID).statistics();
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  // counters in the order of Statistics::Counter + timers in nanoseconds in the order of Statistics::Timer, or an
+  // empty list if the library is compiled without statistics
+  constexpr auto counterCount = static_cast<mint>(Statistics::Counter::Count);
+  constexpr auto timerCount = static_cast<mint>(Statistics::Timer::Count);
+  const mint dimensions[1] = {Statistics::enabled ? counterCount + timerCount : 0};
+  MTensor output;
+  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  if (Statistics::enabled) {
+    mint* outputData = libData->MTensor_getIntegerData(output);
+    for (mint i = 0; i < counterCount; ++i) {
+      *(outputData++) = static_cast<mint>(statistics.count(static_cast<Statistics::Counter>(i)));
+    }
+    for (mint i = 0; i < timerCount; ++i) {
+      *(outputData++) = static_cast<mint>(statistics.time(static_cast<Statistics::Timer>(i)).count());
+    }
+  }
+  MArgument_setMTensor(result, output);
+
+  return LIBRARY_NO_ERROR;
+}
+
+int hypergraphSubstitutionSystemMemoryUsage(WolframLibraryData libData,
+                                            mint argc,
+                                            MArgument* argv,
+                                            MArgument result) {
+  if (argc != 1) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  const SystemID systemID = MArgument_getInteger(argv[0]);
+
+  HypergraphSubstitutionSystem::MemoryUsage memoryUsage;
+  try {
+    memoryUsage = hypergraphSubstitutionSystemFromID(systemID).memoryUsage();
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  // in the order of the fields of HypergraphSubstitutionSystem::MemoryUsage
+  const std::vector<int64_t> bytes = {memoryUsage.tokens,
+                                      memoryUsage.events,
+                                      memoryUsage.separation,
+                                      memoryUsage.atomsIndex,
+                                      memoryUsage.matches,
+                                      memoryUsage.stateGraph};
+  const mint dimensions[1] = {static_cast<mint>(bytes.size())};
+  MTensor output;
+  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  mint* outputData = libData->MTensor_getIntegerData(output);
+  for (const auto partBytes : bytes) {
+    *(outputData++) = static_cast<mint>(partBytes);
+  }
+  MArgument_setMTensor(result, output);
+
+  return LIBRARY_NO_ERROR;
+}
+
+int atomsGraphBallVolumes(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  if (argc != 4) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  std::vector<AtomsVector> hyperedges;
+  AtomsGraph::HyperedgeConnectivity connectivity;
+  std::vector<Atom> centers;
+  int64_t maxRadius;
+  try {
+    hyperedges = getHypergraph(libData, MArgument_getMTensor(argv[0]));
+    connectivity = static_cast<AtomsGraph::HyperedgeConnectivity>(MArgument_getInteger(argv[1]));
+    MTensor centersTensor = MArgument_getMTensor(argv[2]);
+    const mint* centersData = libData->MTensor_getIntegerData(centersTensor);
+    centers.assign(centersData, centersData + libData->MTensor_getFlattenedLength(centersTensor));
+    maxRadius = static_cast<int64_t>(MArgument_getInteger(argv[3]));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  try {
+    const auto volumes = AtomsGraph(hyperedges, connectivity).ballVolumes(centers, maxRadius, shouldAbort(libData));
+    MArgument_setMTensor(result, putMatrix(volumes, static_cast<mint>(maxRadius + 1), libData));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  return LIBRARY_NO_ERROR;
+}
+
+int causalGraphDiamondCounts(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  if (argc != 4) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  int64_t vertexCount;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  int64_t start;
+  int64_t end;
+  try {
+    vertexCount = static_cast<int64_t>(MArgument_getInteger(argv[0]));
+    MTensor edgesTensor = MArgument_getMTensor(argv[1]);
+    const mint edgesTensorLength = libData->MTensor_getFlattenedLength(edgesTensor);
+    const mint* edgesTensorData = libData->MTensor_getIntegerData(edgesTensor);
+    if (edgesTensorLength % 2 != 0) throw LIBRARY_FUNCTION_ERROR;
+    edges.reserve(edgesTensorLength / 2);
+    for (mint i = 0; i < edgesTensorLength; i += 2) {
+      edges.emplace_back(getData(edgesTensorData, edgesTensorLength, i),
+                         getData(edgesTensorData, edgesTensorLength, i + 1));
+    }
+    start = static_cast<int64_t>(MArgument_getInteger(argv[2]));
+    end = static_cast<int64_t>(MArgument_getInteger(argv[3]));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  try {
+    const auto counts = CausalGraph(vertexCount, edges).diamondCounts(start, end, shouldAbort(libData));
+    const mint dimensions[1] = {2};
+    MTensor output;
+    libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+    mint* outputData = libData->MTensor_getIntegerData(output);
+    outputData[0] = static_cast<mint>(counts.vertexCount);
+    outputData[1] = static_cast<mint>(counts.comparablePairCount);
+    MArgument_setMTensor(result, output);
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  return LIBRARY_NO_ERROR;
+}
+
+int hypergraphUnifications(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  if (argc != 2) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  std::vector<AtomsVector> firstHypergraph;
+  std::vector<AtomsVector> secondHypergraph;
+  try {
+    firstHypergraph = getHypergraph(libData, MArgument_getMTensor(argv[0]));
+    secondHypergraph = getHypergraph(libData, MArgument_getMTensor(argv[1]));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  // Unifications are written directly into a flat buffer as they are found. The unified hypergraphs are not returned,
+  // as the Wolfram Language side numbers their vertices differently.
+  mint unificationCount = 0;
+  std::vector<mint> edgeIndices;
+  const auto appendUnification = [&unificationCount, &edgeIndices](const HypergraphUnification& unification) {
+    ++unificationCount;
+    edgeIndices.insert(edgeIndices.end(), unification.firstEdgeIndices.begin(), unification.firstEdgeIndices.end());
+    edgeIndices.insert(edgeIndices.end(), unification.secondEdgeIndices.begin(), unification.secondEdgeIndices.end());
+  };
+
+  try {
+    HypergraphUnifications::enumerate(firstHypergraph, secondHypergraph, appendUnification, shouldAbort(libData));
+  } catch (...) {
+    return LIBRARY_FUNCTION_ERROR;
+  }
+
+  // count + edge indices of both hypergraphs for each unification
+  const mint dimensions[1] = {static_cast<mint>(1 + edgeIndices.size())};
+  MTensor output;
+  libData->MTensor_new(MType_Integer, 1, dimensions, &output);
+  mint* outputData = libData->MTensor_getIntegerData(output);
+  *(outputData++) = unificationCount;
+  copyToTensorData(edgeIndices, outputData);
+  MArgument_setMTensor(result, output);
+
+  return LIBRARY_NO_ERROR;
+}
 }  // namespace
 }  // namespace SetReplace
 
@@ -445,6 +729,20 @@ EXTERN_C int hypergraphSubstitutionSystemEvents(WolframLibraryData libData,
   return SetReplace::hypergraphSubstitutionSystemEvents(libData, argc, argv, result);
 }
 
+EXTERN_C int hypergraphSubstitutionSystemStates(WolframLibraryData libData,
+                                                mint argc,
+                                                MArgument* argv,
+                                                MArgument result) {
+  return SetReplace::hypergraphSubstitutionSystemStates(libData, argc, argv, result);
+}
+
+EXTERN_C int hypergraphSubstitutionSystemStateTransitions(WolframLibraryData libData,
+                                                          mint argc,
+                                                          MArgument* argv,
+                                                          MArgument result) {
+  return SetReplace::hypergraphSubstitutionSystemStateTransitions(libData, argc, argv, result);
+}
+
 EXTERN_C int hypergraphSubstitutionSystemMaxCompleteGeneration(WolframLibraryData libData,
                                                                mint argc,
                                                                MArgument* argv,
@@ -458,3 +756,29 @@ EXTERN_C int hypergraphSubstitutionSystemTerminationReason(WolframLibraryData li
                                                            MArgument result) {
   return SetReplace::hypergraphSubstitutionSystemTerminationReason(libData, argc, argv, result);
 }
+
+EXTERN_C int hypergraphSubstitutionSystemStatistics(WolframLibraryData libData,
+                                                    mint argc,
+                                                    MArgument* argv,
+                                                    MArgument result) {
+  return SetReplace::hypergraphSubstitutionSystemStatistics(libData, argc, argv, result);
+}
+
+EXTERN_C int hypergraphSubstitutionSystemMemoryUsage(WolframLibraryData libData,
+                                                     mint argc,
+                                                     MArgument* argv,
+                                                     MArgument result) {
+  return SetReplace::hypergraphSubstitutionSystemMemoryUsage(libData, argc, argv, result);
+}
+
+EXTERN_C int atomsGraphBallVolumes(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  return SetReplace::atomsGraphBallVolumes(libData, argc, argv, result);
+}
+
+EXTERN_C int causalGraphDiamondCounts(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  return SetReplace::causalGraphDiamondCounts(libData, argc, argv, result);
+}
+
+EXTERN_C int hypergraphUnifications(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result) {
+  return SetReplace::hypergraphUnifications(libData, argc, argv, result);
+}
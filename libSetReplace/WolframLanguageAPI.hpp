@@ -39,6 +39,22 @@ EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemEvents(WolframLibraryData lib
                                                           MArgument* argv,
                                                           MArgument result);
 
+/** @brief Returns the list of global states (as lists of token IDs) for a specified hypergraph substitution system
+ * pointer.
+ * @details The list is empty unless the system was created with state deduplication enabled.
+ */
+EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemStates(WolframLibraryData libData,
+                                                          mint argc,
+                                                          MArgument* argv,
+                                                          MArgument result);
+
+/** @brief Returns the flattened list of {source state, target state, event} transitions between global states.
+ */
+EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemStateTransitions(WolframLibraryData libData,
+                                                                    mint argc,
+                                                                    MArgument* argv,
+                                                                    MArgument result);
+
 /** @brief Returns the largest generation that has both been reached, and has no matches that would produce tokens
  * with that or lower generation.
  * @details Is abortable, in which case returns LIBRARY_FUNCTION_ERROR.
@@ -55,4 +71,42 @@ EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemTerminationReason(WolframLibr
                                                                      MArgument* argv,
                                                                      MArgument result);
 
+/** @brief Returns the counters of the hot-path operations followed by the timers in nanoseconds, see Statistics.
+ * @details Returns an empty list if libSetReplace is compiled without LIBSETREPLACE_STATISTICS.
+ */
+EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemStatistics(WolframLibraryData libData,
+                                                              mint argc,
+                                                              MArgument* argv,
+                                                              MArgument result);
+
+/** @brief Returns the bytes of memory taken by the tokens, events, separation tracking data, atoms index and matches,
+ * see HypergraphSubstitutionSystem::memoryUsage().
+ */
+EXTERN_C DLLEXPORT int hypergraphSubstitutionSystemMemoryUsage(WolframLibraryData libData,
+                                                               mint argc,
+                                                               MArgument* argv,
+                                                               MArgument result);
+
+/** @brief Returns the matrix of the numbers of atoms within each graph distance (columns) from each of the given
+ * centers (rows) in a hypergraph.
+ * @details Is abortable, in which case returns LIBRARY_FUNCTION_ERROR.
+ */
+EXTERN_C DLLEXPORT int atomsGraphBallVolumes(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result);
+
+/** @brief Returns {vertex count, number of causally related pairs} for the causal diamond between two vertices of a
+ * directed acyclic graph.
+ * @details Is abortable, in which case returns LIBRARY_FUNCTION_ERROR.
+ */
+EXTERN_C DLLEXPORT int causalGraphDiamondCounts(WolframLibraryData libData,
+                                                mint argc,
+                                                MArgument* argv,
+                                                MArgument result);
+
+/** @brief Returns all unifications of two hypergraphs.
+ * @details The result is {count, edge indices...}, where for each unification, there are the indices in the unified
+ * hypergraph for each edge of the first hypergraph and then of the second one. Is abortable, in which case returns
+ * LIBRARY_FUNCTION_ERROR.
+ */
+EXTERN_C DLLEXPORT int hypergraphUnifications(WolframLibraryData libData, mint argc, MArgument* argv, MArgument result);
+
 #endif  // LIBSETREPLACE_WOLFRAMLANGUAGEAPI_HPP_
@@ -0,0 +1,242 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "AtomsIndex.hpp"
+#include "HypergraphMatcher.hpp"
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Parallelism.hpp"
+
+// Every allocation in the process goes through these, so that the allocations per event can be reported.
+namespace {
+std::atomic<int64_t> allocationCount = 0;
+}  // namespace
+
+void* operator new(const size_t size) {
+  ++allocationCount;
+  if (void* pointer = std::malloc(size == 0 ? 1 : size)) return pointer;
+  throw std::bad_alloc();
+}
+
+void* operator new[](const size_t size) { return operator new(size); }
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+struct Workload {
+  std::string name;
+  std::vector<Rule> rules;
+  std::vector<AtomsVector> initialTokens;
+};
+
+// Same rules as in profile_tests.cpp.
+const std::vector<Workload> workloads = {
+    {"singleInputRule", {{{{-1, -2}}, {{-1, -3}, {-1, -3}, {-3, -2}}}}, {{1, 1}}},
+    {"mediumRule",
+     {{{{-1, -2, -3}, {-4, -3, -5}, {-3, -6}},
+       {{-6, -7, -8}, {-6, -9, -10}, {-11, -8, -10}, {-5, -2, -9}, {-9, -9}, {-1, -9}, {-7, -5}, {-8, -5}}}},
+     {{1, 1, 1}, {1, 1, 1}, {1, 1}}},
+    {"sequentialRule",
+     {{{{-1, -2, -2}, {-3, -2, -4}}, {{-5, -4, -4}, {-4, -3, -5}, {-3, -5, -1}}}},
+     {{1, 1, 1}, {1, 1, 1}}},
+    {"exponentialMatchCountRule", {{{{-1}, {-1}, {-1}}, {{-1}, {-1}, {-1}, {-1}}}}, {{1}, {1}, {1}}}};
+
+struct NamedOrderingSpec {
+  std::string name;
+  HypergraphMatcher::OrderingSpec spec;
+};
+
+const std::vector<NamedOrderingSpec> orderingSpecs = {
+    // LeastRecentEdge, RuleOrdering, RuleIndex
+    {"wolframModelDefault",
+     {{HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+       HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}}},
+    // Same as in profile_tests.cpp
+    {"profileTests",
+     {{HypergraphMatcher::OrderingFunction::SortedInputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+       HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}}},
+    {"random", {}},
+    {"any", {{HypergraphMatcher::OrderingFunction::Any, HypergraphMatcher::OrderingDirection::Normal}}}};
+
+struct DestroyerMode {
+  std::string name;
+  uint64_t maxDestroyerEvents;
+};
+
+const DestroyerMode singleDestroyer = {"single", 1};
+const DestroyerMode unlimitedDestroyers = {"unlimited", HypergraphSubstitutionSystem::stepLimitDisabled};
+
+int64_t peakRSSBytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+  return static_cast<int64_t>(counters.PeakWorkingSetSize);
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+  return static_cast<int64_t>(usage.ru_maxrss);
+#else
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void setThreadCount(const int64_t threadCount) {
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, static_cast<int>(threadCount));
+}
+
+// Arguments: {events, threads}.
+void evolution(benchmark::State& state,
+               const Workload& workload,
+               const HypergraphMatcher::OrderingSpec& orderingSpec,
+               const uint64_t maxDestroyerEvents) {
+  const int64_t maxEvents = state.range(0);
+  setThreadCount(state.range(1));
+
+  int64_t totalEvents = 0;
+  const int64_t allocationsBefore = allocationCount;
+  for (auto _ : state) {
+    HypergraphSubstitutionSystem system(workload.rules,
+                                        workload.initialTokens,
+                                        maxDestroyerEvents,
+                                        orderingSpec,
+                                        HypergraphMatcher::EventDeduplication::None);
+    totalEvents += system.replace(HypergraphSubstitutionSystem::StepSpecification{maxEvents}, doNotAbort);
+  }
+  const int64_t allocations = allocationCount - allocationsBefore;
+
+  state.counters["eventsPerSecond"] =
+      benchmark::Counter(static_cast<double>(totalEvents), benchmark::Counter::kIsRate);
+  state.counters["allocationsPerEvent"] =
+      totalEvents > 0 ? static_cast<double>(allocations) / static_cast<double>(totalEvents) : 0;
+  state.counters["peakRSSBytes"] = static_cast<double>(peakRSSBytes());
+  setThreadCount(std::thread::hardware_concurrency());
+}
+
+// Arguments: {events used to grow the hypergraph, threads}. Measures indexing all matches of the final state from
+// scratch.
+void matching(benchmark::State& state, const Workload& workload) {
+  HypergraphSubstitutionSystem grownSystem(
+      workload.rules, workload.initialTokens, 1, orderingSpecs[0].spec, HypergraphMatcher::EventDeduplication::None);
+  grownSystem.replace(HypergraphSubstitutionSystem::StepSpecification{state.range(0)}, doNotAbort);
+  std::vector<AtomsVector> tokens;
+  std::vector<TokenID> finalTokenIDs;
+  {
+    const auto allTokens = grownSystem.tokens();
+    std::vector<bool> isDestroyed(allTokens.size(), false);
+    for (const auto& event : grownSystem.events()) {
+      for (const auto token : event.inputTokens) {
+        isDestroyed[token] = true;
+      }
+    }
+    for (size_t token = 0; token < allTokens.size(); ++token) {
+      if (!isDestroyed[token]) {
+        finalTokenIDs.push_back(static_cast<TokenID>(tokens.size()));
+        tokens.push_back(allTokens[token]);
+      }
+    }
+  }
+  setThreadCount(state.range(1));
+
+  const GetAtomsVectorFunc getAtomsVector = [&tokens](const TokenID& token) -> const AtomsVector& {
+    return tokens[token];
+  };
+  const GetTokenSeparationFunc getTokenSeparation = [](const TokenID&, const TokenID&) {
+    return SeparationType::Unknown;
+  };
+  int64_t totalMatches = 0;
+  const int64_t allocationsBefore = allocationCount;
+  for (auto _ : state) {
+    AtomsIndex atomsIndex(getAtomsVector);
+    atomsIndex.addTokens(finalTokenIDs);
+    HypergraphMatcher matcher(workload.rules,
+                              &atomsIndex,
+                              getAtomsVector,
+                              getTokenSeparation,
+                              orderingSpecs[0].spec,
+                              HypergraphMatcher::EventDeduplication::None);
+    matcher.addMatchesInvolvingTokens(finalTokenIDs, doNotAbort);
+    totalMatches += static_cast<int64_t>(matcher.allMatches().size());
+  }
+  const int64_t allocations = allocationCount - allocationsBefore;
+
+  state.counters["matchesPerSecond"] =
+      benchmark::Counter(static_cast<double>(totalMatches), benchmark::Counter::kIsRate);
+  state.counters["allocationsPerMatch"] =
+      totalMatches > 0 ? static_cast<double>(allocations) / static_cast<double>(totalMatches) : 0;
+  state.counters["peakRSSBytes"] = static_cast<double>(peakRSSBytes());
+  setThreadCount(std::thread::hardware_concurrency());
+}
+
+void registerBenchmarks() {
+  const int64_t hardwareThreads = std::max<int64_t>(std::thread::hardware_concurrency(), 1);
+  const std::vector<int64_t> threadCounts = hardwareThreads > 1 ? std::vector<int64_t>{1, hardwareThreads}
+                                                                : std::vector<int64_t>{1};
+  for (const auto& workload : workloads) {
+    const bool isExponential = workload.name == "exponentialMatchCountRule";
+    const std::vector<int64_t> eventCounts =
+        isExponential ? std::vector<int64_t>{12, 18} : std::vector<int64_t>{1000, 10000};
+    // Multiway evolution of the exponential rule does not finish in reasonable time
+    const std::vector<DestroyerMode> destroyerModes =
+        isExponential ? std::vector<DestroyerMode>{singleDestroyer}
+                      : std::vector<DestroyerMode>{singleDestroyer, unlimitedDestroyers};
+    // Named as evolution/<workload>/ordering:<ordering>/destroyers:<mode>/events:<events>/threads:<threads>
+    for (const auto& orderingSpec : orderingSpecs) {
+      for (const auto& destroyerMode : destroyerModes) {
+        const std::string name =
+            "evolution/" + workload.name + "/ordering:" + orderingSpec.name + "/destroyers:" + destroyerMode.name;
+        benchmark::RegisterBenchmark(name.c_str(),
+                                     [&workload, &orderingSpec, destroyerMode](benchmark::State& state) {
+                                       evolution(state, workload, orderingSpec.spec, destroyerMode.maxDestroyerEvents);
+                                     })
+            ->ArgNames({"events", "threads"})
+            ->ArgsProduct({eventCounts, threadCounts})
+            ->Unit(benchmark::kMillisecond);
+      }
+    }
+    benchmark::RegisterBenchmark(("matching/" + workload.name).c_str(),
+                                 [&workload](benchmark::State& state) { matching(state, workload); })
+        ->ArgNames({"events", "threads"})
+        ->ArgsProduct({{eventCounts.back()}, threadCounts})
+        ->Unit(benchmark::kMillisecond);
+  }
+}
+}  // namespace
+}  // namespace SetReplace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  SetReplace::registerBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,215 @@
+#include "EvolutionSpecification.hpp"
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SetReplace {
+namespace {
+using OrderingFunctionAndDirection =
+    std::pair<HypergraphMatcher::OrderingFunction, HypergraphMatcher::OrderingDirection>;
+
+const std::unordered_map<std::string, OrderingFunctionAndDirection> orderingFunctions = {
+    {"OldestEdge",
+     {HypergraphMatcher::OrderingFunction::SortedInputTokenIndices, HypergraphMatcher::OrderingDirection::Normal}},
+    {"LeastOldEdge",
+     {HypergraphMatcher::OrderingFunction::SortedInputTokenIndices, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"LeastRecentEdge",
+     {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+      HypergraphMatcher::OrderingDirection::Normal}},
+    {"NewestEdge",
+     {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+      HypergraphMatcher::OrderingDirection::Reverse}},
+    {"RuleOrdering",
+     {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal}},
+    {"ReverseRuleOrdering",
+     {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"RuleIndex", {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}},
+    {"ReverseRuleIndex",
+     {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"Any", {HypergraphMatcher::OrderingFunction::Any, HypergraphMatcher::OrderingDirection::Normal}},
+    {"OldestGeneration",
+     {HypergraphMatcher::OrderingFunction::MaxInputGeneration, HypergraphMatcher::OrderingDirection::Normal}},
+    {"NewestGeneration",
+     {HypergraphMatcher::OrderingFunction::MaxInputGeneration, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"OldestInputGeneration",
+     {HypergraphMatcher::OrderingFunction::MinInputGeneration, HypergraphMatcher::OrderingDirection::Normal}},
+    {"NewestInputGeneration",
+     {HypergraphMatcher::OrderingFunction::MinInputGeneration, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"RuleWeight", {HypergraphMatcher::OrderingFunction::RuleWeight, HypergraphMatcher::OrderingDirection::Reverse}},
+    {"ReverseRuleWeight",
+     {HypergraphMatcher::OrderingFunction::RuleWeight, HypergraphMatcher::OrderingDirection::Normal}},
+    {"WeightedRandom",
+     {HypergraphMatcher::OrderingFunction::WeightedRandom, HypergraphMatcher::OrderingDirection::Normal}}};
+
+int64_t parseInteger(const std::string& word) {
+  if (word == "Infinity") return HypergraphSubstitutionSystem::stepLimitDisabled;
+  size_t parsedLength;
+  int64_t result;
+  try {
+    result = std::stoll(word, &parsedLength);
+  } catch (...) {
+    throw EvolutionSpecification::Error::InvalidInteger;
+  }
+  if (parsedLength != word.size()) throw EvolutionSpecification::Error::InvalidInteger;
+  return result;
+}
+
+double parseWeight(const std::string& word) {
+  size_t parsedLength;
+  double result;
+  try {
+    result = std::stod(word, &parsedLength);
+  } catch (...) {
+    throw EvolutionSpecification::Error::InvalidWeight;
+  }
+  if (parsedLength != word.size() || !std::isfinite(result)) throw EvolutionSpecification::Error::InvalidWeight;
+  return result;
+}
+
+// Hyperedges are separated by commas, atoms by whitespace.
+std::vector<AtomsVector> parseHypergraph(const std::vector<std::string>& words) {
+  std::vector<AtomsVector> result(1);
+  for (const auto& word : words) {
+    if (word == ",") {
+      result.emplace_back();
+    } else {
+      const int64_t atom = parseInteger(word);
+      if (!fitsInID<Atom>(atom)) throw EvolutionSpecification::Error::InvalidInteger;
+      result.back().push_back(static_cast<Atom>(atom));
+    }
+  }
+  if (words.empty()) result.clear();
+  return result;
+}
+
+Rule parseRule(const std::vector<std::string>& words, const EventSelectionFunction eventSelectionFunction) {
+  size_t arrowIndex = 0;
+  while (arrowIndex < words.size() && words[arrowIndex] != "->") ++arrowIndex;
+  if (arrowIndex == words.size()) throw EvolutionSpecification::Error::InvalidRule;
+  const std::vector<std::string> inputWords(words.begin(), words.begin() + arrowIndex);
+  const std::vector<std::string> outputWords(words.begin() + arrowIndex + 1, words.end());
+  return Rule{parseHypergraph(inputWords), parseHypergraph(outputWords), eventSelectionFunction};
+}
+
+// Splits a line into words, with commas and arrows as separate words, and comments removed.
+std::vector<std::string> splitWords(std::string line) {
+  line = line.substr(0, line.find('#'));
+  std::string spacedLine;
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == ',') {
+      spacedLine += " , ";
+    } else if (line.compare(i, 2, "->") == 0) {
+      spacedLine += " -> ";
+      ++i;
+    } else {
+      spacedLine += line[i];
+    }
+  }
+  std::istringstream lineStream(spacedLine);
+  std::vector<std::string> words;
+  std::string word;
+  while (lineStream >> word) words.push_back(word);
+  return words;
+}
+}  // namespace
+
+EvolutionSpecification EvolutionSpecification::parse(std::istream& input, int64_t* errorLine) {
+  EvolutionSpecification result;
+  bool isOrderingSpecified = false;
+  std::string line;
+  *errorLine = 0;
+  while (std::getline(input, line)) {
+    ++*errorLine;
+    std::vector<std::string> words = splitWords(line);
+    if (words.empty()) continue;
+    const std::string keyword = words.front();
+    words.erase(words.begin());
+
+    const auto singleValue = [&words]() -> const std::string& {
+      if (words.empty()) throw Error::MissingValue;
+      if (words.size() > 1) throw Error::UnexpectedValue;
+      return words.front();
+    };
+    const auto nonNegativeInteger = [&singleValue]() {
+      const int64_t value = parseInteger(singleValue());
+      if (value < 0) throw Error::InvalidInteger;
+      return value;
+    };
+
+    if (keyword == "rule") {
+      result.rules.push_back(parseRule(words, EventSelectionFunction::All));
+    } else if (keyword == "spacelikeRule") {
+      result.rules.push_back(parseRule(words, EventSelectionFunction::Spacelike));
+    } else if (keyword == "ruleWeight") {
+      const double weight = parseWeight(singleValue());
+      if (result.rules.empty()) throw Error::InvalidWeight;
+      // Rule is not assignable, so it is replaced instead
+      const Rule rule = result.rules.back();
+      result.rules.pop_back();
+      result.rules.push_back(Rule{rule.inputs, rule.outputs, rule.eventSelectionFunction, weight});
+    } else if (keyword == "init") {
+      const auto tokens = parseHypergraph(words);
+      result.initialTokens.insert(result.initialTokens.end(), tokens.begin(), tokens.end());
+    } else if (keyword == "maxEvents") {
+      result.stepSpec.maxEvents = nonNegativeInteger();
+    } else if (keyword == "maxGenerations") {
+      result.stepSpec.maxGenerationsLocal = nonNegativeInteger();
+    } else if (keyword == "maxVertices") {
+      result.stepSpec.maxFinalAtoms = nonNegativeInteger();
+    } else if (keyword == "maxVertexDegree") {
+      result.stepSpec.maxFinalAtomDegree = nonNegativeInteger();
+    } else if (keyword == "maxEdges") {
+      result.stepSpec.maxFinalTokens = nonNegativeInteger();
+    } else if (keyword == "maxMemory") {
+      const int64_t megabytes = nonNegativeInteger();
+      constexpr int64_t bytesPerMegabyte = int64_t(1) << 20;
+      result.stepSpec.maxMemoryBytes = megabytes > HypergraphSubstitutionSystem::stepLimitDisabled / bytesPerMegabyte
+                                           ? HypergraphSubstitutionSystem::stepLimitDisabled
+                                           : megabytes * bytesPerMegabyte;
+    } else if (keyword == "maxDestroyerEvents") {
+      result.maxDestroyerEvents = static_cast<uint64_t>(nonNegativeInteger());
+    } else if (keyword == "ordering") {
+      if (words.empty()) throw Error::MissingValue;
+      if (!isOrderingSpecified) result.orderingSpec.clear();
+      isOrderingSpecified = true;
+      for (size_t i = 0; i < words.size(); ++i) {
+        const auto& word = words[i];
+        if (word == "Random") {
+          // random is always applied last, so nothing can follow it
+          if (i + 1 != words.size()) throw Error::InvalidOrderingFunction;
+          break;
+        }
+        const auto orderingFunction = orderingFunctions.find(word);
+        if (orderingFunction == orderingFunctions.end()) throw Error::InvalidOrderingFunction;
+        result.orderingSpec.push_back(orderingFunction->second);
+      }
+    } else if (keyword == "eventDeduplication") {
+      const std::string& value = singleValue();
+      if (value == "None") {
+        result.eventDeduplication = HypergraphMatcher::EventDeduplication::None;
+      } else if (value == "SameInputSetIsomorphicOutputs") {
+        result.eventDeduplication = HypergraphMatcher::EventDeduplication::SameInputSetIsomorphicOutputs;
+      } else {
+        throw Error::InvalidEventDeduplication;
+      }
+    } else if (keyword == "seed") {
+      const int64_t seed = nonNegativeInteger();
+      if (seed > std::numeric_limits<unsigned int>::max()) throw Error::InvalidInteger;
+      result.randomSeed = static_cast<unsigned int>(seed);
+    } else if (keyword == "timeConstraint") {
+      result.timeConstraintSeconds = static_cast<double>(nonNegativeInteger());
+    } else {
+      throw Error::UnknownKeyword;
+    }
+  }
+
+  if (result.rules.empty()) throw Error::NoRules;
+  *errorLine = 0;
+  return result;
+}
+}  // namespace SetReplace
@@ -0,0 +1,66 @@
+#ifndef LIBSETREPLACE_CLI_EVOLUTIONSPECIFICATION_HPP_
+#define LIBSETREPLACE_CLI_EVOLUTIONSPECIFICATION_HPP_
+
+#include <istream>
+#include <vector>
+
+#include "HypergraphMatcher.hpp"
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Rule.hpp"
+
+namespace SetReplace {
+/** @brief Everything needed to construct a HypergraphSubstitutionSystem and run its evolution.
+ * @details The defaults are the same as the defaults of WolframModel.
+ */
+struct EvolutionSpecification {
+  /** @brief Type of the error occurred during parsing.
+   */
+  enum class Error {
+    UnknownKeyword,
+    InvalidInteger,
+    InvalidRule,
+    InvalidWeight,
+    InvalidOrderingFunction,
+    InvalidEventDeduplication,
+    MissingValue,
+    UnexpectedValue,
+    NoRules
+  };
+
+  std::vector<Rule> rules;
+  std::vector<AtomsVector> initialTokens;
+  HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  uint64_t maxDestroyerEvents = 1;
+  HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+       HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}};
+  HypergraphMatcher::EventDeduplication eventDeduplication = HypergraphMatcher::EventDeduplication::None;
+  unsigned int randomSeed = 0;
+  double timeConstraintSeconds = 0;  // non-positive means no constraint
+
+  /** @brief Reads the specification from a line-based text format.
+   * @details Each line is a keyword followed by its value, and everything after # is a comment:
+   *
+   *     rule -1 -2, -2 -3 -> -1 -3, -1 -4, -4 -3   # hyperedges are separated by commas, patterns are negative
+   *     spacelikeRule -1 -2 -> -1 -3, -3 -2       # same as rule, but only matches spacelike inputs
+   *     ruleWeight 2.5                            # weight of the preceding rule for RuleWeight and WeightedRandom
+   *     init 1 2, 2 3                             # initial hyperedges, atoms must be positive
+   *     maxEvents 1000                            # also maxGenerations, maxVertices, maxVertexDegree, maxEdges
+   *     maxMemory 4096                            # MiB, see HypergraphSubstitutionSystem::memoryUsage()
+   *     maxDestroyerEvents 1                      # or Infinity for multiway systems
+   *     ordering LeastRecentEdge RuleOrdering     # EventOrderingFunction names, Random is implied at the end and
+   *                                               # can only be given last, WeightedRandom replaces it, see
+   *                                               # HypergraphMatcher::OrderingFunction
+   *     eventDeduplication SameInputSetIsomorphicOutputs
+   *     seed 42
+   *     timeConstraint 3600                       # seconds
+   *
+   * Throws Error and sets errorLine to the 1-based line number if the specification is invalid.
+   */
+  static EvolutionSpecification parse(std::istream& input, int64_t* errorLine);
+};
+}  // namespace SetReplace
+
+#endif  // LIBSETREPLACE_CLI_EVOLUTIONSPECIFICATION_HPP_
@@ -0,0 +1,436 @@
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EventStream.hpp"
+#include "EvolutionSpecification.hpp"
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Tracing.hpp"
+
+// setreplace-run evolves a hypergraph substitution system without a Wolfram Language kernel, e.g., as a batch job.
+// See EvolutionSpecification.hpp for the input format. The output contains all tokens, all events (including the
+// initial one, and with their times for the WeightedRandom ordering), the final state (tokens without destroyer
+// events), and the termination reason. Timing, throughput and memory usage are printed to stderr. With --stream, the
+// history is written to disk during the evolution instead, so that it does not need to fit in memory.
+
+namespace SetReplace {
+namespace {
+enum class OutputFormat { NDJSON, Binary };
+
+// "SRRUN" followed by the format version, all numbers after it are 64-bit integers or IEEE 754 doubles (event times) in
+// the native byte order.
+constexpr char binaryMagic[8] = {'S', 'R', 'R', 'U', 'N', '\0', '\0', '\1'};
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void interrupt(int) { interrupted = 1; }
+
+const char* terminationReasonName(const HypergraphSubstitutionSystem::TerminationReason reason) {
+  switch (reason) {
+    case HypergraphSubstitutionSystem::TerminationReason::NotTerminated:
+      return "NotTerminated";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxEvents:
+      return "MaxEvents";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxGenerationsLocal:
+      return "MaxGenerationsLocal";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxFinalAtoms:
+      return "MaxVertices";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxFinalAtomDegree:
+      return "MaxVertexDegree";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxFinalTokens:
+      return "MaxEdges";
+    case HypergraphSubstitutionSystem::TerminationReason::Complete:
+      return "FixedPoint";
+    case HypergraphSubstitutionSystem::TerminationReason::Aborted:
+      return "Aborted";
+    case HypergraphSubstitutionSystem::TerminationReason::TimeConstrained:
+      return "TimeConstraint";
+    case HypergraphSubstitutionSystem::TerminationReason::MaxMemory:
+      return "MaxMemory";
+    default:
+      return "Unknown";
+  }
+}
+
+const char* errorDescription(const EvolutionSpecification::Error error) {
+  switch (error) {
+    case EvolutionSpecification::Error::UnknownKeyword:
+      return "unknown keyword";
+    case EvolutionSpecification::Error::InvalidInteger:
+      return "invalid integer";
+    case EvolutionSpecification::Error::InvalidRule:
+      return "rule should have the form inputs -> outputs";
+    case EvolutionSpecification::Error::InvalidWeight:
+      return "rule weight should be a finite number following a rule";
+    case EvolutionSpecification::Error::InvalidOrderingFunction:
+      return "unknown ordering function";
+    case EvolutionSpecification::Error::InvalidEventDeduplication:
+      return "unknown event deduplication";
+    case EvolutionSpecification::Error::MissingValue:
+      return "missing value";
+    case EvolutionSpecification::Error::UnexpectedValue:
+      return "unexpected value";
+    case EvolutionSpecification::Error::NoRules:
+      return "no rules specified";
+    default:
+      return "unknown error";
+  }
+}
+
+const char* errorDescription(const HypergraphMatcher::Error error) {
+  switch (error) {
+    case HypergraphMatcher::Error::DisconnectedInputs:
+      return "rule inputs are disconnected";
+    case HypergraphMatcher::Error::InvalidOrderingFunction:
+      return "invalid ordering function";
+    case HypergraphMatcher::Error::InvalidOrderingDirection:
+      return "invalid ordering direction";
+    case HypergraphMatcher::Error::InvalidWeight:
+      return "weights should be positive for the WeightedRandom ordering";
+    default:
+      return "unknown error";
+  }
+}
+
+const char* errorDescription(const HypergraphSubstitutionSystem::Error error) {
+  switch (error) {
+    case HypergraphSubstitutionSystem::Error::Aborted:
+      return "aborted";
+    case HypergraphSubstitutionSystem::Error::DisconnectedInputs:
+      return "rule inputs are disconnected";
+    case HypergraphSubstitutionSystem::Error::NonPositiveAtoms:
+      return "initial state atoms must be positive";
+    case HypergraphSubstitutionSystem::Error::AtomCountOverflow:
+      return "too many atoms";
+    case HypergraphSubstitutionSystem::Error::TokenCountOverflow:
+      return "too many tokens";
+    case HypergraphSubstitutionSystem::Error::EventCountOverflow:
+      return "too many events";
+    case HypergraphSubstitutionSystem::Error::FinalStateStepSpecificationForMultihistory:
+      return "final state step specifications are not supported for multihistories";
+    case HypergraphSubstitutionSystem::Error::HistoryNotKept:
+      return "history is not kept in memory";
+    case HypergraphSubstitutionSystem::Error::HistoryRequired:
+      return "history cannot be streamed for multihistories";
+    default:
+      return "unknown error";
+  }
+}
+
+std::vector<TokenID> finalState(const EventsView& events, const size_t tokenCount) {
+  std::vector<bool> isDestroyed(tokenCount, false);
+  for (const auto& event : events) {
+    for (const auto token : event.inputTokens) {
+      isDestroyed[token] = true;
+    }
+  }
+  std::vector<TokenID> result;
+  for (size_t token = 0; token < tokenCount; ++token) {
+    if (!isDestroyed[token]) result.push_back(static_cast<TokenID>(token));
+  }
+  return result;
+}
+
+template <typename Container>
+void writeJSONList(std::ostream& output, const Container& values) {
+  output << '[';
+  bool isFirst = true;
+  for (const auto value : values) {
+    if (!isFirst) output << ',';
+    isFirst = false;
+    output << value;
+  }
+  output << ']';
+}
+
+void writeNDJSON(std::ostream& output,
+                 const std::vector<AtomsVector>& tokens,
+                 const EventsView& events,
+                 const std::vector<double>& eventTimes,
+                 const std::vector<TokenID>& finalTokens,
+                 const HypergraphSubstitutionSystem::TerminationReason terminationReason) {
+  output.precision(std::numeric_limits<double>::max_digits10);
+  for (size_t token = 0; token < tokens.size(); ++token) {
+    output << R"({"type":"token","id":)" << token << R"(,"atoms":)";
+    writeJSONList(output, tokens[token]);
+    output << "}\n";
+  }
+  for (size_t event = 0; event < events.size(); ++event) {
+    output << R"({"type":"event","id":)" << event << R"(,"rule":)" << events[event].rule << R"(,"generation":)"
+           << events[event].generation << R"(,"inputs":)";
+    writeJSONList(output, events[event].inputTokens);
+    output << R"(,"outputs":)";
+    writeJSONList(output, events[event].outputTokens);
+    if (!eventTimes.empty()) output << R"(,"time":)" << eventTimes[event];
+    output << "}\n";
+  }
+  output << R"({"type":"finalState","tokens":)";
+  writeJSONList(output, finalTokens);
+  output << "}\n";
+  output << R"({"type":"terminationReason","value":")" << terminationReasonName(terminationReason) << "\"}\n";
+}
+
+class BinaryWriter {
+ public:
+  explicit BinaryWriter(std::ostream& output) : output_(output) {}
+
+  void write(const int64_t value) { output_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+  void writeDouble(const double value) { output_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+  template <typename Container>
+  void writeList(const Container& values) {
+    write(static_cast<int64_t>(values.size()));
+    for (const auto value : values) {
+      write(static_cast<int64_t>(value));
+    }
+  }
+
+ private:
+  std::ostream& output_;
+};
+
+void writeBinary(std::ostream& output,
+                 const std::vector<AtomsVector>& tokens,
+                 const EventsView& events,
+                 const std::vector<double>& eventTimes,
+                 const std::vector<TokenID>& finalTokens,
+                 const HypergraphSubstitutionSystem::TerminationReason terminationReason) {
+  output.write(binaryMagic, sizeof(binaryMagic));
+  BinaryWriter writer(output);
+  writer.write(static_cast<int64_t>(tokens.size()));
+  for (const auto& token : tokens) {
+    writer.writeList(token);
+  }
+  writer.write(static_cast<int64_t>(events.size()));
+  for (const auto& event : events) {
+    writer.write(event.rule);
+    writer.write(event.generation);
+    writer.writeList(event.inputTokens);
+    writer.writeList(event.outputTokens);
+  }
+  // event times are only recorded for the WeightedRandom ordering, and the list is empty otherwise
+  writer.write(static_cast<int64_t>(eventTimes.size()));
+  for (const double time : eventTimes) {
+    writer.writeDouble(time);
+  }
+  writer.writeList(finalTokens);
+  writer.write(static_cast<int64_t>(terminationReason));
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printUsage(const char* programName) {
+  std::cerr << "Usage: " << programName
+            << " SPECIFICATION [-o OUTPUT] [--format ndjson|binary] [--trace TRACE] [--huge-pages]\n"
+            << "       " << programName << " SPECIFICATION --stream HISTORY [--trace TRACE] [--huge-pages]\n"
+            << "Evolves the hypergraph substitution system described in the SPECIFICATION file (- for stdin), and\n"
+            << "writes tokens, events and the final state to OUTPUT (stdout by default).\n"
+            << "With --stream, writes events and tokens to HISTORY as they are created instead of keeping them in\n"
+            << "memory, which can be read with EventStreamReader. Only supported for singleway systems.\n"
+            << "If built with SET_REPLACE_ENABLE_TRACING, writes the timeline of the evolution to TRACE in the Chrome\n"
+            << "trace event format.\n"
+            << "With --huge-pages, the memory of the system is backed by transparent huge pages where supported,\n"
+            << "which can speed up large evolutions.\n";
+}
+
+int run(const int argc, char** argv) {
+  std::string specificationPath;
+  std::string outputPath;
+  std::string tracePath;
+  std::string streamPath;
+  OutputFormat format = OutputFormat::NDJSON;
+  bool useHugePages = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if ((argument == "-o" || argument == "--output") && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (argument == "--format" && i + 1 < argc) {
+      const std::string formatName = argv[++i];
+      if (formatName == "ndjson") {
+        format = OutputFormat::NDJSON;
+      } else if (formatName == "binary") {
+        format = OutputFormat::Binary;
+      } else {
+        printUsage(argv[0]);
+        return 2;
+      }
+    } else if (argument == "--trace" && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else if (argument == "--stream" && i + 1 < argc) {
+      streamPath = argv[++i];
+    } else if (argument == "--huge-pages") {
+      useHugePages = true;
+    } else if (argument == "-h" || argument == "--help") {
+      printUsage(argv[0]);
+      return 0;
+    } else if (specificationPath.empty() && (argument == "-" || argument.rfind('-', 0) != 0)) {
+      specificationPath = argument;
+    } else {
+      printUsage(argv[0]);
+      return 2;
+    }
+  }
+  if (specificationPath.empty() || (!streamPath.empty() && !outputPath.empty())) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  const auto parseStart = std::chrono::steady_clock::now();
+  EvolutionSpecification specification;
+  std::ifstream specificationFile;
+  if (specificationPath != "-") {
+    specificationFile.open(specificationPath);
+    if (!specificationFile) {
+      std::cerr << "Cannot open " << specificationPath << "\n";
+      return 1;
+    }
+  }
+  int64_t errorLine = 0;
+  try {
+    specification = EvolutionSpecification::parse(specificationPath == "-" ? std::cin : specificationFile, &errorLine);
+  } catch (const EvolutionSpecification::Error error) {
+    std::cerr << specificationPath << ":" << errorLine << ": " << errorDescription(error) << "\n";
+    return 1;
+  }
+  const double parseSeconds = secondsSince(parseStart);
+
+  std::signal(SIGINT, interrupt);
+  std::signal(SIGTERM, interrupt);
+  const auto shouldAbort = []() { return interrupted != 0; };
+  const auto timeConstraint =
+      specification.timeConstraintSeconds > 0
+          ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(specification.timeConstraintSeconds))
+          : HypergraphSubstitutionSystem::timeConstraintDisabled;
+
+  if (!tracePath.empty()) {
+    if (!Tracing::enabled) {
+      std::cerr << "Tracing is not compiled in, ignoring --trace\n";
+    }
+    try {
+      Tracing::start(tracePath);
+    } catch (const Tracing::Error&) {
+      std::cerr << "Cannot open " << tracePath << "\n";
+      return 1;
+    }
+  }
+
+  std::shared_ptr<EventStreamWriter> eventStream;
+  if (!streamPath.empty()) {
+    try {
+      eventStream = std::make_shared<EventStreamWriter>(streamPath);
+    } catch (const EventStreamWriter::Error&) {
+      std::cerr << "Cannot open " << streamPath << "\n";
+      return 1;
+    }
+  }
+
+  const auto evolutionStart = std::chrono::steady_clock::now();
+  std::unique_ptr<HypergraphSubstitutionSystem> system;
+  try {
+    system = std::make_unique<HypergraphSubstitutionSystem>(specification.rules,
+                                                            specification.initialTokens,
+                                                            specification.maxDestroyerEvents,
+                                                            specification.orderingSpec,
+                                                            specification.eventDeduplication,
+                                                            specification.randomSeed,
+                                                            MultiwayStateGraph::StateDeduplication::Disabled,
+                                                            useHugePages);
+    if (eventStream) system->setEventSink(eventStream, false);
+    system->replace(specification.stepSpec, shouldAbort, timeConstraint);
+  } catch (const EventStreamWriter::Error&) {
+    std::cerr << "Failed to write " << streamPath << "\n";
+    return 1;
+  } catch (const HypergraphSubstitutionSystem::Error error) {
+    std::cerr << "Evolution failed: " << errorDescription(error) << "\n";
+    return 1;
+  } catch (const HypergraphMatcher::Error error) {
+    // Events produced before an abort or a timeout are still written, same as in WolframModel.
+    if (error != HypergraphMatcher::Error::Aborted) {
+      std::cerr << "Evolution failed: " << errorDescription(error) << "\n";
+      return 1;
+    }
+  }
+  const double evolutionSeconds = secondsSince(evolutionStart);
+
+  const auto terminationReason = system->terminationReason();
+  // without the initial event
+  const int64_t eventCount =
+      (eventStream ? eventStream->eventCount() : static_cast<int64_t>(system->events().size())) - 1;
+  std::cerr << "parse: " << parseSeconds << " s\n"
+            << "evolution: " << evolutionSeconds << " s, " << eventCount << " events, "
+            << (evolutionSeconds > 0 ? static_cast<double>(eventCount) / evolutionSeconds : 0) << " events/s\n";
+  std::vector<AtomsVector> tokens;
+  std::vector<TokenID> finalTokens;
+  if (eventStream) {
+    std::cerr << "tokens: " << system->tokenCount() << " total\n";
+  } else {
+    tokens = system->tokens();
+    finalTokens = finalState(system->events(), tokens.size());
+    std::cerr << "tokens: " << tokens.size() << " total, " << finalTokens.size() << " in the final state\n";
+  }
+  std::cerr << "termination reason: " << terminationReasonName(terminationReason) << "\n";
+  const auto memoryUsage = system->memoryUsage();
+  constexpr double bytesPerMegabyte = 1 << 20;
+  std::cerr << "memory: " << static_cast<double>(memoryUsage.total()) / bytesPerMegabyte << " MiB ("
+            << static_cast<double>(memoryUsage.tokens) / bytesPerMegabyte << " tokens, "
+            << static_cast<double>(memoryUsage.events) / bytesPerMegabyte << " events, "
+            << static_cast<double>(memoryUsage.separation) / bytesPerMegabyte << " separation, "
+            << static_cast<double>(memoryUsage.atomsIndex) / bytesPerMegabyte << " atoms index, "
+            << static_cast<double>(memoryUsage.matches) / bytesPerMegabyte << " matches, "
+            << static_cast<double>(memoryUsage.stateGraph) / bytesPerMegabyte << " state graph)\n";
+  if (Statistics::enabled) {
+    const auto statistics = system->statistics();
+    for (int i = 0; i < static_cast<int>(Statistics::Counter::Count); ++i) {
+      const auto counter = static_cast<Statistics::Counter>(i);
+      std::cerr << Statistics::name(counter) << ": " << statistics.count(counter) << "\n";
+    }
+    for (int i = 0; i < static_cast<int>(Statistics::Timer::Count); ++i) {
+      const auto timer = static_cast<Statistics::Timer>(i);
+      std::cerr << Statistics::name(timer) << ": " << std::chrono::duration<double>(statistics.time(timer)).count()
+                << " s\n";
+    }
+  }
+
+  // The history is already written, and events() is not available.
+  if (eventStream) {
+    return terminationReason == HypergraphSubstitutionSystem::TerminationReason::Aborted ? 130 : 0;
+  }
+
+  const auto outputStart = std::chrono::steady_clock::now();
+  std::ofstream outputFile;
+  if (!outputPath.empty()) {
+    outputFile.open(outputPath, std::ios::binary);
+    if (!outputFile) {
+      std::cerr << "Cannot open " << outputPath << "\n";
+      return 1;
+    }
+  }
+  std::ostream& output = outputPath.empty() ? std::cout : outputFile;
+  if (format == OutputFormat::NDJSON) {
+    writeNDJSON(output, tokens, system->events(), system->eventTimes(), finalTokens, terminationReason);
+  } else {
+    writeBinary(output, tokens, system->events(), system->eventTimes(), finalTokens, terminationReason);
+  }
+  output.flush();
+  if (!output) {
+    std::cerr << "Failed to write the output\n";
+    return 1;
+  }
+  std::cerr << "output: " << secondsSince(outputStart) << " s\n";
+
+  return terminationReason == HypergraphSubstitutionSystem::TerminationReason::Aborted ? 130 : 0;
+}
+}  // namespace
+}  // namespace SetReplace
+
+int main(int argc, char** argv) { return SetReplace::run(argc, argv); }
@@ -0,0 +1,398 @@
+#include "setreplace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+
+struct setreplace_system {
+  std::unique_ptr<SetReplace::HypergraphSubstitutionSystem> system;
+};
+
+namespace SetReplace {
+namespace {
+constexpr int32_t defaultOrderingFunctions[] = {SETREPLACE_ORDERING_REVERSE_SORTED_INPUT_TOKEN_INDICES,
+                                                SETREPLACE_ORDERING_INPUT_TOKEN_INDICES,
+                                                SETREPLACE_ORDERING_RULE_INDEX};
+constexpr int32_t defaultOrderingDirections[] = {
+    SETREPLACE_ORDERING_NORMAL, SETREPLACE_ORDERING_NORMAL, SETREPLACE_ORDERING_NORMAL};
+
+static_assert(SETREPLACE_STEP_LIMIT_DISABLED == HypergraphSubstitutionSystem::stepLimitDisabled);
+static_assert(SETREPLACE_TERMINATED_MAX_MEMORY ==
+              static_cast<int>(HypergraphSubstitutionSystem::TerminationReason::MaxMemory));
+static_assert(SETREPLACE_ORDERING_WEIGHTED_RANDOM ==
+              static_cast<int>(HypergraphMatcher::OrderingFunction::WeightedRandom));
+static_assert(SETREPLACE_STATE_DEDUPLICATION_ISOMORPHIC_ATOMS_VECTORS ==
+              static_cast<int>(MultiwayStateGraph::StateDeduplication::IsomorphicAtomsVectors));
+
+std::vector<AtomsVector> getHypergraph(const setreplace_hypergraph& hypergraph) {
+  if (hypergraph.edge_count < 0) throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+  if (hypergraph.edge_count == 0) return {};
+  if (hypergraph.edge_offsets == nullptr || hypergraph.atoms == nullptr) throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+  std::vector<AtomsVector> result;
+  result.reserve(hypergraph.edge_count);
+  for (int64_t edge = 0; edge < hypergraph.edge_count; ++edge) {
+    const int64_t begin = hypergraph.edge_offsets[edge];
+    const int64_t end = hypergraph.edge_offsets[edge + 1];
+    if (begin < 0 || end < begin) throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+    if (!std::all_of(hypergraph.atoms + begin, hypergraph.atoms + end, fitsInID<Atom>)) {
+      throw SETREPLACE_ERROR_ATOM_COUNT_OVERFLOW;
+    }
+    result.emplace_back(hypergraph.atoms + begin, hypergraph.atoms + end);
+  }
+  return result;
+}
+
+std::function<bool()> shouldAbort(const volatile int32_t* abortFlag) {
+  if (abortFlag == nullptr) return []() { return false; };
+  return [abortFlag]() { return *abortFlag != 0; };
+}
+
+// Converts exceptions from the C++ classes to status codes, so that they do not cross the C boundary.
+template <typename Function>
+setreplace_status statusOf(const Function& function) {
+  try {
+    function();
+    return SETREPLACE_OK;
+  } catch (const setreplace_status status) {
+    return status;
+  } catch (const HypergraphSubstitutionSystem::Error error) {
+    switch (error) {
+      case HypergraphSubstitutionSystem::Error::Aborted:
+        return SETREPLACE_ERROR_ABORTED;
+      case HypergraphSubstitutionSystem::Error::DisconnectedInputs:
+        return SETREPLACE_ERROR_DISCONNECTED_INPUTS;
+      case HypergraphSubstitutionSystem::Error::NonPositiveAtoms:
+        return SETREPLACE_ERROR_NON_POSITIVE_ATOMS;
+      case HypergraphSubstitutionSystem::Error::AtomCountOverflow:
+        return SETREPLACE_ERROR_ATOM_COUNT_OVERFLOW;
+      case HypergraphSubstitutionSystem::Error::TokenCountOverflow:
+        return SETREPLACE_ERROR_TOKEN_COUNT_OVERFLOW;
+      case HypergraphSubstitutionSystem::Error::EventCountOverflow:
+        return SETREPLACE_ERROR_EVENT_COUNT_OVERFLOW;
+      case HypergraphSubstitutionSystem::Error::FinalStateStepSpecificationForMultihistory:
+        return SETREPLACE_ERROR_FINAL_STATE_STEP_SPECIFICATION_FOR_MULTIHISTORY;
+      default:
+        return SETREPLACE_ERROR_UNKNOWN;
+    }
+  } catch (const HypergraphMatcher::Error error) {
+    switch (error) {
+      case HypergraphMatcher::Error::Aborted:
+        return SETREPLACE_ERROR_ABORTED;
+      case HypergraphMatcher::Error::DisconnectedInputs:
+        return SETREPLACE_ERROR_DISCONNECTED_INPUTS;
+      case HypergraphMatcher::Error::InvalidOrderingFunction:
+      case HypergraphMatcher::Error::InvalidOrderingDirection:
+      case HypergraphMatcher::Error::InvalidWeight:
+        return SETREPLACE_ERROR_INVALID_ARGUMENT;
+      default:
+        return SETREPLACE_ERROR_UNKNOWN;
+    }
+  } catch (const std::bad_alloc&) {
+    return SETREPLACE_ERROR_OUT_OF_MEMORY;
+  } catch (...) {
+    return SETREPLACE_ERROR_UNKNOWN;
+  }
+}
+
+template <typename Source, typename Allocator, typename Destination>
+void copyToBuffer(const std::vector<Source, Allocator>& source, Destination* destination) {
+  if constexpr (sizeof(Source) == sizeof(Destination)) {
+    if (!source.empty()) std::memcpy(destination, source.data(), source.size() * sizeof(Source));
+  } else {
+    std::copy(source.begin(), source.end(), destination);
+  }
+}
+}  // namespace
+}  // namespace SetReplace
+
+using SetReplace::statusOf;
+
+int32_t setreplace_api_version(void) { return SETREPLACE_API_VERSION; }
+
+const char* setreplace_status_message(const setreplace_status status) {
+  switch (status) {
+    case SETREPLACE_OK:
+      return "success";
+    case SETREPLACE_ERROR_INVALID_ARGUMENT:
+      return "invalid argument";
+    case SETREPLACE_ERROR_BUFFER_TOO_SMALL:
+      return "buffer is too small";
+    case SETREPLACE_ERROR_ABORTED:
+      return "aborted";
+    case SETREPLACE_ERROR_DISCONNECTED_INPUTS:
+      return "rule inputs are disconnected";
+    case SETREPLACE_ERROR_NON_POSITIVE_ATOMS:
+      return "initial state atoms must be positive";
+    case SETREPLACE_ERROR_ATOM_COUNT_OVERFLOW:
+      return "too many atoms";
+    case SETREPLACE_ERROR_TOKEN_COUNT_OVERFLOW:
+      return "too many tokens";
+    case SETREPLACE_ERROR_EVENT_COUNT_OVERFLOW:
+      return "too many events";
+    case SETREPLACE_ERROR_FINAL_STATE_STEP_SPECIFICATION_FOR_MULTIHISTORY:
+      return "final state step specifications are not supported for multihistories";
+    case SETREPLACE_ERROR_OUT_OF_MEMORY:
+      return "out of memory";
+    case SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH:
+      return "struct size does not match the library, the caller uses a different version of setreplace.h";
+    default:
+      return "unknown error";
+  }
+}
+
+void setreplace_rule_init(setreplace_rule* rule) {
+  if (rule == nullptr) return;
+  rule->struct_size = sizeof(setreplace_rule);
+  rule->inputs = {0, nullptr, nullptr};
+  rule->outputs = {0, nullptr, nullptr};
+  rule->event_selection = SETREPLACE_EVENT_SELECTION_ALL;
+  rule->weight = 1;
+}
+
+void setreplace_system_options_init(setreplace_system_options* options) {
+  if (options == nullptr) return;
+  options->struct_size = sizeof(setreplace_system_options);
+  options->max_destroyer_events = 1;
+  options->ordering_count = std::size(SetReplace::defaultOrderingFunctions);
+  options->ordering_functions = SetReplace::defaultOrderingFunctions;
+  options->ordering_directions = SetReplace::defaultOrderingDirections;
+  options->event_deduplication = SETREPLACE_EVENT_DEDUPLICATION_NONE;
+  options->state_deduplication = SETREPLACE_STATE_DEDUPLICATION_DISABLED;
+  options->random_seed = 0;
+}
+
+void setreplace_step_specification_init(setreplace_step_specification* step_specification) {
+  if (step_specification == nullptr) return;
+  step_specification->struct_size = sizeof(setreplace_step_specification);
+  step_specification->max_events = SETREPLACE_STEP_LIMIT_DISABLED;
+  step_specification->max_generations_local = SETREPLACE_STEP_LIMIT_DISABLED;
+  step_specification->max_final_atoms = SETREPLACE_STEP_LIMIT_DISABLED;
+  step_specification->max_final_atom_degree = SETREPLACE_STEP_LIMIT_DISABLED;
+  step_specification->max_final_tokens = SETREPLACE_STEP_LIMIT_DISABLED;
+  step_specification->max_memory_bytes = SETREPLACE_STEP_LIMIT_DISABLED;
+}
+
+setreplace_status setreplace_system_create(const setreplace_rule* rules,
+                                           const int64_t rule_count,
+                                           const setreplace_hypergraph* initial_tokens,
+                                           const setreplace_system_options* options,
+                                           setreplace_system** system) {
+  using SetReplace::HypergraphMatcher;
+  if (system == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  *system = nullptr;
+  if (rule_count < 0 || (rule_count > 0 && rules == nullptr) || initial_tokens == nullptr || options == nullptr) {
+    return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  }
+  if (options->struct_size != sizeof(setreplace_system_options)) return SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH;
+  // The first rule is at the same address with any struct size, so a different stride is detected before the others
+  // are read.
+  for (int64_t i = 0; i < rule_count; ++i) {
+    if (rules[i].struct_size != sizeof(setreplace_rule)) return SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH;
+  }
+  if (options->ordering_count < 0 ||
+      (options->ordering_count > 0 &&
+       (options->ordering_functions == nullptr || options->ordering_directions == nullptr))) {
+    return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  }
+
+  return statusOf([&]() {
+    std::vector<SetReplace::Rule> cppRules;
+    cppRules.reserve(rule_count);
+    for (int64_t i = 0; i < rule_count; ++i) {
+      const int32_t eventSelection = rules[i].event_selection;
+      if (eventSelection != SETREPLACE_EVENT_SELECTION_ALL && eventSelection != SETREPLACE_EVENT_SELECTION_SPACELIKE) {
+        throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+      }
+      cppRules.push_back(SetReplace::Rule{SetReplace::getHypergraph(rules[i].inputs),
+                                          SetReplace::getHypergraph(rules[i].outputs),
+                                          static_cast<SetReplace::EventSelectionFunction>(eventSelection),
+                                          rules[i].weight});
+    }
+
+    HypergraphMatcher::OrderingSpec orderingSpec;
+    orderingSpec.reserve(options->ordering_count);
+    for (int64_t i = 0; i < options->ordering_count; ++i) {
+      orderingSpec.emplace_back(static_cast<HypergraphMatcher::OrderingFunction>(options->ordering_functions[i]),
+                                static_cast<HypergraphMatcher::OrderingDirection>(options->ordering_directions[i]));
+    }
+
+    if (options->event_deduplication < SETREPLACE_EVENT_DEDUPLICATION_NONE ||
+        options->event_deduplication > SETREPLACE_EVENT_DEDUPLICATION_SAME_INPUT_SET_ISOMORPHIC_OUTPUTS ||
+        options->state_deduplication < SETREPLACE_STATE_DEDUPLICATION_DISABLED ||
+        options->state_deduplication > SETREPLACE_STATE_DEDUPLICATION_ISOMORPHIC_ATOMS_VECTORS) {
+      throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto result = std::make_unique<setreplace_system>();
+    result->system = std::make_unique<SetReplace::HypergraphSubstitutionSystem>(
+        cppRules,
+        SetReplace::getHypergraph(*initial_tokens),
+        options->max_destroyer_events,
+        orderingSpec,
+        static_cast<HypergraphMatcher::EventDeduplication>(options->event_deduplication),
+        options->random_seed,
+        static_cast<SetReplace::MultiwayStateGraph::StateDeduplication>(options->state_deduplication));
+    *system = result.release();
+  });
+}
+
+void setreplace_system_destroy(setreplace_system* system) { delete system; }
+
+setreplace_status setreplace_system_replace(setreplace_system* system,
+                                            const setreplace_step_specification* step_specification,
+                                            const double time_constraint_seconds,
+                                            const volatile int32_t* abort_flag,
+                                            int64_t* event_count) {
+  using SetReplace::HypergraphSubstitutionSystem;
+  if (system == nullptr || step_specification == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  if (event_count != nullptr) *event_count = 0;
+  if (step_specification->struct_size != sizeof(setreplace_step_specification)) {
+    return SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH;
+  }
+
+  HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  stepSpec.maxEvents = step_specification->max_events;
+  stepSpec.maxGenerationsLocal = step_specification->max_generations_local;
+  stepSpec.maxFinalAtoms = step_specification->max_final_atoms;
+  stepSpec.maxFinalAtomDegree = step_specification->max_final_atom_degree;
+  stepSpec.maxFinalTokens = step_specification->max_final_tokens;
+  stepSpec.maxMemoryBytes = step_specification->max_memory_bytes;
+
+  auto timeConstraint = HypergraphSubstitutionSystem::timeConstraintDisabled;
+  if (time_constraint_seconds > 0) {
+    timeConstraint = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(time_constraint_seconds));
+  }
+
+  const size_t previousEventCount = system->system->events().size();
+  const setreplace_status status = statusOf(
+      [&]() { system->system->replace(stepSpec, SetReplace::shouldAbort(abort_flag), timeConstraint); });
+  if (event_count != nullptr) {
+    *event_count = static_cast<int64_t>(system->system->events().size() - previousEventCount);
+  }
+
+  // Timing out is a normal termination, same as reaching a step limit.
+  if (status == SETREPLACE_ERROR_ABORTED &&
+      system->system->terminationReason() == HypergraphSubstitutionSystem::TerminationReason::TimeConstrained) {
+    return SETREPLACE_OK;
+  }
+  return status;
+}
+
+setreplace_status setreplace_system_termination_reason(const setreplace_system* system,
+                                                       int32_t* termination_reason) {
+  if (system == nullptr || termination_reason == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  return statusOf(
+      [&]() { *termination_reason = static_cast<int32_t>(system->system->terminationReason()); });
+}
+
+setreplace_status setreplace_system_max_complete_generation(setreplace_system* system,
+                                                            const volatile int32_t* abort_flag,
+                                                            int64_t* generation) {
+  if (system == nullptr || generation == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  return statusOf(
+      [&]() { *generation = system->system->maxCompleteGeneration(SetReplace::shouldAbort(abort_flag)); });
+}
+
+setreplace_status setreplace_system_tokens_size(const setreplace_system* system,
+                                                int64_t* token_count,
+                                                int64_t* atom_count) {
+  if (system == nullptr || token_count == nullptr || atom_count == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  return statusOf([&]() {
+    const auto tokenCount = static_cast<SetReplace::TokenID>(system->system->tokenCount());
+    int64_t atomCount = 0;
+    for (SetReplace::TokenID token = 0; token < tokenCount; ++token) {
+      atomCount += static_cast<int64_t>(system->system->tokenAtoms(token).size());
+    }
+    *token_count = tokenCount;
+    *atom_count = atomCount;
+  });
+}
+
+setreplace_status setreplace_system_tokens(const setreplace_system* system,
+                                           const int64_t edge_offsets_capacity,
+                                           int64_t* edge_offsets,
+                                           const int64_t atoms_capacity,
+                                           int64_t* atoms) {
+  if (system == nullptr || edge_offsets == nullptr || (atoms == nullptr && atoms_capacity > 0)) {
+    return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  }
+  return statusOf([&]() {
+    const auto tokenCount = static_cast<SetReplace::TokenID>(system->system->tokenCount());
+    if (edge_offsets_capacity < tokenCount + 1) throw SETREPLACE_ERROR_BUFFER_TOO_SMALL;
+
+    int64_t atomCount = 0;
+    edge_offsets[0] = 0;
+    for (SetReplace::TokenID token = 0; token < tokenCount; ++token) {
+      const auto& tokenAtoms = system->system->tokenAtoms(token);
+      if (atomCount + static_cast<int64_t>(tokenAtoms.size()) > atoms_capacity) {
+        throw SETREPLACE_ERROR_BUFFER_TOO_SMALL;
+      }
+      SetReplace::copyToBuffer(tokenAtoms, atoms + atomCount);
+      atomCount += static_cast<int64_t>(tokenAtoms.size());
+      edge_offsets[token + 1] = atomCount;
+    }
+  });
+}
+
+setreplace_status setreplace_system_events_size(const setreplace_system* system, setreplace_events_size* size) {
+  if (system == nullptr || size == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  return statusOf([&]() {
+    const auto& storage = system->system->events().storage();
+    size->event_count = static_cast<int64_t>(storage.rules.size());
+    size->input_token_count = static_cast<int64_t>(storage.inputTokens.size());
+    size->output_token_count = static_cast<int64_t>(storage.outputTokens.size());
+  });
+}
+
+setreplace_status setreplace_system_events(const setreplace_system* system,
+                                           const setreplace_events_size* capacity,
+                                           int32_t* rules,
+                                           int64_t* generations,
+                                           int64_t* input_offsets,
+                                           int64_t* input_tokens,
+                                           int64_t* output_offsets,
+                                           int64_t* output_tokens) {
+  if (system == nullptr || capacity == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  setreplace_events_size size = {0, 0, 0};
+  const setreplace_status sizeStatus = setreplace_system_events_size(system, &size);
+  if (sizeStatus != SETREPLACE_OK) return sizeStatus;
+  if (capacity->event_count < size.event_count ||
+      (input_tokens != nullptr && capacity->input_token_count < size.input_token_count) ||
+      (output_tokens != nullptr && capacity->output_token_count < size.output_token_count)) {
+    return SETREPLACE_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  return statusOf([&]() {
+    const auto& storage = system->system->events().storage();
+    if (rules != nullptr) SetReplace::copyToBuffer(storage.rules, rules);
+    if (generations != nullptr) SetReplace::copyToBuffer(storage.generations, generations);
+    if (input_offsets != nullptr) SetReplace::copyToBuffer(storage.inputOffsets, input_offsets);
+    if (input_tokens != nullptr) SetReplace::copyToBuffer(storage.inputTokens, input_tokens);
+    if (output_offsets != nullptr) SetReplace::copyToBuffer(storage.outputOffsets, output_offsets);
+    if (output_tokens != nullptr) SetReplace::copyToBuffer(storage.outputTokens, output_tokens);
+  });
+}
+
+setreplace_status setreplace_system_event_times(const setreplace_system* system,
+                                                const int64_t capacity,
+                                                double* times,
+                                                int64_t* event_count) {
+  if (system == nullptr) return SETREPLACE_ERROR_INVALID_ARGUMENT;
+  return statusOf([&]() {
+    const auto& eventTimes = system->system->eventTimes();
+    if (eventTimes.empty()) throw SETREPLACE_ERROR_INVALID_ARGUMENT;
+    if (event_count != nullptr) *event_count = static_cast<int64_t>(eventTimes.size());
+    if (times == nullptr) return;
+    if (capacity < static_cast<int64_t>(eventTimes.size())) throw SETREPLACE_ERROR_BUFFER_TOO_SMALL;
+    SetReplace::copyToBuffer(eventTimes, times);
+  });
+}
@@ -0,0 +1,235 @@
+#ifndef LIBSETREPLACE_SETREPLACE_H_
+#define LIBSETREPLACE_SETREPLACE_H_
+
+/* Stable C interface to libSetReplace, which can be used through a plain FFI from other languages.
+ *
+ * Systems are referred to by opaque handles. Results are written to buffers allocated by the caller, which first
+ * queries the sizes, so that no intermediate containers are exposed. None of the functions throw, all of them return
+ * a setreplace_status instead. Long computations can be aborted by setting the int32_t the abort_flag points to to a
+ * nonzero value from another thread or a signal handler.
+ *
+ * The structs passed to the library start with struct_size, which should be set to their sizeof (the *_init functions
+ * do that), so that callers compiled against a different version of this header are rejected with
+ * SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH instead of being misread.
+ *
+ * Hypergraphs are passed in the compressed sparse row format: the atoms of edge i are
+ * atoms[edge_offsets[i]] to atoms[edge_offsets[i + 1] - 1], so edge_offsets has edge_count + 1 elements.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define SETREPLACE_API __declspec(dllexport)
+#else
+#define SETREPLACE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented every time the layout of the structs or the meaning of the constants below changes. */
+#define SETREPLACE_API_VERSION 1
+
+/* Same as HypergraphSubstitutionSystem::stepLimitDisabled. */
+#define SETREPLACE_STEP_LIMIT_DISABLED INT64_MAX
+
+typedef enum {
+  SETREPLACE_OK = 0,
+  SETREPLACE_ERROR_INVALID_ARGUMENT = 1,
+  SETREPLACE_ERROR_BUFFER_TOO_SMALL = 2,
+  SETREPLACE_ERROR_ABORTED = 3,
+  SETREPLACE_ERROR_DISCONNECTED_INPUTS = 4,
+  SETREPLACE_ERROR_NON_POSITIVE_ATOMS = 5,
+  SETREPLACE_ERROR_ATOM_COUNT_OVERFLOW = 6,
+  SETREPLACE_ERROR_FINAL_STATE_STEP_SPECIFICATION_FOR_MULTIHISTORY = 7,
+  SETREPLACE_ERROR_OUT_OF_MEMORY = 8,
+  SETREPLACE_ERROR_UNKNOWN = 9,
+  /* Only possible if the library is built with SET_REPLACE_ENABLE_COMPACT_IDS. */
+  SETREPLACE_ERROR_TOKEN_COUNT_OVERFLOW = 10,
+  SETREPLACE_ERROR_EVENT_COUNT_OVERFLOW = 11,
+  SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH = 12
+} setreplace_status;
+
+/* Same values as HypergraphSubstitutionSystem::TerminationReason. */
+typedef enum {
+  SETREPLACE_NOT_TERMINATED = 0,
+  SETREPLACE_TERMINATED_MAX_EVENTS = 1,
+  SETREPLACE_TERMINATED_MAX_GENERATIONS_LOCAL = 2,
+  SETREPLACE_TERMINATED_MAX_FINAL_ATOMS = 3,
+  SETREPLACE_TERMINATED_MAX_FINAL_ATOM_DEGREE = 4,
+  SETREPLACE_TERMINATED_MAX_FINAL_TOKENS = 5,
+  SETREPLACE_TERMINATED_COMPLETE = 6,
+  SETREPLACE_TERMINATED_ABORTED = 7,
+  SETREPLACE_TERMINATED_TIME_CONSTRAINED = 8,
+  SETREPLACE_TERMINATED_MAX_MEMORY = 9
+} setreplace_termination_reason;
+
+/* Same values as EventSelectionFunction. */
+typedef enum {
+  SETREPLACE_EVENT_SELECTION_ALL = 0,
+  SETREPLACE_EVENT_SELECTION_SPACELIKE = 1
+} setreplace_event_selection;
+
+/* Same values as HypergraphMatcher::OrderingFunction. */
+typedef enum {
+  SETREPLACE_ORDERING_SORTED_INPUT_TOKEN_INDICES = 0,
+  SETREPLACE_ORDERING_REVERSE_SORTED_INPUT_TOKEN_INDICES = 1,
+  SETREPLACE_ORDERING_INPUT_TOKEN_INDICES = 2,
+  SETREPLACE_ORDERING_RULE_INDEX = 3,
+  SETREPLACE_ORDERING_ANY = 4,
+  SETREPLACE_ORDERING_MAX_INPUT_GENERATION = 5,
+  SETREPLACE_ORDERING_MIN_INPUT_GENERATION = 6,
+  SETREPLACE_ORDERING_RULE_WEIGHT = 7,
+  SETREPLACE_ORDERING_WEIGHTED_RANDOM = 8
+} setreplace_ordering_function;
+
+/* Same values as HypergraphMatcher::OrderingDirection. */
+typedef enum { SETREPLACE_ORDERING_NORMAL = 0, SETREPLACE_ORDERING_REVERSE = 1 } setreplace_ordering_direction;
+
+/* Same values as HypergraphMatcher::EventDeduplication. */
+typedef enum {
+  SETREPLACE_EVENT_DEDUPLICATION_NONE = 0,
+  SETREPLACE_EVENT_DEDUPLICATION_SAME_INPUT_SET_ISOMORPHIC_OUTPUTS = 1
+} setreplace_event_deduplication;
+
+/* Same values as MultiwayStateGraph::StateDeduplication. */
+typedef enum {
+  SETREPLACE_STATE_DEDUPLICATION_DISABLED = 0,
+  SETREPLACE_STATE_DEDUPLICATION_SAME_TOKENS = 1,
+  SETREPLACE_STATE_DEDUPLICATION_SAME_ATOMS_VECTORS = 2,
+  SETREPLACE_STATE_DEDUPLICATION_ISOMORPHIC_ATOMS_VECTORS = 3
+} setreplace_state_deduplication;
+
+typedef struct {
+  int64_t edge_count;
+  const int64_t* edge_offsets; /* edge_count + 1 elements */
+  const int64_t* atoms;
+} setreplace_hypergraph;
+
+/* Negative atoms are patterns. */
+typedef struct {
+  size_t struct_size; /* sizeof(setreplace_rule) */
+  setreplace_hypergraph inputs;
+  setreplace_hypergraph outputs;
+  int32_t event_selection; /* setreplace_event_selection */
+  double weight;           /* only used by SETREPLACE_ORDERING_RULE_WEIGHT and SETREPLACE_ORDERING_WEIGHTED_RANDOM */
+} setreplace_rule;
+
+typedef struct {
+  size_t struct_size; /* sizeof(setreplace_system_options) */
+  uint64_t max_destroyer_events;
+  int64_t ordering_count;
+  const int32_t* ordering_functions;  /* setreplace_ordering_function, ordering_count elements */
+  const int32_t* ordering_directions; /* setreplace_ordering_direction, ordering_count elements */
+  int32_t event_deduplication;        /* setreplace_event_deduplication */
+  int32_t state_deduplication;        /* setreplace_state_deduplication */
+  uint32_t random_seed;
+} setreplace_system_options;
+
+/* See HypergraphSubstitutionSystem::StepSpecification. */
+typedef struct {
+  size_t struct_size; /* sizeof(setreplace_step_specification) */
+  int64_t max_events;
+  int64_t max_generations_local;
+  int64_t max_final_atoms;
+  int64_t max_final_atom_degree;
+  int64_t max_final_tokens;
+  int64_t max_memory_bytes;
+} setreplace_step_specification;
+
+/* Sizes of the buffers needed for setreplace_system_events(). Events include the initial one. */
+typedef struct {
+  int64_t event_count;
+  int64_t input_token_count;
+  int64_t output_token_count;
+} setreplace_events_size;
+
+typedef struct setreplace_system setreplace_system;
+
+/* Returns SETREPLACE_API_VERSION of the library, which may differ from the one of the header. */
+SETREPLACE_API int32_t setreplace_api_version(void);
+
+/* Returns a static English description of the status. */
+SETREPLACE_API const char* setreplace_status_message(setreplace_status status);
+
+/* Sets empty inputs and outputs, SETREPLACE_EVENT_SELECTION_ALL and a unit weight. */
+SETREPLACE_API void setreplace_rule_init(setreplace_rule* rule);
+
+/* Sets the defaults of WolframModel: a single destroyer event, LeastRecentEdge, RuleOrdering and RuleIndex ordering,
+ * and no deduplication. The ordering arrays are static. */
+SETREPLACE_API void setreplace_system_options_init(setreplace_system_options* options);
+
+/* Disables all limits. */
+SETREPLACE_API void setreplace_step_specification_init(setreplace_step_specification* step_specification);
+
+/* Creates a system, which should be destroyed with setreplace_system_destroy(). The arguments are copied and are not
+ * referenced after the call. Returns SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH if the struct_size of the options or of any
+ * of the rules is not the one of this version of the library. */
+SETREPLACE_API setreplace_status setreplace_system_create(const setreplace_rule* rules,
+                                                          int64_t rule_count,
+                                                          const setreplace_hypergraph* initial_tokens,
+                                                          const setreplace_system_options* options,
+                                                          setreplace_system** system);
+
+SETREPLACE_API void setreplace_system_destroy(setreplace_system* system);
+
+/* Continues the evolution until one of the limits is reached. time_constraint_seconds <= 0 means no constraint, and
+ * abort_flag may be NULL. If aborted, returns SETREPLACE_ERROR_ABORTED, and the events made before the abort are kept.
+ * event_count, if not NULL, is set to the number of events made by this call. */
+SETREPLACE_API setreplace_status setreplace_system_replace(setreplace_system* system,
+                                                           const setreplace_step_specification* step_specification,
+                                                           double time_constraint_seconds,
+                                                           const volatile int32_t* abort_flag,
+                                                           int64_t* event_count);
+
+SETREPLACE_API setreplace_status setreplace_system_termination_reason(const setreplace_system* system,
+                                                                      int32_t* termination_reason);
+
+SETREPLACE_API setreplace_status setreplace_system_max_complete_generation(setreplace_system* system,
+                                                                           const volatile int32_t* abort_flag,
+                                                                           int64_t* generation);
+
+SETREPLACE_API setreplace_status setreplace_system_tokens_size(const setreplace_system* system,
+                                                               int64_t* token_count,
+                                                               int64_t* atom_count);
+
+/* Writes all tokens, past and present, as a hypergraph in the compressed sparse row format. edge_offsets should have
+ * space for token_count + 1 elements, and atoms for atom_count elements as returned by setreplace_system_tokens_size(),
+ * otherwise SETREPLACE_ERROR_BUFFER_TOO_SMALL is returned. */
+SETREPLACE_API setreplace_status setreplace_system_tokens(const setreplace_system* system,
+                                                          int64_t edge_offsets_capacity,
+                                                          int64_t* edge_offsets,
+                                                          int64_t atoms_capacity,
+                                                          int64_t* atoms);
+
+SETREPLACE_API setreplace_status setreplace_system_events_size(const setreplace_system* system,
+                                                               setreplace_events_size* size);
+
+/* Writes all events as a struct of arrays, see EventsStorage. The capacities of the buffers are given by capacity:
+ * rules and generations have event_count elements, the offsets have event_count + 1 elements, and the tokens have
+ * input_token_count and output_token_count elements. Any of the buffers may be NULL to skip it. */
+SETREPLACE_API setreplace_status setreplace_system_events(const setreplace_system* system,
+                                                          const setreplace_events_size* capacity,
+                                                          int32_t* rules,
+                                                          int64_t* generations,
+                                                          int64_t* input_offsets,
+                                                          int64_t* input_tokens,
+                                                          int64_t* output_offsets,
+                                                          int64_t* output_tokens);
+
+/* Writes the times of all events, including the initial one at time 0, if the last ordering function is
+ * SETREPLACE_ORDERING_WEIGHTED_RANDOM, see HypergraphSubstitutionSystem::eventTimes(). times should have space for
+ * capacity elements, the number of events is written to event_count. Returns SETREPLACE_ERROR_INVALID_ARGUMENT if the
+ * times are not recorded. */
+SETREPLACE_API setreplace_status setreplace_system_event_times(const setreplace_system* system,
+                                                               int64_t capacity,
+                                                               double* times,
+                                                               int64_t* event_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIBSETREPLACE_SETREPLACE_H_
@@ -0,0 +1,143 @@
+#include "Arena.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <scoped_allocator>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SetReplace {
+namespace {
+bool isAligned(const void* pointer) { return reinterpret_cast<uintptr_t>(pointer) % Arena::alignment == 0; }
+}  // namespace
+
+TEST(Arena, reusesFreedBlocks) {
+  Arena arena;
+  void* first = arena.allocate(24);
+  arena.deallocate(first, 24);
+  // Same size class
+  EXPECT_EQ(arena.allocate(32), first);
+  EXPECT_NE(arena.allocate(32), first);
+}
+
+TEST(Arena, alignedAndDistinctBlocks) {
+  Arena arena;
+  std::vector<std::pair<char*, size_t>> blocks;
+  for (size_t size = 0; size < 2 * Arena::maxPooledSize; size += 7) {
+    for (int i = 0; i < 100; ++i) {
+      auto* block = static_cast<char*>(arena.allocate(size));
+      ASSERT_TRUE(isAligned(block));
+      std::memset(block, static_cast<int>(blocks.size() % 256), size);
+      blocks.emplace_back(block, size);
+    }
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    for (size_t j = 0; j < blocks[i].second; ++j) {
+      ASSERT_EQ(static_cast<unsigned char>(blocks[i].first[j]), i % 256);
+    }
+  }
+  for (const auto& block : blocks) arena.deallocate(block.first, block.second);
+}
+
+TEST(Arena, largeAllocations) {
+  Arena arena;
+  void* small = arena.allocate(8);
+  const size_t reservedBytes = arena.reservedBytes();
+  EXPECT_GT(reservedBytes, 0);
+
+  void* large = arena.allocate(1 << 20);
+  EXPECT_TRUE(isAligned(large));
+  EXPECT_GE(arena.reservedBytes(), reservedBytes + (1 << 20));
+  arena.deallocate(large, 1 << 20);
+  EXPECT_EQ(arena.reservedBytes(), reservedBytes);
+
+  // Not deallocated explicitly, released with the arena
+  arena.allocate(1 << 16);
+  arena.deallocate(small, 8);
+}
+
+TEST(Arena, chunksGrow) {
+  Arena arena;
+  constexpr size_t blockCount = 1 << 16;
+  for (size_t i = 0; i < blockCount; ++i) arena.allocate(Arena::maxPooledSize);
+  // Chunks double in size, so at most half of the reserved memory is unused
+  EXPECT_GE(arena.reservedBytes(), blockCount * Arena::maxPooledSize);
+  EXPECT_LE(arena.reservedBytes(), 2 * blockCount * Arena::maxPooledSize);
+}
+
+TEST(Arena, hugePages) {
+  Arena arena(true);
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < (1 << 16); ++i) {
+    blocks.push_back(arena.allocate(64));
+    ASSERT_TRUE(isAligned(blocks.back()));
+  }
+  for (const auto block : blocks) arena.deallocate(block, 64);
+  void* large = arena.allocate(3 << 20);
+  arena.deallocate(large, 3 << 20);
+}
+
+TEST(Arena, threadSafe) {
+  Arena arena;
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < 4; ++thread) {
+    threads.emplace_back([&arena, thread]() {
+      std::vector<int*> blocks;
+      for (int i = 0; i < 10000; ++i) {
+        blocks.push_back(static_cast<int*>(arena.allocate(sizeof(int) * (1 + i % 100))));
+        *blocks.back() = thread;
+      }
+      for (size_t i = 0; i < blocks.size(); ++i) {
+        EXPECT_EQ(*blocks[i], thread);
+        arena.deallocate(blocks[i], sizeof(int) * (1 + i % 100));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+TEST(Arena, make) {
+  int destructorCalls = 0;
+  struct Counter {
+    int* destructorCalls;
+    ~Counter() { ++*destructorCalls; }
+  };
+  {
+    Arena arena;
+    using Map = std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int>>>;
+    auto& map = arena.make<Map>(ArenaAllocator<Map::value_type>(&arena));
+    for (int i = 0; i < 1000; ++i) map[i] = i;
+    EXPECT_EQ(map.size(), 1000);
+    arena.make<Counter>(Counter{&destructorCalls});
+  }
+  // Objects created with make() are released without being destroyed, the one destroyed here is the temporary
+  EXPECT_EQ(destructorCalls, 1);
+}
+
+TEST(ArenaAllocator, nestedContainers) {
+  Arena arena;
+  using Vector = std::vector<int, ArenaAllocator<int>>;
+  using Map = std::unordered_map<int,
+                                 Vector,
+                                 std::hash<int>,
+                                 std::equal_to<int>,
+                                 std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const int, Vector>>>>;
+  Map map{Map::allocator_type(ArenaAllocator<Map::value_type>(&arena))};
+  for (int i = 0; i < 1000; ++i) {
+    for (int j = 0; j <= i % 10; ++j) map[i].push_back(j);
+  }
+  EXPECT_EQ(map.size(), 1000);
+  for (const auto& keyAndVector : map) {
+    EXPECT_EQ(keyAndVector.second.get_allocator().arena(), &arena);
+    EXPECT_EQ(keyAndVector.second.size(), keyAndVector.first % 10 + 1);
+  }
+  EXPECT_EQ(ArenaAllocator<int>(&arena), ArenaAllocator<char>(&arena));
+  Arena otherArena;
+  EXPECT_NE(ArenaAllocator<int>(&arena), ArenaAllocator<int>(&otherArena));
+}
+}  // namespace SetReplace
@@ -0,0 +1,69 @@
+#include "AtomsGraph.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+constexpr auto doNotAbort = []() { return false; };
+
+TEST(AtomsGraph, pathConnectivity) {
+  const AtomsGraph graph({{1, 2, 3}, {3, 4}, {4, 4}, {2, 1}}, AtomsGraph::HyperedgeConnectivity::Path);
+  EXPECT_EQ(graph.atoms(), std::vector<Atom>({1, 2, 3, 4}));
+  EXPECT_EQ(graph.neighborOffsets(), std::vector<int64_t>({0, 1, 3, 5, 6}));
+  EXPECT_EQ(graph.neighbors(), std::vector<int64_t>({1, 0, 2, 1, 3, 2}));
+
+  EXPECT_EQ(graph.ballVolumes({1, 3}, 4, doNotAbort),
+            std::vector<std::vector<int64_t>>({{1, 2, 3, 4, 4}, {1, 3, 4, 4, 4}}));
+}
+
+TEST(AtomsGraph, cliqueConnectivity) {
+  const AtomsGraph graph({{1, 2, 3}, {3, 4}}, AtomsGraph::HyperedgeConnectivity::Clique);
+  EXPECT_EQ(graph.neighbors(), std::vector<int64_t>({1, 2, 0, 2, 0, 1, 3, 2}));
+  EXPECT_EQ(graph.ballVolumes({1, 4}, 2, doNotAbort), std::vector<std::vector<int64_t>>({{1, 3, 4}, {1, 2, 4}}));
+}
+
+TEST(AtomsGraph, disconnectedComponents) {
+  const AtomsGraph graph({{1, 2}, {3, 4}, {4, 5}}, AtomsGraph::HyperedgeConnectivity::Path);
+  EXPECT_EQ(graph.ballVolumes({2, 5, 2}, 3, doNotAbort),
+            std::vector<std::vector<int64_t>>({{1, 2, 2, 2}, {1, 2, 3, 3}, {1, 2, 2, 2}}));
+}
+
+TEST(AtomsGraph, invalidArguments) {
+  EXPECT_THROW(AtomsGraph({{1, 2}}, static_cast<AtomsGraph::HyperedgeConnectivity>(2)), AtomsGraph::Error);
+  const AtomsGraph graph({{1, 2}}, AtomsGraph::HyperedgeConnectivity::Path);
+  EXPECT_THROW(graph.ballVolumes({3}, 1, doNotAbort), AtomsGraph::Error);
+  EXPECT_THROW(graph.ballVolumes({1}, -1, doNotAbort), AtomsGraph::Error);
+  EXPECT_THROW(graph.ballVolumes({1}, 1, []() { return true; }), AtomsGraph::Error);
+}
+
+// Checks that the balls are grown correctly for multiple batches of centers, both sequentially and in parallel.
+TEST(AtomsGraph, cycleManyCenters) {
+  constexpr int64_t cycleLength = 200;
+  std::vector<AtomsVector> cycle;
+  for (Atom atom = 0; atom < cycleLength; ++atom) {
+    cycle.push_back({atom, static_cast<Atom>((atom + 1) % cycleLength)});
+  }
+  const AtomsGraph graph(cycle, AtomsGraph::HyperedgeConnectivity::Path);
+
+  std::vector<Atom> centers;
+  for (Atom atom = 0; atom < cycleLength; ++atom) {
+    centers.push_back((atom * 7) % cycleLength);
+  }
+
+  constexpr int64_t maxRadius = 120;
+  std::vector<int64_t> expectedVolumes;
+  for (int64_t radius = 0; radius <= maxRadius; ++radius) {
+    expectedVolumes.push_back(std::min(2 * radius + 1, cycleLength));
+  }
+  const std::vector<std::vector<int64_t>> expected(centers.size(), expectedVolumes);
+
+  for (const int hardwareThreads : {1, 4}) {
+    Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, hardwareThreads);
+    EXPECT_EQ(graph.ballVolumes(centers, maxRadius, doNotAbort), expected);
+  }
+}
+}  // namespace SetReplace
@@ -0,0 +1,117 @@
+#include "AtomsIndex.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+std::vector<TokenID> sorted(std::vector<TokenID> tokens) {
+  std::sort(tokens.begin(), tokens.end());
+  return tokens;
+}
+}  // namespace
+
+TEST(AtomsIndex, tokensMatchingPattern) {
+  const std::vector<AtomsVector> tokens = {{1, 2, 3}, {2, 1, 3}, {1, 2}, {1, 1, 2}, {1, 2, 3, 4, 5}, {3, 1, 2}};
+  AtomsIndex index([&tokens](const TokenID& token) -> const AtomsVector& { return tokens[token]; });
+  index.addTokens({0, 1, 2, 3, 4, 5});
+
+  // Arity and positions of the specific atoms are taken into account
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({1, -1, -2})), std::vector<TokenID>({0, 3}));
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({-1, 2})), std::vector<TokenID>({2}));
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({1, 2, -1})), std::vector<TokenID>({0}));
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({-1, 1, 2})), std::vector<TokenID>({3, 5}));
+  // Atoms can repeat
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({1, 1, -1})), std::vector<TokenID>({3}));
+  EXPECT_TRUE(index.tokensMatchingPattern({1, 2, 3, 4}).empty());
+  EXPECT_TRUE(index.tokensMatchingPattern({7, -1}).empty());
+  // At least one specific atom is required
+  EXPECT_TRUE(index.tokensMatchingPattern({-1, -2}).empty());
+
+  EXPECT_EQ(index.tokensContainingAtom(4), std::unordered_set<TokenID>({4}));
+  EXPECT_EQ(index.tokensContainingAtom(3), std::unordered_set<TokenID>({0, 1, 4, 5}));
+
+  index.removeTokens({0, 3});
+  EXPECT_EQ(sorted(index.tokensMatchingPattern({1, -1, -2})), std::vector<TokenID>());
+  EXPECT_EQ(index.tokensContainingAtom(3), std::unordered_set<TokenID>({1, 4, 5}));
+  EXPECT_EQ(index.tokensContainingAtom(1), std::unordered_set<TokenID>({1, 2, 4, 5}));
+}
+
+TEST(AtomsIndex, estimatedTokensMatchingPattern) {
+  // Atom 1 is a hub at the first position of binary tokens
+  std::vector<AtomsVector> tokens = {{2, 1}, {1, 1}, {1, 3, 1}};
+  for (Atom atom = 4; atom < 100; ++atom) tokens.push_back({1, atom});
+  std::vector<TokenID> tokenIDs(tokens.size());
+  for (size_t i = 0; i < tokens.size(); ++i) tokenIDs[i] = static_cast<TokenID>(i);
+  AtomsIndex index([&tokens](const TokenID& token) -> const AtomsVector& { return tokens[token]; });
+  index.addTokens(tokenIDs);
+
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({1, -1}), 97);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({-1, 1}), 2);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({1, 5}), 1);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({1, -1, 1}), 1);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({1, 100}), 0);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({-1, -2}), 0);
+  // The estimate is an upper bound of the actual count
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({2, 4}), 1);
+  EXPECT_TRUE(index.tokensMatchingPattern({2, 4}).empty());
+
+  index.removeTokens({0, 1, 3});
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({1, -1}), 95);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({-1, 1}), 0);
+  EXPECT_EQ(index.estimatedTokensMatchingPattern({2, -1}), 0);
+}
+
+TEST(AtomsIndex, longTokens) {
+  // Positions past the indexed ones are not distinguished, but still found
+  AtomsVector longToken(AtomsIndex::maxIndexedPositions + 2, 0);
+  longToken[AtomsIndex::maxIndexedPositions] = 1;
+  AtomsVector otherLongToken(AtomsIndex::maxIndexedPositions + 2, 0);
+  otherLongToken[AtomsIndex::maxIndexedPositions + 1] = 1;
+  const std::vector<AtomsVector> tokens = {longToken, otherLongToken};
+  AtomsIndex index([&tokens](const TokenID& token) -> const AtomsVector& { return tokens[token]; });
+  index.addTokens({0, 1});
+
+  AtomsVector pattern(AtomsIndex::maxIndexedPositions + 2, -1);
+  pattern[AtomsIndex::maxIndexedPositions] = 1;
+  EXPECT_EQ(sorted(index.tokensMatchingPattern(pattern)), std::vector<TokenID>({0, 1}));
+  pattern[0] = 0;
+  EXPECT_EQ(sorted(index.tokensMatchingPattern(pattern)), std::vector<TokenID>({0, 1}));
+  pattern[0] = 1;
+  EXPECT_TRUE(index.tokensMatchingPattern(pattern).empty());
+}
+
+TEST(AtomsIndex, parallelInsertion) {
+  // Large lists are indexed in multiple threads, which should produce the same index, including the order of tokens
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 4);
+  std::vector<AtomsVector> tokens;
+  std::vector<TokenID> ids;
+  for (Atom atom = 1; atom <= 30000; ++atom) {
+    tokens.push_back({atom % 1000 + 1, atom % 7 + 1, atom % 1000 + 1});
+    tokens.push_back({atom % 3 + 1, atom});
+    ids.push_back(static_cast<TokenID>(ids.size()));
+    ids.push_back(static_cast<TokenID>(ids.size()));
+  }
+  const auto getAtomsVector = [&tokens](const TokenID& token) -> const AtomsVector& { return tokens[token]; };
+  AtomsIndex parallelIndex(getAtomsVector);
+  parallelIndex.addTokens(ids);
+  AtomsIndex sequentialIndex(getAtomsVector);
+  for (const auto id : ids) sequentialIndex.addTokens({id});
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu,
+                                                   static_cast<int>(std::thread::hardware_concurrency()));
+
+  for (const AtomsVector& pattern : std::vector<AtomsVector>{
+           {5, -1, 5}, {5, 3, -1}, {-1, 3, -2}, {2, -1}, {-1, 12345}, {2, 12345}, {1001, -1, -2}, {-1, -2, 1000}}) {
+    EXPECT_EQ(parallelIndex.tokensMatchingPattern(pattern), sequentialIndex.tokensMatchingPattern(pattern));
+    EXPECT_EQ(parallelIndex.estimatedTokensMatchingPattern(pattern),
+              sequentialIndex.estimatedTokensMatchingPattern(pattern));
+  }
+  EXPECT_FALSE(parallelIndex.tokensMatchingPattern({-1, 3, -2}).empty());
+}
+}  // namespace SetReplace
@@ -0,0 +1,142 @@
+#include "CausalGraph.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+constexpr auto doNotAbort = []() { return false; };
+
+TEST(CausalGraph, diamond) {
+  const CausalGraph graph(6, {{5, 4}, {4, 3}, {4, 2}, {3, 1}, {2, 1}, {0, 1}});
+  EXPECT_EQ(graph.vertexCount(), 6);
+  EXPECT_EQ(graph.diamond(4, 1).size(), 4);
+  EXPECT_EQ(graph.diamond(4, 1).front(), 4);
+  EXPECT_EQ(graph.diamond(4, 1).back(), 1);
+  EXPECT_EQ(graph.diamond(4, 4), std::vector<int64_t>({4}));
+  EXPECT_TRUE(graph.diamond(1, 4).empty());
+  EXPECT_TRUE(graph.diamond(3, 2).empty());
+}
+
+TEST(CausalGraph, invalidGraphs) {
+  EXPECT_THROW(CausalGraph(2, {{0, 1}, {1, 0}}), CausalGraph::Error);
+  EXPECT_THROW(CausalGraph(2, {{1, 1}}), CausalGraph::Error);
+  EXPECT_THROW(CausalGraph(2, {{0, 2}}), CausalGraph::Error);
+  const CausalGraph graph(2, {{0, 1}});
+  EXPECT_THROW(graph.diamond(0, 2), CausalGraph::Error);
+  EXPECT_THROW(graph.diamondCounts(0, 1, []() { return true; }), CausalGraph::Error);
+}
+
+TEST(CausalGraph, pathDiamondCounts) {
+  constexpr int64_t length = 100;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  for (int64_t i = length - 1; i > 0; --i) {
+    edges.emplace_back(i - 1, i);
+  }
+  const CausalGraph graph(length, edges);
+  const auto counts = graph.diamondCounts(0, 89, doNotAbort);
+  EXPECT_EQ(counts.vertexCount, 90);
+  EXPECT_EQ(counts.comparablePairCount, 90 * 89 / 2);
+
+  const auto emptyCounts = graph.diamondCounts(89, 0, doNotAbort);
+  EXPECT_EQ(emptyCounts.vertexCount, 0);
+  EXPECT_EQ(emptyCounts.comparablePairCount, 0);
+}
+
+// Diamond with a layer of parallel vertices in the middle, i.e., 1 -> k -> 1002 for k in 2 ... 1001.
+TEST(CausalGraph, wideDiamondCounts) {
+  constexpr int64_t width = 1000;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  for (int64_t i = 1; i <= width; ++i) {
+    edges.emplace_back(0, i);
+    edges.emplace_back(i, width + 1);
+  }
+  const CausalGraph graph(width + 2, edges);
+  for (const int hardwareThreads : {1, 4}) {
+    Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, hardwareThreads);
+    const auto counts = graph.diamondCounts(0, width + 1, doNotAbort);
+    EXPECT_EQ(counts.vertexCount, width + 2);
+    EXPECT_EQ(counts.comparablePairCount, 2 * width + 1);
+  }
+}
+
+TEST(CausalGraph, events) {
+  const std::vector<Rule> rules = {{{{-1, -2}}, {{-1, -3}, {-3, -2}}, EventSelectionFunction::All}};
+  HypergraphSubstitutionSystem system(rules,
+                                      {{1, 2}},
+                                      HypergraphSubstitutionSystem::stepLimitDisabled,
+                                      {{HypergraphMatcher::OrderingFunction::SortedInputTokenIndices,
+                                        HypergraphMatcher::OrderingDirection::Normal}},
+                                      HypergraphMatcher::EventDeduplication::None);
+  system.replace({HypergraphSubstitutionSystem::stepLimitDisabled, 3}, doNotAbort);
+  const CausalGraph graph(system.events());
+
+  // Each event of the binary tree has two children, plus the initial event.
+  EXPECT_EQ(graph.vertexCount(), 1 + 1 + 2 + 4);
+  const auto counts = graph.diamondCounts(initialConditionEvent, 1, doNotAbort);
+  EXPECT_EQ(counts.vertexCount, 2);
+  EXPECT_EQ(counts.comparablePairCount, 1);
+  EXPECT_EQ(graph.diamond(1, 7), std::vector<int64_t>({1, 3, 7}));
+
+  EXPECT_EQ(graph.edgeOffsets(), std::vector<int64_t>({0, 1, 3, 5, 7, 7, 7, 7, 7}));
+  EXPECT_EQ(graph.edgeTargets(), std::vector<int64_t>({1, 2, 3, 4, 5, 6, 7}));
+  std::vector<Generation> generations;
+  for (const auto& event : system.events()) {
+    generations.push_back(event.generation);
+  }
+  EXPECT_EQ(graph.layers(), generations);
+}
+
+TEST(CausalGraph, transitiveReduction) {
+  // 0 -> 1 -> 2 -> 3 with shortcuts 0 -> 2, 0 -> 3 and a multiple edge 2 -> 3, and a separate edge 4 -> 3.
+  const CausalGraph graph(5, {{0, 1}, {1, 2}, {2, 3}, {0, 2}, {0, 3}, {2, 3}, {4, 3}});
+  EXPECT_EQ(graph.layers(), std::vector<Generation>({0, 1, 2, 3, 0}));
+
+  for (const int hardwareThreads : {1, 4}) {
+    Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, hardwareThreads);
+    const auto reduction = graph.transitiveReduction(doNotAbort);
+    EXPECT_EQ(reduction.edgeOffsets(), std::vector<int64_t>({0, 1, 2, 3, 3, 4}));
+    EXPECT_EQ(reduction.edgeTargets(), std::vector<int64_t>({1, 2, 3, 3}));
+    EXPECT_EQ(reduction.layers(), graph.layers());
+  }
+}
+
+// Large enough to be split between threads, a path with random shortcuts, which are all removed by the reduction.
+TEST(CausalGraph, parallelTransitiveReduction) {
+  constexpr int64_t vertexCount = 3 * 4096 + 17;
+  std::vector<std::pair<int64_t, int64_t>> edges;
+  std::mt19937 randomGenerator(123);
+  for (int64_t i = 0; i + 1 < vertexCount; ++i) {
+    edges.emplace_back(i, i + 1);
+    std::uniform_int_distribution<int64_t> distribution(i + 1, std::min(i + 100, vertexCount - 1));
+    for (int k = 0; k < 3; ++k) edges.emplace_back(i, distribution(randomGenerator));
+  }
+  std::shuffle(edges.begin(), edges.end(), randomGenerator);
+  const CausalGraph graph(vertexCount, edges);
+
+  std::vector<int64_t> expectedOffsets;
+  std::vector<int64_t> expectedTargets;
+  for (int64_t i = 0; i < vertexCount; ++i) {
+    expectedOffsets.push_back(i);
+    if (i > 0) expectedTargets.push_back(i);
+  }
+  expectedOffsets.push_back(vertexCount - 1);
+
+  std::vector<CausalGraph> reductions;
+  for (const int hardwareThreads : {1, 4}) {
+    Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, hardwareThreads);
+    reductions.push_back(graph.transitiveReduction(doNotAbort));
+    EXPECT_EQ(reductions.back().edgeOffsets(), expectedOffsets);
+    EXPECT_EQ(reductions.back().edgeTargets(), expectedTargets);
+  }
+  EXPECT_EQ(reductions[0].edgeOffsets(), reductions[1].edgeOffsets());
+  EXPECT_EQ(reductions[0].edgeTargets(), reductions[1].edgeTargets());
+  EXPECT_EQ(reductions[0].layers(), reductions[1].layers());
+}
+}  // namespace SetReplace
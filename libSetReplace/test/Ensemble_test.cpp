@@ -0,0 +1,123 @@
+#include "Ensemble.hpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+// Merges pairs of edges sharing a source, so the final state depends on the order of events, which is random.
+const std::vector<Rule> rules = {{{{-1, -2}, {-1, -3}}, {{-2, -3}, {-3, -4}}}};
+const std::vector<AtomsVector> star = {{1, 2}, {1, 3}, {1, 4}, {1, 5}, {1, 6}, {1, 7}, {2, 3}, {3, 4}};
+
+std::vector<Ensemble::Job> testJobs(const int count) {
+  std::vector<Ensemble::Job> jobs;
+  for (int i = 0; i < count; ++i) {
+    jobs.push_back({star, static_cast<unsigned int>(i), HypergraphSubstitutionSystem::StepSpecification{10 + i}});
+  }
+  return jobs;
+}
+
+std::vector<Ensemble::Summary> evolveTestJobs(const int count, const bool includeFinalTokens) {
+  return Ensemble::evolve(
+      rules, testJobs(count), 1, {}, HypergraphMatcher::EventDeduplication::None, includeFinalTokens, doNotAbort);
+}
+}  // namespace
+
+TEST(Ensemble, sameAsIndividualSystems) {
+  const auto jobs = testJobs(8);
+  const auto summaries = evolveTestJobs(8, true);
+  ASSERT_EQ(summaries.size(), jobs.size());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    HypergraphSubstitutionSystem system(
+        rules, jobs[i].initialTokens, 1, {}, HypergraphMatcher::EventDeduplication::None, jobs[i].randomSeed);
+    system.replace(jobs[i].stepSpec, doNotAbort);
+    const auto events = system.events();
+    EXPECT_EQ(summaries[i].eventCount, static_cast<int64_t>(events.size()) - 1);
+    EXPECT_EQ(summaries[i].terminationReason, system.terminationReason());
+    EXPECT_EQ(summaries[i].finalTokenCount, static_cast<int64_t>(summaries[i].finalTokens.size()));
+
+    std::vector<bool> isDestroyed(system.tokenCount(), false);
+    for (const auto& event : events) {
+      for (const auto token : event.inputTokens) isDestroyed[token] = true;
+    }
+    std::vector<AtomsVector> finalTokens;
+    for (TokenID token = 0; token < system.tokenCount(); ++token) {
+      if (!isDestroyed[token]) finalTokens.push_back(system.tokenAtoms(token));
+    }
+    EXPECT_EQ(summaries[i].finalTokens, finalTokens);
+  }
+}
+
+TEST(Ensemble, summaries) {
+  const std::vector<Ensemble::Job> jobs = {{{{1, 2}, {1, 3}}}, {{{1, 2}, {1, 3}, {1, 4}}}, {{{1, 2}}}};
+  const auto summaries = Ensemble::evolve(rules,
+                                          jobs,
+                                          1,
+                                          {},
+                                          HypergraphMatcher::EventDeduplication::None,
+                                          false,
+                                          doNotAbort);
+  ASSERT_EQ(summaries.size(), 3);
+  for (const auto& summary : summaries) {
+    EXPECT_EQ(summary.terminationReason, HypergraphSubstitutionSystem::TerminationReason::Complete);
+    EXPECT_TRUE(summary.finalTokens.empty());
+  }
+  // {{1, 2}, {1, 3}} -> {{2, 3}, {3, 4}}
+  EXPECT_EQ(summaries[0].eventCount, 1);
+  EXPECT_EQ(summaries[0].generationCount, 1);
+  EXPECT_EQ(summaries[0].finalTokenCount, 2);
+  EXPECT_EQ(summaries[0].finalAtomCount, 3);
+  // The edge left over from the star cannot be merged with the new ones
+  EXPECT_EQ(summaries[1].eventCount, 1);
+  EXPECT_EQ(summaries[1].finalTokenCount, 3);
+  EXPECT_EQ(summaries[2].eventCount, 0);
+  EXPECT_EQ(summaries[2].generationCount, 0);
+  EXPECT_EQ(summaries[2].finalTokenCount, 1);
+  EXPECT_EQ(summaries[2].finalAtomCount, 2);
+}
+
+TEST(Ensemble, independentOfThreadCount) {
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 4);
+  const auto parallelSummaries = evolveTestJobs(16, true);
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 1);
+  const auto sequentialSummaries = evolveTestJobs(16, true);
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu,
+                                                   static_cast<int>(std::thread::hardware_concurrency()));
+
+  ASSERT_EQ(parallelSummaries.size(), sequentialSummaries.size());
+  for (size_t i = 0; i < parallelSummaries.size(); ++i) {
+    EXPECT_EQ(parallelSummaries[i].eventCount, sequentialSummaries[i].eventCount);
+    EXPECT_EQ(parallelSummaries[i].generationCount, sequentialSummaries[i].generationCount);
+    EXPECT_EQ(parallelSummaries[i].finalAtomCount, sequentialSummaries[i].finalAtomCount);
+    EXPECT_EQ(parallelSummaries[i].terminationReason, sequentialSummaries[i].terminationReason);
+    EXPECT_EQ(parallelSummaries[i].finalTokens, sequentialSummaries[i].finalTokens);
+  }
+}
+
+TEST(Ensemble, errors) {
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 4);
+  auto jobs = testJobs(8);
+  jobs[5].initialTokens = {{1, 0}};
+  EXPECT_THROW(
+      Ensemble::evolve(rules, std::move(jobs), 1, {}, HypergraphMatcher::EventDeduplication::None, false, doNotAbort),
+      HypergraphSubstitutionSystem::Error);
+  EXPECT_THROW(Ensemble::evolve(rules,
+                                testJobs(8),
+                                1,
+                                {},
+                                HypergraphMatcher::EventDeduplication::None,
+                                false,
+                                []() { return true; }),
+               HypergraphMatcher::Error);
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu,
+                                                   static_cast<int>(std::thread::hardware_concurrency()));
+}
+}  // namespace SetReplace
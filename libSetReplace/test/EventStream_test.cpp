@@ -0,0 +1,141 @@
+#include "EventStream.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+std::string temporaryPath(const std::string& name) { return testing::TempDir() + "EventStream_test_" + name; }
+
+HypergraphSubstitutionSystem testSystem(const uint64_t maxDestroyerEvents = 1) {
+  // Grows a ring
+  const std::vector<Rule> rules = {{{{-1, -2}, {-2, -3}}, {{-1, -3}, {-3, -4}, {-4, -2}, {-2, -3}}}};
+  return HypergraphSubstitutionSystem(
+      rules, {{1, 2}, {2, 3}, {3, 4}, {4, 1}}, maxDestroyerEvents, {}, HypergraphMatcher::EventDeduplication::None);
+}
+
+// Events are read backwards, so that they are not decoded in the order they are stored.
+void expectSameHistory(const EventStreamReader& reader, const HypergraphSubstitutionSystem& system) {
+  const auto events = system.events();
+  ASSERT_EQ(reader.eventCount(), static_cast<int64_t>(events.size()));
+  for (EventID eventID = reader.eventCount() - 1; eventID >= 0; --eventID) {
+    const auto event = reader.event(eventID);
+    const auto expectedEvent = events[eventID];
+    EXPECT_EQ(event.rule, expectedEvent.rule);
+    EXPECT_EQ(event.inputTokens,
+              std::vector<TokenID>(expectedEvent.inputTokens.begin(), expectedEvent.inputTokens.end()));
+    EXPECT_EQ(event.outputTokens,
+              std::vector<TokenID>(expectedEvent.outputTokens.begin(), expectedEvent.outputTokens.end()));
+    EXPECT_EQ(event.generation, expectedEvent.generation);
+  }
+
+  const auto tokens = system.tokens();
+  ASSERT_EQ(reader.tokenCount(), static_cast<int64_t>(tokens.size()));
+  for (TokenID token = static_cast<TokenID>(reader.tokenCount()) - 1; token >= 0; --token) {
+    EXPECT_EQ(reader.tokenAtoms(token), tokens[token]);
+  }
+}
+}  // namespace
+
+TEST(EventStream, roundTrip) {
+  const auto path = temporaryPath("roundTrip");
+  auto system = testSystem();
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{10}, doNotAbort);
+  // Past events are written once the sink is set
+  system.setEventSink(std::make_shared<EventStreamWriter>(path, 16));
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{200}, doNotAbort);
+  EXPECT_EQ(system.events().size(), 201);
+
+  const EventStreamReader reader(path);
+  expectSameHistory(reader, system);
+  EXPECT_THROW(reader.event(reader.eventCount()), EventStreamReader::Error);
+  EXPECT_THROW(reader.event(-1), EventStreamReader::Error);
+  EXPECT_THROW(reader.tokenAtoms(static_cast<TokenID>(reader.tokenCount())), EventStreamReader::Error);
+}
+
+TEST(EventStream, discardedHistory) {
+  const auto path = temporaryPath("discardedHistory");
+  auto expectedSystem = testSystem();
+  expectedSystem.replace(HypergraphSubstitutionSystem::StepSpecification{500}, doNotAbort);
+
+  auto system = testSystem();
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{100}, doNotAbort);
+  const auto writer = std::make_shared<EventStreamWriter>(path);
+  system.setEventSink(writer, false);
+  EXPECT_THROW(system.events(), HypergraphSubstitutionSystem::Error);
+  EXPECT_THROW(system.tokens(), HypergraphSubstitutionSystem::Error);
+  // The new sink would not get the past events
+  EXPECT_THROW(system.setEventSink(nullptr), HypergraphSubstitutionSystem::Error);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{500}, doNotAbort);
+  EXPECT_EQ(system.tokenCount(), expectedSystem.tokenCount());
+  EXPECT_EQ(writer->eventCount(), 501);
+
+  const EventStreamReader reader(path);
+  expectSameHistory(reader, expectedSystem);
+
+  // Only the tokens that were not destroyed are kept
+  std::vector<bool> isDestroyed(system.tokenCount(), false);
+  for (EventID event = 0; event < reader.eventCount(); ++event) {
+    for (const auto token : reader.event(event).inputTokens) isDestroyed[token] = true;
+  }
+  for (TokenID token = 0; token < static_cast<TokenID>(system.tokenCount()); ++token) {
+    EXPECT_EQ(system.tokenAtoms(token), isDestroyed[token] ? AtomsVector() : reader.tokenAtoms(token));
+  }
+}
+
+TEST(EventStream, historyRequiredForMultihistories) {
+  auto system = testSystem(2);
+  EXPECT_THROW(system.setEventSink(std::make_shared<EventStreamWriter>(temporaryPath("multihistory")), false),
+               HypergraphSubstitutionSystem::Error);
+  EXPECT_NO_THROW(system.events());
+}
+
+TEST(EventStream, compactEncoding) {
+  const auto path = temporaryPath("compactEncoding");
+  auto system = testSystem();
+  system.setEventSink(std::make_shared<EventStreamWriter>(path), false);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{1000}, doNotAbort);
+
+  // Rule, generation, input count and output count of each event, input token IDs, and atom counts and atoms of tokens
+  const EventStreamReader reader(path);
+  int64_t numberCount = 4 * reader.eventCount();
+  for (EventID event = 0; event < reader.eventCount(); ++event) {
+    numberCount += static_cast<int64_t>(reader.event(event).inputTokens.size());
+  }
+  for (TokenID token = 0; token < static_cast<TokenID>(reader.tokenCount()); ++token) {
+    numberCount += 1 + static_cast<int64_t>(reader.tokenAtoms(token).size());
+  }
+  // Most numbers only take a single byte
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  EXPECT_LT(static_cast<double>(file.tellg()), 1.5 * static_cast<double>(numberCount));
+}
+
+TEST(EventStream, invalidFiles) {
+  EXPECT_THROW(EventStreamWriter("/nonexistent-directory/events"), EventStreamWriter::Error);
+  EXPECT_THROW(EventStreamReader("/nonexistent-directory/events"), EventStreamReader::Error);
+
+  const auto path = temporaryPath("invalidFiles");
+  std::ofstream(path) << "not an event stream";
+  EXPECT_THROW(EventStreamReader{path}, EventStreamReader::Error);
+
+  // A truncated stream, e.g., if the evolution was killed in the middle of writing
+  const auto truncatedPath = temporaryPath("truncated");
+  {
+    auto system = testSystem();
+    system.setEventSink(std::make_shared<EventStreamWriter>(truncatedPath));
+    system.replace(HypergraphSubstitutionSystem::StepSpecification{10}, doNotAbort);
+  }
+  std::ifstream file(truncatedPath, std::ios::binary);
+  const std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::ofstream(truncatedPath, std::ios::binary | std::ios::trunc) << contents.substr(0, contents.size() - 1);
+  EXPECT_THROW(EventStreamReader{truncatedPath}, EventStreamReader::Error);
+}
+}  // namespace SetReplace
@@ -0,0 +1,142 @@
+#include "EvolutionSpecification.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SetReplace {
+namespace {
+EvolutionSpecification parseString(const std::string& text, int64_t* errorLine) {
+  std::istringstream input(text);
+  return EvolutionSpecification::parse(input, errorLine);
+}
+
+EvolutionSpecification::Error parseError(const std::string& text, int64_t* errorLine) {
+  try {
+    parseString(text, errorLine);
+  } catch (const EvolutionSpecification::Error error) {
+    return error;
+  }
+  ADD_FAILURE() << "Expected an error for: " << text;
+  return EvolutionSpecification::Error::NoRules;
+}
+}  // namespace
+
+TEST(EvolutionSpecification, fullSpecification) {
+  int64_t errorLine;
+  const auto specification = parseString(
+      "# comment\n"
+      "rule -1 -2, -2 -3 -> -1 -3, -1 -4, -4 -3  # trailing comment\n"
+      "spacelikeRule -1->-1 -2\n"
+      "ruleWeight 2.5\n"
+      "\n"
+      "init 1 2, 2 3\n"
+      "init 3 1\n"
+      "maxEvents 100\n"
+      "maxGenerations 5\n"
+      "maxVertices 1000\n"
+      "maxVertexDegree 10\n"
+      "maxEdges Infinity\n"
+      "maxMemory 64\n"
+      "maxDestroyerEvents Infinity\n"
+      "ordering OldestGeneration NewestEdge RuleIndex Random\n"
+      "eventDeduplication SameInputSetIsomorphicOutputs\n"
+      "seed 42\n"
+      "timeConstraint 60\n",
+      &errorLine);
+
+  ASSERT_EQ(specification.rules.size(), 2);
+  EXPECT_EQ(specification.rules[0].inputs, std::vector<AtomsVector>({{-1, -2}, {-2, -3}}));
+  EXPECT_EQ(specification.rules[0].outputs, std::vector<AtomsVector>({{-1, -3}, {-1, -4}, {-4, -3}}));
+  EXPECT_EQ(specification.rules[0].eventSelectionFunction, EventSelectionFunction::All);
+  EXPECT_EQ(specification.rules[1].inputs, std::vector<AtomsVector>({{-1}}));
+  EXPECT_EQ(specification.rules[1].outputs, std::vector<AtomsVector>({{-1, -2}}));
+  EXPECT_EQ(specification.rules[1].eventSelectionFunction, EventSelectionFunction::Spacelike);
+  EXPECT_EQ(specification.rules[0].weight, 1);
+  EXPECT_EQ(specification.rules[1].weight, 2.5);
+  EXPECT_EQ(specification.initialTokens, std::vector<AtomsVector>({{1, 2}, {2, 3}, {3, 1}}));
+
+  EXPECT_EQ(specification.stepSpec.maxEvents, 100);
+  EXPECT_EQ(specification.stepSpec.maxGenerationsLocal, 5);
+  EXPECT_EQ(specification.stepSpec.maxFinalAtoms, 1000);
+  EXPECT_EQ(specification.stepSpec.maxFinalAtomDegree, 10);
+  EXPECT_EQ(specification.stepSpec.maxFinalTokens, HypergraphSubstitutionSystem::stepLimitDisabled);
+  EXPECT_EQ(specification.stepSpec.maxMemoryBytes, 64 << 20);
+  EXPECT_EQ(specification.maxDestroyerEvents, HypergraphSubstitutionSystem::stepLimitDisabled);
+  EXPECT_EQ(specification.orderingSpec,
+            HypergraphMatcher::OrderingSpec({{HypergraphMatcher::OrderingFunction::MaxInputGeneration,
+                                              HypergraphMatcher::OrderingDirection::Normal},
+                                             {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+                                              HypergraphMatcher::OrderingDirection::Reverse},
+                                             {HypergraphMatcher::OrderingFunction::RuleIndex,
+                                              HypergraphMatcher::OrderingDirection::Normal}}));
+  EXPECT_EQ(specification.eventDeduplication, HypergraphMatcher::EventDeduplication::SameInputSetIsomorphicOutputs);
+  EXPECT_EQ(specification.randomSeed, 42);
+  EXPECT_EQ(specification.timeConstraintSeconds, 60);
+}
+
+TEST(EvolutionSpecification, defaults) {
+  int64_t errorLine;
+  const auto specification = parseString("rule -1 -> -1, -1", &errorLine);
+  EXPECT_TRUE(specification.initialTokens.empty());
+  EXPECT_EQ(specification.stepSpec.maxEvents, HypergraphSubstitutionSystem::stepLimitDisabled);
+  EXPECT_EQ(specification.stepSpec.maxMemoryBytes, HypergraphSubstitutionSystem::stepLimitDisabled);
+  EXPECT_EQ(specification.maxDestroyerEvents, 1);
+  EXPECT_EQ(specification.orderingSpec.size(), 3);
+  EXPECT_EQ(specification.eventDeduplication, HypergraphMatcher::EventDeduplication::None);
+  EXPECT_EQ(specification.randomSeed, 0);
+  EXPECT_EQ(specification.timeConstraintSeconds, 0);
+}
+
+TEST(EvolutionSpecification, weightedRandomOrdering) {
+  int64_t errorLine;
+  const auto specification =
+      parseString("rule -1 -> -1\nruleWeight 2\nordering OldestGeneration WeightedRandom", &errorLine);
+  EXPECT_EQ(specification.rules[0].weight, 2);
+  EXPECT_EQ(specification.orderingSpec.size(), 2);
+  EXPECT_TRUE(HypergraphMatcher::isWeightedRandom(specification.orderingSpec));
+}
+
+TEST(EvolutionSpecification, errors) {
+  const std::vector<std::pair<std::string, EvolutionSpecification::Error>> cases = {
+      {"rule -1 -> -1\nfoo 1", EvolutionSpecification::Error::UnknownKeyword},
+      {"rule -1 -> -1\nmaxEvents 1x", EvolutionSpecification::Error::InvalidInteger},
+      {"rule -1 -> -1\nmaxEvents -1", EvolutionSpecification::Error::InvalidInteger},
+      {"rule -1 -> -1\nrule -1 -2", EvolutionSpecification::Error::InvalidRule},
+      {"rule -1 -> -1\nruleWeight heavy", EvolutionSpecification::Error::InvalidWeight},
+      {"init 1\nruleWeight 2", EvolutionSpecification::Error::InvalidWeight},
+      {"rule -1 -> -1\nordering Oldest", EvolutionSpecification::Error::InvalidOrderingFunction},
+      {"rule -1 -> -1\nordering Random OldestEdge", EvolutionSpecification::Error::InvalidOrderingFunction},
+      {"rule -1 -> -1\neventDeduplication All", EvolutionSpecification::Error::InvalidEventDeduplication},
+      {"rule -1 -> -1\nseed", EvolutionSpecification::Error::MissingValue},
+      {"rule -1 -> -1\nseed 1 2", EvolutionSpecification::Error::UnexpectedValue}};
+  for (const auto& [text, error] : cases) {
+    int64_t errorLine;
+    EXPECT_EQ(parseError(text, &errorLine), error) << text;
+    EXPECT_EQ(errorLine, 2) << text;
+  }
+
+  int64_t errorLine;
+  EXPECT_EQ(parseError("init 1 2\n", &errorLine), EvolutionSpecification::Error::NoRules);
+}
+
+TEST(EvolutionSpecification, evolution) {
+  int64_t errorLine;
+  const auto specification = parseString(
+      "rule -1 -2 -> -1 -3, -3 -2\n"
+      "init 1 2\n"
+      "maxEvents 7\n",
+      &errorLine);
+  HypergraphSubstitutionSystem system(specification.rules,
+                                      specification.initialTokens,
+                                      specification.maxDestroyerEvents,
+                                      specification.orderingSpec,
+                                      specification.eventDeduplication,
+                                      specification.randomSeed);
+  EXPECT_EQ(system.replace(specification.stepSpec, []() { return false; }), 7);
+  EXPECT_EQ(system.terminationReason(), HypergraphSubstitutionSystem::TerminationReason::MaxEvents);
+}
+}  // namespace SetReplace
@@ -0,0 +1,354 @@
+#include "HypergraphMatcher.hpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AtomsIndex.hpp"
+#include "Parallelism.hpp"
+#include "Rule.hpp"
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+// Unary tokens {1}, {2}, ... with given generations, all matching a single-input rule.
+class UnaryTokens {
+ public:
+  explicit UnaryTokens(std::vector<Generation> generations) : generations_(std::move(generations)), index_(getter()) {
+    for (size_t i = 0; i < generations_.size(); ++i) {
+      tokens_.push_back({static_cast<Atom>(i + 1)});
+      ids_.push_back(static_cast<TokenID>(i));
+    }
+    index_.addTokens(ids_);
+  }
+
+  GetAtomsVectorFunc getter() {
+    return [this](const TokenID& id) -> const AtomsVector& { return tokens_.at(id); };
+  }
+
+  GetTokenGenerationFunc generationGetter() {
+    return [this](const TokenID& id) { return generations_.at(id); };
+  }
+
+  AtomsIndex* index() { return &index_; }
+
+  const std::vector<TokenID>& ids() const { return ids_; }
+
+ private:
+  std::vector<AtomsVector> tokens_;
+  std::vector<TokenID> ids_;
+  const std::vector<Generation> generations_;
+  AtomsIndex index_;
+};
+
+const GetTokenSeparationFunc unknownSeparation = [](const TokenID&, const TokenID&) {
+  return SeparationType::Unknown;
+};
+
+std::vector<Generation> removeAllMatches(HypergraphMatcher* matcher) {
+  std::vector<Generation> result;
+  while (!matcher->empty()) {
+    const auto match = matcher->nextMatch();
+    result.push_back(match->maxInputGeneration);
+    matcher->removeMatchesInvolvingTokens(match->inputTokens);
+  }
+  return result;
+}
+}  // namespace
+
+TEST(HypergraphMatcher, generationOrdering) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  const std::vector<Generation> generations = {3, 1, 4, 1, 5, 9, 2, 6};
+  for (const auto direction : {HypergraphMatcher::OrderingDirection::Normal,
+                               HypergraphMatcher::OrderingDirection::Reverse}) {
+    UnaryTokens tokens(generations);
+    HypergraphMatcher matcher(rules,
+                              tokens.index(),
+                              tokens.getter(),
+                              unknownSeparation,
+                              {{HypergraphMatcher::OrderingFunction::MaxInputGeneration, direction}},
+                              HypergraphMatcher::EventDeduplication::None,
+                              0,
+                              tokens.generationGetter());
+    matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+    EXPECT_EQ(matcher.allMatches().size(), generations.size());
+    if (direction == HypergraphMatcher::OrderingDirection::Normal) {
+      EXPECT_EQ(removeAllMatches(&matcher), std::vector<Generation>({1, 1, 2, 3, 4, 5, 6, 9}));
+    } else {
+      EXPECT_EQ(removeAllMatches(&matcher), std::vector<Generation>({9, 6, 5, 4, 3, 2, 1, 1}));
+    }
+  }
+}
+
+TEST(HypergraphMatcher, generationOrderingInsertionBelowFirstMatch) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  UnaryTokens tokens({5, 7, 2});
+  HypergraphMatcher matcher(
+      rules,
+      tokens.index(),
+      tokens.getter(),
+      unknownSeparation,
+      {{HypergraphMatcher::OrderingFunction::MinInputGeneration, HypergraphMatcher::OrderingDirection::Normal}},
+      HypergraphMatcher::EventDeduplication::None,
+      0,
+      tokens.generationGetter());
+  matcher.addMatchesInvolvingTokens({0, 1}, doNotAbort);
+  EXPECT_EQ(matcher.nextMatch()->minInputGeneration, 5);
+  matcher.addMatchesInvolvingTokens({2}, doNotAbort);
+  EXPECT_EQ(matcher.nextMatch()->minInputGeneration, 2);
+  EXPECT_EQ(removeAllMatches(&matcher), std::vector<Generation>({2, 5, 7}));
+}
+
+TEST(HypergraphMatcher, generationOrderingRequiresGenerations) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  UnaryTokens tokens({0});
+  EXPECT_THROW(HypergraphMatcher(rules,
+                                 tokens.index(),
+                                 tokens.getter(),
+                                 unknownSeparation,
+                                 {{HypergraphMatcher::OrderingFunction::MaxInputGeneration,
+                                   HypergraphMatcher::OrderingDirection::Normal}},
+                                 HypergraphMatcher::EventDeduplication::None),
+               HypergraphMatcher::Error);
+}
+
+TEST(HypergraphMatcher, disconnectedInputs) {
+  // {{-1}, {-2}} -> {} matches all ordered pairs of distinct tokens
+  const std::vector<Rule> rules = {{{{-1}, {-2}}, {}, EventSelectionFunction::All}};
+  UnaryTokens tokens({0, 0, 0, 0});
+  HypergraphMatcher matcher(rules,
+                            tokens.index(),
+                            tokens.getter(),
+                            unknownSeparation,
+                            {},
+                            HypergraphMatcher::EventDeduplication::None);
+  matcher.addMatchesInvolvingTokens({0, 1, 2}, doNotAbort);
+  EXPECT_EQ(matcher.allMatches().size(), 6);
+  // New products are only formed with the new token
+  matcher.addMatchesInvolvingTokens({3}, doNotAbort);
+  EXPECT_EQ(matcher.allMatches().size(), 12);
+  for (const auto& match : matcher.allMatches()) {
+    EXPECT_NE(match->inputTokens[0], match->inputTokens[1]);
+  }
+  matcher.removeMatchesInvolvingTokens({0});
+  EXPECT_EQ(matcher.allMatches().size(), 6);
+  matcher.removeMatchesInvolvingTokens({1, 2});
+  EXPECT_TRUE(matcher.empty());
+  // Component matches of removed tokens are not used anymore
+  matcher.addMatchesInvolvingTokens({}, doNotAbort);
+  EXPECT_TRUE(matcher.empty());
+}
+
+TEST(HypergraphMatcher, disconnectedInputsLazyProducts) {
+  // {{-1}, {-2}} -> {} has n (n - 1) matches, which are not stored, as they only differ by their tokens
+  constexpr int tokenCount = 2000;
+  const std::vector<Rule> rules = {{{{-1}, {-2}}, {}, EventSelectionFunction::All, 2},
+                                   {{{-1}}, {}, EventSelectionFunction::All, 3}};
+  // Random (the empty spec), Any, RuleIndex and WeightedRandom
+  for (const auto& orderingSpec : std::vector<HypergraphMatcher::OrderingSpec>{
+           {},
+           {{HypergraphMatcher::OrderingFunction::Any, HypergraphMatcher::OrderingDirection::Normal}},
+           {{HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}},
+           {{HypergraphMatcher::OrderingFunction::WeightedRandom, HypergraphMatcher::OrderingDirection::Normal}}}) {
+    const bool isWeightedRandom = HypergraphMatcher::isWeightedRandom(orderingSpec);
+    const bool isRuleIndex =
+        !orderingSpec.empty() && orderingSpec[0].first == HypergraphMatcher::OrderingFunction::RuleIndex;
+    // Only the products are chosen from first if ordered by the rule index
+    const auto expectedTotalWeight = [&](const double remainingTokens) {
+      const double productsWeight = remainingTokens * (remainingTokens - 1) * (isWeightedRandom ? 2 : 1);
+      return isRuleIndex ? productsWeight : productsWeight + remainingTokens * (isWeightedRandom ? 3 : 1);
+    };
+
+    UnaryTokens tokens(std::vector<Generation>(tokenCount, 0));
+    HypergraphMatcher matcher(rules,
+                              tokens.index(),
+                              tokens.getter(),
+                              unknownSeparation,
+                              orderingSpec,
+                              HypergraphMatcher::EventDeduplication::None);
+    matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+    // The matches themselves would take at least 4 million times the size of Match
+    EXPECT_LT(matcher.memoryUsage(), 100 * tokenCount * sizeof(Match));
+    EXPECT_EQ(matcher.totalWeight(), expectedTotalWeight(tokenCount));
+
+    int remainingTokens = tokenCount;
+    for (int event = 0; event < 100; ++event) {
+      const auto match = matcher.nextMatch();
+      ASSERT_EQ(match->inputTokens.size(), rules[match->rule].inputs.size());
+      if (match->rule == 0) EXPECT_NE(match->inputTokens[0], match->inputTokens[1]);
+      matcher.removeMatchesInvolvingTokens(match->inputTokens);
+      remainingTokens -= static_cast<int>(match->inputTokens.size());
+      ASSERT_EQ(matcher.totalWeight(), expectedTotalWeight(remainingTokens));
+    }
+
+    if (isRuleIndex) {
+      // Deleted products are not chosen again
+      const auto deletedMatch = matcher.nextMatch();
+      matcher.deleteMatch(deletedMatch);
+      EXPECT_EQ(matcher.totalWeight(), expectedTotalWeight(remainingTokens) - 1);
+      matcher.addMatchesInvolvingTokens({}, doNotAbort);
+      EXPECT_NE(matcher.nextMatch()->inputTokens, deletedMatch->inputTokens);
+    }
+  }
+}
+
+TEST(HypergraphMatcher, ruleWeightOrdering) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All, 1},
+                                   {{{-1}}, {{-1}}, EventSelectionFunction::All, 3},
+                                   {{{-1}}, {{-1, -1}}, EventSelectionFunction::All, 2}};
+  for (const auto direction : {HypergraphMatcher::OrderingDirection::Normal,
+                               HypergraphMatcher::OrderingDirection::Reverse}) {
+    UnaryTokens tokens({0});
+    HypergraphMatcher matcher(rules,
+                              tokens.index(),
+                              tokens.getter(),
+                              unknownSeparation,
+                              {{HypergraphMatcher::OrderingFunction::RuleWeight, direction}},
+                              HypergraphMatcher::EventDeduplication::None);
+    matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+    EXPECT_EQ(matcher.nextMatch()->rule, direction == HypergraphMatcher::OrderingDirection::Normal ? 0 : 1);
+  }
+}
+
+TEST(HypergraphMatcher, weightedRandomOrdering) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All, 1},
+                                   {{{-1}}, {{-1}}, EventSelectionFunction::All, 3}};
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::WeightedRandom, HypergraphMatcher::OrderingDirection::Normal}};
+  EXPECT_TRUE(HypergraphMatcher::isWeightedRandom(orderingSpec));
+  // Token i is chosen with probability proportional to i + 1
+  const GetMatchWeightFunc getMatchWeight = [](const Match& match) { return match.inputTokens[0] + 1.; };
+
+  constexpr int sampleCount = 4000;
+  int ruleCounts[2] = {};
+  int tokenCounts[4] = {};
+  for (unsigned int seed = 0; seed < sampleCount; ++seed) {
+    UnaryTokens tokens({0, 0, 0, 0});
+    HypergraphMatcher matcher(rules,
+                              tokens.index(),
+                              tokens.getter(),
+                              unknownSeparation,
+                              orderingSpec,
+                              HypergraphMatcher::EventDeduplication::None,
+                              seed,
+                              {},
+                              HypergraphMatcher::MatchRemoval::Eager,
+                              false,
+                              getMatchWeight);
+    matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+    ASSERT_EQ(matcher.totalWeight(), (1 + 3) * (1 + 2 + 3 + 4));
+    const auto match = matcher.nextMatch();
+    ++ruleCounts[match->rule];
+    ++tokenCounts[match->inputTokens[0]];
+    matcher.deleteMatch(match);
+    ASSERT_EQ(matcher.totalWeight(), 40 - rules[match->rule].weight * getMatchWeight(*match));
+  }
+  EXPECT_NEAR(static_cast<double>(ruleCounts[1]) / sampleCount, 0.75, 0.03);
+  for (int token = 0; token < 4; ++token) {
+    EXPECT_NEAR(static_cast<double>(tokenCounts[token]) / sampleCount, (token + 1) / 10., 0.03);
+  }
+}
+
+TEST(HypergraphMatcher, invalidWeights) {
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::WeightedRandom, HypergraphMatcher::OrderingDirection::Normal}};
+  UnaryTokens tokens({0, 0});
+  const std::vector<Rule> zeroWeightRules = {{{{-1}}, {}, EventSelectionFunction::All, 0}};
+  EXPECT_THROW(HypergraphMatcher(zeroWeightRules,
+                                 tokens.index(),
+                                 tokens.getter(),
+                                 unknownSeparation,
+                                 orderingSpec,
+                                 HypergraphMatcher::EventDeduplication::None),
+               HypergraphMatcher::Error);
+  // Weights are not used by other orderings
+  EXPECT_NO_THROW(HypergraphMatcher(zeroWeightRules,
+                                    tokens.index(),
+                                    tokens.getter(),
+                                    unknownSeparation,
+                                    {},
+                                    HypergraphMatcher::EventDeduplication::None));
+
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  HypergraphMatcher matcher(rules,
+                            tokens.index(),
+                            tokens.getter(),
+                            unknownSeparation,
+                            orderingSpec,
+                            HypergraphMatcher::EventDeduplication::None,
+                            0,
+                            {},
+                            HypergraphMatcher::MatchRemoval::Eager,
+                            false,
+                            [](const Match& match) { return match.inputTokens[0] == 0 ? 1. : -1.; });
+  EXPECT_THROW(matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort), HypergraphMatcher::Error);
+}
+
+TEST(HypergraphMatcher, lazyMatchRemoval) {
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}};
+  EXPECT_TRUE(HypergraphMatcher::isTotalOrder(orderingSpec));
+  EXPECT_FALSE(HypergraphMatcher::isTotalOrder({orderingSpec.front()}));
+
+  UnaryTokens tokens(std::vector<Generation>(10, 0));
+  HypergraphMatcher matcher(rules,
+                            tokens.index(),
+                            tokens.getter(),
+                            unknownSeparation,
+                            orderingSpec,
+                            HypergraphMatcher::EventDeduplication::None,
+                            0,
+                            {},
+                            HypergraphMatcher::MatchRemoval::Lazy);
+  matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+  matcher.removeMatchesInvolvingTokens({0, 2});
+  // Stale matches are neither chosen nor returned
+  EXPECT_EQ(matcher.nextMatch()->inputTokens, std::vector<TokenID>({1}));
+  EXPECT_EQ(matcher.allMatches().size(), 8);
+  matcher.removeMatchesInvolvingTokens({1, 3, 4, 5, 6, 7, 8});
+  EXPECT_EQ(matcher.nextMatch()->inputTokens, std::vector<TokenID>({9}));
+  EXPECT_EQ(matcher.allMatches().size(), 1);
+  matcher.removeMatchesInvolvingTokens({9});
+  EXPECT_TRUE(matcher.empty());
+  EXPECT_TRUE(matcher.allMatches().empty());
+}
+
+TEST(HypergraphMatcher, tokensSplitBetweenThreads) {
+  // If the order is total, large lists of tokens are split between threads even for a single rule
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+       HypergraphMatcher::OrderingDirection::Reverse},
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}};
+  const auto chosenTokens = [&rules, &orderingSpec](const int hardwareThreads) {
+    Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, hardwareThreads);
+    UnaryTokens tokens(std::vector<Generation>(5000, 0));
+    HypergraphMatcher matcher(rules,
+                              tokens.index(),
+                              tokens.getter(),
+                              unknownSeparation,
+                              orderingSpec,
+                              HypergraphMatcher::EventDeduplication::None);
+    matcher.addMatchesInvolvingTokens(tokens.ids(), doNotAbort);
+    std::vector<TokenID> result;
+    while (!matcher.empty()) {
+      result.push_back(matcher.nextMatch()->inputTokens[0]);
+      matcher.removeMatchesInvolvingTokens(matcher.nextMatch()->inputTokens);
+    }
+    return result;
+  };
+  const auto parallelResult = chosenTokens(4);
+  const auto sequentialResult = chosenTokens(1);
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu,
+                                                   static_cast<int>(std::thread::hardware_concurrency()));
+  EXPECT_EQ(parallelResult.size(), 5000);
+  EXPECT_EQ(parallelResult, sequentialResult);
+  EXPECT_EQ(parallelResult.front(), 4999);
+}
+}  // namespace SetReplace
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <unordered_map>
 #include <vector>
@@ -99,7 +100,7 @@ TEST(HypergraphSubstitutionSystem, maxDestroyerEvents1) {
   }
 }
 
-std::unordered_map<TokenID, uint64_t> getDestroyerEventsCountMap(const std::vector<Event>& events) {
+std::unordered_map<TokenID, uint64_t> getDestroyerEventsCountMap(const EventsView& events) {
   std::unordered_map<TokenID, uint64_t> destroyerEventsCountMap;
   for (const auto& event : events) {
     for (const auto& id : event.inputTokens) {
@@ -139,6 +140,25 @@ TEST(HypergraphSubstitutionSystem, maxDestroyerEventsMultiwaySpacelike) {
   EXPECT_EQ(aSystem3.events()[5].outputTokens, (std::vector<TokenID>{18, 19, 20, 21}));
 }
 
+TEST(HypergraphSubstitutionSystem, spacelikeAfterBranchMerge) {
+  const std::vector<Rule> rules = {
+      {{{1}}, {{2}}, EventSelectionFunction::All},
+      {{{1}}, {{3}}, EventSelectionFunction::All},
+      // merges the branches
+      {{{2}, {3}}, {{4}, {5}}, EventSelectionFunction::All},
+      // the outputs of the merging event are spacelike separated
+      {{{4}, {5}}, {{6}}, EventSelectionFunction::Spacelike},
+      // but the merged branches are not
+      {{{2}, {3}}, {{7}}, EventSelectionFunction::Spacelike}};
+  HypergraphSubstitutionSystem system(rules,
+                                      {{1}},
+                                      HypergraphSubstitutionSystem::stepLimitDisabled,
+                                      {},
+                                      HypergraphMatcher::EventDeduplication::None);
+  EXPECT_EQ(system.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 4);
+  EXPECT_EQ(system.tokens(), (std::vector<AtomsVector>{{1}, {3}, {2}, {4}, {5}, {6}}));
+}
+
 TEST(HypergraphSubstitutionSystem, replaceOnce) {
   HypergraphMatcher::OrderingSpec orderingSpec = {
       {HypergraphMatcher::OrderingFunction::SortedInputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
@@ -163,4 +183,226 @@ TEST(HypergraphSubstitutionSystem, multiruleSeeding) {
   }
   EXPECT_EQ(std::max(replacedTokenCounts[0], replacedTokenCounts[1]), trialCount);
 }
+
+TEST(HypergraphSubstitutionSystem, disconnectedInputs) {
+  // {{-1, -2}, {-3, -4}} -> {{-1, -4}} merges two edges into one until a single edge is left
+  const std::vector<Rule> rules = {{{{-1, -2}, {-3, -4}}, {{-1, -4}}, EventSelectionFunction::All}};
+  HypergraphSubstitutionSystem system(
+      rules, {{1, 2}, {3, 4}, {5, 6}, {7, 8}}, 1, {}, HypergraphMatcher::EventDeduplication::None, 0);
+  EXPECT_EQ(system.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 3);
+  EXPECT_EQ(system.terminationReason(), HypergraphSubstitutionSystem::TerminationReason::Complete);
+  for (EventID event = 1; event <= 3; ++event) {
+    EXPECT_NE(system.events()[event].inputTokens[0], system.events()[event].inputTokens[1]);
+  }
+  EXPECT_EQ(system.tokenCount(), 7);
+}
+
+TEST(HypergraphSubstitutionSystem, deferredMatching) {
+  // Matching of new tokens is deferred for the default ordering, but not if it starts with Any, which does not change
+  // the order
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::ReverseSortedInputTokenIndices,
+       HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::InputTokenIndices, HypergraphMatcher::OrderingDirection::Normal},
+      {HypergraphMatcher::OrderingFunction::RuleIndex, HypergraphMatcher::OrderingDirection::Normal}};
+  EXPECT_TRUE(HypergraphMatcher::ordersNewerTokensLast(orderingSpec));
+  HypergraphMatcher::OrderingSpec immediateOrderingSpec = orderingSpec;
+  immediateOrderingSpec.insert(
+      immediateOrderingSpec.begin(),
+      {HypergraphMatcher::OrderingFunction::Any, HypergraphMatcher::OrderingDirection::Normal});
+  EXPECT_FALSE(HypergraphMatcher::ordersNewerTokensLast(immediateOrderingSpec));
+
+  const std::vector<Rule> rules = {{{{-1, -2}, {-1, -3}}, {{-1, -2}, {-2, -4}, {-3, -4}, {-1, -4}}},
+                                   {{{-1, -1}}, {{-1, -2}}}};
+  const auto evolve = [&rules](const HypergraphMatcher::OrderingSpec& spec) {
+    HypergraphSubstitutionSystem system(
+        rules, {{1, 1}, {1, 1}}, 1, spec, HypergraphMatcher::EventDeduplication::None, 0);
+    EXPECT_EQ(system.replace(HypergraphSubstitutionSystem::StepSpecification{1000}, doNotAbort), 1000);
+    return system;
+  };
+  const auto deferredSystem = evolve(orderingSpec);
+  const auto immediateSystem = evolve(immediateOrderingSpec);
+  EXPECT_EQ(deferredSystem.tokens(), immediateSystem.tokens());
+  for (EventID event = 0; event <= 1000; ++event) {
+    EXPECT_EQ(deferredSystem.events()[event].rule, immediateSystem.events()[event].rule);
+    const auto deferredInputs = deferredSystem.events()[event].inputTokens;
+    const auto immediateInputs = immediateSystem.events()[event].inputTokens;
+    EXPECT_TRUE(
+        std::equal(deferredInputs.begin(), deferredInputs.end(), immediateInputs.begin(), immediateInputs.end()));
+  }
+}
+
+TEST(HypergraphSubstitutionSystem, memoryUsage) {
+  // Grows a ring
+  const std::vector<Rule> rules = {{{{-1, -2}, {-2, -3}}, {{-1, -3}, {-3, -4}, {-4, -2}, {-2, -3}}}};
+  HypergraphSubstitutionSystem system(
+      rules, {{1, 2}, {2, 3}, {3, 1}}, 1, {}, HypergraphMatcher::EventDeduplication::None, 0);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{10}, doNotAbort);
+  const auto smallUsage = system.memoryUsage();
+  EXPECT_GT(smallUsage.tokens, 0);
+  EXPECT_GT(smallUsage.events, 0);
+  EXPECT_GT(smallUsage.atomsIndex, 0);
+  EXPECT_GT(smallUsage.matches, 0);
+  // States are not tracked
+  EXPECT_EQ(smallUsage.stateGraph, 0);
+  EXPECT_EQ(smallUsage.total(),
+            smallUsage.tokens + smallUsage.events + smallUsage.separation + smallUsage.atomsIndex + smallUsage.matches +
+                smallUsage.stateGraph);
+
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{10000}, doNotAbort);
+  const auto largeUsage = system.memoryUsage();
+  // At least the atoms of the tokens, and the input and output token IDs of the events
+  EXPECT_GE(largeUsage.tokens, static_cast<int64_t>(system.tokenCount() * 2 * sizeof(Atom)));
+  EXPECT_GE(largeUsage.events, static_cast<int64_t>(10000 * 6 * sizeof(TokenID)));
+  EXPECT_GT(largeUsage.atomsIndex, smallUsage.atomsIndex);
+  // Separation is not tracked for singleway systems
+  EXPECT_EQ(largeUsage.separation, smallUsage.separation);
+}
+
+TEST(HypergraphSubstitutionSystem, maxMemory) {
+  const std::vector<Rule> rules = {{{{-1, -2}, {-2, -3}}, {{-1, -3}, {-3, -4}, {-4, -2}, {-2, -3}}}};
+  HypergraphSubstitutionSystem system(
+      rules, {{1, 2}, {2, 3}, {3, 1}}, 1, {}, HypergraphMatcher::EventDeduplication::None, 0);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{100}, doNotAbort);
+
+  HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  stepSpec.maxEvents = 100000;
+  stepSpec.maxMemoryBytes = 4 * system.memoryUsage().total();
+  const int64_t eventCount = system.replace(stepSpec, doNotAbort);
+  EXPECT_EQ(system.terminationReason(), HypergraphSubstitutionSystem::TerminationReason::MaxMemory);
+  EXPECT_GT(eventCount, 0);
+  EXPECT_LT(eventCount, stepSpec.maxEvents);
+  EXPECT_GT(system.memoryUsage().total(), stepSpec.maxMemoryBytes);
+
+  // The system can continue once the limit is raised
+  stepSpec.maxMemoryBytes *= 2;
+  EXPECT_GT(system.replace(stepSpec, doNotAbort), 0);
+}
+
+TEST(HypergraphSubstitutionSystem, maxMemoryStateDeduplication) {
+  // Each edge is flipped independently, so each combination of the flips is a separate state, and the number of states
+  // grows faster than the number of events
+  const std::vector<Rule> rules = {{{{-1, -2}}, {{-2, -1}}, EventSelectionFunction::All}};
+  std::vector<AtomsVector> initialTokens;
+  for (Atom atom = 1; atom <= 6; atom += 2) initialTokens.push_back({atom, atom + 1});
+  HypergraphSubstitutionSystem system(rules,
+                                      initialTokens,
+                                      max64int,
+                                      {},
+                                      HypergraphMatcher::EventDeduplication::None,
+                                      0,
+                                      MultiwayStateGraph::StateDeduplication::SameTokens);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{100}, doNotAbort);
+  EXPECT_GT(system.memoryUsage().stateGraph, 0);
+
+  HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  stepSpec.maxEvents = 100000;
+  stepSpec.maxMemoryBytes = 4 * system.memoryUsage().total();
+  const int64_t eventCount = system.replace(stepSpec, doNotAbort);
+  EXPECT_EQ(system.terminationReason(), HypergraphSubstitutionSystem::TerminationReason::MaxMemory);
+  EXPECT_GT(eventCount, 0);
+  EXPECT_LT(eventCount, stepSpec.maxEvents);
+  const auto usage = system.memoryUsage();
+  EXPECT_GT(usage.total(), stepSpec.maxMemoryBytes);
+  // The states are what takes the memory here, so the limit would not be reached without them
+  EXPECT_GT(usage.stateGraph, usage.total() / 2);
+}
+
+TEST(HypergraphSubstitutionSystem, eventTimes) {
+  // Each of the tokens decays with rate 1, so half of them decay by the time log(2)
+  const std::vector<Rule> rules = {{{{-1}}, {}, EventSelectionFunction::All}};
+  constexpr int tokenCount = 10000;
+  std::vector<AtomsVector> initialTokens;
+  for (int i = 1; i <= tokenCount; ++i) initialTokens.push_back({i});
+  const HypergraphMatcher::OrderingSpec orderingSpec = {
+      {HypergraphMatcher::OrderingFunction::WeightedRandom, HypergraphMatcher::OrderingDirection::Normal}};
+  HypergraphSubstitutionSystem system(
+      rules, initialTokens, 1, orderingSpec, HypergraphMatcher::EventDeduplication::None, 0);
+  EXPECT_EQ(system.eventTimes(), std::vector<double>({0}));
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{tokenCount / 2}, doNotAbort);
+
+  const auto& times = system.eventTimes();
+  ASSERT_EQ(times.size(), system.events().size());
+  EXPECT_TRUE(std::is_sorted(times.begin(), times.end()));
+  EXPECT_NEAR(times.back(), std::log(2), 0.05);
+
+  HypergraphSubstitutionSystem unweightedSystem(
+      rules, initialTokens, 1, {}, HypergraphMatcher::EventDeduplication::None);
+  unweightedSystem.replace(HypergraphSubstitutionSystem::StepSpecification{10}, doNotAbort);
+  EXPECT_TRUE(unweightedSystem.eventTimes().empty());
+}
+
+HypergraphSubstitutionSystem testSystemStateDeduplication(
+    const uint64_t maxDestroyerEvents, const MultiwayStateGraph::StateDeduplication stateDeduplication) {
+  // {{1}} -> {{1, 2}}
+  std::vector<Rule> rules = {{{{-1}}, {{-1, -2}}, EventSelectionFunction::All}};
+  return HypergraphSubstitutionSystem(
+      rules, {{1}, {2}}, maxDestroyerEvents, {}, HypergraphMatcher::EventDeduplication::None, 0, stateDeduplication);
+}
+
+TEST(HypergraphSubstitutionSystem, atomCountOverflow) {
+  // The initial atom is the last one below the largest atom ID, so the new atom of {{-1}} -> {{-1, -2}} cannot be named
+  const std::vector<Rule> rules = {{{{-1}}, {{-1, -2}}, EventSelectionFunction::All}};
+  HypergraphSubstitutionSystem aSystem(
+      rules, {{std::numeric_limits<Atom>::max() - 1}}, 1, {}, HypergraphMatcher::EventDeduplication::None, 0);
+  EXPECT_THROW(aSystem.replace(HypergraphSubstitutionSystem::StepSpecification{1}, doNotAbort),
+               HypergraphSubstitutionSystem::Error);
+}
+
+TEST(HypergraphSubstitutionSystem, stateDeduplicationDisabled) {
+  auto aSystem = testSystemStateDeduplication(max64int, MultiwayStateGraph::StateDeduplication::Disabled);
+  EXPECT_EQ(aSystem.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 2);
+  EXPECT_TRUE(aSystem.states().empty());
+  EXPECT_TRUE(aSystem.stateTransitions().empty());
+}
+
+TEST(HypergraphSubstitutionSystem, stateDeduplicationSameTokens) {
+  auto aSystem = testSystemStateDeduplication(max64int, MultiwayStateGraph::StateDeduplication::SameTokens);
+  EXPECT_EQ(aSystem.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 2);
+  // The two events commute, so the final state is reached along two different paths
+  EXPECT_EQ(aSystem.states(), (std::vector<std::vector<TokenID>>{{0, 1}, {1, 2}, {0, 3}, {2, 3}}));
+  EXPECT_EQ(aSystem.stateTransitions().size(), 4);
+  for (const auto& transition : aSystem.stateTransitions()) {
+    EXPECT_EQ(transition.target == 3, transition.source != 0);
+  }
+}
+
+TEST(HypergraphSubstitutionSystem, stateDeduplicationSameAtomsVectors) {
+  // New atoms are named differently on different branches, so no additional states are merged
+  auto aSystem = testSystemStateDeduplication(max64int, MultiwayStateGraph::StateDeduplication::SameAtomsVectors);
+  EXPECT_EQ(aSystem.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 2);
+  EXPECT_EQ(aSystem.states().size(), 4);
+  EXPECT_EQ(aSystem.stateTransitions().size(), 4);
+}
+
+TEST(HypergraphSubstitutionSystem, stateDeduplicationIsomorphicAtomsVectors) {
+  auto aSystem =
+      testSystemStateDeduplication(max64int, MultiwayStateGraph::StateDeduplication::IsomorphicAtomsVectors);
+  EXPECT_EQ(aSystem.replace(HypergraphSubstitutionSystem::StepSpecification(), doNotAbort), 2);
+  // {{2}, {1, 3}} and {{1}, {2, 4}} are isomorphic
+  EXPECT_EQ(aSystem.states(), (std::vector<std::vector<TokenID>>{{0, 1}, {1, 2}, {2, 3}}));
+  EXPECT_EQ(aSystem.stateTransitions().size(), 3);
+}
+
+TEST(HypergraphSubstitutionSystem, stateDeduplicationSharesSubsequentEvents) {
+  // {{1, 2}} -> {{2, 1}} returns to the initial state after two events
+  std::vector<Rule> rules = {{{{-1, -2}}, {{-2, -1}}, EventSelectionFunction::All}};
+  HypergraphSubstitutionSystem::StepSpecification stepSpec;
+  stepSpec.maxEvents = 10;
+
+  HypergraphSubstitutionSystem aSystem(rules, {{1, 2}}, 1, {}, HypergraphMatcher::EventDeduplication::None, 0);
+  EXPECT_EQ(aSystem.replace(stepSpec, doNotAbort), 10);
+
+  HypergraphSubstitutionSystem aDeduplicatingSystem(rules,
+                                                    {{1, 2}},
+                                                    1,
+                                                    {},
+                                                    HypergraphMatcher::EventDeduplication::None,
+                                                    0,
+                                                    MultiwayStateGraph::StateDeduplication::SameAtomsVectors);
+  EXPECT_EQ(aDeduplicatingSystem.replace(stepSpec, doNotAbort), 2);
+  EXPECT_EQ(aDeduplicatingSystem.terminationReason(), HypergraphSubstitutionSystem::TerminationReason::Complete);
+  EXPECT_EQ(aDeduplicatingSystem.states().size(), 2);
+  EXPECT_EQ(aDeduplicatingSystem.stateTransitions().back().target, initialState);
+}
 }  // namespace SetReplace
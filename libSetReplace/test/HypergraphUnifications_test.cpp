@@ -0,0 +1,76 @@
+#include "HypergraphUnifications.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+constexpr auto doNotAbort = []() { return false; };
+
+std::vector<HypergraphUnification> allUnifications(const std::vector<AtomsVector>& first,
+                                                   const std::vector<AtomsVector>& second) {
+  std::vector<HypergraphUnification> result;
+  HypergraphUnifications::enumerate(
+      first,
+      second,
+      [&result](const HypergraphUnification& unification) { result.push_back(unification); },
+      doNotAbort);
+  return result;
+}
+
+TEST(HypergraphUnifications, singleEdge) {
+  const auto unifications = allUnifications({{1, 2}}, {{1, 2}});
+  ASSERT_EQ(unifications.size(), 1);
+  EXPECT_EQ(unifications[0].hypergraph, std::vector<AtomsVector>({{1, 2}}));
+  EXPECT_EQ(unifications[0].firstEdgeIndices, std::vector<int64_t>({0}));
+  EXPECT_EQ(unifications[0].secondEdgeIndices, std::vector<int64_t>({0}));
+
+  EXPECT_TRUE(allUnifications({{1, 2}}, {{1, 2, 3}}).empty());
+  EXPECT_TRUE(allUnifications({}, {{1}}).empty());
+}
+
+TEST(HypergraphUnifications, edgeIndices) {
+  const auto unifications = allUnifications({{1, 2}, {3, 4}}, {{1, 2}});
+  ASSERT_EQ(unifications.size(), 2);
+  EXPECT_EQ(unifications[0].hypergraph, std::vector<AtomsVector>({{1, 2}, {3, 4}}));
+  EXPECT_EQ(unifications[0].firstEdgeIndices, std::vector<int64_t>({1, 0}));
+  EXPECT_EQ(unifications[0].secondEdgeIndices, std::vector<int64_t>({1}));
+  EXPECT_EQ(unifications[1].firstEdgeIndices, std::vector<int64_t>({0, 1}));
+  EXPECT_EQ(unifications[1].secondEdgeIndices, std::vector<int64_t>({1}));
+}
+
+TEST(HypergraphUnifications, vertexIdentifications) {
+  // {1, 2} is matched to {a, b} and {2, 1} to {b, c}, so a = c = 1, b = 2
+  const auto unifications = allUnifications({{1, 2}, {2, 1}}, {{1, 2}, {2, 3}});
+  ASSERT_EQ(unifications.size(), 6);
+  EXPECT_EQ(unifications[1].hypergraph, std::vector<AtomsVector>({{1, 2}, {2, 1}}));
+}
+
+TEST(HypergraphUnifications, counts) {
+  EXPECT_EQ(allUnifications({{1, 2}, {2, 3}, {3, 4}}, {{1, 2}, {2, 3}, {3, 4}}).size(), 33);
+  EXPECT_EQ(allUnifications({{1, 2}, {2, 3}, {3, 4, 5}}, {{1, 2}, {2, 3}, {3, 4, 5}}).size(), 13);
+  EXPECT_EQ(allUnifications({{1, 2}, {2, 3, 4}}, {{1, 2}, {2, 3, 4}}).size(), 3);
+}
+
+TEST(HypergraphUnifications, parallelOrder) {
+  const std::vector<AtomsVector> hypergraph = {{1, 2}, {2, 3}, {3, 1}, {1, 4}};
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 1);
+  const auto sequential = allUnifications(hypergraph, hypergraph);
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 4);
+  const auto parallel = allUnifications(hypergraph, hypergraph);
+  ASSERT_EQ(sequential.size(), parallel.size());
+  for (size_t i = 0; i < sequential.size(); ++i) {
+    EXPECT_EQ(sequential[i].hypergraph, parallel[i].hypergraph);
+    EXPECT_EQ(sequential[i].firstEdgeIndices, parallel[i].firstEdgeIndices);
+    EXPECT_EQ(sequential[i].secondEdgeIndices, parallel[i].secondEdgeIndices);
+  }
+}
+
+TEST(HypergraphUnifications, abort) {
+  EXPECT_THROW(HypergraphUnifications::enumerate(
+                   {{1, 2}}, {{1, 2}}, [](const HypergraphUnification&) {}, []() { return true; }),
+               HypergraphUnifications::Error);
+}
+}  // namespace SetReplace
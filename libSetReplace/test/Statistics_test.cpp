@@ -0,0 +1,106 @@
+#include "Statistics.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+void expectAllZero(const Statistics& statistics) {
+  for (int i = 0; i < static_cast<int>(Statistics::Counter::Count); ++i) {
+    EXPECT_EQ(statistics.count(static_cast<Statistics::Counter>(i)), 0);
+  }
+  for (int i = 0; i < static_cast<int>(Statistics::Timer::Count); ++i) {
+    EXPECT_EQ(statistics.time(static_cast<Statistics::Timer>(i)).count(), 0);
+  }
+}
+}  // namespace
+
+TEST(Statistics, accumulation) {
+  Statistics first;
+  Statistics second;
+  expectAllZero(first);
+
+  first.increment(Statistics::Counter::MatchAttempts);
+  second.increment(Statistics::Counter::MatchAttempts, 2);
+  second.increment(Statistics::Counter::IndexLookups, 5);
+  {
+    Statistics::ScopedTimer timer(&second, Statistics::Timer::CandidateSelection);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  first += second;
+
+  if (Statistics::enabled) {
+    EXPECT_EQ(first.count(Statistics::Counter::MatchAttempts), 3);
+    EXPECT_EQ(first.count(Statistics::Counter::IndexLookups), 5);
+    EXPECT_EQ(first.count(Statistics::Counter::ArityPrunes), 0);
+    EXPECT_GE(first.time(Statistics::Timer::CandidateSelection), std::chrono::milliseconds(1));
+    EXPECT_EQ(first.time(Statistics::Timer::Deduplication).count(), 0);
+  } else {
+    expectAllZero(first);
+  }
+}
+
+TEST(Statistics, names) {
+  EXPECT_EQ(std::string(Statistics::name(Statistics::Counter::MatchAttempts)), "MatchAttempts");
+  EXPECT_EQ(std::string(Statistics::name(Statistics::Counter::IndexRemovals)), "IndexRemovals");
+  EXPECT_EQ(std::string(Statistics::name(Statistics::Timer::IndexUpdate)), "IndexUpdate");
+  EXPECT_EQ(std::string(Statistics::name(Statistics::Counter::Count)), "Unknown");
+}
+
+TEST(Statistics, evolution) {
+  // {{-1, -2}} -> {{-1, -3}, {-3, -2}}, with a second rule that can never match, but is attempted on every token
+  const std::vector<Rule> rules = {{{{-1, -2}}, {{-1, -3}, {-3, -2}}}, {{{-1, -1}, {-1, -2, -3}}, {}}};
+  HypergraphSubstitutionSystem system(rules, {{1, 2}}, 1, {}, HypergraphMatcher::EventDeduplication::None);
+  EXPECT_EQ(system.replace(HypergraphSubstitutionSystem::StepSpecification{5}, doNotAbort), 5);
+  const auto statistics = system.statistics();
+
+  if (!Statistics::enabled) {
+    expectAllZero(statistics);
+    return;
+  }
+
+  // Every event removes its input token, and every match is removed once its token is.
+  EXPECT_EQ(statistics.count(Statistics::Counter::IndexRemovals), 5);
+  EXPECT_EQ(statistics.count(Statistics::Counter::MatchesRemoved), 5);
+  // All tokens except the outputs of the last event are indexed before the next event.
+  EXPECT_EQ(statistics.count(Statistics::Counter::IndexInsertions), 9);
+  EXPECT_EQ(statistics.count(Statistics::Counter::MatchesInserted), 9);
+  EXPECT_EQ(statistics.count(Statistics::Counter::DuplicateMatches), 0);
+  // Binary tokens are attempted on the {-1, -1} input of the second rule, and fail to bind
+  EXPECT_GT(statistics.count(Statistics::Counter::BindingFailures), 0);
+  // and on its ternary input, which does not match by size.
+  EXPECT_GT(statistics.count(Statistics::Counter::ArityPrunes), 0);
+  EXPECT_EQ(statistics.count(Statistics::Counter::MatchAttempts),
+            statistics.count(Statistics::Counter::MatchesInserted) +
+                statistics.count(Statistics::Counter::ArityPrunes) +
+                statistics.count(Statistics::Counter::BindingFailures));
+  EXPECT_EQ(statistics.count(Statistics::Counter::SeparationFailures), 0);
+  EXPECT_EQ(statistics.count(Statistics::Counter::DeduplicationComparisons), 0);
+}
+
+TEST(Statistics, deduplication) {
+  // {{-1, -2}, {-2, -3}} -> {{-1, -3}} has two isomorphic matches of a symmetric input pair
+  const std::vector<Rule> rules = {{{{-1, -2}, {-2, -3}}, {{-1, -3}}}};
+  HypergraphSubstitutionSystem system(rules,
+                                      {{1, 2}, {2, 1}},
+                                      HypergraphSubstitutionSystem::stepLimitDisabled,
+                                      {},
+                                      HypergraphMatcher::EventDeduplication::SameInputSetIsomorphicOutputs);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{1}, doNotAbort);
+  const auto statistics = system.statistics();
+
+  if (Statistics::enabled) {
+    EXPECT_GT(statistics.count(Statistics::Counter::DeduplicationComparisons), 0);
+  } else {
+    expectAllZero(statistics);
+  }
+}
+}  // namespace SetReplace
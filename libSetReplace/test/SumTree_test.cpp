@@ -0,0 +1,66 @@
+#include "SumTree.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "Arena.hpp"
+
+namespace SetReplace {
+TEST(SumTree, totalAndFind) {
+  SumTree<> tree;
+  EXPECT_EQ(tree.total(), 0);
+  for (const double weight : {1., 2., 0., 3., 4.}) tree.push_back(weight);
+  EXPECT_EQ(tree.size(), 5);
+  EXPECT_EQ(tree.total(), 10);
+  EXPECT_EQ(tree.weight(3), 3);
+
+  EXPECT_EQ(tree.find(0), 0);
+  EXPECT_EQ(tree.find(0.99), 0);
+  EXPECT_EQ(tree.find(1), 1);
+  // The item with zero weight is skipped
+  EXPECT_EQ(tree.find(3), 3);
+  EXPECT_EQ(tree.find(5.99), 3);
+  EXPECT_EQ(tree.find(6), 4);
+  EXPECT_EQ(tree.find(9.99), 4);
+  // Out of range due to rounding
+  EXPECT_EQ(tree.find(10), 4);
+
+  tree.set(4, 0);
+  EXPECT_EQ(tree.total(), 6);
+  EXPECT_EQ(tree.find(6), 3);
+  tree.pop_back();
+  tree.pop_back();
+  EXPECT_EQ(tree.size(), 3);
+  EXPECT_EQ(tree.total(), 3);
+  tree.push_back(5);
+  EXPECT_EQ(tree.weight(3), 5);
+  EXPECT_EQ(tree.total(), 8);
+}
+
+TEST(SumTree, noDriftAfterUpdates) {
+  Arena arena;
+  SumTree<ArenaAllocator<double>> tree{ArenaAllocator<double>(&arena)};
+  std::mt19937 randomGenerator(0);
+  std::uniform_real_distribution<double> weights(0, 1e6);
+  for (int i = 0; i < 1000; ++i) tree.push_back(weights(randomGenerator));
+  for (int i = 0; i < 100000; ++i) tree.set(static_cast<size_t>(i % 1000), weights(randomGenerator));
+  for (size_t i = 0; i < 1000; ++i) tree.set(i, 0.25);
+  EXPECT_EQ(tree.total(), 250);
+}
+
+TEST(SumTree, sampling) {
+  SumTree<> tree;
+  const std::vector<double> weights = {1, 0, 2, 7};
+  for (const double weight : weights) tree.push_back(weight);
+  std::mt19937 randomGenerator(0);
+  std::uniform_real_distribution<double> points(0, tree.total());
+  constexpr int sampleCount = 100000;
+  std::vector<int> counts(weights.size());
+  for (int i = 0; i < sampleCount; ++i) ++counts[tree.find(points(randomGenerator))];
+  for (size_t i = 0; i < weights.size(); ++i) {
+    EXPECT_NEAR(static_cast<double>(counts[i]) / sampleCount, weights[i] / tree.total(), 0.01);
+  }
+}
+}  // namespace SetReplace
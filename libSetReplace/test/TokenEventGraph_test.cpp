@@ -0,0 +1,86 @@
+#include "TokenEventGraph.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace SetReplace {
+namespace {
+// Token 0 is destroyed by events 1, 2 and 4 on different branches, and event 3 merges the first two of them.
+TokenEventGraph branchMergingGraph(const TokenEventGraph::SeparationTrackingMethod separationTrackingMethod) {
+  TokenEventGraph graph(1, separationTrackingMethod);
+  EXPECT_EQ(graph.addEvent(0, {0}, 1), std::vector<TokenID>({1}));
+  EXPECT_EQ(graph.addEvent(0, {0}, 1), std::vector<TokenID>({2}));
+  EXPECT_EQ(graph.addEvent(1, {1, 2}, 2), std::vector<TokenID>({3, 4}));
+  EXPECT_EQ(graph.addEvent(0, {0}, 1), std::vector<TokenID>({5}));
+  return graph;
+}
+}  // namespace
+
+TEST(TokenEventGraph, eventsIterator) {
+  TokenEventGraph graph(2, TokenEventGraph::SeparationTrackingMethod::None);
+  graph.addEvent(3, {0, 1}, 1);
+  // The iterator outlives the temporary view
+  auto iterator = graph.events().begin();
+  ++iterator;
+  EXPECT_EQ((*iterator).rule, 3);
+  EXPECT_EQ((*iterator).inputTokens, std::vector<TokenID>({0, 1}));
+  EXPECT_EQ((*iterator).outputTokens, std::vector<TokenID>({2}));
+  EXPECT_EQ(++iterator, graph.events().end());
+
+  // Iterators of different graphs are different even at the same position
+  const TokenEventGraph otherGraph(0, TokenEventGraph::SeparationTrackingMethod::None);
+  EXPECT_NE(graph.events().begin(), otherGraph.events().begin());
+}
+
+TEST(TokenEventGraph, spacelikeSeparation) {
+  // Both methods are the same if no events merge branches
+  for (const auto separationTrackingMethod : {TokenEventGraph::SeparationTrackingMethod::DestroyerChoices,
+                                              TokenEventGraph::SeparationTrackingMethod::DestroyerChoiceSets}) {
+    TokenEventGraph graph(2, separationTrackingMethod);
+    graph.addEvent(0, {0}, 2);
+    graph.addEvent(0, {0}, 1);
+    graph.addEvent(0, {1, 3}, 1);
+    EXPECT_EQ(graph.tokenSeparation(2, 2), SeparationType::Identical);
+    EXPECT_EQ(graph.tokenSeparation(2, 3), SeparationType::Spacelike);
+    EXPECT_EQ(graph.tokenSeparation(1, 2), SeparationType::Spacelike);
+    EXPECT_EQ(graph.tokenSeparation(3, 5), SeparationType::Timelike);
+    EXPECT_EQ(graph.tokenSeparation(5, 1), SeparationType::Timelike);
+    EXPECT_EQ(graph.tokenSeparation(2, 4), SeparationType::Branchlike);
+    EXPECT_EQ(graph.tokenSeparation(4, 5), SeparationType::Branchlike);
+  }
+
+  const TokenEventGraph untrackedGraph(2, TokenEventGraph::SeparationTrackingMethod::None);
+  EXPECT_EQ(untrackedGraph.tokenSeparation(0, 1), SeparationType::Unknown);
+}
+
+TEST(TokenEventGraph, destroyerChoicesBranchMerge) {
+  const auto graph = branchMergingGraph(TokenEventGraph::SeparationTrackingMethod::DestroyerChoices);
+  EXPECT_EQ(graph.tokenSeparation(3, 4), SeparationType::Unknown);
+  EXPECT_EQ(graph.tokenSeparation(1, 2), SeparationType::Unknown);
+}
+
+TEST(TokenEventGraph, destroyerChoiceSetsBranchMerge) {
+  auto graph = branchMergingGraph(TokenEventGraph::SeparationTrackingMethod::DestroyerChoiceSets);
+  EXPECT_EQ(graph.tokenSeparation(3, 4), SeparationType::Spacelike);
+  EXPECT_EQ(graph.tokenSeparation(1, 2), SeparationType::Branchlike);
+  EXPECT_EQ(graph.tokenSeparation(3, 1), SeparationType::Timelike);
+  EXPECT_EQ(graph.tokenSeparation(2, 4), SeparationType::Timelike);
+  // Token 0 is destroyed by event 4 in the history of token 5, but by events 1 and 2 in the history of token 3
+  EXPECT_EQ(graph.tokenSeparation(3, 5), SeparationType::Branchlike);
+
+  // Continues on the branch of token 1 without the merge (token 1 is destroyed by event 6 instead of 3)
+  EXPECT_EQ(graph.addEvent(0, {1}, 1), std::vector<TokenID>({6}));
+  EXPECT_EQ(graph.tokenSeparation(6, 3), SeparationType::Branchlike);
+  EXPECT_EQ(graph.tokenSeparation(6, 2), SeparationType::Branchlike);
+  EXPECT_EQ(graph.tokenSeparation(6, 5), SeparationType::Branchlike);
+
+  // Merges again, now token 0 has to be destroyed by event 1, which is the only one allowed by both inputs
+  EXPECT_EQ(graph.addEvent(2, {4, 6}, 1), std::vector<TokenID>({7}));
+  EXPECT_EQ(graph.addEvent(0, {3}, 1), std::vector<TokenID>({8}));
+  EXPECT_EQ(graph.tokenSeparation(7, 8), SeparationType::Spacelike);
+  EXPECT_EQ(graph.tokenSeparation(7, 5), SeparationType::Branchlike);
+  EXPECT_EQ(graph.tokenSeparation(7, 2), SeparationType::Timelike);
+  EXPECT_GT(graph.separationMemoryUsage(), 0);
+}
+}  // namespace SetReplace
@@ -0,0 +1,90 @@
+#include "Tracing.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HypergraphSubstitutionSystem.hpp"
+#include "Parallelism.hpp"
+
+namespace SetReplace {
+namespace {
+constexpr auto doNotAbort = []() { return false; };
+
+int64_t occurrences(const std::string& string, const std::string& substring) {
+  int64_t count = 0;
+  for (size_t position = string.find(substring); position != std::string::npos;
+       position = string.find(substring, position + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+void evolve(const int64_t eventCount) {
+  // Two rules, so that matching is done in multiple threads
+  const std::vector<Rule> rules = {{{{-1, -2}}, {{-1, -3}, {-3, -2}}}, {{{-1, -2, -3}}, {}}};
+  HypergraphSubstitutionSystem system(rules, {{1, 2}}, 1, {}, HypergraphMatcher::EventDeduplication::None);
+  system.replace(HypergraphSubstitutionSystem::StepSpecification{eventCount}, doNotAbort);
+}
+
+std::string trace() {
+  std::ostringstream output;
+  Tracing::write(&output);
+  return output.str();
+}
+}  // namespace
+
+TEST(Tracing, evolutionPhases) {
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu, 3);
+  Tracing::start();
+  EXPECT_EQ(Tracing::isRecording(), Tracing::enabled);
+  evolve(10);
+  Tracing::stop();
+  EXPECT_FALSE(Tracing::isRecording());
+  const auto events = trace();
+  Parallelism::Testing::overrideNumHardwareThreads(Parallelism::HardwareType::StdCpu,
+                                                   static_cast<int>(std::thread::hardware_concurrency()));
+
+  EXPECT_EQ(events.rfind("{\"traceEvents\":[", 0), 0);
+  if (!Tracing::enabled) {
+    EXPECT_EQ(occurrences(events, "\"ph\":\"X\""), 0);
+    return;
+  }
+  EXPECT_EQ(occurrences(events, "\"name\":\"replaceOnce\""), 11);  // the last one finds no matches
+  EXPECT_EQ(occurrences(events, "\"name\":\"nameAnonymousAtoms\""), 10);
+  EXPECT_EQ(occurrences(events, "\"name\":\"removeMatchesInvolvingTokens\""), 10);
+  EXPECT_GT(occurrences(events, "\"name\":\"addMatchesForRules\""), 0);
+  EXPECT_GT(occurrences(events, "\"name\":\"indexNewTokens\""), 0);
+  // The main thread and at least one matching thread
+  EXPECT_GE(occurrences(events, "\"name\":\"thread_name\""), 2);
+
+  // Events are not recorded after stop()
+  evolve(10);
+  EXPECT_EQ(trace(), events);
+}
+
+TEST(Tracing, ringBuffer) {
+  Tracing::start("", 4);
+  evolve(100);
+  Tracing::stop();
+  const auto events = trace();
+  if (Tracing::enabled) {
+    // Only the last 4 events of each thread are kept
+    EXPECT_EQ(occurrences(events, "\"ph\":\"X\""), 4 * occurrences(events, "\"name\":\"thread_name\""));
+  } else {
+    EXPECT_EQ(occurrences(events, "\"ph\":\"X\""), 0);
+  }
+}
+
+TEST(Tracing, invalidOutputPath) {
+  if (Tracing::enabled) {
+    EXPECT_THROW(Tracing::start("/nonexistent-directory/trace.json"), Tracing::Error);
+    EXPECT_FALSE(Tracing::isRecording());
+  } else {
+    EXPECT_NO_THROW(Tracing::start("/nonexistent-directory/trace.json"));
+  }
+}
+}  // namespace SetReplace
@@ -0,0 +1,260 @@
+#include "setreplace.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "IDTypes.hpp"
+
+namespace SetReplace {
+namespace {
+// {{-1, -2}} -> {{-1, -3}, {-3, -2}}
+const std::vector<int64_t> ruleInputOffsets = {0, 2};
+const std::vector<int64_t> ruleInputAtoms = {-1, -2};
+const std::vector<int64_t> ruleOutputOffsets = {0, 2, 4};
+const std::vector<int64_t> ruleOutputAtoms = {-1, -3, -3, -2};
+// {{1, 2}}
+const std::vector<int64_t> initialOffsets = {0, 2};
+const std::vector<int64_t> initialAtoms = {1, 2};
+
+setreplace_system* createSystem(const setreplace_system_options& options) {
+  setreplace_rule rule;
+  setreplace_rule_init(&rule);
+  rule.inputs = {1, ruleInputOffsets.data(), ruleInputAtoms.data()};
+  rule.outputs = {2, ruleOutputOffsets.data(), ruleOutputAtoms.data()};
+  const setreplace_hypergraph initialTokens = {1, initialOffsets.data(), initialAtoms.data()};
+  setreplace_system* system;
+  EXPECT_EQ(setreplace_system_create(&rule, 1, &initialTokens, &options, &system), SETREPLACE_OK);
+  return system;
+}
+
+setreplace_system* createSystem() {
+  setreplace_system_options options;
+  setreplace_system_options_init(&options);
+  return createSystem(options);
+}
+}  // namespace
+
+TEST(setreplace, evolution) {
+  EXPECT_EQ(setreplace_api_version(), SETREPLACE_API_VERSION);
+  setreplace_system* system = createSystem();
+
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+  stepSpecification.max_events = 3;
+  int64_t eventCount;
+  ASSERT_EQ(setreplace_system_replace(system, &stepSpecification, 0, nullptr, &eventCount), SETREPLACE_OK);
+  EXPECT_EQ(eventCount, 3);
+  int32_t terminationReason;
+  ASSERT_EQ(setreplace_system_termination_reason(system, &terminationReason), SETREPLACE_OK);
+  EXPECT_EQ(terminationReason, SETREPLACE_TERMINATED_MAX_EVENTS);
+
+  int64_t tokenCount;
+  int64_t atomCount;
+  ASSERT_EQ(setreplace_system_tokens_size(system, &tokenCount, &atomCount), SETREPLACE_OK);
+  EXPECT_EQ(tokenCount, 7);
+  EXPECT_EQ(atomCount, 14);
+  std::vector<int64_t> tokenOffsets(tokenCount + 1);
+  std::vector<int64_t> tokenAtoms(atomCount);
+  EXPECT_EQ(setreplace_system_tokens(system, tokenCount, tokenOffsets.data(), atomCount, tokenAtoms.data()),
+            SETREPLACE_ERROR_BUFFER_TOO_SMALL);
+  EXPECT_EQ(setreplace_system_tokens(system, tokenCount + 1, tokenOffsets.data(), atomCount - 1, tokenAtoms.data()),
+            SETREPLACE_ERROR_BUFFER_TOO_SMALL);
+  ASSERT_EQ(setreplace_system_tokens(system, tokenCount + 1, tokenOffsets.data(), atomCount, tokenAtoms.data()),
+            SETREPLACE_OK);
+  EXPECT_EQ(tokenOffsets, std::vector<int64_t>({0, 2, 4, 6, 8, 10, 12, 14}));
+  EXPECT_EQ(tokenAtoms, std::vector<int64_t>({1, 2, 1, 4, 4, 2, 1, 5, 5, 4, 4, 6, 6, 2}));
+
+  setreplace_events_size eventsSize;
+  ASSERT_EQ(setreplace_system_events_size(system, &eventsSize), SETREPLACE_OK);
+  EXPECT_EQ(eventsSize.event_count, 4);
+  EXPECT_EQ(eventsSize.input_token_count, 3);
+  EXPECT_EQ(eventsSize.output_token_count, 7);
+  std::vector<int32_t> rules(eventsSize.event_count);
+  std::vector<int64_t> generations(eventsSize.event_count);
+  std::vector<int64_t> inputOffsets(eventsSize.event_count + 1);
+  std::vector<int64_t> inputTokens(eventsSize.input_token_count);
+  std::vector<int64_t> outputOffsets(eventsSize.event_count + 1);
+  std::vector<int64_t> outputTokens(eventsSize.output_token_count);
+  ASSERT_EQ(setreplace_system_events(system,
+                                     &eventsSize,
+                                     rules.data(),
+                                     generations.data(),
+                                     inputOffsets.data(),
+                                     inputTokens.data(),
+                                     outputOffsets.data(),
+                                     outputTokens.data()),
+            SETREPLACE_OK);
+  EXPECT_EQ(rules, std::vector<int32_t>({-1, 0, 0, 0}));
+  EXPECT_EQ(generations, std::vector<int64_t>({0, 1, 2, 2}));
+  EXPECT_EQ(inputOffsets, std::vector<int64_t>({0, 0, 1, 2, 3}));
+  EXPECT_EQ(inputTokens, std::vector<int64_t>({0, 1, 2}));
+  EXPECT_EQ(outputOffsets, std::vector<int64_t>({0, 1, 3, 5, 7}));
+  EXPECT_EQ(outputTokens, std::vector<int64_t>({0, 1, 2, 3, 4, 5, 6}));
+
+  // Buffers can be skipped
+  EXPECT_EQ(setreplace_system_events(system, &eventsSize, rules.data(), nullptr, nullptr, nullptr, nullptr, nullptr),
+            SETREPLACE_OK);
+  eventsSize.event_count = 3;
+  EXPECT_EQ(setreplace_system_events(system, &eventsSize, rules.data(), nullptr, nullptr, nullptr, nullptr, nullptr),
+            SETREPLACE_ERROR_BUFFER_TOO_SMALL);
+
+  int64_t generation;
+  ASSERT_EQ(setreplace_system_max_complete_generation(system, nullptr, &generation), SETREPLACE_OK);
+  EXPECT_EQ(generation, 2);
+
+  setreplace_system_destroy(system);
+}
+
+TEST(setreplace, abortFlag) {
+  setreplace_system* system = createSystem();
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+
+  volatile int32_t abortFlag = 0;
+  std::thread aborter([&abortFlag]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    abortFlag = 1;
+  });
+  int64_t eventCount;
+  EXPECT_EQ(setreplace_system_replace(system, &stepSpecification, 0, &abortFlag, &eventCount),
+            SETREPLACE_ERROR_ABORTED);
+  aborter.join();
+  EXPECT_GT(eventCount, 0);
+  int32_t terminationReason;
+  setreplace_system_termination_reason(system, &terminationReason);
+  EXPECT_EQ(terminationReason, SETREPLACE_TERMINATED_ABORTED);
+
+  setreplace_events_size eventsSize;
+  setreplace_system_events_size(system, &eventsSize);
+  EXPECT_EQ(eventsSize.event_count, eventCount + 1);
+  setreplace_system_destroy(system);
+}
+
+TEST(setreplace, timeConstraint) {
+  setreplace_system* system = createSystem();
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+  EXPECT_EQ(setreplace_system_replace(system, &stepSpecification, 0.1, nullptr, nullptr), SETREPLACE_OK);
+  int32_t terminationReason;
+  setreplace_system_termination_reason(system, &terminationReason);
+  EXPECT_EQ(terminationReason, SETREPLACE_TERMINATED_TIME_CONSTRAINED);
+  setreplace_system_destroy(system);
+}
+
+TEST(setreplace, maxMemory) {
+  setreplace_system* system = createSystem();
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+  stepSpecification.max_memory_bytes = 0;
+  int64_t eventCount = -1;
+  EXPECT_EQ(setreplace_system_replace(system, &stepSpecification, 0, nullptr, &eventCount), SETREPLACE_OK);
+  EXPECT_EQ(eventCount, 0);
+  int32_t terminationReason;
+  setreplace_system_termination_reason(system, &terminationReason);
+  EXPECT_EQ(terminationReason, SETREPLACE_TERMINATED_MAX_MEMORY);
+  setreplace_system_destroy(system);
+}
+
+TEST(setreplace, eventTimes) {
+  setreplace_system* system = createSystem();
+  int64_t eventCount;
+  EXPECT_EQ(setreplace_system_event_times(system, 0, nullptr, &eventCount), SETREPLACE_ERROR_INVALID_ARGUMENT);
+  setreplace_system_destroy(system);
+
+  setreplace_system_options options;
+  setreplace_system_options_init(&options);
+  const int32_t orderingFunction = SETREPLACE_ORDERING_WEIGHTED_RANDOM;
+  const int32_t orderingDirection = SETREPLACE_ORDERING_NORMAL;
+  options.ordering_count = 1;
+  options.ordering_functions = &orderingFunction;
+  options.ordering_directions = &orderingDirection;
+  system = createSystem(options);
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+  stepSpecification.max_events = 5;
+  ASSERT_EQ(setreplace_system_replace(system, &stepSpecification, 0, nullptr, nullptr), SETREPLACE_OK);
+
+  ASSERT_EQ(setreplace_system_event_times(system, 0, nullptr, &eventCount), SETREPLACE_OK);
+  EXPECT_EQ(eventCount, 6);
+  std::vector<double> times(eventCount);
+  EXPECT_EQ(setreplace_system_event_times(system, eventCount - 1, times.data(), nullptr),
+            SETREPLACE_ERROR_BUFFER_TOO_SMALL);
+  ASSERT_EQ(setreplace_system_event_times(system, eventCount, times.data(), nullptr), SETREPLACE_OK);
+  EXPECT_EQ(times[0], 0);
+  for (size_t i = 1; i < times.size(); ++i) EXPECT_GT(times[i], times[i - 1]);
+  setreplace_system_destroy(system);
+}
+
+TEST(setreplace, invalidArguments) {
+  setreplace_system_options options;
+  setreplace_system_options_init(&options);
+  const setreplace_hypergraph emptyHypergraph = {0, nullptr, nullptr};
+  setreplace_system* system;
+  EXPECT_EQ(setreplace_system_create(nullptr, 1, &emptyHypergraph, &options, &system),
+            SETREPLACE_ERROR_INVALID_ARGUMENT);
+  EXPECT_EQ(system, nullptr);
+  EXPECT_EQ(setreplace_system_create(nullptr, 0, nullptr, &options, &system), SETREPLACE_ERROR_INVALID_ARGUMENT);
+
+  const int32_t invalidOrderingFunction = 100;
+  const int32_t orderingDirection = SETREPLACE_ORDERING_NORMAL;
+  options.ordering_count = 1;
+  options.ordering_functions = &invalidOrderingFunction;
+  options.ordering_directions = &orderingDirection;
+  EXPECT_EQ(setreplace_system_create(nullptr, 0, &emptyHypergraph, &options, &system),
+            SETREPLACE_ERROR_INVALID_ARGUMENT);
+
+  setreplace_system_options_init(&options);
+  const std::vector<int64_t> nonPositiveAtoms = {0, 1};
+  const setreplace_hypergraph nonPositiveHypergraph = {1, initialOffsets.data(), nonPositiveAtoms.data()};
+  EXPECT_EQ(setreplace_system_create(nullptr, 0, &nonPositiveHypergraph, &options, &system),
+            SETREPLACE_ERROR_NON_POSITIVE_ATOMS);
+
+  // Only out of range of the 32-bit atoms of the compact ID mode
+  const std::vector<int64_t> largeAtoms = {1, int64_t{1} << 40};
+  const setreplace_hypergraph largeAtomsHypergraph = {1, initialOffsets.data(), largeAtoms.data()};
+  EXPECT_EQ(setreplace_system_create(nullptr, 0, &largeAtomsHypergraph, &options, &system),
+            SetReplace::compactIDs ? SETREPLACE_ERROR_ATOM_COUNT_OVERFLOW : SETREPLACE_OK);
+  setreplace_system_destroy(system);
+
+  EXPECT_EQ(setreplace_system_replace(nullptr, nullptr, 0, nullptr, nullptr), SETREPLACE_ERROR_INVALID_ARGUMENT);
+  EXPECT_STREQ(setreplace_status_message(SETREPLACE_ERROR_BUFFER_TOO_SMALL), "buffer is too small");
+}
+
+TEST(setreplace, structSizeMismatch) {
+  // As if the caller was compiled against a header, in which the structs are smaller
+  setreplace_rule rules[2];
+  for (auto& rule : rules) {
+    setreplace_rule_init(&rule);
+    rule.inputs = {1, ruleInputOffsets.data(), ruleInputAtoms.data()};
+    rule.outputs = {2, ruleOutputOffsets.data(), ruleOutputAtoms.data()};
+  }
+  const setreplace_hypergraph emptyHypergraph = {0, nullptr, nullptr};
+  setreplace_system_options options;
+  setreplace_system_options_init(&options);
+  setreplace_system* system;
+  ASSERT_EQ(setreplace_system_create(rules, 2, &emptyHypergraph, &options, &system), SETREPLACE_OK);
+  setreplace_system_destroy(system);
+
+  rules[1].struct_size = sizeof(setreplace_rule) - sizeof(double);
+  EXPECT_EQ(setreplace_system_create(rules, 2, &emptyHypergraph, &options, &system),
+            SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH);
+  EXPECT_EQ(system, nullptr);
+  rules[1].struct_size = sizeof(setreplace_rule);
+  options.struct_size = sizeof(setreplace_system_options) - sizeof(uint32_t);
+  EXPECT_EQ(setreplace_system_create(rules, 2, &emptyHypergraph, &options, &system),
+            SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH);
+
+  setreplace_system_options_init(&options);
+  system = createSystem(options);
+  setreplace_step_specification stepSpecification;
+  setreplace_step_specification_init(&stepSpecification);
+  stepSpecification.max_events = 1;
+  stepSpecification.struct_size = sizeof(setreplace_step_specification) - sizeof(int64_t);
+  EXPECT_EQ(setreplace_system_replace(system, &stepSpecification, 0, nullptr, nullptr),
+            SETREPLACE_ERROR_STRUCT_SIZE_MISMATCH);
+  setreplace_system_destroy(system);
+}
+}  // namespace SetReplace
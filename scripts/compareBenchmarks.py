@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Compares two JSON outputs of HypergraphSubstitutionSystem_benchmark and flags regressions.
+
+Usage: compareBenchmarks.py BASELINE.json CONTENDER.json [--threshold 0.05]
+
+The JSON files are produced with --benchmark_out=FILE --benchmark_out_format=json. If the benchmarks were run with
+--benchmark_repetitions, medians are compared. Exits with status 1 if any metric regressed by more than the threshold.
+
+peakRSSBytes is the high-water mark of the whole process at the end of each benchmark, so it is only comparable between
+runs with the same --benchmark_filter.
+"""
+
+import argparse
+import json
+import sys
+
+# Metric name -> whether larger values are better.
+METRICS = {
+    "eventsPerSecond": True,
+    "matchesPerSecond": True,
+    "allocationsPerEvent": False,
+    "allocationsPerMatch": False,
+    "peakRSSBytes": False,
+}
+
+def load_results(path):
+    with open(path) as file:
+        benchmarks = json.load(file)["benchmarks"]
+    has_medians = any(benchmark.get("aggregate_name") == "median" for benchmark in benchmarks)
+    results = {}
+    for benchmark in benchmarks:
+        if has_medians:
+            if benchmark.get("aggregate_name") != "median":
+                continue
+            name = benchmark["run_name"]
+        else:
+            if benchmark.get("run_type", "iteration") != "iteration":
+                continue
+            name = benchmark["name"]
+        results[name] = {metric: benchmark[metric] for metric in METRICS if metric in benchmark}
+    return results
+
+def relative_change(baseline, contender, larger_is_better):
+    if baseline == 0:
+        return 0.0
+    change = (contender - baseline) / baseline
+    return change if larger_is_better else -change
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative change that counts as a regression (default: 0.05)")
+    arguments = parser.parse_args()
+
+    baseline = load_results(arguments.baseline)
+    contender = load_results(arguments.contender)
+
+    regressions = []
+    print(f"{'benchmark':<80} {'metric':<20} {'baseline':>14} {'contender':>14} {'change':>8}")
+    for name in sorted(baseline.keys() & contender.keys()):
+        for metric, larger_is_better in METRICS.items():
+            if metric not in baseline[name] or metric not in contender[name]:
+                continue
+            old = baseline[name][metric]
+            new = contender[name][metric]
+            improvement = relative_change(old, new, larger_is_better)
+            flag = ""
+            if improvement < -arguments.threshold:
+                flag = "  REGRESSION"
+                regressions.append((name, metric))
+            print(f"{name:<80} {metric:<20} {old:>14.6g} {new:>14.6g} {improvement:>+8.1%}{flag}")
+
+    for name in sorted(baseline.keys() - contender.keys()):
+        print(f"{name}: missing from {arguments.contender}")
+    for name in sorted(contender.keys() - baseline.keys()):
+        print(f"{name}: missing from {arguments.baseline}")
+
+    if regressions:
+        print(f"\n{len(regressions)} regression(s) above {arguments.threshold:.1%}")
+        return 1
+    print(f"\nNo regressions above {arguments.threshold:.1%}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())